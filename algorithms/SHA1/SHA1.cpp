@@ -153,6 +153,7 @@ static uint32_t ntohl(uint32_t bigEndian); // Standard "net endian to host endia
 #endif
 static void SHA1PadMessage(SHA1Context *);
 static void SHA1ProcessMessageBlock(SHA1Context *);
+static void SHA1ProcessMessageBlocks(uint32_t Intermediate_Hash[5], const uint8_t *blocks, unsigned int nBlocks);
 
 /*
  * SHA1Reset
@@ -268,20 +269,44 @@ int SHA1Input(SHA1Context *context, ///< 上下文指针
 	if (context->Corrupted) {
 		return context->Corrupted;
 	}
-	while (length-- && !context->Corrupted) {
-		context->Message_Block[context->Message_Block_Index++] = (*message_array & 0xFF);
-		context->Length_Low += 8;
-		if (context->Length_Low == 0) {
-			context->Length_High++;
-			if (context->Length_High == 0) {
-				/* Message is too long */
-				context->Corrupted = 1;
-			}
+	/* 更新消息总长度(按比特计数, 64 位) */
+	uint64_t nBits = ((uint64_t) context->Length_High << 32) | context->Length_Low;
+	uint64_t nAddBits = (uint64_t) length << 3;
+	if (nBits + nAddBits < nBits) {
+		/* Message is too long */
+		context->Corrupted = 1;
+		return shaSuccess;
+	}
+	nBits += nAddBits;
+	context->Length_Low = (uint32_t) nBits;
+	context->Length_High = (uint32_t) (nBits >> 32);
+
+	/* 先补齐上次余留的不完整分组 */
+	if (context->Message_Block_Index > 0) {
+		unsigned int n = 64 - context->Message_Block_Index;
+		if (n > length) {
+			n = length;
 		}
-		if (context->Message_Block_Index == 64) {
-			SHA1ProcessMessageBlock(context);
+		memcpy(context->Message_Block + context->Message_Block_Index, message_array, n);
+		context->Message_Block_Index += n;
+		message_array += n;
+		length -= n;
+		if (context->Message_Block_Index < 64) {
+			return shaSuccess;
 		}
-		message_array++;
+		SHA1ProcessMessageBlock(context);
+	}
+	/* 完整的分组直接从调用者的缓冲区读取, 不必逐字节复制到 Message_Block */
+	if (length >= 64) {
+		unsigned int nBlocks = length / 64;
+		SHA1ProcessMessageBlocks(context->Intermediate_Hash, message_array, nBlocks);
+		message_array += 64 * nBlocks;
+		length -= 64 * nBlocks;
+	}
+	/* 缓存最后余留的数据(不足 64 字节) */
+	if (length > 0) {
+		memcpy(context->Message_Block, message_array, length);
+		context->Message_Block_Index = length;
 	}
 	return shaSuccess;
 }
@@ -353,14 +378,16 @@ void SHA1PadMessage(SHA1Context *context) {
 	(((word) << (bits)) | ((word) >> (32-(bits))))
 
 /*
- * SHA1ProcessMessageBlock
+ * SHA1ProcessMessageBlocksPortable
  *
  * Description:
- * This function will process the next 512 bits of the message
- * stored in the Message_Block array.
+ * This function will process the next nBlocks * 512 bits of the
+ * message, read directly from the caller's buffer.
  *
  * Parameters:
- * None.
+ * Intermediate_Hash: [in/out]
+ * blocks: [in] 不要求 4 字节对齐
+ * nBlocks: [in]
  *
  * Returns:
  * Nothing.
@@ -371,7 +398,7 @@ void SHA1PadMessage(SHA1Context *context) {
  * names used in the publication.
  *
  */
-void SHA1ProcessMessageBlock(SHA1Context *context) {
+static void SHA1ProcessMessageBlocksPortable(uint32_t Intermediate_Hash[5], const uint8_t *blocks, unsigned int nBlocks) {
 	/** Constants defined in SHA-1 (Always stroed in localhost's endian format)*/
 	const uint32_t K[] = {
 			ntohl(0x9979825A), // =0x5A827999 for little endian CPU(e.g. x86)
@@ -383,21 +410,22 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 	uint32_t temp; /* Temporary word value (Always stroed in localhost's endian format)*/
 	uint32_t W[80]; /* Word sequence (Always stroed in localhost's endian format)*/
 	uint32_t A, B, C, D, E; /* Word buffers (Always stroed in localhost's endian format)*/
+	for (; nBlocks > 0; nBlocks--, blocks += 64) {
 	/*
 	 * Initialize the first 16 words in the array W
 	 */
-	uint32_t *p; // Pointer to a big endian uint32_t's memory address. Note: 此处要求 context->Message_Block[64] 必须是4字节对正的内存块 否则无法快速访问
-	for (t = 0, p = (uint32_t *) (context->Message_Block); t < 16; t++, p++) {
-		W[t] = ntohl(*p);
+	const uint8_t *p; // 按字节读取大端格式的 32 位整数, 因此调用者的缓冲区不必 4 字节对齐
+	for (t = 0, p = blocks; t < 16; t++, p += 4) {
+		W[t] = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | ((uint32_t) p[3]);
 	}
 	for (t = 16; t < 80; t++) {
 		W[t] = SHA1CircularShift(1, (W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16]));
 	}
-	A = context->Intermediate_Hash[0];
-	B = context->Intermediate_Hash[1];
-	C = context->Intermediate_Hash[2];
-	D = context->Intermediate_Hash[3];
-	E = context->Intermediate_Hash[4];
+	A = Intermediate_Hash[0];
+	B = Intermediate_Hash[1];
+	C = Intermediate_Hash[2];
+	D = Intermediate_Hash[3];
+	E = Intermediate_Hash[4];
 	for (t = 0; t < 20; t++) {
 		temp = SHA1CircularShift(5, A) + ((B & C) | ((~B) & D)) + E + W[t] + K[0];
 		E = D;
@@ -430,11 +458,189 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 		B = A;
 		A = temp;
 	}
-	context->Intermediate_Hash[0] += A;
-	context->Intermediate_Hash[1] += B;
-	context->Intermediate_Hash[2] += C;
-	context->Intermediate_Hash[3] += D;
-	context->Intermediate_Hash[4] += E;
+	Intermediate_Hash[0] += A;
+	Intermediate_Hash[1] += B;
+	Intermediate_Hash[2] += C;
+	Intermediate_Hash[3] += D;
+	Intermediate_Hash[4] += E;
+	} // end for (nBlocks)
+}
+
+
+// ===========================================================================
+// 使用 Intel SHA 扩展指令集(SHA-NI)的分组处理函数, 运行时检测 CPU 是否支持
+// ===========================================================================
+
+/*
+ * 编译时定义 SHA1_NO_SIMD 宏可以禁用 SHA-NI 加速代码, 始终使用上面的 C 语言实现
+ */
+#if !defined(SHA1_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_HAVE_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+
+/**
+ * 查询 CPU 是否支持 SHA 扩展指令集(同时要求 SSSE3 和 SSE4.1)
+ */
+static int SHA1CPUSupportsSHANI()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+	if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) {
+		return 0;
+	}
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return 0;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx >> 29) & 1; // CPUID.(EAX=07H,ECX=0):EBX.SHA[bit 29]
+}
+
+/**
+ * SHA-NI 版本的分组处理函数
+ *
+ * 每 4 轮运算使用一条 sha1rnds4 指令, 消息扩展使用 sha1msg1/sha1msg2 指令
+ */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void SHA1ProcessMessageBlocksSHANI(uint32_t Intermediate_Hash[5], const uint8_t *blocks, unsigned int nBlocks)
+{
+	__m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL); // 大端字节序转换
+
+	ABCD = _mm_loadu_si128((const __m128i *) Intermediate_Hash);
+	E0 = _mm_set_epi32(Intermediate_Hash[4], 0, 0, 0);
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+
+	for (; nBlocks > 0; nBlocks--, blocks += 64) {
+		ABCD_SAVE = ABCD;
+		E0_SAVE = E0;
+
+		/* Rounds 0-3 */
+		MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 0)), MASK);
+		E0 = _mm_add_epi32(E0, MSG0);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+		/* Rounds 4-7 */
+		MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 16)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+		/* Rounds 8-11 */
+		MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 32)), MASK);
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+		MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+		MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+		/* Rounds 12-15 */
+		MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 48)), MASK);
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+		MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+		MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+/*
+ * Rounds 16-67 每 4 轮的指令序列相同, 只是 4 个消息寄存器轮换使用.
+ * 参数: Ea/Eb 为交替使用的 E 寄存器, M0..M3 为轮换后的消息寄存器, F 为轮函数编号(0-3)
+ */
+#define SHA1_SHANI_4ROUNDS(Ea, Eb, M0, M1, M2, M3, F) \
+		Ea = _mm_sha1nexte_epu32(Ea, M0); \
+		Eb = ABCD; \
+		M1 = _mm_sha1msg2_epu32(M1, M0); \
+		ABCD = _mm_sha1rnds4_epu32(ABCD, Ea, F); \
+		M3 = _mm_sha1msg1_epu32(M3, M0); \
+		M2 = _mm_xor_si128(M2, M0);
+
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG0, MSG1, MSG2, MSG3, 0) /* Rounds 16-19 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG1, MSG2, MSG3, MSG0, 1) /* Rounds 20-23 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG2, MSG3, MSG0, MSG1, 1) /* Rounds 24-27 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG3, MSG0, MSG1, MSG2, 1) /* Rounds 28-31 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG0, MSG1, MSG2, MSG3, 1) /* Rounds 32-35 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG1, MSG2, MSG3, MSG0, 1) /* Rounds 36-39 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG2, MSG3, MSG0, MSG1, 2) /* Rounds 40-43 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG3, MSG0, MSG1, MSG2, 2) /* Rounds 44-47 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG0, MSG1, MSG2, MSG3, 2) /* Rounds 48-51 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG1, MSG2, MSG3, MSG0, 2) /* Rounds 52-55 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG2, MSG3, MSG0, MSG1, 2) /* Rounds 56-59 */
+		SHA1_SHANI_4ROUNDS(E1, E0, MSG3, MSG0, MSG1, MSG2, 3) /* Rounds 60-63 */
+		SHA1_SHANI_4ROUNDS(E0, E1, MSG0, MSG1, MSG2, MSG3, 3) /* Rounds 64-67 */
+#undef SHA1_SHANI_4ROUNDS
+
+		/* Rounds 68-71 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG1);
+		E0 = ABCD;
+		MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+		MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+		/* Rounds 72-75 */
+		E0 = _mm_sha1nexte_epu32(E0, MSG2);
+		E1 = ABCD;
+		MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+		/* Rounds 76-79 */
+		E1 = _mm_sha1nexte_epu32(E1, MSG3);
+		E0 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+
+		/* Combine state */
+		E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+		ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+	}
+
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+	_mm_storeu_si128((__m128i *) Intermediate_Hash, ABCD);
+	Intermediate_Hash[4] = (uint32_t) _mm_extract_epi32(E0, 3);
+}
+#endif // SHA1_HAVE_SHANI
+
+// ===========================================================================
+// 分组处理函数的运行时分派
+// ===========================================================================
+
+typedef void (*SHA1BlocksFunction)(uint32_t Intermediate_Hash[5], const uint8_t *blocks, unsigned int nBlocks);
+
+/**
+ * 首次调用时检测 CPU 特性, 选出最快的分组处理函数
+ */
+static SHA1BlocksFunction SHA1SelectBlocksFunction()
+{
+#if defined(SHA1_HAVE_SHANI)
+	if (SHA1CPUSupportsSHANI()) {
+		return SHA1ProcessMessageBlocksSHANI;
+	}
+#endif
+	return SHA1ProcessMessageBlocksPortable;
+}
+
+/**
+ * 连续处理 nBlocks 个 512 比特分组
+ */
+static void SHA1ProcessMessageBlocks(uint32_t Intermediate_Hash[5], const uint8_t *blocks, unsigned int nBlocks)
+{
+	static const SHA1BlocksFunction process = SHA1SelectBlocksFunction(); // C++ 保证局部静态变量只初始化一次
+	process(Intermediate_Hash, blocks, nBlocks);
+}
+
+/*
+ * SHA1ProcessMessageBlock
+ *
+ * Description:
+ * This function will process the next 512 bits of the message
+ * stored in the Message_Block array.
+ */
+void SHA1ProcessMessageBlock(SHA1Context *context) {
+	SHA1ProcessMessageBlocks(context->Intermediate_Hash, context->Message_Block, 1);
 	context->Message_Block_Index = 0;
 }
 
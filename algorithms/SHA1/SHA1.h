@@ -15,6 +15,9 @@
 * @note 关于 SHA1 哈希算法的详细描述和实现代码请查阅 RFC3174
 * @see https://tools.ietf.org/html/rfc3174
 *
+* @note 在支持 Intel SHA 扩展指令集(SHA-NI)的 x86 CPU 上, 运行时自动切换到 SHA-NI 加速代码;
+* 编译时定义 SHA1_NO_SIMD 宏可禁用加速代码
+*
 * 库函数调用方法请参考相应目录下的示例程序:
 * @example example.c 是一个 C 语言示例程序
 * @example example.cpp 是一个 C++ 语言示例程序
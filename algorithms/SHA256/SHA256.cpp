@@ -0,0 +1,243 @@
+/* encoding: utf-8 */
+/// @file SHA256.cpp
+/// @details SHA256 哈希算法的 C 底层实现
+/// @copyright Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+/// All rights reserved.
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring> // using standard C functions: memset() / memcpy()
+
+#include "SHA256.h"
+
+/** 单个数据分组的尺寸(单位:字节) */
+#define SHA256_BLOCK_SIZE	64
+
+/**
+ * 内部上下文结构体
+ *
+ * @note _SHA256Context 和 SHA256Context 完全相同, 前缀带下划线的只在本文件内部使用
+ */
+struct _SHA256Context {
+	uint32_t Intermediate_Hash[SHA256HashSize / 4]; ///< Message Digest (Always stored in localhost's endian format)
+	uint64_t nBits; ///< Total input bits received
+	/** Index into message block array */
+	int Message_Block_Index;
+	uint8_t Message_Block[SHA256_BLOCK_SIZE]; ///< 512-bit message blocks
+	int Computed; ///< Is the digest computed?
+	int Corrupted; ///< Is the message digest corrupted?
+};
+
+/* Local Function Prototyptes */
+static void SHA256ProcessMessageBlock(uint32_t H[8], const uint8_t block[SHA256_BLOCK_SIZE]);
+
+// ===========================================================================
+// SHA256 上下文的创建和释放(C 语言 API 接口)
+// ===========================================================================
+
+SHA256Context *SHA256CreateNewContext()
+{
+	SHA256Context *context;
+
+	context = (SHA256Context *) malloc(sizeof(SHA256Context));
+	SHA256Reset(context); // 默认自动执行一次复位清零
+	return context;
+}
+
+void SHA256DeleteContext(SHA256Context *context)
+{
+	if (context) {
+		memset(context, 0x00, sizeof(SHA256Context)); // 清除内部残留数据
+	}
+	free(context);
+}
+
+// ===========================================================================
+// 以下内容为 SHA256 哈希算法的 C 语言底层实现
+// ===========================================================================
+
+int SHA256Reset(SHA256Context *context)
+{
+	if (!context) {
+		return shaNull;
+	}
+	context->Intermediate_Hash[0] = 0x6A09E667;
+	context->Intermediate_Hash[1] = 0xBB67AE85;
+	context->Intermediate_Hash[2] = 0x3C6EF372;
+	context->Intermediate_Hash[3] = 0xA54FF53A;
+	context->Intermediate_Hash[4] = 0x510E527F;
+	context->Intermediate_Hash[5] = 0x9B05688C;
+	context->Intermediate_Hash[6] = 0x1F83D9AB;
+	context->Intermediate_Hash[7] = 0x5BE0CD19;
+	context->nBits = 0;
+	context->Message_Block_Index = 0;
+	context->Computed = 0;
+	context->Corrupted = 0;
+	return shaSuccess;
+}
+
+int SHA256Input(SHA256Context *context, ///< 上下文指针
+		const uint8_t message_array[], ///< 数据
+		unsigned int length ///< 数据长度
+		)
+{
+	if (!length) {
+		return shaSuccess;
+	}
+	if (!context || !message_array) {
+		return shaNull;
+	}
+	if (context->Computed) {
+		context->Corrupted = shaStateError;
+		return shaStateError;
+	}
+	if (context->Corrupted) {
+		return context->Corrupted;
+	}
+	uint64_t nBits = context->nBits + ((uint64_t) length << 3);
+	if (nBits < context->nBits) {
+		/* Message is too long */
+		context->Corrupted = shaInputTooLong;
+		return shaInputTooLong;
+	}
+	context->nBits = nBits;
+
+	/* 先补齐上次余留的不完整分组 */
+	if (context->Message_Block_Index > 0) {
+		unsigned int n = SHA256_BLOCK_SIZE - context->Message_Block_Index;
+		if (n > length) {
+			n = length;
+		}
+		memcpy(context->Message_Block + context->Message_Block_Index, message_array, n);
+		context->Message_Block_Index += n;
+		message_array += n;
+		length -= n;
+		if (context->Message_Block_Index < SHA256_BLOCK_SIZE) {
+			return shaSuccess;
+		}
+		SHA256ProcessMessageBlock(context->Intermediate_Hash, context->Message_Block);
+		context->Message_Block_Index = 0;
+	}
+	/* 完整的分组直接从调用者的缓冲区读取, 不必复制 */
+	while (length >= SHA256_BLOCK_SIZE) {
+		SHA256ProcessMessageBlock(context->Intermediate_Hash, message_array);
+		message_array += SHA256_BLOCK_SIZE;
+		length -= SHA256_BLOCK_SIZE;
+	}
+	/* 缓存最后余留的数据 */
+	if (length > 0) {
+		memcpy(context->Message_Block, message_array, length);
+		context->Message_Block_Index = length;
+	}
+	return shaSuccess;
+}
+
+int SHA256Result(SHA256Context *context, uint8_t Message_Digest[SHA256HashSize])
+{
+	int i;
+	if (!context || !Message_Digest) {
+		return shaNull;
+	}
+	if (context->Corrupted) {
+		return context->Corrupted;
+	}
+	if (!context->Computed) {
+		/* Padding: 0x80, 0x00..., 64 比特大端格式的消息长度 */
+		uint64_t nBits = context->nBits;
+		context->Message_Block[context->Message_Block_Index++] = 0x80;
+		if (context->Message_Block_Index > 56) {
+			memset(context->Message_Block + context->Message_Block_Index, 0x00, SHA256_BLOCK_SIZE - context->Message_Block_Index);
+			SHA256ProcessMessageBlock(context->Intermediate_Hash, context->Message_Block);
+			context->Message_Block_Index = 0;
+		}
+		memset(context->Message_Block + context->Message_Block_Index, 0x00, 56 - context->Message_Block_Index);
+		for (i = 0; i < 8; i++) {
+			context->Message_Block[63 - i] = (uint8_t) (nBits >> (8 * i));
+		}
+		SHA256ProcessMessageBlock(context->Intermediate_Hash, context->Message_Block);
+		/* message may be sensitive, clear it out */
+		memset(context->Message_Block, 0x00, sizeof(context->Message_Block));
+		context->Message_Block_Index = 0;
+		context->nBits = 0; /* and clear length */
+		context->Computed = 1;
+	}
+	for (i = 0; i < 8; i++) {
+		uint32_t h = context->Intermediate_Hash[i];
+		Message_Digest[4 * i + 0] = (uint8_t) (h >> 24);
+		Message_Digest[4 * i + 1] = (uint8_t) (h >> 16);
+		Message_Digest[4 * i + 2] = (uint8_t) (h >> 8);
+		Message_Digest[4 * i + 3] = (uint8_t) (h);
+	}
+	return shaSuccess;
+}
+
+/** 32 位循环右移 */
+#define SHA256_ROTR(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define SHA256_CH(x,y,z)  (((x) & (y)) ^ (~(x) & (z)))
+#define SHA256_MAJ(x,y,z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SHA256_BSIG0(x) (SHA256_ROTR(x, 2) ^ SHA256_ROTR(x,13) ^ SHA256_ROTR(x,22))
+#define SHA256_BSIG1(x) (SHA256_ROTR(x, 6) ^ SHA256_ROTR(x,11) ^ SHA256_ROTR(x,25))
+#define SHA256_SSIG0(x) (SHA256_ROTR(x, 7) ^ SHA256_ROTR(x,18) ^ ((x) >> 3))
+#define SHA256_SSIG1(x) (SHA256_ROTR(x,17) ^ SHA256_ROTR(x,19) ^ ((x) >> 10))
+
+/** Constants defined in SHA-256 */
+static const uint32_t K[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+/**
+ * 压缩函数: 处理一个 512 比特数据分组
+ *
+ * @note block 可以指向调用者缓冲区中任意地址(不要求 4 字节对齐)
+ */
+static void SHA256ProcessMessageBlock(uint32_t H[8], const uint8_t block[SHA256_BLOCK_SIZE])
+{
+	uint32_t W[64];
+	uint32_t A, B, C, D, E, F, G, Hh, T1, T2;
+	int t;
+
+	for (t = 0; t < 16; t++) {
+		W[t] = ((uint32_t) block[4 * t] << 24) | ((uint32_t) block[4 * t + 1] << 16)
+				| ((uint32_t) block[4 * t + 2] << 8) | ((uint32_t) block[4 * t + 3]);
+	}
+	for (t = 16; t < 64; t++) {
+		W[t] = SHA256_SSIG1(W[t - 2]) + W[t - 7] + SHA256_SSIG0(W[t - 15]) + W[t - 16];
+	}
+
+	A = H[0];
+	B = H[1];
+	C = H[2];
+	D = H[3];
+	E = H[4];
+	F = H[5];
+	G = H[6];
+	Hh = H[7];
+	for (t = 0; t < 64; t++) {
+		T1 = Hh + SHA256_BSIG1(E) + SHA256_CH(E, F, G) + K[t] + W[t];
+		T2 = SHA256_BSIG0(A) + SHA256_MAJ(A, B, C);
+		Hh = G;
+		G = F;
+		F = E;
+		E = D + T1;
+		D = C;
+		C = B;
+		B = A;
+		A = T1 + T2;
+	}
+	H[0] += A;
+	H[1] += B;
+	H[2] += C;
+	H[3] += D;
+	H[4] += E;
+	H[5] += F;
+	H[6] += G;
+	H[7] += Hh;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file SHA256.h
+ * @brief SHA256 哈希算法 C 语言头文件
+ *
+ * @note 关于 SHA256 哈希算法的详细描述请查阅 FIPS PUB 180-4 以及 RFC6234
+ * @see https://tools.ietf.org/html/rfc6234
+ *
+ * 库函数调用方法请参考相应目录下的示例程序:
+ * @example example.c 是一个 C 语言示例程序
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#if (defined(__GNUC__) || (defined(_MSC_VER) && (_MSC_VER >= 1600)))
+#include <stdint.h>
+/*
+ * GCC 始终支持 <stdint.h>
+ * Mircrosoft Visual Studio 2010 以上版本(_MSC_VER >= 1600)才支持 C99 标准 <stdint.h>
+ */
+#else
+/*
+ * If you do not have the ISO standard stdint.h header file, then you
+ * must typdef the following:
+ * name meaning
+ * uint32_t unsigned 32 bit integer
+ * uint8_t unsigned 8 bit integer (i.e., unsigned char)
+ */
+#include <windef.h>
+typedef BYTE uint8_t;
+typedef DWORD uint32_t;
+#endif
+
+#ifndef _SHA_enum_
+#define _SHA_enum_
+/**
+ * 定义 SHA 系列函数的一组成功/错误返回值 (与 SHA1.h 共用)
+ */
+enum
+{
+	shaSuccess = 0, ///< Success
+	shaNull, ///< Null pointer parameter
+	shaInputTooLong, ///< input data too long
+	shaStateError, ///< This error happens when another SHA1Input() is called unexpectedly after SHA1Result()
+};
+#endif
+#define SHA256HashSize 32 ///< SHA256 哈希摘要结果长度(32 字节)
+/**
+ * This structure will hold context information for the SHA-256
+ * hashing operation
+ * 这是 SHA256 哈希算法上下文结构体
+ *
+ * @see SHA256CreateNewContext() 创建 SHA256 上下文
+ * @see SHA256DeleteContext() 销毁 SHA256 上下文
+ */
+typedef struct _SHA256Context SHA256Context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif//
+/*
+ * Function Prototypes
+ * API 接口函数原型声明如下:
+ */
+
+/**
+ * 对 SHA256 上下文结构体进行复位清零
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull
+ */
+int SHA256Reset(
+		SHA256Context *context ///< 上下文指针
+		);
+
+/**
+ * 向 SHA256 上下文结构体输入数据
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaInputTooLong / shaStateError
+ */
+int SHA256Input(
+		SHA256Context *context, ///< 上下文指针
+		const uint8_t data[], ///< 数据
+		unsigned int length ///< 数据长度
+		);
+
+/**
+ * 从 SHA256 上下文取出哈希摘要结果
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaStateError
+ */
+int SHA256Result(
+		SHA256Context *context, ///< 上下文指针
+		uint8_t Message_Digest[SHA256HashSize] ///< 输出 SHA256HashSize=32 字节哈希摘要
+		);
+
+/**
+ * 创建 SHA256 上下文对象
+ *
+ * @return 指针, 指向新创建的上下文对象
+ */
+SHA256Context *SHA256CreateNewContext();
+
+/**
+ * 删除 SHA256 上下文对象
+ */
+void SHA256DeleteContext(SHA256Context *context ///< 上下文指针
+		);
+
+#ifdef __cplusplus
+}
+#endif//__cplusplus
+
+#endif//_SHA256_H_
@@ -0,0 +1,67 @@
+/*
+ * example.c
+ *
+ * Description:
+ * This file will exercise the SHA-256 code performing the tests
+ * documented in FIPS PUB 180-4 plus one which calls SHA256Input
+ * with a message longer than one 512-bit block.
+ *
+ * Portability Issues:
+ * <stdint.h> is only supported by GCC and _MSC_VER>=1600 (Microsoft Visual Studio 2010 or later)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SHA256.h"
+
+const char *testarray[3] = {
+	"abc",
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	"0123456701234567012345670123456701234567012345670123456701234567012345670123456701234567012345670123456701234567012345670123456701234567",
+};
+
+const char *strCorrectSHA256Result[3] = {
+	"BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD",
+	"248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1",
+	"17B2355F39A9004532BA90EFF16C3601669FC323FA119BCA62EEE1F827873425",
+};
+
+int main()
+{
+	SHA256Context *pContext;
+	pContext = SHA256CreateNewContext();
+
+	/*
+	 * Perform some SHA-256 tests
+	 */
+	for (int j = 0; j < 3; j++)
+	{
+		uint8_t Message_Digest[SHA256HashSize];
+
+		SHA256Reset(pContext);
+
+		SHA256Input(pContext, (unsigned char *) testarray[j],
+				strlen(testarray[j]));
+
+		SHA256Result(pContext, Message_Digest);
+
+		printf("[Test-%d]\n", j + 1);
+		printf("Origin message testarray[%d]: \"%s\"\n", j, testarray[j]);
+		printf("SHA256 digest:\n");
+		for (int i = 0; i < SHA256HashSize; ++i)
+		{
+			printf("%02X", Message_Digest[i]);
+		}
+		printf("\n");
+
+		printf("Should match:\n");
+		printf("%s\n", strCorrectSHA256Result[j]);
+		printf("\n");
+		printf("\n");
+	}
+
+	SHA256DeleteContext(pContext);
+	return 0;
+}
@@ -178,14 +178,34 @@ int SM3Input(SM3Context *context, ///< 上下文指针
 	if (context->Computed) {
 		return (SM3StateError);
 	}
-	while (length--) {
-		context->Message_Block[context->Message_Block_Index++] = (*message_array & 0xFF);
-		context->nBits += 8; /* clear length */
-		if (context->Message_Block_Index == SM3_BLOCK_SIZE) {
-			SM3ProcessMessageBlock(context->Intermediate_Hash, context->Message_Block);
-			context->Message_Block_Index = 0;
+	context->nBits += (uint64_t) length << 3;
+
+	/* 先补齐上次余留的不完整分组 */
+	if (context->Message_Block_Index > 0) {
+		unsigned int n = SM3_BLOCK_SIZE - context->Message_Block_Index;
+		if (n > length) {
+			n = length;
+		}
+		memcpy(context->Message_Block + context->Message_Block_Index, message_array, n);
+		context->Message_Block_Index += n;
+		message_array += n;
+		length -= n;
+		if (context->Message_Block_Index < SM3_BLOCK_SIZE) {
+			return SM3Success;
 		}
-		message_array++;
+		SM3ProcessMessageBlock(context->Intermediate_Hash, context->Message_Block);
+		context->Message_Block_Index = 0;
+	}
+	/* 完整的分组直接从调用者的缓冲区读取, 不必逐字节复制到 Message_Block */
+	while (length >= SM3_BLOCK_SIZE) {
+		SM3ProcessMessageBlock(context->Intermediate_Hash, message_array);
+		message_array += SM3_BLOCK_SIZE;
+		length -= SM3_BLOCK_SIZE;
+	}
+	/* 缓存最后余留的数据(不足 64 字节) */
+	if (length > 0) {
+		memcpy(context->Message_Block, message_array, length);
+		context->Message_Block_Index = length;
 	}
 	return SM3Success;
 }
@@ -238,6 +258,20 @@ void SM3PadMessage(SM3Context *context) {
 	context->Message_Block_Index = 0;
 }
 
+/**
+ * 强制内联
+ *
+ * SM3Compress() 会被实例化为标量版本和 SIMD 多通道版本, 后者必须内联到带有 target 属性的函数中才能生成相应的向量指令.
+ * 同样的原因, 以下 P0/P1/FF/GG 运算符均定义为宏, 对 uint32_t 和向量类型都适用
+ */
+#if defined(__GNUC__)
+#define SM3_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SM3_FORCE_INLINE __forceinline
+#else
+#define SM3_FORCE_INLINE inline
+#endif
+
 /**
  * 宏定义
  *
@@ -252,9 +286,8 @@ void SM3PadMessage(SM3Context *context) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t P0(uint32_t x) {
-	return (x ^ SM3CircularShift(9, x) ^ SM3CircularShift(17, x));
-}
+#define P0(x) \
+	((x) ^ SM3CircularShift(9, (x)) ^ SM3CircularShift(17, (x)))
 
 /**
  * P1 组合运算符定义
@@ -262,16 +295,14 @@ inline uint32_t P0(uint32_t x) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t P1(uint32_t x) {
-	return (x ^ SM3CircularShift(15, x) ^ SM3CircularShift(23, x));
-}
+#define P1(x) \
+	((x) ^ SM3CircularShift(15, (x)) ^ SM3CircularShift(23, (x)))
 
 /**
  * 3变量异或运算符定义
  */
-inline uint32_t XOR_3_VARIABLES(uint32_t x, uint32_t y, uint32_t z) {
-	return (x ^ y ^ z);
-}
+#define XOR_3_VARIABLES(x, y, z) \
+	((x) ^ (y) ^ (z))
 
 /**
  * FF0: 3变量异或运算符定义
@@ -279,9 +310,8 @@ inline uint32_t XOR_3_VARIABLES(uint32_t x, uint32_t y, uint32_t z) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t FF0(uint32_t x, uint32_t y, uint32_t z) {
-	return (x ^ y ^ z);
-}
+#define FF0(x, y, z) \
+	((x) ^ (y) ^ (z))
 
 /**
  * FF1: 3变量组合逻辑运算符定义
@@ -289,9 +319,8 @@ inline uint32_t FF0(uint32_t x, uint32_t y, uint32_t z) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t FF1(uint32_t x, uint32_t y, uint32_t z) {
-	return ((x & y) | (y & z) | (z & x));
-}
+#define FF1(x, y, z) \
+	(((x) & (y)) | ((y) & (z)) | ((z) & (x)))
 
 /**
  * GG0: 3变量异或运算符定义
@@ -299,9 +328,8 @@ inline uint32_t FF1(uint32_t x, uint32_t y, uint32_t z) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t GG0(uint32_t x, uint32_t y, uint32_t z) {
-	return (x ^ y ^ z);
-}
+#define GG0(x, y, z) \
+	((x) ^ (y) ^ (z))
 
 /**
  * GG1: 3变量组合逻辑运算符定义
@@ -309,53 +337,93 @@ inline uint32_t GG0(uint32_t x, uint32_t y, uint32_t z) {
  * @see 《GM/T 0004-2012 SM3密码杂凑算法》
  * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
  */
-inline uint32_t GG1(uint32_t x, uint32_t y, uint32_t z) {
-	return ((x & y) | ((~x) & z));
-}
+#define GG1(x, y, z) \
+	(((x) & (y)) | ((~(x)) & (z)))
 
-/*
- * SM3ProcessMessageBlock
+/**
+ * 预先计算好的常量表 SM3_Tj[j] = T_j <<< (j mod 32)
  *
- * @details
- * This function will process the next 512 bits of the message
- * stored in the Message_Block array.
+ * T_j = 0x79CC4519 (0 <= j <= 15), T_j = 0x7A879D8A (16 <= j <= 63).
+ * 查表代替每轮一次循环移位, 同时避免了移位位数为 0 或大于等于 32 时 C 语言移位运算的未定义行为.
+ */
+static const uint32_t SM3_Tj[64] = {
+	0x79CC4519, 0xF3988A32, 0xE7311465, 0xCE6228CB, 0x9CC45197, 0x3988A32F, 0x7311465E, 0xE6228CBC,
+	0xCC451979, 0x988A32F3, 0x311465E7, 0x6228CBCE, 0xC451979C, 0x88A32F39, 0x11465E73, 0x228CBCE6,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+	0x7A879D8A, 0xF50F3B14, 0xEA1E7629, 0xD43CEC53, 0xA879D8A7, 0x50F3B14F, 0xA1E7629E, 0x43CEC53D,
+	0x879D8A7A, 0x0F3B14F5, 0x1E7629EA, 0x3CEC53D4, 0x79D8A7A8, 0xF3B14F50, 0xE7629EA1, 0xCEC53D43,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+};
+
+/** 按大端格式读取 32 位整数(不要求地址 4 字节对齐) */
+#define SM3_LOAD_BE32(p) \
+	(((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | ((uint32_t) (p)[3]))
+
+/** 消息扩展: 由 W[t-16]...W[t-3] 计算 W[t] */
+#define SM3_EXPAND(t) \
+	do { \
+		Word X = W[(t) - 16] ^ W[(t) - 9] ^ SM3CircularShift(15, W[(t) - 3]); \
+		W[t] = P1(X) ^ SM3CircularShift(7, W[(t) - 13]) ^ W[(t) - 6]; \
+	} while (0)
+
+/**
+ * 单轮压缩函数
  *
- * Parameters:
- * TODO: (ADD IMPLEMENTATION DETAIL DESCRIPTIONS HERE)
+ * 通过轮换变量名代替每轮 8 个寄存器的整体赋值: 本轮结束时 D 存放新的 A, H 存放新的 E,
+ * 下一轮调用时参数依次右移一位, 即 SM3_ROUND(D, A, B, C, H, E, F, G, ...)
+ */
+#define SM3_ROUND(A, B, C, D, E, F, G, H, FF, GG, j) \
+	do { \
+		Word A12 = SM3CircularShift(12, A); \
+		Word SS1 = SM3CircularShift(7, A12 + E + SM3_Tj[j]); \
+		Word SS2 = SS1 ^ A12; \
+		Word TT1 = FF(A, B, C) + D + SS2 + (W[j] ^ W[(j) + 4]); \
+		Word TT2 = GG(E, F, G) + H + SS1 + W[j]; \
+		B = SM3CircularShift(9, B); \
+		D = TT1; \
+		F = SM3CircularShift(19, F); \
+		H = P0(TT2); \
+	} while (0)
+
+/** 连续 4 轮压缩, 4 轮之后变量名恢复原位 */
+#define SM3_4ROUNDS(FF, GG, j) \
+	SM3_ROUND(A, B, C, D, E, F, G, H, FF, GG, (j)); \
+	SM3_ROUND(D, A, B, C, H, E, F, G, FF, GG, (j) + 1); \
+	SM3_ROUND(C, D, A, B, G, H, E, F, FF, GG, (j) + 2); \
+	SM3_ROUND(B, C, D, A, F, G, H, E, FF, GG, (j) + 3)
+
+/**
+ * 消息扩展 + 64 轮压缩
  *
- * @see 《GM/T 0004-2012 SM3密码杂凑算法》
- * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
+ * 消息扩展和 64 轮压缩均已展开, 常量 T_j 的循环移位结果通过查表 SM3_Tj[] 得到.
+ * Word 为 uint32_t 时即普通的单消息压缩函数; Word 为 GCC 向量类型时, 向量的每个通道各自独立计算一条消息
+ *
+ * @param Intermediate_Hash [in/out] 中间哈希值
+ * @param W [in] W[0]...W[15] 为已转换为本机字节序的消息分组, W[16]...W[67] 由本函数填写
  */
-void SM3ProcessMessageBlock(uint32_t Intermediate_Hash[8], const uint8_t Message_Block[64]) {
-	/**
-	 * Constants defined in SM3 (Always stroed in localhost's endian format)
-	 * @see 《GM/T 0004-2012 SM3密码杂凑算法》
-	 */
-	const uint32_t T[] = {
-			ntohl(0x1945CC79), // 0x79CC4519 for little endian X86 CPU
-			ntohl(0x8A9D877A), // 0x7A879D8A
-			};
-	int t; /* Loop counter */
-	uint32_t SS0, SS1,SS2; /* Word buffers (Always stroed in localhost's endian format)*/
-	uint32_t TT1,TT2; /* Temporary word value (Always stroed in localhost's endian format)*/
-	uint32_t W[68]; /* Word sequence (Always stroed in localhost's endian format)*/
-	uint32_t W1[64]; /* Word sequence (Always stroed in localhost's endian format)*/
-	uint32_t A, B, C, D, E, F, G, H; /* Word buffers (Always stroed in localhost's endian format)*/
+template <typename Word>
+SM3_FORCE_INLINE void SM3Compress(Word Intermediate_Hash[8], Word W[68]) {
+	Word A, B, C, D, E, F, G, H; /* Word buffers (Always stroed in localhost's endian format)*/
 
 	/*
-	 * Initialize the first 16 words in the array W
+	 * 消息扩展 W[16]...W[67]. W'[j] = W[j] ^ W[j+4] 不再单独存储, 在压缩函数中即时计算
 	 */
-	uint32_t *p; // Pointer to a big endian uint32_t's memory address. Note: 此处要求 context->Message_Block[64] 必须是4字节对正的内存块 否则无法快速访问
-	for (t = 0, p = (uint32_t *) (Message_Block); t < 16; t++, p++) {
-		W[t] = ntohl(*p);
-	}
-	for (t = 16; t < sizeof(W)/sizeof(W[0]); t++) {
-		uint32_t x = W[t - 16] ^ W[t - 9] ^ SM3CircularShift(15, W[t - 3]);
-		W[t] = P1(x) ^ SM3CircularShift(7, W[t - 13]) ^ W[t - 6];
-	}
-	for (t = 0;  t < sizeof(W1)/sizeof(W1[0]); t++) {
-		W1[t] = W[t] ^ W[t + 4];
-	}
+	SM3_EXPAND(16); SM3_EXPAND(17); SM3_EXPAND(18); SM3_EXPAND(19);
+	SM3_EXPAND(20); SM3_EXPAND(21); SM3_EXPAND(22); SM3_EXPAND(23);
+	SM3_EXPAND(24); SM3_EXPAND(25); SM3_EXPAND(26); SM3_EXPAND(27);
+	SM3_EXPAND(28); SM3_EXPAND(29); SM3_EXPAND(30); SM3_EXPAND(31);
+	SM3_EXPAND(32); SM3_EXPAND(33); SM3_EXPAND(34); SM3_EXPAND(35);
+	SM3_EXPAND(36); SM3_EXPAND(37); SM3_EXPAND(38); SM3_EXPAND(39);
+	SM3_EXPAND(40); SM3_EXPAND(41); SM3_EXPAND(42); SM3_EXPAND(43);
+	SM3_EXPAND(44); SM3_EXPAND(45); SM3_EXPAND(46); SM3_EXPAND(47);
+	SM3_EXPAND(48); SM3_EXPAND(49); SM3_EXPAND(50); SM3_EXPAND(51);
+	SM3_EXPAND(52); SM3_EXPAND(53); SM3_EXPAND(54); SM3_EXPAND(55);
+	SM3_EXPAND(56); SM3_EXPAND(57); SM3_EXPAND(58); SM3_EXPAND(59);
+	SM3_EXPAND(60); SM3_EXPAND(61); SM3_EXPAND(62); SM3_EXPAND(63);
+	SM3_EXPAND(64); SM3_EXPAND(65); SM3_EXPAND(66); SM3_EXPAND(67);
+
 	A = Intermediate_Hash[0];
 	B = Intermediate_Hash[1];
 	C = Intermediate_Hash[2];
@@ -364,36 +432,24 @@ void SM3ProcessMessageBlock(uint32_t Intermediate_Hash[8], const uint8_t Message
 	F = Intermediate_Hash[5];
 	G = Intermediate_Hash[6];
 	H = Intermediate_Hash[7];
-	for (t = 0; t < 16; t++) {
-		SS0 = SM3CircularShift(12, A) + E + SM3CircularShift(t, T[0]);
-		SS1 = SM3CircularShift(7, SS0);
-		SS2 = SS1 ^ SM3CircularShift(12, A);
-		TT1 = FF0(A, B, C) + D + SS2 + W1[t];
-		TT2 = GG0(E, F, G) + H + SS1 + W[t];
-		D = C;
-		C = SM3CircularShift(9, B);
-		B = A;
-		A = TT1;
-		H = G;
-		G = SM3CircularShift(19, F);
-		F = E;
-		E = P0(TT2);
-	}
-	for (t = 16; t < 64; t++) {
-		SS0 = SM3CircularShift(12, A) + E + SM3CircularShift(t, T[1]);
-		SS1 = SM3CircularShift(7, SS0);
-		SS2 = SS1 ^ SM3CircularShift(12, A);
-		TT1 = FF1(A, B, C) + D + SS2 + W1[t];
-		TT2 = GG1(E, F, G) + H + SS1 + W[t];
-		D = C;
-		C = SM3CircularShift(9, B);
-		B = A;
-		A = TT1;
-		H = G;
-		G = SM3CircularShift(19, F);
-		F = E;
-		E = P0(TT2);
-	}
+
+	SM3_4ROUNDS(FF0, GG0, 0);
+	SM3_4ROUNDS(FF0, GG0, 4);
+	SM3_4ROUNDS(FF0, GG0, 8);
+	SM3_4ROUNDS(FF0, GG0, 12);
+	SM3_4ROUNDS(FF1, GG1, 16);
+	SM3_4ROUNDS(FF1, GG1, 20);
+	SM3_4ROUNDS(FF1, GG1, 24);
+	SM3_4ROUNDS(FF1, GG1, 28);
+	SM3_4ROUNDS(FF1, GG1, 32);
+	SM3_4ROUNDS(FF1, GG1, 36);
+	SM3_4ROUNDS(FF1, GG1, 40);
+	SM3_4ROUNDS(FF1, GG1, 44);
+	SM3_4ROUNDS(FF1, GG1, 48);
+	SM3_4ROUNDS(FF1, GG1, 52);
+	SM3_4ROUNDS(FF1, GG1, 56);
+	SM3_4ROUNDS(FF1, GG1, 60);
+
 	Intermediate_Hash[0] ^= A;
 	Intermediate_Hash[1] ^= B;
 	Intermediate_Hash[2] ^= C;
@@ -404,6 +460,353 @@ void SM3ProcessMessageBlock(uint32_t Intermediate_Hash[8], const uint8_t Message
 	Intermediate_Hash[7] ^= H;
 }
 
+/*
+ * SM3ProcessMessageBlock
+ *
+ * @details
+ * This function will process the next 512 bits of the message.
+ *
+ * Parameters:
+ * Intermediate_Hash: [in/out] 中间哈希值
+ * Message_Block: [in] 64 字节数据分组, 可以直接指向调用者的缓冲区(不要求 4 字节对齐)
+ *
+ * @see 《GM/T 0004-2012 SM3密码杂凑算法》
+ * @see https://github.com/guanzhi/GmSSL/blob/master/crypto/sm3/sm3.c
+ */
+void SM3ProcessMessageBlock(uint32_t Intermediate_Hash[8], const uint8_t Message_Block[64]) {
+	uint32_t W[68]; /* Word sequence (Always stroed in localhost's endian format)*/
+
+	/*
+	 * Initialize the first 16 words in the array W
+	 */
+	W[0] = SM3_LOAD_BE32(Message_Block + 0);
+	W[1] = SM3_LOAD_BE32(Message_Block + 4);
+	W[2] = SM3_LOAD_BE32(Message_Block + 8);
+	W[3] = SM3_LOAD_BE32(Message_Block + 12);
+	W[4] = SM3_LOAD_BE32(Message_Block + 16);
+	W[5] = SM3_LOAD_BE32(Message_Block + 20);
+	W[6] = SM3_LOAD_BE32(Message_Block + 24);
+	W[7] = SM3_LOAD_BE32(Message_Block + 28);
+	W[8] = SM3_LOAD_BE32(Message_Block + 32);
+	W[9] = SM3_LOAD_BE32(Message_Block + 36);
+	W[10] = SM3_LOAD_BE32(Message_Block + 40);
+	W[11] = SM3_LOAD_BE32(Message_Block + 44);
+	W[12] = SM3_LOAD_BE32(Message_Block + 48);
+	W[13] = SM3_LOAD_BE32(Message_Block + 52);
+	W[14] = SM3_LOAD_BE32(Message_Block + 56);
+	W[15] = SM3_LOAD_BE32(Message_Block + 60);
+
+	SM3Compress(Intermediate_Hash, W);
+}
+
+// ===========================================================================
+// 多缓冲区 SM3: 多条相互独立的消息交错放入 SIMD 寄存器的各个通道同时计算
+// ===========================================================================
+
+/**
+ * 标量版本: 逐条计算, 用于不支持 SIMD 的平台
+ */
+static void SM3HashMultiBufferScalar(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize])
+{
+	SM3Context context;
+	unsigned int n;
+	for (n = 0; n < count; n++) {
+		SM3Reset(&context);
+		SM3Input(&context, messages[n], lengths[n]);
+		SM3Result(&context, digests[n]);
+	}
+}
+
+/*
+ * 编译时定义 SM3_NO_SIMD 宏可以禁用 SIMD 多通道代码, SM3HashMultiBuffer() 始终逐条计算
+ */
+#if !defined(SM3_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define SM3_HAVE_MULTI_BUFFER_SIMD 1
+#include <cpuid.h>
+
+/**
+ * SM3 初始值 IV (本机字节序)
+ */
+static const uint32_t SM3_IV[8] = {
+	0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600, 0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E,
+};
+
+/**
+ * 多缓冲区调度过程中单个通道的状态
+ */
+struct SM3MultiBufferLane {
+	int message; ///< 通道中正在计算的消息序号, -1 表示通道空闲
+	const uint8_t *data; ///< 下一个完整数据分组的地址(直接指向调用者的缓冲区)
+	unsigned int fullBlocks; ///< 剩余的完整数据分组个数
+	unsigned int tailBlocks; ///< 剩余的填充分组个数
+	const uint8_t *tail; ///< 下一个填充分组的地址
+	uint8_t padding[2 * SM3_BLOCK_SIZE]; ///< 消息末尾不足 64 字节的数据及其填充内容
+};
+
+/**
+ * 通道载入一条新消息
+ *
+ * 消息末尾不足 64 字节的数据按照与 SM3PadMessage() 相同的规则填充到 lane->padding 中
+ */
+static void SM3MultiBufferLaneLoad(SM3MultiBufferLane *lane, int message, const uint8_t *data, unsigned int length)
+{
+	unsigned int rest = length % SM3_BLOCK_SIZE;
+	unsigned int paddedSize;
+	uint64_t nBits = (uint64_t) length << 3;
+	int i;
+
+	lane->message = message;
+	lane->data = data;
+	lane->fullBlocks = length / SM3_BLOCK_SIZE;
+	lane->tailBlocks = (rest < SM3_BLOCK_SIZE - sizeof(uint64_t)) ? 1 : 2;
+	lane->tail = lane->padding;
+	paddedSize = lane->tailBlocks * SM3_BLOCK_SIZE;
+	memset(lane->padding, 0, paddedSize);
+	if (rest > 0) {
+		memcpy(lane->padding, data + lane->fullBlocks * SM3_BLOCK_SIZE, rest);
+	}
+	lane->padding[rest] = 0x80;
+	for (i = 0; i < 8; i++) {
+		lane->padding[paddedSize - 1 - i] = (uint8_t) (nBits >> (8 * i));
+	}
+}
+
+/**
+ * 取出通道的下一个数据分组(先取完整分组, 再取填充分组)
+ */
+static const uint8_t *SM3MultiBufferLaneNextBlock(SM3MultiBufferLane *lane)
+{
+	const uint8_t *block;
+	if (lane->fullBlocks > 0) {
+		block = lane->data;
+		lane->data += SM3_BLOCK_SIZE;
+		lane->fullBlocks--;
+	} else {
+		block = lane->tail;
+		lane->tail += SM3_BLOCK_SIZE;
+		lane->tailBlocks--;
+	}
+	return block;
+}
+
+/**
+ * 通道中的消息是否已经全部处理完毕
+ */
+static int SM3MultiBufferLaneFinished(const SM3MultiBufferLane *lane)
+{
+	return (0 == lane->fullBlocks && 0 == lane->tailBlocks);
+}
+
+/**
+ * 输出哈希摘要(大端格式)
+ */
+static void SM3StoreDigest(const uint32_t Intermediate_Hash[8], uint8_t Message_Digest[SM3HashDigestSize])
+{
+	int i;
+	for (i = 0; i < 8; i++) {
+		Message_Digest[4 * i] = (uint8_t) (Intermediate_Hash[i] >> 24);
+		Message_Digest[4 * i + 1] = (uint8_t) (Intermediate_Hash[i] >> 16);
+		Message_Digest[4 * i + 2] = (uint8_t) (Intermediate_Hash[i] >> 8);
+		Message_Digest[4 * i + 3] = (uint8_t) (Intermediate_Hash[i]);
+	}
+}
+
+typedef uint32_t SM3Vec4 __attribute__((vector_size(16))); ///< 4 通道, 对应 SSE2 的 128 位寄存器
+typedef uint32_t SM3Vec8 __attribute__((vector_size(32))); ///< 8 通道, 对应 AVX2 的 256 位寄存器
+
+/**
+ * 多通道调度
+ *
+ * 每个通道各自计算一条消息, 所有通道每次同时压缩一个数据分组. 某个通道的消息处理完毕后立即载入下一条消息,
+ * 因此长度不同的消息也可以混合在一起计算. 剩余的消息不足以填满一半通道时, 剩余的数据分组改用标量函数完成
+ */
+template <typename Vec, int LANES>
+SM3_FORCE_INLINE void SM3HashMultiBufferLanes(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize])
+{
+	static const uint8_t idleBlock[SM3_BLOCK_SIZE] = { 0 }; // 空闲通道的占位数据分组, 计算结果直接丢弃
+	SM3MultiBufferLane lane[LANES];
+	const uint8_t *blocks[LANES];
+	Vec state[8];
+	Vec W[68];
+	unsigned int next = 0; // 下一条待载入的消息
+	int active = 0; // 正在计算的通道数
+	int l, i, t;
+
+	for (l = 0; l < LANES; l++) {
+		lane[l].message = -1;
+	}
+	for (;;) {
+		for (l = 0; l < LANES && next < count; l++) {
+			if (lane[l].message >= 0) {
+				continue;
+			}
+			SM3MultiBufferLaneLoad(&lane[l], next, messages[next], lengths[next]);
+			for (i = 0; i < 8; i++) {
+				state[i][l] = SM3_IV[i];
+			}
+			next++;
+			active++;
+		}
+		if (0 == active) {
+			break;
+		}
+		if (next >= count && active < LANES / 2) {
+			for (l = 0; l < LANES; l++) {
+				uint32_t Intermediate_Hash[8];
+				if (lane[l].message < 0) {
+					continue;
+				}
+				for (i = 0; i < 8; i++) {
+					Intermediate_Hash[i] = state[i][l];
+				}
+				while (!SM3MultiBufferLaneFinished(&lane[l])) {
+					SM3ProcessMessageBlock(Intermediate_Hash, SM3MultiBufferLaneNextBlock(&lane[l]));
+				}
+				SM3StoreDigest(Intermediate_Hash, digests[lane[l].message]);
+			}
+			break;
+		}
+
+		for (l = 0; l < LANES; l++) {
+			blocks[l] = (lane[l].message >= 0) ? SM3MultiBufferLaneNextBlock(&lane[l]) : idleBlock;
+		}
+		for (t = 0; t < 16; t++) {
+			for (l = 0; l < LANES; l++) {
+				W[t][l] = SM3_LOAD_BE32(blocks[l] + 4 * t);
+			}
+		}
+		SM3Compress(state, W);
+
+		for (l = 0; l < LANES; l++) {
+			if (lane[l].message >= 0 && SM3MultiBufferLaneFinished(&lane[l])) {
+				uint32_t Intermediate_Hash[8];
+				for (i = 0; i < 8; i++) {
+					Intermediate_Hash[i] = state[i][l];
+				}
+				SM3StoreDigest(Intermediate_Hash, digests[lane[l].message]);
+				lane[l].message = -1;
+				active--;
+			}
+		}
+	}
+}
+
+/**
+ * 4 通道版本(SSE2, 所有 x86_64 CPU 均支持)
+ */
+static void SM3HashMultiBufferSSE2(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize])
+{
+	SM3HashMultiBufferLanes<SM3Vec4, 4>(count, messages, lengths, digests);
+}
+
+/**
+ * 8 通道版本(AVX2)
+ */
+__attribute__((target("avx2")))
+static void SM3HashMultiBufferAVX2(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize])
+{
+	SM3HashMultiBufferLanes<SM3Vec8, 8>(count, messages, lengths, digests);
+}
+
+/**
+ * 查询 CPU 和操作系统是否支持 AVX2 指令集
+ */
+static int SM3CPUSupportsAVX2()
+{
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0Low, xcr0High;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+	if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+		return 0;
+	}
+	__asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+	if ((xcr0Low & 0x6) != 0x6) { // 操作系统需保存 XMM 和 YMM 寄存器
+		return 0;
+	}
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return 0;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & bit_AVX2) ? 1 : 0;
+}
+#endif // SM3_HAVE_MULTI_BUFFER_SIMD
+
+typedef void (*SM3MultiBufferFunction)(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize]);
+
+/**
+ * 多缓冲区版本及其并行路数
+ */
+struct SM3MultiBufferImplementation {
+	SM3MultiBufferFunction function;
+	int lanes;
+};
+
+/**
+ * 根据 CPU 支持的指令集选择多缓冲区版本
+ */
+static SM3MultiBufferImplementation SM3DetectMultiBufferImplementation()
+{
+	SM3MultiBufferImplementation impl;
+	impl.function = SM3HashMultiBufferScalar;
+	impl.lanes = 1;
+#ifdef SM3_HAVE_MULTI_BUFFER_SIMD
+	if (SM3CPUSupportsAVX2()) {
+		impl.function = SM3HashMultiBufferAVX2;
+		impl.lanes = 8;
+	} else {
+		impl.function = SM3HashMultiBufferSSE2;
+		impl.lanes = 4;
+	}
+#endif
+	return impl;
+}
+
+/**
+ * 返回选出的多缓冲区版本, 只在第一次调用时检测
+ */
+static SM3MultiBufferFunction SM3SelectMultiBufferFunction(int *pLanes)
+{
+	static const SM3MultiBufferImplementation selected = SM3DetectMultiBufferImplementation(); // C++ 保证局部静态变量只初始化一次(多线程首次调用时也不会竞争)
+	if (pLanes) {
+		*pLanes = selected.lanes;
+	}
+	return selected.function;
+}
+
+int SM3MultiBufferLanes()
+{
+	int lanes;
+	SM3SelectMultiBufferFunction(&lanes);
+	return lanes;
+}
+
+/*
+ * 多缓冲区批量计算 SM3 哈希摘要
+ *
+ * Return code:
+ * - SM3Success on success or when count == 0
+ * - SM3Null when one of the input parameters is a NULL pointer
+ */
+int SM3HashMultiBuffer(unsigned int count, const uint8_t *const messages[], const unsigned int lengths[], uint8_t digests[][SM3HashDigestSize])
+{
+	unsigned int n;
+	if (!count) {
+		return SM3Success;
+	}
+	if (!messages || !lengths || !digests) {
+		return SM3Null;
+	}
+	for (n = 0; n < count; n++) {
+		if (!messages[n] && lengths[n] > 0) {
+			return SM3Null;
+		}
+	}
+	SM3SelectMultiBufferFunction(NULL)(count, messages, lengths, digests);
+	return SM3Success;
+}
+
 // ===========================================================================
 // 网络字节序-本机字节序转换
 // ===========================================================================
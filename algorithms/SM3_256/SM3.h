@@ -105,6 +105,29 @@ SM3Context *SM3CreateNewContext();
 void SM3DeleteContext(SM3Context *context ///< 上下文指针
 		);
 
+/**
+ * 多缓冲区批量计算 SM3 哈希摘要
+ *
+ * 一次调用计算 count 条相互独立的消息, 适用于大量短消息(证书, 日志记录等)的批量哈希:
+ * 内部将 4 条(SSE2)或 8 条(AVX2)消息交错放入 SIMD 寄存器的各个通道同时压缩, 运行时自动选择 CPU 支持的指令集.
+ * 计算结果与逐条调用 SM3Reset() / SM3Input() / SM3Result() 完全相同
+ *
+ * @return SM3Success=0 表示成功, 其他非 0 值表示错误: SM3Null
+ */
+int SM3HashMultiBuffer(
+		unsigned int count, ///< 消息条数
+		const uint8_t *const messages[], ///< 各条消息的数据指针
+		const unsigned int lengths[], ///< 各条消息的数据长度
+		uint8_t digests[][SM3HashDigestSize] ///< 输出 count 条哈希摘要, 每条 SM3HashDigestSize=32 字节
+		);
+
+/**
+ * 查询 SM3HashMultiBuffer() 在当前 CPU 上同时计算的消息条数
+ *
+ * @return 8(AVX2), 4(SSE2) 或 1(不使用 SIMD 指令)
+ */
+int SM3MultiBufferLanes();
+
 #ifdef __cplusplus
 }
 #endif//__cplusplus
@@ -57,6 +57,37 @@ int main()
 		printf("\n");
 	}
 
+	/*
+	 * 多缓冲区批量计算, 结果应与上面逐条计算的结果相同
+	 */
+	{
+		const uint8_t *messages[2];
+		unsigned int lengths[2];
+		uint8_t digests[2][SM3HashDigestSize];
+
+		for (int j = 0; j <= 1; j++)
+		{
+			messages[j] = (const uint8_t *) testarray[j];
+			lengths[j] = strlen(testarray[j]);
+		}
+		SM3HashMultiBuffer(2, messages, lengths, digests);
+
+		printf("[Test-3]\n");
+		printf("SM3HashMultiBuffer(): %d lanes\n", SM3MultiBufferLanes());
+		for (int j = 0; j <= 1; j++)
+		{
+			printf("SM3 digest of testarray[%d]:\n", j);
+			for (int i = 0; i < SM3HashDigestSize; ++i)
+			{
+				printf("%02X", digests[j][i]);
+			}
+			printf("\n");
+			printf("Should match:\n");
+			printf("%s\n", strCorrectSM3Result[j]);
+		}
+		printf("\n");
+	}
+
 	SM3DeleteContext(pContext);
 	return 0;
 }
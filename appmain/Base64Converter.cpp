@@ -2,145 +2,528 @@
 // Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
 // All rights reserved.
 
-#include <cstdlib>
-#include <cassert>
+#include <cstring>
+#include <stdexcept>
 #include <string>
-using std::string;
+#include <vector>
+#include <stdint.h>
 #include "Base64Converter.h"
 
-// 输出: 文本字符串 sBase64TextOut; 输入: 二进制数据 dataIn
-void Base64TextFromBinaryData(std::string& sBase64TextOut, const void *dataIn, unsigned int length)
+#if !defined(BASE64_DISABLE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static const char ENCODE_MAP[64] = // base64编码映射表
+{   'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P',
+    'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f',
+    'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v',
+    'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'
+};
+
+/// (内部) 反查表, 非法字符对应 0xFF, 首次调用时生成(C++11 保证线程安全)
+struct Base64DecodeTable
 {
-    const char base[64] = // base64编码映射表
-    {   'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P',
-        'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f',
-        'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v',
-        'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'
-    };
-    const unsigned char *data = (const unsigned char *)dataIn;
-    unsigned int a, b, c, d;
-    unsigned int i;
-    unsigned int j;
-    char *szCache;
-    const unsigned int n = 1 + (2 + length)/3 * 4; // 可以事先求得 base64 编码的最终输出长度
-    szCache = (char *)malloc(n);
-    assert(szCache);
-    if (!szCache)
+    uint8_t entries[256];
+    Base64DecodeTable()
     {
-        return; // Error: 内存耗尽
+        memset(entries, 0xFF, sizeof(entries));
+        for (int i = 0; i < 64; i++)
+        {
+            entries[(uint8_t) ENCODE_MAP[i]] = (uint8_t) i;
+        }
     }
-    szCache[0] = '\0';
-    j = 0;
-    for (i=3; i<=length; i+=3)
+};
+
+static const uint8_t *DecodeMap()
+{
+    static const Base64DecodeTable table;
+    return table.entries;
+}
+
+// ============================================================================
+// 标量实现
+// ============================================================================
+
+/// 编码若干个完整的 3 字节分组, length 必须是 3 的整数倍
+static void EncodeScalar(char *out, const uint8_t *in, size_t length)
+{
+    for (size_t i = 0; i < length; i += 3)
     {
-        a = (unsigned int) (data[i-3] >> 2);
-        b = (unsigned int) ((0x03 & data[i-3])<<4) | (data[i-2]>>4);
-        c = (unsigned int) ((0x0F & data[i-2])<<2) | (data[i-1]>>6);
-        d = (unsigned int) (0x3F & data[i-1]);
-        szCache[j++] = base[a];
-        szCache[j++] = base[b];
-        szCache[j++] = base[c];
-        szCache[j++] = base[d];
+        const uint32_t v = ((uint32_t) in[i] << 16) | ((uint32_t) in[i + 1] << 8) | in[i + 2];
+        *out++ = ENCODE_MAP[v >> 18];
+        *out++ = ENCODE_MAP[(v >> 12) & 0x3F];
+        *out++ = ENCODE_MAP[(v >> 6) & 0x3F];
+        *out++ = ENCODE_MAP[v & 0x3F];
     }
+}
 
-    i -= 3;
-    if (i == length)
+/// 编码末尾不足 3 字节(1 或 2 字节)的数据并补齐 '='
+static void EncodeTail(char *out, const uint8_t *in, size_t length)
+{
+    const uint32_t v = ((uint32_t) in[0] << 16) | ((length > 1) ? ((uint32_t) in[1] << 8) : 0);
+    out[0] = ENCODE_MAP[v >> 18];
+    out[1] = ENCODE_MAP[(v >> 12) & 0x3F];
+    out[2] = (length > 1) ? ENCODE_MAP[(v >> 6) & 0x3F] : '=';
+    out[3] = '=';
+}
+
+/// 解码若干个不含 '=' 的完整 4 字符分组, 遇到非法字符时返回 false
+static bool DecodeScalar(uint8_t *out, const char *in, size_t length)
+{
+    const uint8_t *map = DecodeMap();
+    for (size_t i = 0; i < length; i += 4)
     {
-        goto FINISH;
+        const uint8_t a = map[(uint8_t) in[i]];
+        const uint8_t b = map[(uint8_t) in[i + 1]];
+        const uint8_t c = map[(uint8_t) in[i + 2]];
+        const uint8_t d = map[(uint8_t) in[i + 3]];
+        if ((a | b | c | d) & 0x80)
+        {
+            return false;
+        }
+        const uint32_t v = ((uint32_t) a << 18) | ((uint32_t) b << 12) | ((uint32_t) c << 6) | d;
+        *out++ = (uint8_t) (v >> 16);
+        *out++ = (uint8_t) (v >> 8);
+        *out++ = (uint8_t) v;
     }
+    return true;
+}
+
+static size_t EncodeBlocksScalar(char *, const uint8_t *, size_t)
+{
+    return 0;
+}
+
+static size_t DecodeBlocksScalar(uint8_t *, size_t, const char *, size_t)
+{
+    return 0;
+}
 
-    // 可能剩余 2 字节或剩余 1 字节未处理, 对应 i 的取值可能等于 len-2 或 len-1
-    a = (unsigned int) (data[i] >> 2);
-    szCache[j++] = base[a];
-    b = (unsigned int) ((0x03 & data[i]) << 4);
-    if (length-i <= 1) {
-        szCache[j++] = base[b];
-        szCache[j++] = '=';
-        szCache[j++] = '=';
-        goto FINISH;
+// ============================================================================
+// SIMD 实现(x86 SSSE3/AVX2)
+//
+// 算法参见 Wojciech Muła 的 "Base64 encoding and decoding with SIMD instructions":
+// 编码时用 pshufb 将每 3 字节展开为 4 字节, 乘法指令移位得到 4 个 6 比特下标, 再查表转换为 ASCII;
+// 解码时按高低半字节查表同时完成合法性检查和字符到数值的转换, 再用乘加指令拼接回 3 字节.
+//
+// 各函数只处理能够整块处理的前缀部分, 返回已处理的输入长度, 剩余部分由标量代码处理.
+// 函数通过 target 属性单独启用指令集, 不要求整个程序以 -mssse3/-mavx2 编译, 运行时根据 CPUID 选择.
+// ============================================================================
+#ifdef BASE64_X86_SIMD
+
+__attribute__((target("ssse3")))
+static inline __m128i EncodeTranslateSSSE3(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+
+    const __m128i shiftLUT = _mm_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shiftLUT, result);
+    return _mm_add_epi8(result, indices);
+}
+
+__attribute__((target("ssse3")))
+static size_t EncodeBlocksSSSE3(char *out, const uint8_t *in, size_t length)
+{
+    size_t done = 0;
+    while (length - done >= 16) // 每次读取 16 字节, 使用其中 12 字节
+    {
+        const __m128i data = _mm_loadu_si128((const __m128i *) (in + done));
+        _mm_storeu_si128((__m128i *) out, EncodeTranslateSSSE3(data));
+        out += 16;
+        done += 12;
     }
-    b |= (unsigned int) (data[i+1] >> 4);
-    c = (unsigned int) ((0x0F & data[i+1]) << 2);
-    szCache[j++] = base[b];
-    szCache[j++] = base[c];
-    szCache[j++] = '=';
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t EncodeBlocksAVX2(char *out, const uint8_t *in, size_t length)
+{
+    const __m256i shuffle = _mm256_set_epi8(
+            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shiftLUT = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+    while (length - done >= 28) // 两个 128 位通道分别读取 in[0..15] 和 in[12..27], 共使用 24 字节
+    {
+        const __m128i lo = _mm_loadu_si128((const __m128i *) (in + done));
+        const __m128i hi = _mm_loadu_si128((const __m128i *) (in + done + 12));
+        __m256i data = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        data = _mm256_shuffle_epi8(data, shuffle);
+        const __m256i t0 = _mm256_and_si256(data, _mm256_set1_epi32(0x0FC0FC00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(data, _mm256_set1_epi32(0x003F03F0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
 
-FINISH:
-    szCache[j++] = '\0';
-    sBase64TextOut.assign(szCache, n);
-    free(szCache);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_shuffle_epi8(shiftLUT, result);
+        _mm256_storeu_si256((__m256i *) out, _mm256_add_epi8(result, indices));
+        out += 32;
+        done += 24;
+    }
+    // 剩余部分交给 SSSE3 处理
+    return done + EncodeBlocksSSSE3(out, in + done, length - done);
 }
 
-// (内部函数) 反查 Base64 映射表
-static int Base64DecodeMap(char ch)
+/// 解码 16 个字符, 含非法字符时返回 false
+__attribute__((target("ssse3")))
+static inline bool DecodeTranslateSSSE3(__m128i& str)
 {
-    if (ch >= 'A' && ch <='Z')
+    const __m128i lutLo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+
+    const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+    const __m128i loNibbles = _mm_and_si128(str, mask2F);
+    const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    if (0 != _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
     {
-        return (ch - 'A');
+        return false;
     }
-    if (ch >= 'a' && ch <='z')
+    const __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+    const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+    str = _mm_add_epi8(str, roll);
+
+    const __m128i mergeABAndBC = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    str = _mm_madd_epi16(mergeABAndBC, _mm_set1_epi32(0x00011000));
+    str = _mm_shuffle_epi8(str, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    return true;
+}
+
+__attribute__((target("ssse3")))
+static size_t DecodeBlocksSSSE3(uint8_t *out, size_t capacity, const char *in, size_t length)
+{
+    size_t done = 0;
+    size_t written = 0;
+    while (length - done >= 16 && capacity - written >= 16) // 每次写入 16 字节, 其中有效数据 12 字节
     {
-        return (26 + ch - 'a');
+        __m128i str = _mm_loadu_si128((const __m128i *) (in + done));
+        if (!DecodeTranslateSSSE3(str))
+        {
+            break; // 交给标量代码报错
+        }
+        _mm_storeu_si128((__m128i *) (out + written), str);
+        done += 16;
+        written += 12;
     }
-    if (isdigit(ch))
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t DecodeBlocksAVX2(uint8_t *out, size_t capacity, const char *in, size_t length)
+{
+    const __m256i lutLo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+
+    size_t done = 0;
+    size_t written = 0;
+    while (length - done >= 32 && capacity - written >= 32) // 每次写入 32 字节, 其中有效数据 24 字节
     {
-        return (52 + ch - '0');
+        __m256i str = _mm256_loadu_si256((const __m256i *) (in + done));
+        const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+        const __m256i loNibbles = _mm256_and_si256(str, mask2F);
+        const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        if (0 != _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256())))
+        {
+            break;
+        }
+        const __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+        const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        const __m256i mergeABAndBC = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(mergeABAndBC, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, pack);
+        // 两个通道各有 12 字节有效数据, 合并到低 24 字节
+        str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *) (out + written), str);
+        done += 32;
+        written += 24;
     }
+    return done + DecodeBlocksSSSE3(out + written, capacity - written, in + done, length - done);
+}
 
-    int result;
-    switch (ch)
+#endif // BASE64_X86_SIMD
+
+/// (内部) 运行时根据 CPUID 选择实现, 首次调用时初始化(C++11 保证线程安全)
+struct Base64Dispatch
+{
+    size_t (*encodeBlocks)(char *out, const uint8_t *in, size_t length);
+    size_t (*decodeBlocks)(uint8_t *out, size_t capacity, const char *in, size_t length);
+    const char *name;
+
+    Base64Dispatch()
     {
-    case '+':
-        result = 62;
-        break;
-    case '/':
-        result = 63;
-        break;
-    default:
-        result = 0;
-        break;
+        encodeBlocks = EncodeBlocksScalar;
+        decodeBlocks = DecodeBlocksScalar;
+        name = "scalar";
+#ifdef BASE64_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            encodeBlocks = EncodeBlocksAVX2;
+            decodeBlocks = DecodeBlocksAVX2;
+            name = "avx2";
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            encodeBlocks = EncodeBlocksSSSE3;
+            decodeBlocks = DecodeBlocksSSSE3;
+            name = "ssse3";
+        }
+#endif
     }
-    return result;
+};
+
+static const Base64Dispatch& Dispatch()
+{
+    static const Base64Dispatch dispatch;
+    return dispatch;
 }
 
-#include <cstring>
-#include <vector>
-using std::vector;
+// ============================================================================
+// C 语言接口
+// ============================================================================
+size_t Base64EncodedLength(size_t length)
+{
+    return (length + 2) / 3 * 4;
+}
 
-// 输出: 二进制数据 dataOut; 输入: 以 '\0' 结尾的 C 语言文本字符串 szBase64TextIn[]
-void BinaryDataFromBase64Text(std::vector<unsigned char>& dataOut, const char szBase64TextIn[])
+size_t Base64DecodedMaxLength(size_t textLength)
+{
+    return textLength / 4 * 3;
+}
+
+/// (内部) 编码完整的 3 字节分组, 返回已处理的输入长度
+static size_t EncodeFullGroups(char *out, const uint8_t *in, size_t length)
 {
-    const unsigned int length = std::strlen(szBase64TextIn);
-    if ((length % 4) >= 1)
+    const size_t full = length - length % 3;
+    const size_t done = Dispatch().encodeBlocks(out, in, full);
+    EncodeScalar(out + done / 3 * 4, in + done, full - done);
+    return full;
+}
+
+size_t Base64Encode(char *textOut, size_t textCapacity, const void *dataIn, size_t length)
+{
+    const size_t n = Base64EncodedLength(length);
+    if (textCapacity < n)
+    {
+        return 0;
+    }
+    const uint8_t *data = (const uint8_t *) dataIn;
+    const size_t full = EncodeFullGroups(textOut, data, length);
+    if (full < length)
     {
-        // Error: Invalid input
-        return;
+        EncodeTail(textOut + full / 3 * 4, data + full, length - full);
     }
+    return n;
+}
 
-    unsigned int a, b, c, d;
-    unsigned char raw[3];
-    unsigned int i;
-    for (i=0; i<=length; i+=4)
+int Base64Decode(void *dataOut, size_t dataCapacity, size_t *pLengthOut, const char *textIn, size_t textLength)
+{
+    if (pLengthOut)
     {
-        a = Base64DecodeMap(szBase64TextIn[i]);
-        b = Base64DecodeMap(szBase64TextIn[i+1]);
-        raw[0] = (a << 2) | (b >> 4);
-        dataOut.push_back(raw[0]);
+        *pLengthOut = 0;
+    }
+    if (textLength % 4 != 0)
+    {
+        return BASE64_DECODE_INVALID_INPUT;
+    }
+    if (0 == textLength)
+    {
+        return BASE64_DECODE_OK;
+    }
+    // 只有最后一组允许包含 '=', 形如 "xx==" 或 "xxx="
+    size_t padding = 0;
+    if ('=' == textIn[textLength - 1])
+    {
+        padding = ('=' == textIn[textLength - 2]) ? 2 : 1;
+    }
+    const size_t n = Base64DecodedMaxLength(textLength) - padding;
+    if (dataCapacity < n)
+    {
+        return BASE64_DECODE_BUFFER_TOO_SMALL;
+    }
+
+    uint8_t *out = (uint8_t *) dataOut;
+    const size_t bodyLength = textLength - 4; // 最后一组单独处理
+    const size_t done = Dispatch().decodeBlocks(out, n, textIn, bodyLength);
+    if (!DecodeScalar(out + done / 4 * 3, textIn + done, bodyLength - done))
+    {
+        return BASE64_DECODE_INVALID_INPUT;
+    }
 
-        if ('=' == szBase64TextIn[i+2])
+    const uint8_t *map = DecodeMap();
+    const char *last = textIn + bodyLength;
+    uint8_t v[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < 4 - padding; i++)
+    {
+        v[i] = map[(uint8_t) last[i]];
+        if (v[i] & 0x80)
         {
-            break;
+            return BASE64_DECODE_INVALID_INPUT;
         }
-        c = Base64DecodeMap(szBase64TextIn[i+2]);
-        raw[1] = (0xF0 & (b << 4)) | (c >> 2);
-        dataOut.push_back(raw[1]);
+    }
+    uint8_t *p = out + bodyLength / 4 * 3;
+    p[0] = (uint8_t) ((v[0] << 2) | (v[1] >> 4));
+    if (padding < 2)
+    {
+        p[1] = (uint8_t) ((v[1] << 4) | (v[2] >> 2));
+    }
+    if (padding < 1)
+    {
+        p[2] = (uint8_t) ((v[2] << 6) | v[3]);
+    }
+    if (pLengthOut)
+    {
+        *pLengthOut = n;
+    }
+    return BASE64_DECODE_OK;
+}
+
+const char *Base64ImplementationName(void)
+{
+    return Dispatch().name;
+}
+
+void PrintBase64TextFromBinaryData(FILE *fpOut, const void *dataIn, unsigned int length)
+{
+    const size_t CHUNK = 3 * 1024; // 每次编码的输入长度, 须为 3 的整数倍
+    char text[CHUNK / 3 * 4];
+    const uint8_t *data = (const uint8_t *) dataIn;
+    size_t offset = 0;
+    while (offset < length)
+    {
+        const size_t chunk = (length - offset < CHUNK) ? (length - offset) : CHUNK;
+        const size_t n = Base64Encode(text, sizeof(text), data + offset, chunk);
+        fwrite(text, 1, n, fpOut);
+        offset += chunk;
+    }
+}
 
-        if ('=' == szBase64TextIn[i+3])
+// ============================================================================
+// C++ 接口
+// ============================================================================
+
+// 输出: 文本字符串 sBase64TextOut; 输入: 二进制数据 dataIn
+void Base64TextFromBinaryData(std::string& sBase64TextOut, const void *dataIn, unsigned int length)
+{
+    sBase64TextOut.resize(Base64EncodedLength(length));
+    if (length > 0)
+    {
+        Base64Encode(&sBase64TextOut[0], sBase64TextOut.size(), dataIn, length);
+    }
+}
+
+// 输出: 二进制数据 dataOut; 输入: 以 '\0' 结尾的 C 语言文本字符串 szBase64TextIn[]
+void BinaryDataFromBase64Text(std::vector<unsigned char>& dataOut, const char szBase64TextIn[])
+{
+    const size_t textLength = std::strlen(szBase64TextIn);
+    const size_t oldSize = dataOut.size();
+    dataOut.resize(oldSize + Base64DecodedMaxLength(textLength));
+    size_t n = 0;
+    if (BASE64_DECODE_OK != Base64Decode(dataOut.data() + oldSize, dataOut.size() - oldSize, &n, szBase64TextIn, textLength))
+    {
+        n = 0; // Error: Invalid input
+    }
+    dataOut.resize(oldSize + n);
+}
+
+Base64StreamEncoder::Base64StreamEncoder()
+{
+    m_pendingLength = 0;
+}
+
+void Base64StreamEncoder::reset()
+{
+    m_pendingLength = 0;
+}
+
+size_t Base64StreamEncoder::maxUpdateLength(size_t length)
+{
+    return (length + 2) / 3 * 4;
+}
+
+size_t Base64StreamEncoder::update(char *textOut, size_t textCapacity, const void *dataIn, size_t length)
+{
+    if (textCapacity < maxUpdateLength(length))
+    {
+        throw std::length_error("Base64StreamEncoder::update(): output buffer is too small");
+    }
+    const uint8_t *data = (const uint8_t *) dataIn;
+    char *out = textOut;
+    if (m_pendingLength > 0) // 先与上次剩余的数据凑成一组
+    {
+        uint8_t group[3];
+        memcpy(group, m_pending, m_pendingLength);
+        const size_t need = 3 - m_pendingLength;
+        if (length < need)
         {
-            break;
+            memcpy(m_pending + m_pendingLength, data, length);
+            m_pendingLength += length;
+            return 0;
         }
-        d = Base64DecodeMap(szBase64TextIn[i+3]);
-        raw[2] = (0xC0 & (c << 6)) | d;
-        dataOut.push_back(raw[2]);
+        memcpy(group + m_pendingLength, data, need);
+        EncodeScalar(out, group, 3);
+        out += 4;
+        data += need;
+        length -= need;
+        m_pendingLength = 0;
+    }
+    const size_t full = EncodeFullGroups(out, data, length);
+    out += full / 3 * 4;
+    m_pendingLength = length - full;
+    memcpy(m_pending, data + full, m_pendingLength);
+    return (size_t) (out - textOut);
+}
+
+size_t Base64StreamEncoder::finish(char *textOut, size_t textCapacity)
+{
+    if (textCapacity < 4)
+    {
+        throw std::length_error("Base64StreamEncoder::finish(): output buffer is too small");
+    }
+    const size_t pending = m_pendingLength;
+    m_pendingLength = 0;
+    if (0 == pending)
+    {
+        return 0;
     }
+    EncodeTail(textOut, m_pending, pending);
+    return 4;
 }
@@ -5,16 +5,46 @@
 #ifndef BASE64_CONVERTER_H_
 #define BASE64_CONVERTER_H_
 
+#include <stddef.h>
 #include <stdio.h>
 
-#ifndef __cplusplus
+#ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
-/// 向标准文件打印 Base64 文本
+/// 向标准文件打印 Base64 文本(不输出换行符)
 void PrintBase64TextFromBinaryData(FILE *fpOut, const void *dataIn, unsigned int length);
 
-#ifndef __cplusplus
+/// Base64Decode() 的返回值
+enum Base64DecodeResult {
+    BASE64_DECODE_OK = 0,
+    BASE64_DECODE_INVALID_INPUT = -1, ///< 长度不是 4 的整数倍, 含有非法字符, 或者 '=' 出现在末尾之外的位置
+    BASE64_DECODE_BUFFER_TOO_SMALL = -2, ///< 输出缓冲区容量不足
+};
+
+/// 编码 length 字节数据所需的输出缓冲区长度(不含字符串结束符)
+size_t Base64EncodedLength(size_t length);
+
+/// 解码 textLength 个字符最多输出的字节数(实际输出字节数可能因末尾的 '=' 而减少 1 至 2 字节)
+size_t Base64DecodedMaxLength(size_t textLength);
+
+/// 编码到调用者提供的缓冲区
+///
+/// 不输出字符串结束符 '\0'. 处理器支持时自动使用 AVX2 或 SSSE3 指令
+///
+/// @return 输出的字符数; textCapacity 小于 Base64EncodedLength(length) 时不输出任何字符并返回 0
+size_t Base64Encode(char *textOut, size_t textCapacity, const void *dataIn, size_t length);
+
+/// 解码到调用者提供的缓冲区
+///
+/// @param pLengthOut 输出参数, 实际输出的字节数, 可以为 NULL
+/// @return 参见 Base64DecodeResult. 出错时输出缓冲区中的内容不确定
+int Base64Decode(void *dataOut, size_t dataCapacity, size_t *pLengthOut, const char *textIn, size_t textLength);
+
+/// 查询当前使用的编解码实现, 返回 "avx2", "ssse3" 或 "scalar"
+const char *Base64ImplementationName(void);
+
+#ifdef __cplusplus
 } // end of extern "C"
 #endif // __cplusplus
 
@@ -29,9 +59,50 @@ void PrintBase64TextFromBinaryData(FILE *fpOut, const void *dataIn, unsigned int
 /// 生成 Base64 C++ 字符串
 void Base64TextFromBinaryData(std::string& sBase64TextOut, const void *dataIn, unsigned int length);
 
-/// 解析 Base64 C 字符串
+/// 解析 Base64 C 字符串, 解码结果追加到 dataOut 末尾; 输入无效时 dataOut 保持不变
 void BinaryDataFromBase64Text(std::vector<unsigned char>& dataOut, const char szBase64TextIn[]);
 
+/// 流式 Base64 编码器
+///
+/// 输入数据可以分多次通过 update() 送入, 每次不必是 3 字节的整数倍, 最后调用 finish() 输出末尾的填充字符.
+/// 用法示意:
+/// ```
+/// Base64StreamEncoder encoder;
+/// char text[1024];
+/// size_t n = encoder.update(text, sizeof(text), data1, length1); // length1 <= 765
+/// fwrite(text, 1, n, fp);
+/// ...
+/// n = encoder.finish(text, sizeof(text));
+/// fwrite(text, 1, n, fp);
+/// ```
+class Base64StreamEncoder
+{
+public:
+    Base64StreamEncoder();
+
+    /// 送入 length 字节数据, 编码结果写入 textOut
+    ///
+    /// @return 输出的字符数
+    /// @throws std::length_error textCapacity 小于 maxUpdateLength(length) 时抛出
+    size_t update(char *textOut, size_t textCapacity, const void *dataIn, size_t length);
+
+    /// 结束编码, 输出剩余数据及填充字符(最多 4 个字符), 然后自动复位以便编码下一段数据
+    ///
+    /// @return 输出的字符数
+    /// @throws std::length_error textCapacity 小于 4 时抛出
+    size_t finish(char *textOut, size_t textCapacity);
+
+    /// 放弃尚未输出的数据, 复位编码器
+    void reset();
+
+    /// 调用 update() 送入 length 字节时输出缓冲区所需的最大长度
+    static size_t maxUpdateLength(size_t length);
+
+private:
+    unsigned char m_pending[2]; ///< 上次 update() 剩余的不足 3 字节的数据
+    size_t m_pendingLength;
+};
+
 #endif // __cplusplus
 
 #endif // BASE64_CONVERTER_H_
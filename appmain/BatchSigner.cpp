@@ -0,0 +1,138 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "BatchSigner.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+const unsigned int DEFAULT_PIPELINE_DEPTH = 4;
+
+BatchSigner::BatchSigner() {
+    m_keyHandle = 0x80FFFFFF; // 随意设置一个无效的初始值, 便于调试程序
+    m_scheme = NULL; // NULL 表示沿用 TPMCommands::Sign 的默认签名方案
+    m_authSessionHandle = TPM_RS_PW;
+    m_authPassword.t.size = 0;
+    resizeCommandPool(DEFAULT_PIPELINE_DEPTH);
+}
+
+BatchSigner::~BatchSigner() {
+    eraseCachedAuthPassword();
+    resizeCommandPool(0);
+}
+
+void BatchSigner::configSigningKey(TPM_HANDLE keyHandle) {
+    m_keyHandle = keyHandle;
+}
+
+void BatchSigner::configScheme(const DigitalSignatureSchemes::PaddingScheme inScheme) {
+    m_scheme = inScheme;
+}
+
+void BatchSigner::configAuthSession(TPMI_SH_AUTH_SESSION authSessionHandle) {
+    if (TPM_RS_PW != authSessionHandle) {
+        // HMAC 会话需要逐条计算命令 HMAC, policy 会话在每条命令执行后都会被 TPM 重置, 均不能在整批签名中直接复用
+        throw std::invalid_argument("BatchSigner::configAuthSession(): only password authorization (TPM_RS_PW) is supported");
+    }
+    m_authSessionHandle = authSessionHandle;
+}
+
+void BatchSigner::configAuthPassword(const void *password, UINT16 length) {
+    if (length > sizeof(m_authPassword.t.buffer)) {
+        length = sizeof(m_authPassword.t.buffer);
+    }
+    m_authPassword.t.size = length;
+    memcpy(m_authPassword.t.buffer, password, length);
+}
+
+void BatchSigner::eraseCachedAuthPassword() {
+    memset(m_authPassword.t.buffer, 0x00, sizeof(m_authPassword.t.buffer));
+    m_authPassword.t.size = 0;
+    for (size_t i = 0; i < m_commandPool.size(); i++) {
+        m_commandPool[i]->eraseCachedAuthPassword();
+    }
+}
+
+void BatchSigner::configPipelineDepth(unsigned int depth) {
+    if (depth < 1) {
+        depth = 1;
+    }
+    resizeCommandPool(depth);
+}
+
+void BatchSigner::resizeCommandPool(unsigned int depth) {
+    while (m_commandPool.size() > depth) {
+        delete m_commandPool.back();
+        m_commandPool.pop_back();
+    }
+    while (m_commandPool.size() < depth) {
+        m_commandPool.push_back(new TPMCommands::Sign());
+    }
+}
+
+// ============================================================================
+// 每批签名开始前统一配置所有命令对象, 此后每条命令只需更新摘要和 ticket
+// ============================================================================
+void BatchSigner::applyConfig(TPMCommands::Sign& sign) {
+    sign.configSigningKey(m_keyHandle);
+    if (m_scheme) {
+        sign.configScheme(m_scheme);
+    }
+    sign.configAuthSession(m_authSessionHandle);
+    sign.configAuthPassword(m_authPassword.t.buffer, m_authPassword.t.size);
+}
+
+void BatchSigner::signDigests(const std::vector<TPM2B_DIGEST>& digests, const SignatureCallback& onSignature) {
+    signDigests(digests, std::vector<TPMT_TK_HASHCHECK>(), onSignature);
+}
+
+void BatchSigner::signDigests(
+        const std::vector<TPM2B_DIGEST>& digests,
+        const std::vector<TPMT_TK_HASHCHECK>& tickets,
+        const SignatureCallback& onSignature
+        ) {
+    if (!tickets.empty() && tickets.size() != digests.size()) {
+        throw std::invalid_argument("BatchSigner::signDigests(): tickets.size() != digests.size()");
+    }
+    TPMT_TK_HASHCHECK nullTicket;
+    nullTicket.tag = TPM_ST_HASHCHECK;
+    nullTicket.hierarchy = TPM_RH_NULL;
+    nullTicket.digest.t.size = 0;
+
+    std::deque<TPMCommands::Sign *> idle;
+    for (size_t i = 0; i < m_commandPool.size(); i++) {
+        applyConfig(*m_commandPool[i]);
+        idle.push_back(m_commandPool[i]);
+    }
+
+    size_t next = 0;
+    try {
+        while (next < digests.size() || pendingCommandCount() > 0) {
+            // 所有空闲的命令对象都立即投入发送队列, Client 会在取回每条应答帧之后马上发出下一条命令
+            while (next < digests.size() && !idle.empty()) {
+                TPMCommands::Sign *pSign = idle.front();
+                idle.pop_front();
+                pSign->configDigestToBeSigned(digests[next].t.buffer, digests[next].t.size);
+                pSign->configValidationTicket(tickets.empty() ? nullTicket : tickets[next]);
+                const size_t index = next;
+                sendCommand(*pSign, [pSign, index, &idle, &onSignature](TPMCommand& command, TSS2_RC rc) {
+                    if (onSignature) {
+                        onSignature(index, pSign->outSignature(), rc);
+                    }
+                    idle.push_back(pSign);
+                });
+                next++;
+            }
+            fetchResponse();
+        }
+    } catch (...) {
+        // 回调函数引用了本函数的局部变量, 异常离开本函数之前必须清空 Client 的发送队列
+        discardPendingCommands();
+        throw;
+    }
+}
@@ -0,0 +1,102 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef BATCH_SIGNER_H_
+#define BATCH_SIGNER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "Client.h"
+
+#ifdef __cplusplus
+
+#include <functional>
+#include <vector>
+
+/**
+ * 单个签名完成回调函数
+ *
+ * 参数 index 为该摘要在输入数组中的下标, 参数 rc 为 TPM2_Sign 命令的执行结果(0 表示成功).
+ * 参数 signature 仅在回调函数执行期间有效, 调用者需要时应自行复制.
+ */
+typedef std::function<void (size_t index, const TPMT_SIGNATURE& signature, TSS2_RC rc)> SignatureCallback;
+
+/// 批量数字签名客户端
+///
+/// 使用同一个已加载的签名密钥和同一个授权会话, 对一组哈希摘要连续签名.
+/// 内部维护若干个 TPMCommands::Sign 命令对象轮流使用, 每个对象只配置一次密钥/授权/签名方案,
+/// 借助 Client 的发送队列保持 TPM 一直有命令可以执行, 每取回一个签名就立即通过回调函数交给调用者.
+///
+/// @note 只支持明文密码授权(TPM_RS_PW): HMAC 会话需要逐条计算命令 HMAC,
+/// policy 会话在每条命令执行之后都会被 TPM 重置(需要重新执行 policy 命令), 均不能在整批签名中共用.
+class BatchSigner: public Client
+{
+public:
+    BatchSigner();
+    virtual ~BatchSigner();
+
+    /// 指定签名密钥句柄, 该密钥应由调用者事先加载并在整批签名期间保持加载状态
+    void configSigningKey(TPM_HANDLE keyHandle);
+
+    /// 指定数字签名算法, 默认值与 TPMCommands::Sign 相同
+    void configScheme(const DigitalSignatureSchemes::PaddingScheme inScheme);
+
+    /**
+     * 指定访问签名密钥的授权会话, 整批签名共用同一个会话
+     *
+     * @throws std::invalid_argument authSessionHandle 不是 TPM_RS_PW 时抛出
+     */
+    void configAuthSession(TPMI_SH_AUTH_SESSION authSessionHandle=TPM_RS_PW);
+
+    /// 指定访问签名密钥的授权密码
+    void configAuthPassword(const void *password, UINT16 length);
+
+    /// 擦除临时缓存的密码
+    void eraseCachedAuthPassword();
+
+    /// 指定同时在途的签名命令个数(流水线深度), 默认为 4, 最小为 1
+    void configPipelineDepth(unsigned int depth);
+
+    /**
+     * 对一组哈希摘要批量签名
+     *
+     * 函数返回前, 每个摘要都会恰好调用一次 onSignature 回调函数; 回调顺序与输入顺序相同.
+     * 单个签名失败不会中断整批签名, 错误码通过回调函数的 rc 参数传递.
+     *
+     * @throws std::invalid_argument tickets 非空但个数与 digests 不一致时抛出
+     * @throws TSS2_RC 通信失败时抛出. 此时尚未完成的签名全部被放弃, 不再调用 onSignature
+     */
+    void signDigests(
+            const std::vector<TPM2B_DIGEST>& digests, ///< 待签名的哈希摘要
+            const std::vector<TPMT_TK_HASHCHECK>& tickets, ///< 各个摘要对应的 ticket. 为空时一律使用 TPM_RH_NULL 空 ticket (仅适用于非 restricted 签名密钥)
+            const SignatureCallback& onSignature ///< 单个签名完成回调函数
+            );
+
+    /// 对一组哈希摘要批量签名(不提供 ticket)
+    void signDigests(
+            const std::vector<TPM2B_DIGEST>& digests, ///< 待签名的哈希摘要
+            const SignatureCallback& onSignature ///< 单个签名完成回调函数
+            );
+
+private:
+    void resizeCommandPool(unsigned int depth);
+    void applyConfig(TPMCommands::Sign& sign);
+
+    TPM_HANDLE m_keyHandle;
+    DigitalSignatureSchemes::PaddingScheme m_scheme;
+    TPMI_SH_AUTH_SESSION m_authSessionHandle;
+    TPM2B_AUTH m_authPassword;
+    std::vector<TPMCommands::Sign *> m_commandPool; ///< 轮流使用的签名命令对象, 个数即流水线深度
+
+    // 禁止复制
+    BatchSigner(const BatchSigner&);
+    BatchSigner& operator=(const BatchSigner&);
+};
+
+#endif // __cplusplus
+#endif // BATCH_SIGNER_H_
@@ -0,0 +1,216 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <deque>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "HostRSAPublicKey.h"
+#include "BatchVerifier.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+const unsigned int DEFAULT_PIPELINE_DEPTH = 4;
+
+BatchVerifier::BatchVerifier() {
+    m_keyHandle = 0x80FFFFFF; // 随意设置一个无效的初始值, 便于调试程序
+    m_publicAreaLoaded = false;
+    m_pHostKey = NULL;
+    m_workerThreads = 0;
+    m_pipelineDepth = DEFAULT_PIPELINE_DEPTH;
+    m_hostVerifiedCount = 0;
+    m_tpmVerifiedCount = 0;
+}
+
+BatchVerifier::~BatchVerifier() {
+    delete m_pHostKey;
+}
+
+void BatchVerifier::configVerificationKey(TPM_HANDLE keyHandle) {
+    m_keyHandle = keyHandle;
+    m_publicAreaLoaded = false;
+    delete m_pHostKey;
+    m_pHostKey = NULL;
+}
+
+void BatchVerifier::configWorkerThreads(unsigned int threads) {
+    m_workerThreads = threads;
+}
+
+void BatchVerifier::configPipelineDepth(unsigned int depth) {
+    m_pipelineDepth = (depth < 1) ? 1 : depth;
+}
+
+unsigned long BatchVerifier::hostVerifiedCount() const {
+    return m_hostVerifiedCount;
+}
+
+unsigned long BatchVerifier::tpmVerifiedCount() const {
+    return m_tpmVerifiedCount;
+}
+
+// ============================================================================
+// 读取并缓存公钥区(每个密钥句柄只读取一次)
+// ============================================================================
+void BatchVerifier::loadPublicArea() {
+    if (m_publicAreaLoaded) {
+        return;
+    }
+    TPMCommands::ReadPublic readPublic;
+    readPublic.configObject(m_keyHandle);
+    sendCommandAndWaitUntilResponseIsFetched(readPublic);
+    m_publicArea = readPublic.outPublicArea();
+    m_publicAreaLoaded = true;
+    if (TPM_ALG_RSA == m_publicArea.type) {
+        try {
+            m_pHostKey = new HostRSAPublicKey(m_publicArea);
+        } catch (std::invalid_argument& e) {
+            m_pHostKey = NULL; // 公钥格式异常时全部交给 TPM 处理
+        }
+    }
+}
+
+// ============================================================================
+// 批量校验: 主机端可校验的签名分给工作线程, 其余签名同时在本线程交给 TPM
+// ============================================================================
+void BatchVerifier::verifySignatures(
+        const std::vector<TPM2B_DIGEST>& digests,
+        const std::vector<TPMT_SIGNATURE>& signatures,
+        std::vector<TSS2_RC>& results
+        ) {
+    if (digests.size() != signatures.size()) {
+        throw std::invalid_argument("BatchVerifier::verifySignatures(): digests.size() != signatures.size()");
+    }
+    loadPublicArea();
+    results.assign(digests.size(), 0);
+
+    std::vector<size_t> hostIndexes;
+    std::vector<size_t> tpmIndexes;
+    for (size_t i = 0; i < signatures.size(); i++) {
+        const TPMT_SIGNATURE& sig = signatures[i];
+        if (m_pHostKey && HostRSAPublicKey::supportsScheme(sig.sigAlg, sig.signature.any.hashAlg)) {
+            hostIndexes.push_back(i);
+        } else {
+            tpmIndexes.push_back(i);
+        }
+    }
+
+    unsigned int threads = m_workerThreads;
+    if (0 == threads) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > hostIndexes.size()) {
+        threads = (unsigned int) hostIndexes.size();
+    }
+    std::vector<std::thread> workers;
+    const HostRSAPublicKey *pKey = m_pHostKey;
+    try {
+        for (unsigned int t = 0; t < threads; t++) {
+            // 各线程处理交错的下标, 写入 results 的不同元素, 无需加锁
+            workers.push_back(std::thread([t, threads, pKey, &hostIndexes, &digests, &signatures, &results]() {
+                for (size_t k = t; k < hostIndexes.size(); k += threads) {
+                    const size_t i = hostIndexes[k];
+                    results[i] = pKey->verify(digests[i], signatures[i]) ? 0 : TPM_RC_SIGNATURE;
+                }
+            }));
+        }
+        verifyOnTPM(digests, signatures, tpmIndexes, NULL, results);
+    } catch (...) {
+        // 创建线程失败或 TPM 通信失败: 已经启动的线程仍在访问本函数的局部变量, 必须等它们结束
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        throw;
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    m_hostVerifiedCount += hostIndexes.size();
+}
+
+void BatchVerifier::verifySignaturesWithTickets(
+        const std::vector<TPM2B_DIGEST>& digests,
+        const std::vector<TPMT_SIGNATURE>& signatures,
+        std::vector<TPMT_TK_VERIFIED>& tickets,
+        std::vector<TSS2_RC>& results
+        ) {
+    if (digests.size() != signatures.size()) {
+        throw std::invalid_argument("BatchVerifier::verifySignaturesWithTickets(): digests.size() != signatures.size()");
+    }
+    std::vector<size_t> indexes(digests.size());
+    for (size_t i = 0; i < indexes.size(); i++) {
+        indexes[i] = i;
+    }
+    results.assign(digests.size(), 0);
+    tickets.resize(digests.size());
+    verifyOnTPM(digests, signatures, indexes, &tickets, results);
+}
+
+// ============================================================================
+// TPM 返回的 TPM_RC_SIGNATURE 带有参数编号(例如 TPM_RC_SIGNATURE + TPM_RC_P + TPM_RC_2),
+// 统一去掉参数编号, 与主机端校验的结果保持一致
+// ============================================================================
+static TSS2_RC NormalizeVerificationResult(TSS2_RC rc) {
+    if ((rc & TSS2_ERROR_LEVEL_MASK) == TSS2_TPM_ERROR_LEVEL && (rc & RC_FMT1)
+            && (rc & (RC_FMT1 | 0x3F)) == TPM_RC_SIGNATURE) {
+        return TPM_RC_SIGNATURE;
+    }
+    return rc;
+}
+
+// ============================================================================
+// 通过 TPM2_VerifySignature 校验指定下标的签名, 多条命令经由 Client 发送队列流水线执行
+// ============================================================================
+void BatchVerifier::verifyOnTPM(
+        const std::vector<TPM2B_DIGEST>& digests,
+        const std::vector<TPMT_SIGNATURE>& signatures,
+        const std::vector<size_t>& indexes,
+        std::vector<TPMT_TK_VERIFIED> *pTickets,
+        std::vector<TSS2_RC>& results
+        ) {
+    if (indexes.empty()) {
+        return;
+    }
+    size_t depth = m_pipelineDepth;
+    if (depth > indexes.size()) {
+        depth = indexes.size();
+    }
+    std::vector<TPMCommands::VerifySignature> pool(depth);
+    std::deque<TPMCommands::VerifySignature *> idle;
+    for (size_t i = 0; i < pool.size(); i++) {
+        pool[i].configSigningKey(m_keyHandle);
+        idle.push_back(&pool[i]);
+    }
+
+    size_t next = 0;
+    try {
+        while (next < indexes.size() || pendingCommandCount() > 0) {
+            while (next < indexes.size() && !idle.empty()) {
+                TPMCommands::VerifySignature *pCmd = idle.front();
+                idle.pop_front();
+                const size_t i = indexes[next];
+                pCmd->configDigestWithSignature(digests[i], signatures[i]);
+                sendCommand(*pCmd, [pCmd, i, pTickets, &results, &idle](TPMCommand& command, TSS2_RC rc) {
+                    results[i] = NormalizeVerificationResult(rc);
+                    if (!rc && pTickets) {
+                        (*pTickets)[i] = pCmd->outValidationTicket();
+                    }
+                    idle.push_back(pCmd);
+                });
+                next++;
+            }
+            fetchResponse();
+        }
+    } catch (...) {
+        // 回调函数和命令对象都是本函数的局部变量, 异常离开本函数之前必须清空 Client 的发送队列
+        discardPendingCommands();
+        throw;
+    }
+    m_tpmVerifiedCount += indexes.size();
+}
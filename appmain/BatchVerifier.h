@@ -0,0 +1,104 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef BATCH_VERIFIER_H_
+#define BATCH_VERIFIER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "Client.h"
+
+#ifdef __cplusplus
+
+#include <vector>
+
+class HostRSAPublicKey;
+
+/// 批量数字签名校验客户端
+///
+/// 首次校验时通过 TPMCommands::ReadPublic 读取一次公钥区并缓存下来.
+/// 对于主机端能够校验的签名(RSA 公钥, RSASSA/RSAPSS 方案), 直接在主机端用多个线程并行校验;
+/// 其余签名(例如 ECC 签名)以及需要 TPMT_TK_VERIFIED 凭证的场合, 仍然通过 TPMCommands::VerifySignature 交给 TPM 校验.
+class BatchVerifier: public Client
+{
+public:
+    BatchVerifier();
+    virtual ~BatchVerifier();
+
+    /// 指定用于校验签名的公钥句柄, 同时清除之前缓存的公钥区
+    void configVerificationKey(TPM_HANDLE keyHandle);
+
+    /// 指定主机端校验线程个数, 0 表示使用 CPU 核数(默认值)
+    void configWorkerThreads(unsigned int threads);
+
+    /// 指定在 TPM 上校验时同时在途的命令个数(流水线深度), 默认为 4, 最小为 1
+    void configPipelineDepth(unsigned int depth);
+
+    /**
+     * 批量校验数字签名, 不需要 TPM 凭证
+     *
+     * @param results 输出参数. 与输入一一对应: 0 表示签名有效, TPM_RC_SIGNATURE 表示签名无效
+     *                (无论在主机端还是在 TPM 上校验, 都不带参数编号), 其他值为 TPM 返回的错误码
+     *
+     * @throws std::invalid_argument digests 与 signatures 个数不一致时抛出
+     * @throws TSS2_RC 读取公钥区失败或通信失败时抛出
+     */
+    void verifySignatures(
+            const std::vector<TPM2B_DIGEST>& digests, ///< 被签名的哈希摘要
+            const std::vector<TPMT_SIGNATURE>& signatures, ///< 待校验的数字签名
+            std::vector<TSS2_RC>& results ///< 输出参数. 各个签名的校验结果
+            );
+
+    /**
+     * 批量校验数字签名, 全部交给 TPM 校验并输出 TPMT_TK_VERIFIED 凭证
+     *
+     * @param tickets 输出参数. 校验成功的签名对应的凭证, 校验失败时对应元素内容未定义
+     * @param results 输出参数. 含义同 verifySignatures()
+     *
+     * @throws std::invalid_argument digests 与 signatures 个数不一致时抛出
+     * @throws TSS2_RC 通信失败时抛出
+     */
+    void verifySignaturesWithTickets(
+            const std::vector<TPM2B_DIGEST>& digests, ///< 被签名的哈希摘要
+            const std::vector<TPMT_SIGNATURE>& signatures, ///< 待校验的数字签名
+            std::vector<TPMT_TK_VERIFIED>& tickets, ///< 输出参数. 校验凭证
+            std::vector<TSS2_RC>& results ///< 输出参数. 各个签名的校验结果
+            );
+
+    /// 统计信息: 在主机端完成校验的签名个数
+    unsigned long hostVerifiedCount() const;
+
+    /// 统计信息: 交给 TPM 校验的签名个数
+    unsigned long tpmVerifiedCount() const;
+
+private:
+    void loadPublicArea();
+    void verifyOnTPM(
+            const std::vector<TPM2B_DIGEST>& digests,
+            const std::vector<TPMT_SIGNATURE>& signatures,
+            const std::vector<size_t>& indexes,
+            std::vector<TPMT_TK_VERIFIED> *pTickets,
+            std::vector<TSS2_RC>& results
+            );
+
+    TPM_HANDLE m_keyHandle;
+    bool m_publicAreaLoaded;
+    TPMT_PUBLIC m_publicArea;
+    HostRSAPublicKey *m_pHostKey; ///< 公钥为 RSA 类型时非空
+    unsigned int m_workerThreads;
+    unsigned int m_pipelineDepth;
+    unsigned long m_hostVerifiedCount;
+    unsigned long m_tpmVerifiedCount;
+
+    // 禁止复制
+    BatchVerifier(const BatchVerifier&);
+    BatchVerifier& operator=(const BatchVerifier&);
+};
+
+#endif // __cplusplus
+#endif // BATCH_VERIFIER_H_
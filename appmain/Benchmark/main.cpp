@@ -0,0 +1,1127 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include <sapi/tpm20.h>
+#include <tcti/tcti_socket.h>
+#ifndef DEFAULT_RESMGR_TPM_PORT /* @note This mircro and the legacy resourcemgr has been removed by upstream developer since 2017-05-09. @see https://github.com/01org/TPM2.0-TSS/commit/7966ef8916f79ed09eab966a58d773f413fbb67f#diff-9b5d40e51314bbf4fdfc0997a4b58838L41 */
+    #warning // DEFAULT_RESMGR_TPM_PORT was removed from <tcti_socket.h>!
+    #warning // You should either use "tcti/tcti-tabrmd.h" (which is a replacement to the legacy resourcemgr), or directly connect to port 2321 of the simulator without a resourcemgr!
+    #warning // See https://github.com/01org/tpm2-abrmd
+    #include <stdint.h>
+    const uint16_t DEFAULT_RESMGR_TPM_PORT=DEFAULT_SIMULATOR_TPM_PORT;
+#endif
+#include "TPMCommand.h"
+#include "Client.h"
+#include "CalculatorClient.h"
+#include "ConnectionManager.h"
+#include "SocketConnectionManager.h"
+#include "MockTPMConnectionManager.h"
+#include "WireTracer.h"
+#include "TctiRecorder.h"
+#include "ReplayConnectionManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+using std::exception;
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+static void PrintHelp()
+{
+    printf("用法:\n");
+    printf("-mock 使用进程内模拟 TPM (默认选项, 不需要 TPM 设备或 resourcemgr)\n");
+    printf("-mockLatency 为模拟 TPM 设定命令延迟的中位数(单位: 微秒, 按对数正态分布抽样, 默认值: 0)\n");
+    printf("-rmhost 手动指定运行资源管理器(即 resourcemgr)的主机IP地址或主机名 (默认值: %s)\n",
+            DEFAULT_HOSTNAME);
+    printf("-rmport 手动指定运行资源管理器的主机端口号 (默认值: %d)\n", DEFAULT_RESMGR_TPM_PORT);
+    printf("-localTctiTest\n");
+    printf("[注意: 若使用 -localTctiTest 请手动关闭任何占用/dev/tpm0设备的进程, 即: 关闭其他直接访问/dev/tpm0的resourcemgr进程]\n");
+    printf("-iterations 每项测试的计时次数 (默认值: 200)\n");
+    printf("-warmup 每项测试开始计时之前的预热次数 (默认值: 5)\n");
+    printf("-o 测试结果(JSON 格式)的输出文件名, 指定为 - 时输出到标准输出 (默认值: bench.json)\n");
+    printf("-trace 记录 TCTI 线路跟踪, 参数为输出文件名前缀, 生成 <前缀>.trace (二进制) 和 <前缀>.json (Chrome trace)\n");
+    printf("[注意: -trace 只对 -rmhost/-rmport 和 -localTctiTest 有效]\n");
+    printf("-record 把 TPM 的命令帧/应答帧录制到指定文件, 只对 -rmhost/-rmport 和 -localTctiTest 有效\n");
+    printf("-replay 不连接 TPM, 按 -record 录制的文件重放应答\n");
+    printf("-replayScale 重放时的延迟缩放系数, 1 为原始延迟, 0 为立即应答 (默认值: 1)\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/// 性能测试记录器
+///
+/// 每项测试重复执行 warmup + iterations 次, 只有后 iterations 次计入统计.
+/// 每次执行分为 prepare, operation, cleanup 三步, 只有 operation 计时,
+/// 例如测量 FlushLoadedKeyNode 时由 prepare 负责加载密钥, 测量 Load 时由 cleanup 负责清除密钥.
+///
+/// ops_per_sec 按"计时次数 / 计时总和"计算, 即串行执行时单条操作的吞吐量, 不包括 prepare/cleanup 的开销.
+class BenchmarkRecorder
+{
+public:
+    typedef std::function<void ()> Step;
+
+    BenchmarkRecorder(unsigned int iterations, unsigned int warmup)
+    {
+        m_iterations = iterations;
+        m_warmup = warmup;
+    }
+
+    /// 测量一项操作
+    void measure(const std::string& name, ///< 测试项名称
+            size_t payloadSize, ///< 输入数据长度(单位: 字节), 与数据长度无关的测试项填 0
+            const Step& operation, ///< 被计时的操作
+            const Step& prepare=Step(), ///< 每次计时之前执行的准备工作(不计时), 允许为空
+            const Step& cleanup=Step() ///< 每次计时之后执行的清理工作(不计时), 允许为空, 出错时忽略
+            )
+    {
+        Result result;
+        result.name = name;
+        result.payloadSize = payloadSize;
+        result.errors = 0;
+        result.lastError = 0;
+
+        fprintf(stderr, "%s (%u 字节) ...", name.c_str(), (unsigned int) payloadSize);
+        for (unsigned int i = 0; i < m_warmup + m_iterations; i++)
+        {
+            if (prepare)
+            {
+                try
+                {
+                    prepare();
+                }
+                catch (TSS2_RC rc)
+                {
+                    result.setupError = ErrorString(rc);
+                    break;
+                }
+                catch (std::exception& err)
+                {
+                    result.setupError = err.what();
+                    break;
+                }
+            }
+
+            bool succeeded = false;
+            Clock::time_point start = Clock::now();
+            try
+            {
+                operation();
+                succeeded = true;
+            }
+            catch (TSS2_RC rc)
+            {
+                result.errors += 1;
+                result.lastError = rc;
+            }
+            catch (std::exception& err)
+            {
+                result.errors += 1;
+                result.lastError = 0;
+            }
+            Clock::time_point end = Clock::now();
+
+            if (cleanup)
+            {
+                try
+                {
+                    cleanup();
+                }
+                catch (...)
+                {
+                    // 清理失败不影响计时结果
+                }
+            }
+            if (i >= m_warmup && succeeded) // 失败的调用通常提前返回, 计入样本会抬高吞吐量并拉低百分位数
+            {
+                result.latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            }
+        }
+        if (result.setupError.empty())
+        {
+            fprintf(stderr, " 完成, 错误次数 %u\n", result.errors);
+        }
+        else
+        {
+            fprintf(stderr, " 放弃: %s\n", result.setupError.c_str());
+        }
+        m_results.push_back(result);
+    }
+
+    /// 以 JSON 格式输出全部测试结果
+    void writeJSON(FILE *fp, const char *target) const
+    {
+        fprintf(fp, "{\n");
+        fprintf(fp, "  \"target\": ");
+        WriteJSONString(fp, target);
+        fprintf(fp, ",\n");
+        fprintf(fp, "  \"iterations\": %u,\n", m_iterations);
+        fprintf(fp, "  \"warmup\": %u,\n", m_warmup);
+        fprintf(fp, "  \"unit\": \"us\",\n");
+        fprintf(fp, "  \"results\": [");
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const Result& r = m_results[i];
+            std::vector<double> sorted(r.latencies);
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0;
+            for (size_t j = 0; j < sorted.size(); j++)
+            {
+                total += sorted[j];
+            }
+
+            fprintf(fp, "%s\n    {\"name\": ", (i > 0) ? "," : "");
+            WriteJSONString(fp, r.name.c_str());
+            fprintf(fp, ", \"payload_bytes\": %u", (unsigned int) r.payloadSize);
+            fprintf(fp, ", \"samples\": %u", (unsigned int) sorted.size());
+            fprintf(fp, ", \"errors\": %u", r.errors);
+            if (r.lastError)
+            {
+                fprintf(fp, ", \"last_error\": \"0x%X\"", r.lastError);
+            }
+            if (!r.setupError.empty())
+            {
+                fprintf(fp, ", \"setup_error\": ");
+                WriteJSONString(fp, r.setupError.c_str());
+            }
+            if (!sorted.empty())
+            {
+                fprintf(fp, ", \"ops_per_sec\": %.2f", (total > 0) ? sorted.size() * 1e6 / total : 0.0);
+                fprintf(fp, ", \"mean_us\": %.3f", total / sorted.size());
+                fprintf(fp, ", \"min_us\": %.3f", sorted.front());
+                fprintf(fp, ", \"p50_us\": %.3f", Percentile(sorted, 0.50));
+                fprintf(fp, ", \"p99_us\": %.3f", Percentile(sorted, 0.99));
+                fprintf(fp, ", \"p999_us\": %.3f", Percentile(sorted, 0.999));
+                fprintf(fp, ", \"max_us\": %.3f", sorted.back());
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "\n  ]\n");
+        fprintf(fp, "}\n");
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result {
+        std::string name;
+        size_t payloadSize;
+        std::vector<double> latencies; ///< 单位: 微秒
+        unsigned int errors; ///< 被计时的操作失败的次数
+        TSS2_RC lastError; ///< 最近一次失败的错误码, 非 TSS2_RC 异常记为 0
+        std::string setupError; ///< prepare 失败时的说明, 此时该项测试提前结束
+    };
+
+    /// 取已排序样本的百分位数(最近秩法)
+    static double Percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = (size_t) std::ceil(p * sorted.size());
+        if (rank < 1)
+        {
+            rank = 1;
+        }
+        return sorted[rank - 1];
+    }
+
+    static std::string ErrorString(TSS2_RC rc)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "TSS2_RC 0x%X", rc);
+        return std::string(buf);
+    }
+
+    static void WriteJSONString(FILE *fp, const char *s)
+    {
+        fputc('"', fp);
+        for (; *s; s++)
+        {
+            unsigned char c = (unsigned char) *s;
+            if ('"' == c || '\\' == c)
+            {
+                fprintf(fp, "\\%c", c);
+            }
+            else if (c < 0x20)
+            {
+                fprintf(fp, "\\u%04X", c);
+            }
+            else
+            {
+                fputc(c, fp);
+            }
+        }
+        fputc('"', fp);
+    }
+
+    unsigned int m_iterations;
+    unsigned int m_warmup;
+    std::vector<Result> m_results;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/// 在析构时清除密钥节点(忽略错误), 避免某一组测试中途失败后继续占用 TPM 对象槽位
+class ScopedKeyNode
+{
+public:
+    ScopedKeyNode(Client& client, TPM_HANDLE handle): m_client(client), m_handle(handle)
+    {
+    }
+    ~ScopedKeyNode()
+    {
+        try
+        {
+            TPMCommands::FlushLoadedKeyNode flush;
+            flush.configKeyNodeToFlushAway(m_handle);
+            m_client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        }
+        catch (...)
+        {
+        }
+    }
+    TPM_HANDLE handle() const
+    {
+        return m_handle;
+    }
+
+private:
+    Client& m_client;
+    TPM_HANDLE m_handle;
+};
+
+// 内部函数原型声明
+static void BenchLifecycleCommands(Client& client, BenchmarkRecorder& recorder, bool startupAllowed);
+static void BenchHashAndHMACCommands(Client& client, BenchmarkRecorder& recorder);
+static void BenchSessionCommands(Client& client, BenchmarkRecorder& recorder);
+static void BenchKeyCommands(Client& client, BenchmarkRecorder& recorder);
+static void BenchNVCommands(Client& client, BenchmarkRecorder& recorder);
+static void BenchHashCalculatorClient(ConnectionManager& connectionManager, BenchmarkRecorder& recorder);
+static void BenchHMACCalculatorClient(ConnectionManager& connectionManager, BenchmarkRecorder& recorder);
+
+int main(int argc, char *argv[])
+{
+    int count;
+    int usingDeviceFile = false;
+    int usingSocket = false;
+    const char *deviceFile = "/dev/tpm0";
+    const char *hostname = "127.0.0.1";
+    uint16_t port = DEFAULT_RESMGR_TPM_PORT;
+    double mockLatency = 0; // 单位: 微秒
+    unsigned int iterations = 200;
+    unsigned int warmup = 5;
+    const char *outputFile = "bench.json"; // HMACCalculatorClient 会向标准输出打印调试信息, 因此结果默认写入文件
+    const char *tracePrefix = NULL; // 线路跟踪输出文件名前缀, NULL 表示不跟踪
+    const char *recordFile = NULL;
+    const char *replayFile = NULL;
+    double replayScale = 1.0;
+
+    count = 1;
+    while (count < argc)
+    {
+        if (0 == strcmp(argv[count], "-localTctiTest"))
+        {
+            usingDeviceFile = true;
+            count += 1;
+            continue;
+        }
+        if (0 == strcmp(argv[count], "-mock"))
+        {
+            usingDeviceFile = false;
+            usingSocket = false;
+            count += 1;
+            continue;
+        }
+
+        if (count + 1 >= argc)
+        {
+            PrintHelp();
+            return 1;
+        }
+        if (0 == strcmp(argv[count], "-rmhost"))
+        {
+            hostname = argv[count + 1];  // 暂时不检查无效的输入参数
+            usingSocket = true;
+        }
+        else if (0 == strcmp(argv[count], "-rmport"))
+        {
+            port = strtoul(argv[count + 1], NULL, 10); // 暂时不检查无效的输入参数
+            usingSocket = true;
+        }
+        else if (0 == strcmp(argv[count], "-mockLatency"))
+        {
+            mockLatency = strtod(argv[count + 1], NULL);
+        }
+        else if (0 == strcmp(argv[count], "-iterations"))
+        {
+            iterations = strtoul(argv[count + 1], NULL, 10);
+        }
+        else if (0 == strcmp(argv[count], "-warmup"))
+        {
+            warmup = strtoul(argv[count + 1], NULL, 10);
+        }
+        else if (0 == strcmp(argv[count], "-o"))
+        {
+            outputFile = argv[count + 1];
+        }
+        else if (0 == strcmp(argv[count], "-trace"))
+        {
+            tracePrefix = argv[count + 1];
+        }
+        else if (0 == strcmp(argv[count], "-record"))
+        {
+            recordFile = argv[count + 1];
+        }
+        else if (0 == strcmp(argv[count], "-replay"))
+        {
+            replayFile = argv[count + 1];
+        }
+        else if (0 == strcmp(argv[count], "-replayScale"))
+        {
+            replayScale = strtod(argv[count + 1], NULL);
+        }
+        else
+        {
+            PrintHelp();
+            return -1;
+        }
+        count += 2;
+    }
+    if (iterations < 1)
+    {
+        PrintHelp();
+        return 1;
+    }
+
+    SocketConnectionManager socketConnectionManager(hostname, port);
+    CharacterDeviceConnectionManager deviceConnectionManager(deviceFile);
+    MockTPMConnectionManager mockConnectionManager;
+    WireTracer tracer(tracePrefix ? 16384 : 1); // 只保留最近的 16384 个事件(约 64MB), 不跟踪时不占用内存
+    std::unique_ptr<TctiRecorder> tctiRecorder;
+    std::unique_ptr<ReplayConnectionManager> replayConnectionManager;
+
+    ConnectionManager *connectionManager; ///< 通过指针选择使用哪一个上下文初始化器
+    const char *target;
+    connectionManager = &mockConnectionManager; // 默认使用模拟 TPM, 在编译机上也可以直接运行
+    target = "mock";
+    if (usingDeviceFile)
+    {
+        connectionManager = &deviceConnectionManager;
+        target = deviceFile;
+    }
+    else if (usingSocket)
+    {
+        connectionManager = &socketConnectionManager;
+        target = "socket";
+    }
+    else if (replayFile)
+    {
+        try
+        {
+            replayConnectionManager.reset(new ReplayConnectionManager(replayFile));
+            replayConnectionManager->configTimeScale(replayScale > 0 ? replayScale : 0);
+        }
+        catch (std::exception& err)
+        {
+            fprintf(stderr, "Error: %s\n", err.what());
+            return 1;
+        }
+        connectionManager = replayConnectionManager.get();
+        target = "replay";
+    }
+    else
+    {
+        mockConnectionManager.configRandomSeed(1); // 固定种子, 保证每次运行的命令结果和延迟序列相同
+        if (mockLatency > 0)
+        {
+            mockConnectionManager.configLatency(MockLatencyDistribution::LogNormal(mockLatency, 0.25));
+        }
+    }
+
+    if (tracePrefix)
+    {
+        if (connectionManager == &mockConnectionManager)
+        {
+            fprintf(stderr, "Warning: -trace 对模拟 TPM 无效, 已忽略\n");
+            tracePrefix = NULL;
+        }
+        socketConnectionManager.configTracer(&tracer);
+        deviceConnectionManager.configTracer(&tracer);
+    }
+    if (recordFile)
+    {
+        if (connectionManager != &socketConnectionManager && connectionManager != &deviceConnectionManager)
+        {
+            fprintf(stderr, "Error: -record 只能录制真实的 TPM 或模拟器\n");
+            return 1;
+        }
+        try
+        {
+            tctiRecorder.reset(new TctiRecorder(recordFile));
+        }
+        catch (std::exception& err)
+        {
+            fprintf(stderr, "Error: %s\n", err.what());
+            return 1;
+        }
+        socketConnectionManager.configRecorder(tctiRecorder.get());
+        deviceConnectionManager.configRecorder(tctiRecorder.get());
+    }
+
+    FILE *fpOut = stdout;
+    if (0 != strcmp(outputFile, "-"))
+    {
+        fpOut = fopen(outputFile, "w");
+        if (!fpOut)
+        {
+            perror(outputFile);
+            return 1;
+        }
+    }
+
+    BenchmarkRecorder recorder(iterations, warmup);
+    connectionManager->connect();
+    {
+        Client client;
+        client.bind(*connectionManager);
+        // Startup/Shutdown 会改变 TPM 的运行状态, 只在模拟 TPM 上测量
+        BenchLifecycleCommands(client, recorder, connectionManager == &mockConnectionManager);
+        BenchHashAndHMACCommands(client, recorder);
+        BenchSessionCommands(client, recorder);
+        BenchKeyCommands(client, recorder);
+        BenchNVCommands(client, recorder);
+        client.unbind();
+    }
+    BenchHashCalculatorClient(*connectionManager, recorder);
+    BenchHMACCalculatorClient(*connectionManager, recorder);
+    connectionManager->disconnect();
+
+    if (tctiRecorder)
+    {
+        try
+        {
+            tctiRecorder->close();
+            fprintf(stderr, "已录制 %llu 条命令到 %s\n", (unsigned long long) tctiRecorder->recordCount(), recordFile);
+        }
+        catch (std::exception& err)
+        {
+            fprintf(stderr, "Error: 无法保存录制文件: %s\n", err.what());
+        }
+    }
+    if (replayConnectionManager)
+    {
+        fprintf(stderr, "重放: %llu 条命令, 跳过 %llu 条记录, %llu 条命令找不到匹配的记录\n",
+                (unsigned long long) replayConnectionManager->commandCount(),
+                (unsigned long long) replayConnectionManager->skippedCount(),
+                (unsigned long long) replayConnectionManager->unmatchedCount());
+    }
+    if (tracePrefix)
+    {
+        const std::string traceFile = std::string(tracePrefix) + ".trace";
+        const std::string jsonFile = std::string(tracePrefix) + ".json";
+        try
+        {
+            tracer.dumpBinary(traceFile.c_str());
+            WireTracer::ConvertToChromeTrace(traceFile.c_str(), jsonFile.c_str());
+            fprintf(stderr, "线路跟踪: %llu 个事件 (覆盖 %llu 个), 已写入 %s 和 %s\n",
+                    (unsigned long long) tracer.recordedCount(), (unsigned long long) tracer.droppedCount(),
+                    traceFile.c_str(), jsonFile.c_str());
+        }
+        catch (std::exception& err)
+        {
+            fprintf(stderr, "Error: 无法保存线路跟踪: %s\n", err.what());
+        }
+    }
+
+    recorder.writeJSON(fpOut, target);
+    if (fpOut != stdout)
+    {
+        fclose(fpOut);
+    }
+    return (0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/// 生成指定长度的测试数据
+static std::vector<unsigned char> MakePayload(size_t size)
+{
+    std::vector<unsigned char> payload(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        payload[i] = (unsigned char) (i * 31 + 7);
+    }
+    return payload;
+}
+
+/// 每组测试的一个包装函数, 前置步骤失败时打印错误信息并继续执行下一组测试
+static void RunGroup(const char *groupName, const std::function<void ()>& group)
+{
+    try
+    {
+        group();
+    }
+    catch (TSS2_RC rc)
+    {
+        fprintf(stderr, "%s: 前置步骤失败, rc=0x%X, 跳过本组剩余测试\n", groupName, rc);
+    }
+    catch (std::exception& err)
+    {
+        fprintf(stderr, "%s: 前置步骤失败: %s, 跳过本组剩余测试\n", groupName, err.what());
+    }
+}
+
+static const char *HashAlgorithmName(TPMI_ALG_HASH hashAlg)
+{
+    return (TPM_ALG_SHA1 == hashAlg) ? "SHA1" : "SHA256";
+}
+
+static void BenchLifecycleCommands(Client& client, BenchmarkRecorder& recorder, bool startupAllowed)
+{
+    RunGroup("Startup/Shutdown", [&]()
+    {
+        if (startupAllowed)
+        {
+            TPMCommands::Startup startup;
+            recorder.measure("TPMCommands::Startup", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(startup);
+            });
+
+            TPMCommands::Shutdown shutdown;
+            recorder.measure("TPMCommands::Shutdown", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(shutdown);
+            });
+        }
+
+        TPMCommands::GetTestResult getTestResult;
+        recorder.measure("TPMCommands::GetTestResult", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(getTestResult);
+        });
+    });
+}
+
+static void BenchHashAndHMACCommands(Client& client, BenchmarkRecorder& recorder)
+{
+    const size_t payloadSizes[] = {16, 256, 1024};
+    const TPMI_ALG_HASH hashAlgorithms[] = {TPM_ALG_SHA1, TPM_ALG_SHA256};
+
+    RunGroup("Hash", [&]()
+    {
+        for (size_t a = 0; a < sizeof(hashAlgorithms) / sizeof(hashAlgorithms[0]); a++)
+        {
+            for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+            {
+                const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+                TPMCommands::Hash hash;
+                if (TPM_ALG_SHA1 == hashAlgorithms[a])
+                {
+                    hash.configHashAlgorithmUsingSHA1();
+                }
+                else
+                {
+                    hash.configHashAlgorithmUsingSHA256();
+                }
+                hash.configInputData(payload.data(), payload.size());
+                recorder.measure(std::string("TPMCommands::Hash/") + HashAlgorithmName(hashAlgorithms[a]), payload.size(), [&]()
+                {
+                    client.sendCommandAndWaitUntilResponseIsFetched(hash);
+                });
+            }
+        }
+    });
+
+    RunGroup("HMAC", [&]()
+    {
+        const std::vector<unsigned char> key = MakePayload(32);
+        for (size_t a = 0; a < sizeof(hashAlgorithms) / sizeof(hashAlgorithms[0]); a++)
+        {
+            TPMCommands::LoadExternal loadExternal;
+            loadExternal.configHierarchy(TPM_RH_NULL);
+            loadExternal.configSensitiveDataBits(key.data(), key.size());
+            loadExternal.configHMACKeyUsingHashAlgorithm(hashAlgorithms[a]);
+            loadExternal.configKeyAuthValue("", 0);
+            client.sendCommandAndWaitUntilResponseIsFetched(loadExternal);
+            ScopedKeyNode hmacKey(client, loadExternal.outObjectHandle());
+
+            for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+            {
+                const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+                TPMCommands::HMAC hmac;
+                hmac.configHMACKey(hmacKey.handle());
+                hmac.configAuthSession(TPM_RS_PW);
+                hmac.configAuthPassword("", 0);
+                hmac.configUsingHashAlgorithm(hashAlgorithms[a]);
+                hmac.configInputData(payload.data(), payload.size());
+                recorder.measure(std::string("TPMCommands::HMAC/") + HashAlgorithmName(hashAlgorithms[a]), payload.size(), [&]()
+                {
+                    client.sendCommandAndWaitUntilResponseIsFetched(hmac);
+                });
+            }
+        }
+    });
+}
+
+static void BenchSessionCommands(Client& client, BenchmarkRecorder& recorder)
+{
+    RunGroup("Session", [&]()
+    {
+        TPMCommands::StartAuthSession startAuthSession;
+        TPMCommands::FlushAuthSession flushAuthSession;
+        startAuthSession.configSessionTypeAsHMACSession();
+
+        recorder.measure("TPMCommands::StartAuthSession", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(startAuthSession);
+        }, BenchmarkRecorder::Step(), [&]()
+        {
+            flushAuthSession.configSessionHandleToFlushAway(startAuthSession.outSessionHandle());
+            client.sendCommandAndWaitUntilResponseIsFetched(flushAuthSession);
+        });
+
+        recorder.measure("TPMCommands::FlushAuthSession", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(flushAuthSession);
+        }, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(startAuthSession);
+            flushAuthSession.configSessionHandleToFlushAway(startAuthSession.outSessionHandle());
+        });
+    });
+}
+
+/// 填写 RSA-2048 存储密钥(主节点)模板
+static TPMT_PUBLIC RSAStorageKeyTemplate()
+{
+    TPMT_PUBLIC publicArea;
+    memset(&publicArea, 0, sizeof(publicArea));
+    publicArea.type = TPM_ALG_RSA;
+    publicArea.nameAlg = TPM_ALG_SHA1;
+    publicArea.objectAttributes.val = 0;
+    publicArea.objectAttributes.fixedTPM = 1;
+    publicArea.objectAttributes.fixedParent = 1;
+    publicArea.objectAttributes.restricted = 1;
+    publicArea.objectAttributes.userWithAuth = 1;
+    publicArea.objectAttributes.sensitiveDataOrigin = 1;
+    publicArea.objectAttributes.decrypt = 1;
+    publicArea.objectAttributes.sign = 0;
+    publicArea.authPolicy.t.size = 0;
+    publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_AES;
+    publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM_ALG_CFB;
+    publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    publicArea.parameters.rsaDetail.keyBits = 2048;
+    publicArea.parameters.rsaDetail.exponent = 0;
+    publicArea.unique.rsa.t.size = 0;
+    return publicArea;
+}
+
+/// 填写 RSA-2048 子节点模板: sign 为真时生成签名密钥, 否则生成 OAEP-SHA1 解密密钥
+static TPM2B_PUBLIC RSAChildKeyTemplate(bool sign)
+{
+    TPM2B_PUBLIC inPublic;
+    memset(&inPublic, 0, sizeof(inPublic));
+    inPublic.t.publicArea.type = TPM_ALG_RSA;
+    inPublic.t.publicArea.nameAlg = TPM_ALG_SHA1;
+    inPublic.t.publicArea.objectAttributes.val = 0;
+    inPublic.t.publicArea.objectAttributes.fixedTPM = 1;
+    inPublic.t.publicArea.objectAttributes.fixedParent = 1;
+    inPublic.t.publicArea.objectAttributes.restricted = 0;
+    inPublic.t.publicArea.objectAttributes.userWithAuth = 1;
+    inPublic.t.publicArea.objectAttributes.sensitiveDataOrigin = 1;
+    inPublic.t.publicArea.objectAttributes.decrypt = sign ? 0 : 1;
+    inPublic.t.publicArea.objectAttributes.sign = sign ? 1 : 0;
+    inPublic.t.publicArea.authPolicy.t.size = 0;
+    inPublic.t.publicArea.parameters.rsaDetail.symmetric.algorithm = TPM_ALG_NULL;
+    if (sign)
+    {
+        inPublic.t.publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_NULL;
+    }
+    else
+    {
+        inPublic.t.publicArea.parameters.rsaDetail.scheme.scheme = TPM_ALG_OAEP;
+        inPublic.t.publicArea.parameters.rsaDetail.scheme.details.oaep.hashAlg = TPM_ALG_SHA1;
+    }
+    inPublic.t.publicArea.parameters.rsaDetail.keyBits = 2048;
+    inPublic.t.publicArea.parameters.rsaDetail.exponent = 0;
+    inPublic.t.publicArea.unique.rsa.t.size = 0;
+    return inPublic;
+}
+
+/// 创建并加载一个 RSA 子节点(不计时), 返回其句柄
+static TPM_HANDLE CreateAndLoadRSAChildKey(Client& client, TPM_HANDLE parent, bool sign)
+{
+    TPMCommands::Create create;
+    create.configAuthParent(parent);
+    create.configAuthSession(TPM_RS_PW);
+    create.configAuthPassword("", 0);
+    create.configKeySensitiveData("", 0, "", 0);
+    create.configPublicData(RSAChildKeyTemplate(sign));
+    client.sendCommandAndWaitUntilResponseIsFetched(create);
+
+    TPMCommands::Load load;
+    load.configAuthParent(parent);
+    load.configAuthSession(TPM_RS_PW);
+    load.configAuthPassword("", 0);
+    load.configPrivateData(create.outPrivate());
+    load.configPublicData(create.outPublic());
+    client.sendCommandAndWaitUntilResponseIsFetched(load);
+    return load.outObjectHandle();
+}
+
+static void BenchKeyCommands(Client& client, BenchmarkRecorder& recorder)
+{
+    // 同一时刻最多占用 3 个对象槽位(主节点 + 常驻子节点 + 被测命令临时加载的节点), 不依赖资源管理器也能运行
+    RunGroup("Key", [&]()
+    {
+        TPMCommands::CreatePrimary createPrimary;
+        createPrimary.configAuthHierarchy(TPM_RH_NULL);
+        createPrimary.configAuthSession(TPM_RS_PW);
+        createPrimary.configAuthPassword("", 0);
+        createPrimary.configKeyNameAlg(TPM_ALG_SHA1);
+        createPrimary.configKeySensitiveData("", 0, "", 0);
+        createPrimary.configPublicData(RSAStorageKeyTemplate());
+        TPMCommands::FlushLoadedKeyNode flush;
+
+        recorder.measure("TPMCommands::CreatePrimary/RSA2048", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(createPrimary);
+        }, BenchmarkRecorder::Step(), [&]()
+        {
+            flush.configKeyNodeToFlushAway(createPrimary.outObjectHandle());
+            client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        });
+
+        client.sendCommandAndWaitUntilResponseIsFetched(createPrimary);
+        ScopedKeyNode primary(client, createPrimary.outObjectHandle());
+
+        // Create 系列命令只输出密钥数据, 不占用对象槽位
+        TPMCommands::Create createRSA;
+        createRSA.configAuthParent(primary.handle());
+        createRSA.configAuthSession(TPM_RS_PW);
+        createRSA.configAuthPassword("", 0);
+        createRSA.configKeySensitiveData("", 0, "", 0);
+        createRSA.configPublicData(RSAChildKeyTemplate(true));
+        recorder.measure("TPMCommands::Create/RSA2048", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(createRSA);
+        });
+
+        TPMCommands::HMACKeyCreate createHMACKey;
+        createHMACKey.configAuthParent(primary.handle());
+        createHMACKey.configAuthSession(TPM_RS_PW);
+        createHMACKey.configAuthPassword("", 0);
+        createHMACKey.configKeyNameAlg(TPM_ALG_SHA256);
+        createHMACKey.configKeySensitiveData("", 0, "", 0);
+        createHMACKey.configHMACKeyParameters(TPM_ALG_SHA256);
+        recorder.measure("TPMCommands::HMACKeyCreate", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(createHMACKey);
+        });
+
+        TPMCommands::KeyedHashXORKeyCreate createKeyedHashXORKey;
+        createKeyedHashXORKey.configAuthParent(primary.handle());
+        createKeyedHashXORKey.configAuthSession(TPM_RS_PW);
+        createKeyedHashXORKey.configAuthPassword("", 0);
+        createKeyedHashXORKey.configKeyNameAlg(TPM_ALG_SHA256);
+        createKeyedHashXORKey.configKeySensitiveData("", 0, "", 0);
+        createKeyedHashXORKey.configKeyedHashXORKeyParameters(TPM_ALG_SHA256);
+        recorder.measure("TPMCommands::KeyedHashXORKeyCreate", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(createKeyedHashXORKey);
+        });
+
+        TPMCommands::SymmetricXORKeyCreate createSymmetricXORKey;
+        createSymmetricXORKey.configAuthParent(primary.handle());
+        createSymmetricXORKey.configAuthSession(TPM_RS_PW);
+        createSymmetricXORKey.configAuthPassword("", 0);
+        createSymmetricXORKey.configKeyNameAlg(TPM_ALG_SHA256);
+        createSymmetricXORKey.configKeySensitiveData("", 0, "", 0);
+        createSymmetricXORKey.configSymmetricXORKeyParameters(TPM_ALG_SHA256);
+        recorder.measure("TPMCommands::SymmetricXORKeyCreate", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(createSymmetricXORKey);
+        });
+
+        // 加载/清除
+        TPMCommands::Load load;
+        load.configAuthParent(primary.handle());
+        load.configAuthSession(TPM_RS_PW);
+        load.configAuthPassword("", 0);
+        load.configPrivateData(createRSA.outPrivate());
+        load.configPublicData(createRSA.outPublic());
+        recorder.measure("TPMCommands::Load", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(load);
+        }, BenchmarkRecorder::Step(), [&]()
+        {
+            flush.configKeyNodeToFlushAway(load.outObjectHandle());
+            client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        });
+
+        recorder.measure("TPMCommands::FlushLoadedKeyNode", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        }, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(load);
+            flush.configKeyNodeToFlushAway(load.outObjectHandle());
+        });
+
+        const std::vector<unsigned char> hmacKeyBits = MakePayload(32);
+        TPMCommands::LoadExternal loadExternal;
+        loadExternal.configHierarchy(TPM_RH_NULL);
+        loadExternal.configSensitiveDataBits(hmacKeyBits.data(), hmacKeyBits.size());
+        loadExternal.configHMACKeyUsingHashAlgorithm(TPM_ALG_SHA256);
+        loadExternal.configKeyAuthValue("", 0);
+        recorder.measure("TPMCommands::LoadExternal", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(loadExternal);
+        }, BenchmarkRecorder::Step(), [&]()
+        {
+            flush.configKeyNodeToFlushAway(loadExternal.outObjectHandle());
+            client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        });
+
+        // 签名密钥: ReadPublic, ContextSave, ContextLoad, Sign, VerifySignature
+        {
+            ScopedKeyNode signingKey(client, CreateAndLoadRSAChildKey(client, primary.handle(), true));
+
+            TPMCommands::ReadPublic readPublic;
+            readPublic.configObject(signingKey.handle());
+            recorder.measure("TPMCommands::ReadPublic", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(readPublic);
+            });
+
+            TPMCommands::ContextSave contextSave;
+            contextSave.configHandle(signingKey.handle());
+            recorder.measure("TPMCommands::ContextSave", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(contextSave);
+            });
+
+            client.sendCommandAndWaitUntilResponseIsFetched(contextSave);
+            TPMCommands::ContextLoad contextLoad;
+            contextLoad.configContext(contextSave.outContext());
+            recorder.measure("TPMCommands::ContextLoad", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(contextLoad);
+            }, BenchmarkRecorder::Step(), [&]()
+            {
+                flush.configKeyNodeToFlushAway(contextLoad.outHandle());
+                client.sendCommandAndWaitUntilResponseIsFetched(flush);
+            });
+
+            TPMCommands::Hash hash;
+            hash.configHashAlgorithmUsingSHA256();
+            hash.configInputData("abc", 3);
+            client.sendCommandAndWaitUntilResponseIsFetched(hash);
+
+            TPMCommands::Sign sign;
+            sign.configDigestToBeSigned(hash.outHash().t.buffer, hash.outHash().t.size);
+            sign.configValidationTicket(hash.outValidationTicket());
+            sign.configScheme(DigitalSignatureSchemes::RSASSA_PKCS1_V1_5_SHA256);
+            sign.configSigningKey(signingKey.handle());
+            sign.configAuthSession(TPM_RS_PW);
+            sign.configAuthPassword("", 0);
+            recorder.measure("TPMCommands::Sign/RSASSA-SHA256", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(sign);
+            });
+
+            client.sendCommandAndWaitUntilResponseIsFetched(sign);
+            TPMCommands::VerifySignature verifySignature;
+            verifySignature.configSigningKey(signingKey.handle());
+            verifySignature.configDigestWithSignature(hash.outHash(), sign.outSignature());
+            recorder.measure("TPMCommands::VerifySignature/RSASSA-SHA256", 0, [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(verifySignature);
+            });
+        }
+
+        // 解密密钥: Encrypt, Decrypt
+        {
+            ScopedKeyNode decryptKey(client, CreateAndLoadRSAChildKey(client, primary.handle(), false));
+            const size_t payloadSizes[] = {16, 64, 128};
+            for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+            {
+                const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+                TPMCommands::Encrypt encrypt;
+                encrypt.config(payload.data(), payload.size(), 2048, decryptKey.handle());
+                recorder.measure("TPMCommands::Encrypt/RSA2048-OAEP", payload.size(), [&]()
+                {
+                    client.sendCommandAndWaitUntilResponseIsFetched(encrypt);
+                });
+
+                client.sendCommandAndWaitUntilResponseIsFetched(encrypt);
+                TPMCommands::Decrypt decrypt;
+                decrypt.config(encrypt.outDataBuffer(), encrypt.outDataLength(), 2048, decryptKey.handle());
+                decrypt.configAuthSession(TPM_RS_PW);
+                decrypt.configAuthPassword("", 0);
+                recorder.measure("TPMCommands::Decrypt/RSA2048-OAEP", payload.size(), [&]()
+                {
+                    client.sendCommandAndWaitUntilResponseIsFetched(decrypt);
+                });
+            }
+        }
+    });
+}
+
+/// 删除 NV Index(不计时). TPMCommands 中没有 NV_UndefineSpace 命令, 这里直接调用 SAPI 同步接口
+static void UndefineNVIndex(Client& client, TPMI_RH_NV_INDEX index)
+{
+    TPMS_AUTH_COMMAND sessionData;
+    memset(&sessionData, 0, sizeof(sessionData));
+    sessionData.sessionHandle = TPM_RS_PW;
+    TPMS_AUTH_COMMAND *cmdAuths[1] = {&sessionData};
+    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
+    cmdAuthsArray.cmdAuthsCount = 1;
+    cmdAuthsArray.cmdAuths = cmdAuths;
+
+    TSS2_RC rc = Tss2_Sys_NV_UndefineSpace(client.m_sysContext, TPM_RH_PLATFORM, index, &cmdAuthsArray, NULL);
+    if (rc)
+    {
+        throw rc;
+    }
+}
+
+static void BenchNVCommands(Client& client, BenchmarkRecorder& recorder)
+{
+    const TPMI_RH_NV_INDEX scratchIndex = 0x01500100; // 用于测量 DefineSpace, 每次测量后立即删除
+    const TPMI_RH_NV_INDEX dataIndex = 0x01500101; // 用于测量 ReadPublic/Write/Read
+    const UINT16 dataIndexSize = 1024;
+
+    // 上次运行中途退出时可能遗留了 NV Index, 先尝试删除
+    const TPMI_RH_NV_INDEX indexes[] = {scratchIndex, dataIndex};
+    for (size_t i = 0; i < sizeof(indexes) / sizeof(indexes[0]); i++)
+    {
+        try
+        {
+            UndefineNVIndex(client, indexes[i]);
+        }
+        catch (TSS2_RC rc)
+        {
+        }
+    }
+
+    RunGroup("NV", [&]()
+    {
+        TPMCommands::NV::DefineSpace defineSpace;
+        defineSpace.configNVIndex(scratchIndex);
+        defineSpace.configNVIndexDataSize(dataIndexSize);
+        defineSpace.configCreatorAsPlatform();
+        defineSpace.configAuthSession(TPM_RS_PW);
+        defineSpace.configAuthPassword("", 0);
+        defineSpace.configNVIndexAuthPassword("", 0);
+        recorder.measure("TPMCommands::NV::DefineSpace", dataIndexSize, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(defineSpace);
+        }, BenchmarkRecorder::Step(), [&]()
+        {
+            UndefineNVIndex(client, scratchIndex);
+        });
+
+        defineSpace.configNVIndex(dataIndex);
+        client.sendCommandAndWaitUntilResponseIsFetched(defineSpace);
+
+        TPMCommands::NV::ReadPublic readPublic;
+        readPublic.configNVIndex(dataIndex);
+        recorder.measure("TPMCommands::NV::ReadPublic", 0, [&]()
+        {
+            client.sendCommandAndWaitUntilResponseIsFetched(readPublic);
+        });
+
+        const size_t payloadSizes[] = {16, 256, 1024};
+        for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+        {
+            const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+            TPMCommands::NV::Write write;
+            write.configNVIndex(dataIndex, 0);
+            write.configInputData(payload.data(), payload.size());
+            write.configNVIndexAuthSession(TPM_RS_PW);
+            write.configNVIndexPassword("", 0);
+            recorder.measure("TPMCommands::NV::Write", payload.size(), [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(write);
+            });
+        }
+        for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+        {
+            TPMCommands::NV::Read read;
+            read.configNVIndex(dataIndex, payloadSizes[s], 0);
+            read.configNVIndexAuthSession(TPM_RS_PW);
+            read.configNVIndexPassword("", 0);
+            recorder.measure("TPMCommands::NV::Read", payloadSizes[s], [&]()
+            {
+                client.sendCommandAndWaitUntilResponseIsFetched(read);
+            });
+        }
+
+        UndefineNVIndex(client, dataIndex);
+    });
+}
+
+static void BenchHashCalculatorClient(ConnectionManager& connectionManager, BenchmarkRecorder& recorder)
+{
+    const size_t payloadSizes[] = {64, 1024, 16384};
+    RunGroup("HashCalculatorClient", [&]()
+    {
+        HashCalculatorClient client;
+        client.bind(connectionManager);
+        for (int host = 0; host <= 1; host++)
+        {
+            // 主机模式作为对照组, 可以看出 TPM 模式下的开销主要来自哪里
+            client.configValidationTicketRequired(!host);
+            const char *mode = host ? "(host)" : "";
+            for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+            {
+                const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+                recorder.measure(std::string("HashCalculatorClient") + mode + "::SHA1", payload.size(), [&]()
+                {
+                    client.SHA1(payload.data(), payload.size());
+                });
+                recorder.measure(std::string("HashCalculatorClient") + mode + "::SHA256", payload.size(), [&]()
+                {
+                    client.SHA256(payload.data(), payload.size());
+                });
+            }
+        }
+        client.unbind();
+    });
+}
+
+static void BenchHMACCalculatorClient(ConnectionManager& connectionManager, BenchmarkRecorder& recorder)
+{
+    // 注: HMACCalculatorClient 每次计算都会执行 LoadExternal + HMAC + FlushContext 三条命令, 并向标准输出打印调试信息
+    const size_t payloadSizes[] = {64, 256, 1024};
+    RunGroup("HMACCalculatorClient", [&]()
+    {
+        const std::vector<unsigned char> key = MakePayload(32);
+        HMACCalculatorClient client;
+        client.bind(connectionManager);
+        for (size_t s = 0; s < sizeof(payloadSizes) / sizeof(payloadSizes[0]); s++)
+        {
+            const std::vector<unsigned char> payload = MakePayload(payloadSizes[s]);
+            recorder.measure("HMACCalculatorClient::HMAC_SHA1", payload.size(), [&]()
+            {
+                client.HMAC_SHA1(payload.data(), payload.size(), key.data(), key.size());
+            });
+            recorder.measure("HMACCalculatorClient::HMAC_SHA256", payload.size(), [&]()
+            {
+                client.HMAC_SHA256(payload.data(), payload.size(), key.data(), key.size());
+            });
+        }
+        client.unbind();
+    });
+}
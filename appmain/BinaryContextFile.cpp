@@ -0,0 +1,218 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sapi/tpm20.h>
+#include "BinaryContextFile.h"
+#include "ByteOrder.h"
+
+static const char MAGIC[4] = {'T', 'C', 'T', 'X'};
+static const char *DEFAULT_FILE_NAME = "context.ctx";
+
+// ============================================================================
+// CRC32 (查表法)
+// ============================================================================
+/// CRC32 查找表, 作为函数内静态对象在首次调用时生成(C++11 保证线程安全)
+struct CRC32Table
+{
+    uint32_t entries[256];
+    CRC32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+uint32_t BinaryContextCRC32(const void *data, size_t length, uint32_t crc)
+{
+    static const CRC32Table table;
+    const uint8_t *p = (const uint8_t *) data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ============================================================================
+// TPMS_CONTEXT 编码/解码
+// ============================================================================
+size_t MarshalContext(const TPMS_CONTEXT& context, uint8_t *buffer, size_t capacity)
+{
+    const size_t size = 8 + 4 + 4 + 2 + context.contextBlob.t.size;
+    if (capacity < size)
+    {
+        return 0;
+    }
+    PutUINT32(buffer, (uint32_t) (context.sequence >> 32));
+    PutUINT32(buffer + 4, (uint32_t) context.sequence);
+    PutUINT32(buffer + 8, context.savedHandle);
+    PutUINT32(buffer + 12, context.hierarchy);
+    PutUINT16(buffer + 16, context.contextBlob.t.size);
+    memcpy(buffer + 18, context.contextBlob.t.buffer, context.contextBlob.t.size);
+    return size;
+}
+
+size_t UnmarshalContext(const uint8_t *data, size_t length, TPMS_CONTEXT& context)
+{
+    if (length < 18)
+    {
+        return 0;
+    }
+    const uint16_t blobSize = GetUINT16(data + 16);
+    if (blobSize > sizeof(context.contextBlob.t.buffer) || length < 18u + blobSize)
+    {
+        return 0;
+    }
+    context.sequence = ((UINT64) GetUINT32(data) << 32) | GetUINT32(data + 4);
+    context.savedHandle = GetUINT32(data + 8);
+    context.hierarchy = GetUINT32(data + 12);
+    context.contextBlob.t.size = blobSize;
+    memcpy(context.contextBlob.t.buffer, data + 18, blobSize);
+    return 18u + blobSize;
+}
+
+// ============================================================================
+// 格式化输出器
+// ============================================================================
+BinaryContextFileFormatter::BinaryContextFileFormatter()
+{
+    m_szFileName = DEFAULT_FILE_NAME;
+}
+
+BinaryContextFileFormatter::BinaryContextFileFormatter(const char *szFileName)
+{
+    m_szFileName = DEFAULT_FILE_NAME;
+    setFileName(szFileName);
+}
+
+void BinaryContextFileFormatter::setFileName(const char *szFileName)
+{
+    if (!szFileName) // 不允许调用者传入NULL指针
+    {
+        throw std::invalid_argument("BinaryContextFileFormatter::setFileName(): szFileName is NULL");
+    }
+    m_szFileName = szFileName;
+}
+
+void BinaryContextFileFormatter::output(const TPMS_CONTEXT& context)
+{
+    uint8_t buffer[BINARY_CONTEXT_FILE_HEADER_SIZE + sizeof(TPMS_CONTEXT) + 8];
+    const size_t payloadSize = MarshalContext(context, buffer + BINARY_CONTEXT_FILE_HEADER_SIZE,
+            sizeof(buffer) - BINARY_CONTEXT_FILE_HEADER_SIZE);
+    memcpy(buffer, MAGIC, sizeof(MAGIC));
+    PutUINT16(buffer + 4, BINARY_CONTEXT_FILE_VERSION);
+    PutUINT16(buffer + 6, (uint16_t) BINARY_CONTEXT_FILE_HEADER_SIZE);
+    PutUINT32(buffer + 8, (uint32_t) payloadSize);
+    PutUINT32(buffer + 12, BinaryContextCRC32(buffer + BINARY_CONTEXT_FILE_HEADER_SIZE, payloadSize));
+    const size_t fileSize = BINARY_CONTEXT_FILE_HEADER_SIZE + payloadSize;
+
+    std::string tmpFileName(m_szFileName);
+    tmpFileName += ".tmp";
+    FILE *fp = fopen(tmpFileName.c_str(), "wb");
+    if (!fp)
+    {
+        throw std::ios::failure(std::string("Cannot create ") + tmpFileName + ": " + strerror(errno));
+    }
+    const bool ok = (fwrite(buffer, 1, fileSize, fp) == fileSize) && (0 == fflush(fp)) && (0 == fsync(fileno(fp)));
+    fclose(fp);
+    if (!ok || 0 != rename(tmpFileName.c_str(), m_szFileName))
+    {
+        const int err = errno;
+        unlink(tmpFileName.c_str());
+        throw std::ios::failure(std::string("Cannot write ") + m_szFileName + ": " + strerror(err));
+    }
+}
+
+// ============================================================================
+// 解析器
+// ============================================================================
+BinaryContextFileParser::BinaryContextFileParser()
+{
+    m_szFileName = DEFAULT_FILE_NAME;
+}
+
+BinaryContextFileParser::BinaryContextFileParser(const char *szFileName)
+{
+    m_szFileName = DEFAULT_FILE_NAME;
+    setFileName(szFileName);
+}
+
+void BinaryContextFileParser::setFileName(const char *szFileName)
+{
+    if (!szFileName) // 不允许调用者传入NULL指针
+    {
+        throw std::invalid_argument("BinaryContextFileParser::setFileName(): szFileName is NULL");
+    }
+    m_szFileName = szFileName;
+}
+
+void BinaryContextFileParser::fetch(TPMS_CONTEXT& contextOut)
+{
+    int fd = open(m_szFileName, O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::ios::failure(std::string("Cannot open ") + m_szFileName + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) BINARY_CONTEXT_FILE_HEADER_SIZE)
+    {
+        close(fd);
+        throw std::runtime_error(std::string("Invalid binary context file: ") + m_szFileName);
+    }
+    const size_t fileSize = (size_t) st.st_size;
+    void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapped)
+    {
+        throw std::ios::failure(std::string("Cannot mmap ") + m_szFileName + ": " + strerror(errno));
+    }
+
+    const uint8_t *p = (const uint8_t *) mapped;
+    const char *error = NULL;
+    const uint16_t headerSize = GetUINT16(p + 6);
+    const uint32_t payloadSize = GetUINT32(p + 8);
+    if (0 != memcmp(p, MAGIC, sizeof(MAGIC)))
+    {
+        error = "bad magic";
+    }
+    else if (GetUINT16(p + 4) != BINARY_CONTEXT_FILE_VERSION)
+    {
+        error = "unsupported version";
+    }
+    else if (headerSize < BINARY_CONTEXT_FILE_HEADER_SIZE || (size_t) headerSize + payloadSize > fileSize)
+    {
+        error = "truncated file";
+    }
+    else if (BinaryContextCRC32(p + headerSize, payloadSize) != GetUINT32(p + 12))
+    {
+        error = "checksum mismatch";
+    }
+    else if (0 == UnmarshalContext(p + headerSize, payloadSize, contextOut))
+    {
+        error = "malformed TPMS_CONTEXT";
+    }
+    munmap(mapped, fileSize);
+    if (error)
+    {
+        throw std::runtime_error(std::string("Invalid binary context file ") + m_szFileName + ": " + error);
+    }
+}
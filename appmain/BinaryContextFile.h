@@ -0,0 +1,105 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef BINARY_CONTEXT_FILE_H_
+#define BINARY_CONTEXT_FILE_H_
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <stdint.h>
+#include <sapi/tpm20.h>
+
+/// 二进制 ContextFile 文件格式(版本 1), 所有整数均为大端字节序:
+///
+/// | 偏移 | 长度 | 字段                                           |
+/// |------|------|------------------------------------------------|
+/// | 0    | 4    | 魔数 "TCTX"                                    |
+/// | 4    | 2    | 格式版本号, 当前为 1                           |
+/// | 6    | 2    | 文件头长度, 当前为 16                          |
+/// | 8    | 4    | 数据区长度                                     |
+/// | 12   | 4    | 数据区的 CRC32 校验和                          |
+/// | 16   | -    | 数据区: 按 TPM 规范编码的 TPMS_CONTEXT 结构体  |
+///
+/// 数据区依次为 sequence(8), savedHandle(4), hierarchy(4), contextBlob(2字节长度 + 数据),
+/// 与 TPM2_ContextSave 应答帧中的编码完全相同.
+///
+/// @see ContextFileFormatter 文本格式(便于人工阅读, 但解析较慢)
+
+const size_t BINARY_CONTEXT_FILE_HEADER_SIZE = 16;
+const uint16_t BINARY_CONTEXT_FILE_VERSION = 1;
+
+/// 计算 CRC32 校验和(IEEE 802.3 多项式), 可分段连续计算: crc 参数传入上一段的计算结果
+uint32_t BinaryContextCRC32(const void *data, size_t length, uint32_t crc=0);
+
+/// 按 TPM 规范编码 TPMS_CONTEXT
+///
+/// @return 编码后的字节数; buffer 容量不足时返回 0
+size_t MarshalContext(const TPMS_CONTEXT& context, uint8_t *buffer, size_t capacity);
+
+/// 解码 TPMS_CONTEXT
+///
+/// @return 解码消耗的字节数; 数据不完整或长度字段越界时返回 0
+size_t UnmarshalContext(const uint8_t *data, size_t length, TPMS_CONTEXT& context);
+
+/// 二进制 ContextFile 格式化输出器
+class BinaryContextFileFormatter
+/// 配套的解析器是: BinaryContextFileParser
+{
+public:
+    /// 构造函数格式1: 不带参数, 默认文件名为 "context.ctx"
+    BinaryContextFileFormatter();
+
+    /// 构造函数格式2: 带文件名参数
+    ///
+    /// @throws std::invalid_argument 文件名为 NULL 时抛出
+    BinaryContextFileFormatter(const char *szFileName);
+
+    /// 设定文件名
+    ///
+    /// @throws std::invalid_argument 文件名为 NULL 时抛出
+    void setFileName(const char *szFileName);
+
+    /// 文件格式化输出
+    ///
+    /// 先写入同目录下的临时文件, 完成后再重命名为目标文件名, 避免中途断电留下残缺文件
+    ///
+    /// @throws std::ios::failure 写入失败时抛出
+    void output(const TPMS_CONTEXT& context);
+
+private:
+    const char *m_szFileName;
+};
+
+/// 二进制 ContextFile 解析器
+class BinaryContextFileParser
+/// 文件格式由 BinaryContextFileFormatter 定义
+{
+public:
+    /// 构造函数格式1: 不带参数, 默认文件名为 "context.ctx"
+    BinaryContextFileParser();
+
+    /// 构造函数格式2: 带文件名参数
+    ///
+    /// @throws std::invalid_argument 文件名为 NULL 时抛出
+    BinaryContextFileParser(const char *szFileName);
+
+    /// 设定文件名
+    ///
+    /// @throws std::invalid_argument 文件名为 NULL 时抛出
+    void setFileName(const char *szFileName);
+
+    /// 取回文件解析结果
+    ///
+    /// 文件通过 mmap() 映射到内存, 校验文件头和 CRC32 之后按固定偏移直接取出各个字段, 无需逐行解析文本
+    ///
+    /// @throws std::ios::failure 读取文件失败时抛出
+    /// @throws std::runtime_error 文件格式错误或校验和不符时抛出
+    void fetch(TPMS_CONTEXT& contextOut);
+
+private:
+    const char *m_szFileName;
+};
+
+#endif // __cplusplus
+#endif // BINARY_CONTEXT_FILE_H_
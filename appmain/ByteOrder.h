@@ -0,0 +1,59 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef BYTE_ORDER_H_
+#define BYTE_ORDER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#ifdef __cplusplus
+
+#include <stdint.h>
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// 大端字节序读写
+// ============================================================================
+// 各二进制文件格式(上下文文件, 上下文存储, 线路跟踪, TCTI 录制)共用, 与 TPM 命令帧的字节序一致
+
+inline void PutUINT16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) v;
+}
+
+inline void PutUINT32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+inline void PutUINT64(uint8_t *p, uint64_t v)
+{
+    PutUINT32(p, (uint32_t) (v >> 32));
+    PutUINT32(p + 4, (uint32_t) v);
+}
+
+inline uint16_t GetUINT16(const uint8_t *p)
+{
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+inline uint32_t GetUINT32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+inline uint64_t GetUINT64(const uint8_t *p)
+{
+    return ((uint64_t) GetUINT32(p) << 32) | GetUINT32(p + 4);
+}
+
+#endif // __cplusplus
+#endif // BYTE_ORDER_H_
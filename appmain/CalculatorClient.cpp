@@ -8,6 +8,12 @@ using std::vector;
 using std::ostringstream;
 #include <stdexcept>
 using std::runtime_error;
+#include <cerrno>
+#include <cstring> // strerror()
+#include <fcntl.h> // open()
+#include <unistd.h> // read()/close()
+#include <sys/mman.h> // mmap()/madvise()
+#include <sys/stat.h> // fstat()
 #include "CalculatorClient.h"
 #include "TPMCommand.h"
 
@@ -41,87 +47,118 @@ void HashCalculatorClient::fetchResponse(int32_t timeout)
     m_scheduler.fetchResponse(timeout);
 }
 
-// 计算SHA256哈希摘要结果
-const vector<unsigned char>& HashCalculatorClient::SHA256(const void *data, // 指向输入数据的指针
-        unsigned long long length // 数据长度. 单位: 字节. 取值范围[0, ULLONG_MAX]
-        ) {
-    if (length > MaxBlockSize) {
-        m_digest.clear();
-        try {
-            unsigned long long left = length;
-            const unsigned char *p = (const unsigned char *) data;
+// 构造函数
+HashCalculatorClient::HashCalculatorClient()
+{
+    m_validationTicketRequired = true; // 默认保持原有行为: 由 TPM 计算并出具凭证
+    m_hashAlgorithm = TPM_ALG_NULL;
+    m_hashingOnHost = false;
+    m_sha1Context = SHA1CreateNewContext();
+    m_sha256Context = SHA256CreateNewContext();
+    memset(&m_validationTicket, 0x00, sizeof(m_validationTicket));
+}
 
-            m_scheduler.start(TPM_ALG_SHA256);
-            while (left)
-            {
-                unsigned short n = MaxBlockSize;
-                if (left < MaxBlockSize)
-                {
-                    n = (unsigned short) left;
-                }
-                m_scheduler.inputData(p, n);
-                p += n;
-                left -= n;
-            }
-            m_scheduler.complete();
+// 析构函数
+HashCalculatorClient::~HashCalculatorClient()
+{
+    SHA1DeleteContext(m_sha1Context);
+    SHA256DeleteContext(m_sha256Context);
+}
 
-            const TPM2B_DIGEST& digest = m_scheduler.outDigest();
-            m_digest.assign(digest.t.buffer, digest.t.buffer + digest.t.size);
-        } catch (std::exception& err) {
-            std::ostringstream msg;
-            msg << "Error: 命令执行失败! " << err.what();
-            throw std::runtime_error(msg.str());
-        } catch (...) {
-            std::ostringstream msg;
-            msg << "An unknown error was detected from " << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__;
-            throw std::runtime_error(msg.str());
-        }
-        return m_digest;
-    }
+// 指定是否需要 TPM 出具哈希校验凭证
+void HashCalculatorClient::configValidationTicketRequired(bool required)
+{
+    m_validationTicketRequired = required;
+}
 
-    TPMCommands::Hash hashCmd;
-    hashCmd.configHashAlgorithmUsingSHA256();
+// 输出最近一次计算得到的校验凭证
+const TPMT_TK_HASHCHECK& HashCalculatorClient::outValidationTicket()
+{
+    return m_validationTicket;
+}
+
+// 开始分段计算哈希摘要
+void HashCalculatorClient::startDigest(TPMI_ALG_HASH hashAlg)
+{
     m_digest.clear();
-    try {
-        hashCmd.configInputData(data, length);
-        sendCommand(hashCmd);
-        fetchResponse();
-        const TPM2B_DIGEST &outHash = hashCmd.outHash();
-        m_digest.assign(outHash.t.buffer, outHash.t.buffer+outHash.t.size);
-    } catch (...) {
+    m_hashAlgorithm = hashAlg;
+    m_hashingOnHost = !m_validationTicketRequired;
+    if (!m_hashingOnHost) {
+        m_scheduler.start(hashAlg);
+        return;
+    }
+    switch (hashAlg) {
+    case TPM_ALG_SHA1:
+        SHA1Reset(m_sha1Context);
+        break;
+    case TPM_ALG_SHA256:
+        SHA256Reset(m_sha256Context);
+        break;
+    default:
         std::ostringstream msg;
-        msg << "An unknown error was detected from " << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__;
+        msg << "Error: 主机端不支持该哈希算法 0x" << std::hex << hashAlg;
         throw std::runtime_error(msg.str());
     }
-    return m_digest;
 }
 
-// 计算SHA1哈希摘要结果
-const vector<unsigned char>& HashCalculatorClient::SHA1(const void *data, // 指向输入数据的指针
+// 输入下一段数据
+void HashCalculatorClient::updateDigest(const void *data, unsigned long long length)
+{
+    const unsigned int MaxChunkSize = 1u << 30; // 底层接口长度参数为 unsigned int, 超长数据分段输入
+    const unsigned char *p = (const unsigned char *) data;
+    while (length > 0) {
+        unsigned int n = MaxChunkSize;
+        if (length < MaxChunkSize) {
+            n = (unsigned int) length;
+        }
+        if (!m_hashingOnHost) {
+            m_scheduler.inputData(p, n);
+        } else if (TPM_ALG_SHA1 == m_hashAlgorithm) {
+            SHA1Input(m_sha1Context, p, n);
+        } else {
+            SHA256Input(m_sha256Context, p, n);
+        }
+        p += n;
+        length -= n;
+    }
+}
+
+// 结束分段计算
+void HashCalculatorClient::completeDigest()
+{
+    if (!m_hashingOnHost) {
+        m_scheduler.complete();
+        const TPM2B_DIGEST& digest = m_scheduler.outDigest();
+        m_digest.assign(digest.t.buffer, digest.t.buffer + digest.t.size);
+        m_validationTicket = m_scheduler.outValidationTicket();
+        return;
+    }
+    if (TPM_ALG_SHA1 == m_hashAlgorithm) {
+        uint8_t digest[SHA1HashSize];
+        SHA1Result(m_sha1Context, digest);
+        m_digest.assign(digest, digest + sizeof(digest));
+    } else {
+        uint8_t digest[SHA256HashSize];
+        SHA256Result(m_sha256Context, digest);
+        m_digest.assign(digest, digest + sizeof(digest));
+    }
+    // 主机端计算的摘要没有 TPM 出具的凭证, 输出空凭证
+    m_validationTicket.tag = TPM_ST_HASHCHECK;
+    m_validationTicket.hierarchy = TPM_RH_NULL;
+    m_validationTicket.digest.t.size = 0;
+}
+
+// 计算单个数据包的哈希摘要
+const vector<unsigned char>& HashCalculatorClient::calculateDigest(TPMI_ALG_HASH hashAlg, // 哈希算法
+        const void *data, // 指向输入数据的指针
         unsigned long long length // 数据长度. 单位: 字节. 取值范围[0, ULLONG_MAX]
         ) {
-    if (length > MaxBlockSize) {
+    if (length > MaxBlockSize || !m_validationTicketRequired) {
         m_digest.clear();
         try {
-            unsigned long long left = length;
-            const unsigned char *p = (const unsigned char *) data;
-
-            m_scheduler.start(TPM_ALG_SHA1);
-            while (left)
-            {
-                unsigned short n = MaxBlockSize;
-                if (left < MaxBlockSize)
-                {
-                    n = (unsigned short) left;
-                }
-                m_scheduler.inputData(p, n);
-                p += n;
-                left -= n;
-            }
-            m_scheduler.complete();
-
-            const TPM2B_DIGEST& digest = m_scheduler.outDigest();
-            m_digest.assign(digest.t.buffer, digest.t.buffer + digest.t.size);
+            startDigest(hashAlg);
+            updateDigest(data, length);
+            completeDigest();
         } catch (std::exception& err) {
             std::ostringstream msg;
             msg << "Error: 命令执行失败! " << err.what();
@@ -135,7 +172,11 @@ const vector<unsigned char>& HashCalculatorClient::SHA1(const void *data, // 指
     }
 
     TPMCommands::Hash hashCmd;
-    hashCmd.configHashAlgorithmUsingSHA1();
+    if (TPM_ALG_SHA1 == hashAlg) {
+        hashCmd.configHashAlgorithmUsingSHA1();
+    } else {
+        hashCmd.configHashAlgorithmUsingSHA256();
+    }
     m_digest.clear();
     try {
         hashCmd.configInputData(data, length);
@@ -143,6 +184,7 @@ const vector<unsigned char>& HashCalculatorClient::SHA1(const void *data, // 指
         fetchResponse();
         const TPM2B_DIGEST &outHash = hashCmd.outHash();
         m_digest.assign(outHash.t.buffer, outHash.t.buffer+outHash.t.size);
+        m_validationTicket = hashCmd.outValidationTicket();
     } catch (...) {
         std::ostringstream msg;
         msg << "An unknown error was detected from " << __FILE__ << ":" << __LINE__ << ":" << __FUNCTION__;
@@ -151,6 +193,20 @@ const vector<unsigned char>& HashCalculatorClient::SHA1(const void *data, // 指
     return m_digest;
 }
 
+// 计算SHA256哈希摘要结果
+const vector<unsigned char>& HashCalculatorClient::SHA256(const void *data, // 指向输入数据的指针
+        unsigned long long length // 数据长度. 单位: 字节. 取值范围[0, ULLONG_MAX]
+        ) {
+    return calculateDigest(TPM_ALG_SHA256, data, length);
+}
+
+// 计算SHA1哈希摘要结果
+const vector<unsigned char>& HashCalculatorClient::SHA1(const void *data, // 指向输入数据的指针
+        unsigned long long length // 数据长度. 单位: 字节. 取值范围[0, ULLONG_MAX]
+        ) {
+    return calculateDigest(TPM_ALG_SHA1, data, length);
+}
+
 /// 是否开启printf调试信息
 #define ENABLE_DEBUG_PRINTF 1 ///< 可选值: 0表示禁用printf(); 1或任意非零值表示允许输出printf()调试信息.
 
@@ -295,21 +351,18 @@ const std::vector<unsigned char>& FileHashCalculatorClient::SHA1(FILE *fpFileIn)
         const int nBufSize = sizeof(buf);
         int len = 0;
 
-        m_scheduler.start(TPM_ALG_SHA1);
+        startDigest(TPM_ALG_SHA1);
         while (!(feof(fpFileIn)))
         {
             len = fread(buf, sizeof(BYTE), nBufSize, fpFileIn);
             if (len > 0)
             {
-                m_scheduler.inputData(buf, len);
+                updateDigest(buf, len);
             }
             fprintf(stderr, ".");
         }
-        m_scheduler.complete();
+        completeDigest();
         fprintf(stderr, "\n");
-
-        const TPM2B_DIGEST& digest = m_scheduler.outDigest();
-        m_digest.assign(digest.t.buffer, digest.t.buffer + digest.t.size);
     }
     catch (std::exception& err)
     {
@@ -328,21 +381,18 @@ const std::vector<unsigned char>& FileHashCalculatorClient::SHA256(FILE *fpFileI
         const int nBufSize = sizeof(buf);
         int len = 0;
 
-        m_scheduler.start(TPM_ALG_SHA256);
+        startDigest(TPM_ALG_SHA256);
         while (!(feof(fpFileIn)))
         {
             len = fread(buf, sizeof(BYTE), nBufSize, fpFileIn);
             if (len > 0)
             {
-                m_scheduler.inputData(buf, len);
+                updateDigest(buf, len);
             }
             fprintf(stderr, ".");
         }
-        m_scheduler.complete();
+        completeDigest();
         fprintf(stderr, "\n");
-
-        const TPM2B_DIGEST& digest = m_scheduler.outDigest();
-        m_digest.assign(digest.t.buffer, digest.t.buffer + digest.t.size);
     }
     catch (std::exception& err)
     {
@@ -350,3 +400,105 @@ const std::vector<unsigned char>& FileHashCalculatorClient::SHA256(FILE *fpFileI
     }
     return m_digest;
 }
+
+// 计算指定路径文件的SHA1
+const std::vector<unsigned char>& FileHashCalculatorClient::SHA1(const char *path)
+{
+    digestFile(TPM_ALG_SHA1, path);
+    return m_digest;
+}
+
+// 计算指定路径文件的SHA256
+const std::vector<unsigned char>& FileHashCalculatorClient::SHA256(const char *path)
+{
+    digestFile(TPM_ALG_SHA256, path);
+    return m_digest;
+}
+
+// 按文件路径计算哈希摘要
+void FileHashCalculatorClient::digestFile(TPMI_ALG_HASH hashAlg, const char *path)
+{
+    /// 每次映射的窗口大小(须为页面大小的整数倍). 分窗口映射可以限制超大文件占用的虚拟地址空间
+    const size_t MapWindowSize = 64 * 1024 * 1024;
+
+    m_digest.clear();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::ostringstream msg;
+        msg << "Error: Cannot open file \"" << path << "\": " << strerror(errno);
+        throw std::runtime_error(msg.str());
+    }
+    try {
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            std::ostringstream msg;
+            msg << "Error: Cannot stat file \"" << path << "\": " << strerror(errno);
+            throw std::runtime_error(msg.str());
+        }
+        startDigest(hashAlg);
+        bool mapped = false;
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            unsigned long long offset = 0;
+            unsigned long long fileSize = (unsigned long long) st.st_size;
+            while (offset < fileSize) {
+                size_t n = MapWindowSize;
+                if (fileSize - offset < n) {
+                    n = (size_t) (fileSize - offset);
+                }
+                void *p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+                if (MAP_FAILED == p) {
+                    break; // 只有第一个窗口映射失败时才会改用 read(), 见下文
+                }
+                mapped = true;
+                madvise(p, n, MADV_SEQUENTIAL); // 提示内核按顺序预读, 读过的页面可以尽早回收
+                try {
+                    updateDigest(p, n);
+                } catch (...) {
+                    munmap(p, n);
+                    throw;
+                }
+                munmap(p, n);
+                offset += n;
+            }
+            if (mapped && offset < fileSize) {
+                std::ostringstream msg;
+                msg << "Error: Cannot map file \"" << path << "\": " << strerror(errno);
+                throw std::runtime_error(msg.str());
+            }
+        }
+        if (!mapped) {
+            // 管道/字符设备等无法映射的文件, 以及文件系统不支持 mmap 的情况
+#ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            digestFileDescriptor(fd);
+        }
+        completeDigest();
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+// 通过 read() 逐块读取文件描述符
+void FileHashCalculatorClient::digestFileDescriptor(int fd)
+{
+    std::vector<BYTE> buf(64 * 1024); // 1024字节的整数倍, 保证 HashSequenceScheduler 可以直接发送完整数据包
+    for (;;) {
+        ssize_t len = read(fd, &buf[0], buf.size());
+        if (len > 0) {
+            updateDigest(&buf[0], (unsigned long long) len);
+            continue;
+        }
+        if (0 == len) {
+            break; // EOF
+        }
+        if (EINTR == errno) {
+            continue;
+        }
+        std::ostringstream msg;
+        msg << "Error: Cannot read file: " << strerror(errno);
+        throw std::runtime_error(msg.str());
+    }
+}
@@ -14,10 +14,37 @@
 #include <vector>
 #include "Client.h"
 #include "SequenceScheduler.h"
+#include "SHA1.h" // 主机端 SHA1 算法, 位于 algorithms/SHA1 目录
+#include "SHA256.h" // 主机端 SHA256 算法, 位于 algorithms/SHA256 目录
 
 /// 计算单个数据包的哈希摘要, 输入数据的最大长度由TPM硬件以及TSS动态库限制, 通常为1024字节
+///
+/// 支持两种工作模式:
+/// - TPM 模式(默认): 所有数据都发送给 TPM 计算, 同时由 TPM 出具 TPMT_TK_HASHCHECK 校验凭证
+/// - 主机模式: 调用 configValidationTicketRequired(false) 之后, 直接在主机端计算哈希摘要, 速度快得多, 但不会得到有效的校验凭证
 class HashCalculatorClient: public WrapperClient
 {
+public:
+    /// 构造函数
+    HashCalculatorClient();
+    /// 析构函数
+    virtual ~HashCalculatorClient();
+
+public:
+    /// 指定是否需要 TPM 出具哈希校验凭证
+    ///
+    /// 校验凭证 TPMT_TK_HASHCHECK 用于证明摘要值是 TPM 亲自计算得出的, 后续让 TPM 对该摘要签名时可能需要出示此凭证.
+    /// 不需要凭证时, 哈希摘要直接在主机端计算, 不经过 TPM.
+    ///
+    /// @note TPM 无法为主机端算出的摘要补发凭证(凭证只能证明 TPM 亲自处理过原始数据), 因此需要凭证时只能将全部数据交给 TPM 计算
+    void configValidationTicketRequired(bool required=true ///< true(默认值)表示需要凭证, 由 TPM 计算摘要; false 表示不需要凭证, 由主机计算摘要
+            );
+
+    /// 输出最近一次计算得到的校验凭证
+    ///
+    /// @return TPMT_TK_HASHCHECK 结构体引用. 主机模式下输出空凭证(hierarchy=TPM_RH_NULL, digest 长度为 0)
+    const TPMT_TK_HASHCHECK& outValidationTicket();
+
 public:
     /// 计算SHA256哈希摘要结果
     ///
@@ -39,6 +66,36 @@ public:
 protected:
     /// 哈希摘要结果(私有数据存储区)
     std::vector<unsigned char> m_digest;
+    /// 校验凭证(私有数据存储区)
+    TPMT_TK_HASHCHECK m_validationTicket;
+
+protected:
+    /// 开始分段计算哈希摘要. 根据 configValidationTicketRequired() 的设置选择由主机或由 TPM 计算
+    ///
+    /// @throws std::exception 代表执行失败
+    void startDigest(TPMI_ALG_HASH hashAlg ///< 哈希算法, 取值 TPM_ALG_SHA1 或 TPM_ALG_SHA256
+            );
+    /// 输入下一段数据
+    ///
+    /// @throws std::exception 代表执行失败
+    void updateDigest(const void *data, ///< 指向输入数据的指针
+            unsigned long long length ///< 数据长度. 单位: 字节
+            );
+    /// 结束分段计算, 摘要结果写入 m_digest, 校验凭证写入 m_validationTicket
+    ///
+    /// @throws std::exception 代表执行失败
+    void completeDigest();
+
+private:
+    /// 计算单个数据包的哈希摘要(SHA1()/SHA256()的公共实现)
+    const std::vector<unsigned char>& calculateDigest(TPMI_ALG_HASH hashAlg, const void *data, unsigned long long length);
+
+private:
+    bool m_validationTicketRequired; ///< 是否需要 TPM 出具校验凭证. false 表示在主机端计算
+    TPMI_ALG_HASH m_hashAlgorithm; ///< startDigest() 指定的哈希算法
+    bool m_hashingOnHost; ///< 当前这次分段计算是否在主机端进行
+    SHA1Context *m_sha1Context; ///< 主机端 SHA1 上下文
+    SHA256Context *m_sha256Context; ///< 主机端 SHA256 上下文
 
 public:
     /// 客户端绑定串口连接或socket连接
@@ -86,6 +143,31 @@ public:
     /// @return SHA256 哈希摘要结果, 格式为二进制数据, 类型为 const vector<BYTE>& C++ 指针引用
     const std::vector<unsigned char>& SHA256(FILE *fpFileIn=stdin ///< 通过标准文件IO流读取输入数据
             );
+
+public:
+    /// 计算指定路径文件的SHA1哈希摘要结果
+    ///
+    /// 普通文件通过 mmap() 映射到内存后直接输入哈希序列(或主机端哈希算法), 不经过 stdio 缓冲区;
+    /// 管道等无法映射的文件自动改用 read() 读取
+    ///
+    /// @return SHA1 哈希摘要结果, 格式为二进制数据, 类型为 const vector<BYTE>& C++ 指针引用
+    /// @throws std::exception 代表执行失败, 可能导致执行失败的原因包括: 文件无法打开或读取, TPM设备应答异常等
+    const std::vector<unsigned char>& SHA1(const char *path ///< 文件路径
+            );
+
+    /// 计算指定路径文件的SHA256哈希摘要结果
+    ///
+    /// @return SHA256 哈希摘要结果, 格式为二进制数据, 类型为 const vector<BYTE>& C++ 指针引用
+    /// @throws std::exception 代表执行失败, 可能导致执行失败的原因包括: 文件无法打开或读取, TPM设备应答异常等
+    /// @see SHA1(const char *path)
+    const std::vector<unsigned char>& SHA256(const char *path ///< 文件路径
+            );
+
+private:
+    /// 按文件路径计算哈希摘要(SHA1(const char *)/SHA256(const char *)的公共实现)
+    void digestFile(TPMI_ALG_HASH hashAlg, const char *path);
+    /// 通过 read() 逐块读取文件描述符, 用于管道或无法映射的文件
+    void digestFileDescriptor(int fd);
 };
 
 /// 计算单个数据包的HMAC对称签名, 输入数据的最大长度由TPM硬件以及TSS动态库限制, 通常为1024字节
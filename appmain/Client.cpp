@@ -5,6 +5,9 @@
 #include <cstdlib> // malloc()/free()
 #include <cassert> // assert()
 #include <stdexcept>
+#include <memory> // std::shared_ptr
+#include <exception> // std::exception_ptr
+#include <chrono>
 using std::exception;
 #include <sapi/tpm20.h>
 #include "TPMCommand.h"
@@ -14,7 +17,10 @@ using std::exception;
 
 Client::Client() {
     m_pLastCommand = NULL;
+    m_transmitError = 0;
     m_sysContext = NULL;
+    m_pStatistics = NULL;
+    m_lastCommandCode = 0;
 }
 
 void Client::bind(ConnectionManager& connectionManager) {
@@ -23,31 +29,115 @@ void Client::bind(ConnectionManager& connectionManager) {
 }
 
 void Client::unbind() {
+    m_pendingCommands.clear();
+    m_pLastCommand = NULL;
+    m_lastCommandCompletion = CommandCompletionCallback();
+    m_transmitError = 0;
     m_sysContext = NULL;
     this->ApplicationBasedOnTSSSystemAPI::unbind();
 }
 
 void Client::sendCommandAndWaitUntilResponseIsFetched(TPMCommand& cmd) {
     int timeout = TSS2_TCTI_TIMEOUT_BLOCK;
-    try {
-        sendCommand(cmd);
-        m_pLastCommand = &cmd;
-        fetchResponse(timeout);
-    } catch (std::exception e) {
-        // TODO: 处理发送命令桢或接收响应桢中可能遇到的异常情况, 例如响应超时等
+    // 完成状态由回调函数共同持有, 而不是引用本函数的栈变量:
+    // 即使本函数因异常提前返回, 留在队列中的回调函数也不会写入已经失效的栈帧
+    struct Completion {
+        bool finished;
+        TSS2_RC rc;
+    };
+    std::shared_ptr<Completion> completion(new Completion());
+    completion->finished = false;
+    completion->rc = 0;
+    sendCommand(cmd, [completion](TPMCommand& command, TSS2_RC result) {
+        completion->finished = true;
+        completion->rc = result;
+    });
+    // 先取回排在 cmd 之前的应答帧, 最后一条即为 cmd 的应答帧.
+    // 排在前面的命令出错时仍继续取回, 直到 cmd 完成, 保证返回时 Client 不再引用 cmd, 然后再抛出第一个错误
+    std::exception_ptr firstError;
+    while (!completion->finished && pendingCommandCount() > 0) {
+        try {
+            fetchResponse(timeout);
+        } catch (...) {
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+        }
+    }
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+    if (completion->rc) {
+        throw completion->rc;
     }
 }
 
 void Client::sendCommand(TPMCommand& cmd) {
+    sendCommand(cmd, CommandCompletionCallback());
+}
+
+void Client::sendCommand(TPMCommand& cmd, const CommandCompletionCallback& onCompletion) {
+    if (m_pLastCommand) {
+        // 上一条命令的应答帧尚未取回, 本条命令先排队, 由 fetchResponse() 负责在取回上一条应答帧之后发出
+        PendingCommand pending;
+        pending.pCommand = &cmd;
+        pending.onCompletion = onCompletion;
+        m_pendingCommands.push_back(pending);
+        return;
+    }
+    transmitCommand(cmd, onCompletion);
+}
+
+void Client::configStatistics(CommandStatistics *pStatistics) {
+    m_pStatistics = pStatistics;
+}
+
+void Client::recordStatistics(TPM_CC commandCode, std::chrono::steady_clock::time_point transmitTime, TSS2_RC rc) {
+    if (!m_pStatistics) {
+        return;
+    }
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - transmitTime;
+    m_pStatistics->record(commandCode,
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), rc);
+}
+
+std::future<TSS2_RC> Client::submitCommand(TPMCommand& cmd) {
+    std::shared_ptr< std::promise<TSS2_RC> > promise(new std::promise<TSS2_RC>());
+    std::future<TSS2_RC> result = promise->get_future();
+    sendCommand(cmd, [promise](TPMCommand& command, TSS2_RC rc) {
+        promise->set_value(rc);
+    });
+    return result;
+}
+
+size_t Client::pendingCommandCount() {
+    return m_pendingCommands.size() + (m_pLastCommand ? 1 : 0);
+}
+
+void Client::transmitCommand(TPMCommand& cmd, const CommandCompletionCallback& onCompletion) {
     cmd.buildCmdPacket(m_sysContext); // 调用相应的 TSS 软件栈 Tss2_Sys_XXXX_Prepare() 函数
 
+    if (m_pStatistics) {
+        UINT8 commandCode[4];
+        m_lastCommandCode = 0;
+        if (TSS2_RC_SUCCESS == Tss2_Sys_GetCommandCode(m_sysContext, &commandCode)) {
+            // 输出的命令码按 TPM 命令帧中的大端字节序排列
+            m_lastCommandCode = ((TPM_CC) commandCode[0] << 24) | ((TPM_CC) commandCode[1] << 16)
+                    | ((TPM_CC) commandCode[2] << 8) | (TPM_CC) commandCode[3];
+        }
+        m_lastTransmitTime = std::chrono::steady_clock::now();
+    } else {
+        m_lastTransmitTime = std::chrono::steady_clock::time_point(); // 未计时
+    }
+
     // 异步发送命令帧
     TSS2_RC err = Tss2_Sys_ExecuteAsync(m_sysContext);
     if (err) {
         fprintf(stderr, "Error: Cannot send command packet: Tss2_Sys_ExecuteAsync() returns 0x%X\n", (int) err);
-        // TODO: throw/raise an expection to the up level
     }
+    m_transmitError = err; // 发送失败时由 fetchResponse() 将错误码交给调用者
     m_pLastCommand = &cmd;
+    m_lastCommandCompletion = onCompletion;
 }
 
 void Client::fetchResponse(int32_t timeout) {
@@ -61,11 +151,81 @@ void Client::fetchResponse(int32_t timeout) {
     if (timeout < 0) {
         timeout = TSS2_TCTI_TIMEOUT_BLOCK;
     }
-    TSS2_RC err = Tss2_Sys_ExecuteFinish(m_sysContext, timeout);
+    TSS2_RC err = m_transmitError;
+    if (!err) {
+        err = Tss2_Sys_ExecuteFinish(m_sysContext, timeout);
+    }
+    if (TSS2_TCTI_RC_TRY_AGAIN == err) {
+        // 等待超时: 应答帧尚未到达, 命令仍在传输中, 因此保持队列状态不变, 留待调用者稍后重试
+        throw err;
+    }
+    if (m_pStatistics && m_lastTransmitTime != std::chrono::steady_clock::time_point()) {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_lastTransmitTime;
+        m_pStatistics->record(m_lastCommandCode,
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), err);
+    }
+    TPMCommand *pFinishedCommand = m_pLastCommand;
+    CommandCompletionCallback onCompletion;
+    onCompletion.swap(m_lastCommandCompletion);
+    m_pLastCommand = NULL;
+    m_transmitError = 0;
+    if (!err) {
+        pFinishedCommand->unpackRspPacket(m_sysContext); // 调用相应的 TSS 软件栈 Tss2_Sys_XXXX_Complete() 函数
+    }
+
+    // 必须先完成上一条应答帧的解包, 才能复用 System API 上下文发出队列中的下一条命令
+    if (!m_pendingCommands.empty()) {
+        PendingCommand next = m_pendingCommands.front();
+        m_pendingCommands.pop_front();
+        transmitCommand(*next.pCommand, next.onCompletion);
+    }
+
     if (err) {
         fprintf(stderr, "Error: Cannot fetch response packet: Tss2_Sys_ExecuteFinish() returns err = 0x%X\n", err);
-        // TODO: throw/raise an expection to the up level
+    }
+    if (onCompletion) {
+        // 下一条命令已经发出, 回调函数执行期间 TPM 可以并行处理下一条命令
+        onCompletion(*pFinishedCommand, err);
+        return;
+    }
+    if (err) {
         throw err;
     }
-    m_pLastCommand->unpackRspPacket(m_sysContext); // 调用相应的 TSS 软件栈 Tss2_Sys_XXXX_Complete() 函数
+}
+
+void Client::discardPendingCommands() {
+    m_pendingCommands.clear();
+    if (!m_pLastCommand) {
+        return;
+    }
+    m_lastCommandCompletion = CommandCompletionCallback();
+    try {
+        fetchResponse(TSS2_TCTI_TIMEOUT_BLOCK);
+    } catch (TSS2_RC err) {
+        // 被放弃的命令的错误码不再交给调用者
+    }
+}
+
+bool Client::pollResponse() {
+    if (!m_pLastCommand) {
+        return false;
+    }
+    try {
+        fetchResponse(TSS2_TCTI_TIMEOUT_NONE);
+    } catch (TSS2_RC err) {
+        if (TSS2_TCTI_RC_TRY_AGAIN == err) {
+            return false;
+        }
+        throw;
+    }
+    return true;
+}
+
+TSS2_RC Client::getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *pNumHandles) {
+    TSS2_TCTI_CONTEXT *tctiContext = NULL;
+    TSS2_RC err = Tss2_Sys_GetTctiContext(m_sysContext, &tctiContext);
+    if (err) {
+        return err;
+    }
+    return tss2_tcti_get_poll_handles(tctiContext, handles, pNumHandles);
 }
@@ -12,9 +12,23 @@
 #include <sapi/tpm20.h>
 #include "TPMCommand.h"
 #include "ApplicationBasedOnTSSSystemAPI.h"
+#include "CommandStatistics.h"
 
 #ifdef __cplusplus
 
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+
+/**
+ * 命令完成回调函数
+ *
+ * 参数 command 为 sendCommand() 时提交的命令对象, 参数 rc 为该命令的执行结果(0 表示成功, 非 0 为 TSS2_RC 错误码).
+ * 回调函数返回之后 Client 不再引用 command 对象.
+ */
+typedef std::function<void (TPMCommand& command, TSS2_RC rc)> CommandCompletionCallback;
+
 /// TPM客户端
 class Client: public ApplicationBasedOnTSSSystemAPI
 {
@@ -26,8 +40,37 @@ public:
     void bind(ConnectionManager& connectionManager);
     /** 客户端解除绑定 */
     void unbind();
-    /** 发送命令帧 */
+    /**
+     * 发送命令帧
+     *
+     * 允许连续调用多次 sendCommand() 提交多条命令: 若之前的命令尚未取回应答帧, 本条命令将进入发送队列排队.
+     * 每次 fetchResponse() 取回一条应答帧之后会立即发出队列中的下一条命令, 使 TPM 不必空等调用者处理上一条命令的结果.
+     *
+     * @note 在取回相应的应答帧之前, 调用者必须保证 command 对象一直有效(不能被析构)
+     */
+    void sendCommand(
+            TPMCommand& command ///< 输入参数. 此TPMCommand对象自带buildCmdPacket()组帧方法生成命令帧报文
+            );
+    /**
+     * 发送命令帧, 并在取回应答帧后调用回调函数
+     *
+     * 取回应答帧的时机由调用者决定: 可以直接调用 fetchResponse() / pollResponse(),
+     * 也可以将多个 Client 对象交给 ClientEventLoop 统一调度, 从而由单个线程同时驱动多个 TPM 连接.
+     *
+     * @note 注册了回调函数的命令执行失败时, 错误码通过回调函数的 rc 参数传递, fetchResponse() 不再抛出该错误码
+     */
     void sendCommand(
+            TPMCommand& command, ///< 输入参数. 此TPMCommand对象自带buildCmdPacket()组帧方法生成命令帧报文
+            const CommandCompletionCallback& onCompletion ///< 输入参数. 命令完成回调函数
+            );
+    /**
+     * 发送命令帧, 返回 std::future 对象
+     *
+     * 命令完成后 future 对象中保存该命令的执行结果(0 表示成功, 非 0 为 TSS2_RC 错误码).
+     *
+     * @note 仍需调用 fetchResponse() / pollResponse() 或借助 ClientEventLoop 取回应答帧, 否则 future 对象永远不会就绪
+     */
+    std::future<TSS2_RC> submitCommand(
             TPMCommand& command ///< 输入参数. 此TPMCommand对象自带buildCmdPacket()组帧方法生成命令帧报文
             );
     /**
@@ -35,19 +78,98 @@ public:
      *
      * @note 该函数放在每条sendCommand()之后被调用. 若没有发送过命令帧, 则无法取回的应答桢.
      * @note 若该函数执行成功, 返回的数据将被写入之前调用 sendCommand() 时指定的 command 对象.
+     * @note 连续提交了多条命令时, 应答帧按照 sendCommand() 的提交顺序依次取回, 每调用一次取回一条.
      *
      * @throws TSS2_RC (可能遇到多种错误情况, 包括TSS层或TPM硬件返回的错误码) TODO: 此处需补充文档和样例代码帮助开发者处理不同的 TPM_RC/TSS2_RC 错误编码.
+     * @throws TSS2_TCTI_RC_TRY_AGAIN 等待超时. 此时命令仍在传输中, 调用者可以稍后再次调用 fetchResponse() 重试
      */
     void fetchResponse(
             int32_t timeout=-1 ///< 超时选项. 默认使用负数表示阻塞等待, 直到服务器端应答或者发生其他严重错误
             );
-    /** 发送命令帧并取回应答帧 */
+    /**
+     * 查询尚未取回应答帧的命令个数
+     *
+     * @return 已经提交但尚未通过 fetchResponse() 取回应答帧的命令总数(包括正在传输的命令和排队等候发送的命令)
+     */
+    size_t pendingCommandCount();
+    /**
+     * 非阻塞方式尝试取回一条应答帧
+     *
+     * @return 取回了一条应答帧时返回 true; 应答帧尚未到达或者没有正在传输的命令时返回 false
+     *
+     * @throws TSS2_RC 未注册回调函数的命令执行失败时抛出错误码(同 fetchResponse())
+     */
+    bool pollResponse();
+    /**
+     * 查询底层 TCTI 连接的轮询句柄(Linux 下为 struct pollfd)
+     *
+     * 用法同 TCTI 接口 getPollHandles(): handles 为 NULL 时仅通过 *pNumHandles 返回句柄个数.
+     *
+     * @return TSS2_RC 错误码. 部分 TCTI 实现不支持该功能, 此时返回 TSS2_TCTI_RC_NOT_IMPLEMENTED
+     */
+    TSS2_RC getPollHandles(
+            TSS2_TCTI_POLL_HANDLE *handles, ///< 输出参数. 轮询句柄数组
+            size_t *pNumHandles ///< 输入输出参数. 输入时为 handles 数组容量, 输出时为实际句柄个数
+            );
+    /**
+     * 发送命令帧并取回应答帧
+     *
+     * 若之前提交的命令尚未完成, 先依次取回它们的应答帧. 其中某条命令出错时仍会继续取回, 直到 cmd 完成,
+     * 然后抛出遇到的第一个错误, 因此本函数返回(或抛出异常)之后 Client 不再引用 cmd.
+     *
+     * @throws TSS2_RC 命令执行失败时抛出错误码
+     */
     void sendCommandAndWaitUntilResponseIsFetched(
             TPMCommand& cmd ///< 输入参数. 此TPMCommand对象自带buildCmdPacket()组帧方法生成命令帧报文
             );
+    /**
+     * 放弃尚未取回应答帧的全部命令
+     *
+     * 排队等候发送的命令直接移出队列; 正在传输的命令仍需取回(并丢弃)其应答帧, 以便 System API 上下文可以继续使用.
+     * 被放弃的命令不再调用回调函数, 也不抛出它们的错误码. 用于出错后的清理:
+     * 本函数返回之后, Client 不再引用任何调用者提供的命令对象或回调函数.
+     */
+    void discardPendingCommands();
+    /**
+     * 挂接命令执行统计
+     *
+     * 挂接之后每取回一条应答帧, 都按命令码将该命令的延迟(从命令帧实际发出到取回应答帧, 不包括在发送队列中排队的时间)
+     * 和执行结果记录到 pStatistics 中. 默认不挂接, 此时不做任何计时.
+     *
+     * 派生类绕过 sendCommand() 直接调用 System API 同步执行的命令(例如 SequenceScheduler 的 HMAC_Start/SequenceUpdate)
+     * 由派生类调用 recordStatistics() 记录, 同样计入 pStatistics.
+     *
+     * @note 多个 Client 对象可以共用同一个 CommandStatistics 对象. 调用者必须保证 pStatistics 在解除挂接之前一直有效
+     */
+    void configStatistics(
+            CommandStatistics *pStatistics ///< 统计对象. 传入 NULL 表示解除挂接
+            );
+
+protected:
+    /** 记录一条由派生类直接通过 System API 执行的命令. 未挂接统计对象时不做任何事 */
+    void recordStatistics(
+            TPM_CC commandCode, ///< 命令码
+            std::chrono::steady_clock::time_point transmitTime, ///< 开始执行命令的时刻
+            TSS2_RC rc ///< 执行结果, 0 表示成功
+            );
+
+private:
+    /** 组帧并立即发出命令帧 */
+    void transmitCommand(TPMCommand& cmd, const CommandCompletionCallback& onCompletion);
 
 private:
-    TPMCommand *m_pLastCommand; ///< 内部成员变量. m_pLastCommand总是指向之前最后一次调用sendCommand()成员函数时的关联的TPMCommand参数的内存地址
+    /// 排队等候发送的命令
+    struct PendingCommand {
+        TPMCommand *pCommand;
+        CommandCompletionCallback onCompletion; ///< 命令完成回调函数, 允许为空
+    };
+    TPMCommand *m_pLastCommand; ///< 内部成员变量. m_pLastCommand总是指向当前已经发出但尚未取回应答帧的TPMCommand参数的内存地址, 没有命令正在传输时为NULL
+    CommandCompletionCallback m_lastCommandCompletion; ///< 内部成员变量. m_pLastCommand 对应的命令完成回调函数
+    TSS2_RC m_transmitError; ///< 内部成员变量. m_pLastCommand 发送失败时记录 Tss2_Sys_ExecuteAsync() 返回的错误码
+    std::deque<PendingCommand> m_pendingCommands; ///< 内部成员变量. 排队等候发送的命令(先进先出)
+    CommandStatistics *m_pStatistics; ///< 内部成员变量. 命令执行统计, 为NULL时不计时
+    TPM_CC m_lastCommandCode; ///< 内部成员变量. m_pLastCommand 的命令码, 仅在挂接了统计对象时有效
+    std::chrono::steady_clock::time_point m_lastTransmitTime; ///< 内部成员变量. m_pLastCommand 实际发出的时刻, 仅在挂接了统计对象时有效
 };
 
 /// 对外定义C++包装器类
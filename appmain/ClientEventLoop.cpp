@@ -0,0 +1,117 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include <poll.h>
+#include <sapi/tpm20.h>
+#include "Client.h"
+#include "ClientEventLoop.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+ClientEventLoop::ClientEventLoop() {
+    m_pollInterval = 1;
+}
+
+ClientEventLoop::~ClientEventLoop() {
+}
+
+void ClientEventLoop::add(Client& client) {
+    if (std::find(m_clients.begin(), m_clients.end(), &client) != m_clients.end()) {
+        return;
+    }
+    m_clients.push_back(&client);
+}
+
+void ClientEventLoop::remove(Client& client) {
+    m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), &client), m_clients.end());
+}
+
+void ClientEventLoop::setPollInterval(int milliseconds) {
+    m_pollInterval = (milliseconds > 0) ? milliseconds : 1;
+}
+
+size_t ClientEventLoop::pendingCommandCount() {
+    size_t count = 0;
+    for (size_t i = 0; i < m_clients.size(); i++) {
+        count += m_clients[i]->pendingCommandCount();
+    }
+    return count;
+}
+
+int ClientEventLoop::runOnce(int timeout) {
+    std::vector<struct pollfd> fds;
+    std::vector<Client *> owners; // owners[k] 为 fds[k] 所属的客户端
+    std::vector<Client *> unpollable; // 不支持轮询句柄的客户端
+    for (size_t i = 0; i < m_clients.size(); i++) {
+        Client *pClient = m_clients[i];
+        if (pClient->pendingCommandCount() <= 0) {
+            continue;
+        }
+        size_t n = 0;
+        TSS2_RC err = pClient->getPollHandles(NULL, &n);
+        if (err || n <= 0) {
+            unpollable.push_back(pClient);
+            continue;
+        }
+        size_t offset = fds.size();
+        fds.resize(offset + n);
+        err = pClient->getPollHandles(&fds[offset], &n);
+        if (err) {
+            fds.resize(offset);
+            unpollable.push_back(pClient);
+            continue;
+        }
+        fds.resize(offset + n);
+        for (size_t k = 0; k < n; k++) {
+            fds[offset + k].events = POLLIN;
+            fds[offset + k].revents = 0;
+            owners.push_back(pClient);
+        }
+    }
+    if (fds.empty() && unpollable.empty()) {
+        return 0;
+    }
+
+    int fetched = 0;
+    // 先非阻塞地检查一遍不支持轮询句柄的连接, 若已经有应答帧到达则不必在 poll() 中等待
+    for (size_t i = 0; i < unpollable.size(); i++) {
+        if (unpollable[i]->pollResponse()) {
+            fetched++;
+        }
+    }
+    int waitTime = timeout;
+    if (fetched > 0) {
+        waitTime = 0;
+    } else if (!unpollable.empty() && (waitTime < 0 || waitTime > m_pollInterval)) {
+        waitTime = m_pollInterval;
+    }
+
+    int ready = poll(fds.empty() ? NULL : &fds[0], fds.size(), waitTime);
+    if (ready < 0) {
+        perror("poll");
+        return fetched;
+    }
+    for (size_t k = 0; k < fds.size() && ready > 0; k++) {
+        if (!fds[k].revents) {
+            continue;
+        }
+        ready--;
+        Client *pClient = owners[k];
+        if (k > 0 && owners[k - 1] == pClient && fds[k - 1].revents) {
+            continue; // 同一客户端的多个句柄同时就绪, 只取一次
+        }
+        if (pClient->pollResponse()) {
+            fetched++;
+        }
+    }
+    return fetched;
+}
+
+void ClientEventLoop::run() {
+    while (pendingCommandCount() > 0) {
+        runOnce(-1);
+    }
+}
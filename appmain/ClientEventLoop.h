@@ -0,0 +1,71 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef CLIENT_EVENT_LOOP_H_
+#define CLIENT_EVENT_LOOP_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "Client.h"
+
+#ifdef __cplusplus
+
+#include <vector>
+
+/**
+ * 客户端事件循环
+ *
+ * 由单个线程同时驱动多个 Client 对象: 调用者先通过 Client::sendCommand(command, onCompletion)
+ * 或 Client::submitCommand() 在各个 Client 上提交命令, 然后调用 run() / runOnce(),
+ * 事件循环对各个 TCTI 连接的轮询句柄执行 poll(), 哪个连接的应答帧先到达就先取回哪个, 并调用相应的回调函数.
+ *
+ * @note 部分 TCTI 实现不支持 getPollHandles(), 对这类连接事件循环以较短的间隔 (见 setPollInterval()) 非阻塞地轮询应答帧.
+ * @note 事件循环不是线程安全的, 所有 Client 对象只能在调用 run() / runOnce() 的线程中使用.
+ */
+class ClientEventLoop
+{
+public:
+    /** 构造函数 */
+    ClientEventLoop();
+    /** 析构函数 */
+    ~ClientEventLoop();
+    /** 将客户端加入事件循环. 客户端必须已经调用过 bind() */
+    void add(Client& client);
+    /** 将客户端移出事件循环 */
+    void remove(Client& client);
+    /**
+     * 设置不支持轮询句柄的连接的轮询间隔
+     */
+    void setPollInterval(
+            int milliseconds ///< 轮询间隔, 单位毫秒. 默认 1 毫秒
+            );
+    /**
+     * 等待并处理一轮事件
+     *
+     * @return 本轮取回的应答帧个数
+     *
+     * @throws TSS2_RC 未注册回调函数的命令执行失败时抛出错误码
+     */
+    int runOnce(
+            int timeout=-1 ///< 最长等待时间, 单位毫秒. 负数表示一直等到有应答帧到达为止
+            );
+    /**
+     * 循环处理事件, 直到所有客户端都没有尚未取回应答帧的命令为止
+     *
+     * @throws TSS2_RC 未注册回调函数的命令执行失败时抛出错误码
+     */
+    void run();
+    /** 查询所有客户端尚未取回应答帧的命令总数 */
+    size_t pendingCommandCount();
+
+private:
+    std::vector<Client *> m_clients; ///< 参与事件循环的客户端
+    int m_pollInterval; ///< 不支持轮询句柄的连接的轮询间隔, 单位毫秒
+};
+
+#endif // __cplusplus
+#endif // CLIENT_EVENT_LOOP_H_
@@ -0,0 +1,253 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstdio>
+#include <cmath>
+#include <sapi/tpm20.h>
+#include "CommandStatistics.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// LatencyHistogram
+// ============================================================================
+
+static const unsigned int LINEAR_BUCKET_BITS = 5; ///< 小于 2^5 的值每个整数一个桶
+static const unsigned int SUB_BUCKET_BITS = 4; ///< 之后每个 2 的幂区间分为 2^4 个桶
+static const unsigned int MAX_EXPONENT = 39; ///< 最大可区分的值为 2^40-1 微秒
+static const size_t LINEAR_BUCKET_COUNT = 1u << LINEAR_BUCKET_BITS;
+static const size_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+static const size_t BUCKET_COUNT = LINEAR_BUCKET_COUNT + (MAX_EXPONENT - LINEAR_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+LatencyHistogram::LatencyHistogram()
+        : m_buckets(BUCKET_COUNT, 0) {
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+    if (value < LINEAR_BUCKET_COUNT) {
+        return (size_t) value;
+    }
+    unsigned int exponent = 63 - __builtin_clzll(value); // 最高有效位的位置, >= LINEAR_BUCKET_BITS
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    unsigned int shift = exponent - SUB_BUCKET_BITS;
+    size_t sub = (size_t) (value >> shift) - SUB_BUCKET_COUNT; // 最高位之后的 SUB_BUCKET_BITS 位
+    return LINEAR_BUCKET_COUNT + (exponent - LINEAR_BUCKET_BITS) * SUB_BUCKET_COUNT + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < LINEAR_BUCKET_COUNT) {
+        return index;
+    }
+    unsigned int exponent = LINEAR_BUCKET_BITS + (index - LINEAR_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    uint64_t sub = (index - LINEAR_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    unsigned int shift = exponent - SUB_BUCKET_BITS;
+    return ((SUB_BUCKET_COUNT + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t microseconds) {
+    m_buckets[BucketIndex(microseconds)] += 1;
+    if (0 == m_count || microseconds < m_min) {
+        m_min = microseconds;
+    }
+    if (microseconds > m_max) {
+        m_max = microseconds;
+    }
+    m_count += 1;
+    m_sum += (double) microseconds;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (0 == other.m_count) {
+        return;
+    }
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    if (0 == m_count || other.m_min < m_min) {
+        m_min = other.m_min;
+    }
+    if (other.m_max > m_max) {
+        m_max = other.m_max;
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+}
+
+void LatencyHistogram::reset() {
+    m_buckets.assign(BUCKET_COUNT, 0);
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return m_count;
+}
+
+uint64_t LatencyHistogram::min() const {
+    return m_min;
+}
+
+uint64_t LatencyHistogram::max() const {
+    return m_max;
+}
+
+double LatencyHistogram::mean() const {
+    return m_count ? m_sum / m_count : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (0 == m_count) {
+        return 0;
+    }
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+    uint64_t rank = (uint64_t) std::ceil(percentile / 100.0 * m_count);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            if (BUCKET_COUNT - 1 == i) {
+                return m_max; // 最后一个桶同时容纳所有超出范围的值
+            }
+            uint64_t value = BucketUpperBound(i);
+            return (value < m_max) ? value : m_max;
+        }
+    }
+    return m_max;
+}
+
+// ============================================================================
+// CommandStatistics
+// ============================================================================
+
+CommandStatistics::Entry::Entry() {
+    commandCode = 0;
+    errorCount = 0;
+}
+
+CommandStatistics::CommandStatistics() {
+}
+
+CommandStatistics::~CommandStatistics() {
+}
+
+void CommandStatistics::record(TPM_CC commandCode, uint64_t microseconds, TSS2_RC rc) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[commandCode];
+    entry.commandCode = commandCode;
+    entry.latency.record(microseconds);
+    if (rc) {
+        entry.errorCount += 1;
+        entry.errorCodes[rc] += 1;
+    }
+}
+
+std::vector<CommandStatistics::Entry> CommandStatistics::snapshot() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Entry> entries;
+    entries.reserve(m_entries.size());
+    for (std::map<TPM_CC, Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        entries.push_back(it->second);
+    }
+    return entries;
+}
+
+bool CommandStatistics::lookup(TPM_CC commandCode, Entry& entry) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<TPM_CC, Entry>::const_iterator it = m_entries.find(commandCode);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+void CommandStatistics::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+void CommandStatistics::print(FILE *fp) const {
+    const std::vector<Entry> entries = snapshot();
+    fprintf(fp, "%-22s %10s %8s %10s %10s %10s %10s %10s\n",
+            "command", "count", "errors", "mean", "p50", "p99", "p99.9", "max");
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        const char *name = CommandName(e.commandCode);
+        char buf[32];
+        if (!name) {
+            snprintf(buf, sizeof(buf), "0x%08X", e.commandCode);
+            name = buf;
+        }
+        fprintf(fp, "%-22s %10llu %8llu %10.1f %10llu %10llu %10llu %10llu\n",
+                name,
+                (unsigned long long) e.latency.count(),
+                (unsigned long long) e.errorCount,
+                e.latency.mean(),
+                (unsigned long long) e.latency.percentile(50),
+                (unsigned long long) e.latency.percentile(99),
+                (unsigned long long) e.latency.percentile(99.9),
+                (unsigned long long) e.latency.max());
+        for (std::map<TSS2_RC, uint64_t>::const_iterator it = e.errorCodes.begin(); it != e.errorCodes.end(); ++it) {
+            fprintf(fp, "    rc=0x%X: %llu\n", it->first, (unsigned long long) it->second);
+        }
+    }
+}
+
+const char *CommandStatistics::CommandName(TPM_CC commandCode) {
+    static const struct {
+        TPM_CC commandCode;
+        const char *name;
+    } names[] = {
+        {TPM_CC_Startup, "Startup"},
+        {TPM_CC_Shutdown, "Shutdown"},
+        {TPM_CC_GetTestResult, "GetTestResult"},
+        {TPM_CC_Hash, "Hash"},
+        {TPM_CC_HMAC, "HMAC"},
+        {TPM_CC_HMAC_Start, "HMAC_Start"},
+        {TPM_CC_HashSequenceStart, "HashSequenceStart"},
+        {TPM_CC_SequenceUpdate, "SequenceUpdate"},
+        {TPM_CC_SequenceComplete, "SequenceComplete"},
+        {TPM_CC_StartAuthSession, "StartAuthSession"},
+        {TPM_CC_FlushContext, "FlushContext"},
+        {TPM_CC_ContextSave, "ContextSave"},
+        {TPM_CC_ContextLoad, "ContextLoad"},
+        {TPM_CC_CreatePrimary, "CreatePrimary"},
+        {TPM_CC_Create, "Create"},
+        {TPM_CC_Load, "Load"},
+        {TPM_CC_LoadExternal, "LoadExternal"},
+        {TPM_CC_ReadPublic, "ReadPublic"},
+        {TPM_CC_RSA_Encrypt, "RSA_Encrypt"},
+        {TPM_CC_RSA_Decrypt, "RSA_Decrypt"},
+        {TPM_CC_EncryptDecrypt, "EncryptDecrypt"},
+        {TPM_CC_Sign, "Sign"},
+        {TPM_CC_VerifySignature, "VerifySignature"},
+        {TPM_CC_NV_DefineSpace, "NV_DefineSpace"},
+        {TPM_CC_NV_UndefineSpace, "NV_UndefineSpace"},
+        {TPM_CC_NV_ReadPublic, "NV_ReadPublic"},
+        {TPM_CC_NV_Write, "NV_Write"},
+        {TPM_CC_NV_Read, "NV_Read"},
+        {TPM_CC_GetRandom, "GetRandom"},
+        {TPM_CC_GetCapability, "GetCapability"},
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (names[i].commandCode == commandCode) {
+            return names[i].name;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,135 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef COMMAND_STATISTICS_H_
+#define COMMAND_STATISTICS_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * 延迟直方图(HDR 风格的对数-线性分桶)
+ *
+ * 单位为微秒. 小于 32 微秒的值每个整数一个桶; 之后每个 2 的幂区间均分为 16 个桶,
+ * 因此任意记录值的相对误差不超过 1/16, 而桶的总数与取值范围的对数成正比(固定 592 个桶, 覆盖约 12 天).
+ * record() 只做一次移位和一次数组自增, 不分配内存.
+ *
+ * @note 本类不是线程安全的, 多线程共享时由 CommandStatistics 负责加锁
+ */
+class LatencyHistogram
+{
+public:
+    /** 构造函数 */
+    LatencyHistogram();
+    /** 记录一个样本. 超出范围的值计入最后一个桶 */
+    void record(uint64_t microseconds);
+    /** 合并另一个直方图 */
+    void merge(const LatencyHistogram& other);
+    /** 清空全部样本 */
+    void reset();
+    /** 样本个数 */
+    uint64_t count() const;
+    /** 最小值(精确值). 没有样本时返回 0 */
+    uint64_t min() const;
+    /** 最大值(精确值). 没有样本时返回 0 */
+    uint64_t max() const;
+    /** 平均值(按精确值累加计算). 没有样本时返回 0 */
+    double mean() const;
+    /**
+     * 百分位数
+     *
+     * @return 第 percentile 百分位样本所在桶的上界(不超过 max()). 没有样本时返回 0
+     */
+    uint64_t percentile(
+            double percentile ///< 取值范围 [0, 100], 例如 99.9
+            ) const;
+
+private:
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(size_t index);
+
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count;
+    uint64_t m_min;
+    uint64_t m_max;
+    double m_sum;
+};
+
+/**
+ * 按 TPM 命令码分类的命令执行统计
+ *
+ * 记录每种命令从发出命令帧到取回应答帧之间的延迟分布, 以及执行失败的次数和错误码.
+ * 通过 Client::configStatistics() 挂接到一个或多个 Client 对象上(例如连接池中的全部连接共用一个统计对象),
+ * 其他线程可以随时调用 snapshot() / print() 查询, 用于定位 TPM 变慢时究竟是哪条命令拖慢了整体.
+ * SequenceScheduler 等直接调用 System API 同步执行命令的派生类通过 Client::recordStatistics() 记录,
+ * 其延迟包括命令帧的组帧和应答帧的解包时间.
+ *
+ * ```
+ * // 用法示意:
+ * CommandStatistics stats;
+ * client.configStatistics(&stats);
+ * // ... 正常使用 client ...
+ * stats.print(stderr);
+ * ```
+ *
+ * @note 所有成员函数都是线程安全的
+ */
+class CommandStatistics
+{
+public:
+    /// 一种命令的统计结果
+    struct Entry {
+        TPM_CC commandCode;
+        LatencyHistogram latency; ///< 成功和失败的命令都计入延迟分布
+        uint64_t errorCount; ///< 执行失败(应答码非 0)的次数
+        std::map<TSS2_RC, uint64_t> errorCodes; ///< 各错误码出现的次数
+        Entry();
+    };
+
+    /** 构造函数 */
+    CommandStatistics();
+    /** 析构函数 */
+    ~CommandStatistics();
+    /** 记录一条命令的执行结果. 由 Client 在取回应答帧时调用 */
+    void record(
+            TPM_CC commandCode, ///< 命令码. 无法确定时为 0
+            uint64_t microseconds, ///< 从发出命令帧到取回应答帧的时间, 单位微秒
+            TSS2_RC rc ///< 执行结果, 0 表示成功
+            );
+    /** 取出全部统计结果的副本, 按命令码排序 */
+    std::vector<Entry> snapshot() const;
+    /**
+     * 取出一种命令的统计结果的副本
+     *
+     * @return 该命令从未被记录过时返回 false
+     */
+    bool lookup(TPM_CC commandCode, Entry& entry) const;
+    /** 清空全部统计结果 */
+    void reset();
+    /** 以文本表格形式打印全部统计结果(延迟单位: 微秒) */
+    void print(FILE *fp) const;
+    /** 返回命令码对应的命令名称, 不认识的命令码返回 NULL */
+    static const char *CommandName(TPM_CC commandCode);
+
+private:
+    CommandStatistics(const CommandStatistics&); // 禁止复制
+    CommandStatistics& operator=(const CommandStatistics&); // 禁止复制
+
+    mutable std::mutex m_mutex;
+    std::map<TPM_CC, Entry> m_entries;
+};
+
+#endif // __cplusplus
+#endif // COMMAND_STATISTICS_H_
@@ -9,6 +9,8 @@ using std::exception;
 #include <sapi/tpm20.h>
 #include <tcti/tcti_device.h>
 #include "ConnectionManager.h"
+#include "WireTracer.h"
+#include "TctiRecorder.h"
 
 /* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
 
@@ -44,6 +46,10 @@ CharacterDeviceConnectionManager::CharacterDeviceConnectionManager(const char *s
         szDevice = "/dev/tpm0";
     }
     m_szDevice = szDevice;
+    m_pTracer = NULL;
+    m_tracedContext = NULL;
+    m_pRecorder = NULL;
+    m_recordedContext = NULL;
 }
 
 // 析构函数
@@ -57,10 +63,22 @@ CharacterDeviceConnectionManager::~CharacterDeviceConnectionManager()
 // 接口函数 connect()
 void CharacterDeviceConnectionManager::connect()
 {
+    if (m_pTracer && !m_tracedContext) {
+        m_tracedContext = m_pTracer->attach(m_tctiContext, m_szDevice);
+    }
+    if (m_pRecorder && !m_recordedContext) {
+        m_recordedContext = m_pRecorder->attach(m_tracedContext ? m_tracedContext : m_tctiContext);
+    }
+
     TCTI_DEVICE_CONF conf;
     conf.device_path = (const char *) m_szDevice;
-    conf.logCallback = NULL;
-    conf.logData = NULL;
+    if (m_tracedContext) {
+        conf.logCallback = WireTracer::LogCallback;
+        conf.logData = m_tracedContext;
+    } else {
+        conf.logCallback = NULL;
+        conf.logData = NULL;
+    }
 
     TSS2_RC tctiError;
     tctiError = InitDeviceTcti(m_tctiContext, &m_tctiContextSize, &conf);
@@ -99,10 +117,25 @@ void CharacterDeviceConnectionManager::initializeSysContext(TSS2_SYS_CONTEXT *sy
     err = Tss2_Sys_Initialize(
             sysContext,
             contextSize,
-            m_tctiContext,
+            m_recordedContext ? m_recordedContext : m_tracedContext ? m_tracedContext : m_tctiContext,
             &abiVersion);
     if (err) {
         fprintf(stderr, "Error: Tss2_Sys_Initialize() returns 0x%X\n", (int) err);
         // TODO: throw/raise an expection to the up level
     }
 }
+
+// 接口函数 configTracer()
+void CharacterDeviceConnectionManager::configTracer(WireTracer *tracer)
+{
+    m_pTracer = tracer;
+    m_tracedContext = NULL; // 下次 connect() 时向新的跟踪器注册
+    m_recordedContext = NULL; // 录制器包装的是跟踪器的转发上下文, 需要重新包装
+}
+
+// 接口函数 configRecorder()
+void CharacterDeviceConnectionManager::configRecorder(TctiRecorder *recorder)
+{
+    m_pRecorder = recorder;
+    m_recordedContext = NULL; // 下次 connect() 时向新的录制器注册
+}
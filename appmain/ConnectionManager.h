@@ -13,9 +13,15 @@
 
 #ifdef __cplusplus
 
+class WireTracer;
+class TctiRecorder;
+
 /// 连接管理器
 class ConnectionManager {
 public:
+    /// 析构函数
+    virtual ~ConnectionManager() {}
+
     /// 主动发起连接
     ///
     /// 可能连接到本地 TPM 硬件, 也可能连接到 TCP 2321 端口上运行的软件 TPM 模拟器
@@ -46,11 +52,21 @@ public:
     void disconnect();
     ///
     void initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize);
+    /// 设定线路跟踪器, 必须在 connect() 之前调用. NULL 表示不跟踪(默认)
+    ///
+    /// libtcti-device 没有字节流日志回调, 命令帧/应答帧由 WireTracer::attach() 返回的转发上下文记录
+    void configTracer(WireTracer *tracer);
+    /// 设定 TCTI 录制器, 必须在 connect() 之前调用. NULL 表示不录制(默认)
+    void configRecorder(TctiRecorder *recorder);
 
 private:
     const char *m_szDevice; ///< TPM 设备名
     TSS2_TCTI_CONTEXT *m_tctiContext;
     size_t m_tctiContextSize;
+    WireTracer *m_pTracer;
+    TSS2_TCTI_CONTEXT *m_tracedContext; ///< 由 m_pTracer 持有的转发上下文, 未跟踪时为 NULL
+    TctiRecorder *m_pRecorder;
+    TSS2_TCTI_CONTEXT *m_recordedContext; ///< 由 m_pRecorder 持有的转发上下文, 未录制时为 NULL
 };
 
 #endif // __cplusplus
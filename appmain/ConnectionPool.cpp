@@ -0,0 +1,233 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstdio>
+#include <cassert> // assert()
+#include <ctime>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "Client.h"
+#include "SocketConnectionManager.h"
+#include "ConnectionPool.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+// 构造函数
+ConnectionPool::ConnectionPool(const char *szHostname, unsigned short nPort, size_t nConnections)
+{
+    if (!szHostname) {
+        szHostname = "127.0.0.1";
+    }
+    if (nConnections < 1) {
+        nConnections = 1;
+    }
+    m_szHostname = szHostname;
+    m_nPort = nPort;
+    m_slots.resize(nConnections);
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        m_slots[i].pConnection = NULL;
+        m_slots[i].pClient = NULL;
+        m_slots[i].leased = false;
+        m_slots[i].broken = false;
+        m_slots[i].lastChecked = 0;
+    }
+    m_opened = false;
+    m_healthCheckInterval = 30;
+}
+
+// 析构函数
+ConnectionPool::~ConnectionPool()
+{
+    close();
+}
+
+// 建立所有连接
+void ConnectionPool::open()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_opened) {
+        return;
+    }
+    time_t now = time(NULL);
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot& slot = m_slots[i];
+        slot.pConnection = new SocketConnectionManager(m_szHostname, m_nPort);
+        slot.pClient = new Client();
+        slot.pConnection->connect();
+        slot.pClient->bind(*slot.pConnection);
+        slot.leased = false;
+        slot.broken = false;
+        slot.lastChecked = now;
+    }
+    m_opened = true;
+}
+
+// 关闭所有连接
+void ConnectionPool::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_opened) {
+        return;
+    }
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot& slot = m_slots[i];
+        assert(!slot.leased);
+        slot.pClient->unbind();
+        slot.pConnection->disconnect();
+        delete slot.pClient;
+        delete slot.pConnection;
+        slot.pClient = NULL;
+        slot.pConnection = NULL;
+    }
+    m_opened = false;
+}
+
+// 租借一个连接
+Client& ConnectionPool::acquire(int timeout)
+{
+    Slot *pSlot = NULL;
+    int healthCheckInterval;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            if (!m_opened) {
+                const TSS2_RC AppError=(TSS2_APP_ERROR_LEVEL|TSS2_BASE_RC_BAD_SEQUENCE);
+                throw AppError;
+            }
+            for (size_t i = 0; i < m_slots.size(); i++) {
+                if (!m_slots[i].leased) {
+                    pSlot = &m_slots[i];
+                    break;
+                }
+            }
+            if (pSlot) {
+                break;
+            }
+            if (timeout < 0) {
+                m_idle.wait(lock);
+            } else if (m_idle.wait_for(lock, std::chrono::milliseconds(timeout)) == std::cv_status::timeout) {
+                throw TSS2_TCTI_RC_TRY_AGAIN;
+            }
+        }
+        pSlot->leased = true;
+        healthCheckInterval = m_healthCheckInterval;
+    }
+
+    // 健康检查和重新连接都涉及网络 IO, 因此在锁外进行. 该连接已被标记为租出, 不会有其他线程访问
+    time_t now = time(NULL);
+    bool needCheck = pSlot->broken || (now - pSlot->lastChecked >= healthCheckInterval);
+    if (needCheck) {
+        try {
+            if (pSlot->broken || !isHealthy(*pSlot->pClient)) {
+                reconnect(*pSlot);
+                if (!isHealthy(*pSlot->pClient)) {
+                    fprintf(stderr, "Error: Connection to %s:%u is unavailable\n", m_szHostname, (unsigned) m_nPort);
+                    throw TSS2_TCTI_RC_NO_CONNECTION;
+                }
+            }
+        } catch (...) {
+            // reconnect() 或 isHealthy() 抛出任何异常时都要归还连接, 否则该连接永远处于租出状态
+            release(*pSlot->pClient, true);
+            throw;
+        }
+        pSlot->broken = false;
+        pSlot->lastChecked = now;
+    }
+    return *pSlot->pClient;
+}
+
+// 归还连接
+void ConnectionPool::release(Client& client, bool broken)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_slots.size(); i++) {
+            Slot& slot = m_slots[i];
+            if (slot.pClient != &client) {
+                continue;
+            }
+            assert(slot.leased);
+            slot.leased = false;
+            if (broken) {
+                slot.broken = true;
+            } else if (!slot.broken) {
+                slot.lastChecked = time(NULL); // 刚刚正常使用过的连接, 可以推迟下一次健康检查
+            }
+            break;
+        }
+    }
+    m_idle.notify_one();
+}
+
+void ConnectionPool::setHealthCheckInterval(int seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_healthCheckInterval = (seconds > 0) ? seconds : 0;
+}
+
+size_t ConnectionPool::size()
+{
+    return m_slots.size();
+}
+
+size_t ConnectionPool::idleCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        if (!m_slots[i].leased) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 健康检查: 发送一条开销很小且不需要授权的 TPM2_GetTestResult 命令
+bool ConnectionPool::isHealthy(Client& client)
+{
+    TPMCommands::GetTestResult cmd;
+    try {
+        client.sendCommandAndWaitUntilResponseIsFetched(cmd);
+    } catch (TSS2_RC err) {
+        return false;
+    }
+    TPM_RC result = cmd.outTestResult();
+    return (TPM_RC_SUCCESS == result || TPM_RC_TESTING == result);
+}
+
+// 断开并重新连接
+void ConnectionPool::reconnect(Slot& slot)
+{
+    slot.pClient->unbind();
+    slot.pConnection->disconnect();
+    slot.pConnection->connect();
+    slot.pClient->bind(*slot.pConnection);
+}
+
+// ============================================================================
+// 租借连接的 RAII 助手类
+// ============================================================================
+ConnectionPool::Lease::Lease(ConnectionPool& pool, int timeout) :
+        m_pool(pool)
+{
+    m_pClient = &(pool.acquire(timeout));
+    m_broken = false;
+}
+
+ConnectionPool::Lease::~Lease()
+{
+    m_pool.release(*m_pClient, m_broken);
+}
+
+Client& ConnectionPool::Lease::client()
+{
+    return *m_pClient;
+}
+
+void ConnectionPool::Lease::markBroken()
+{
+    m_broken = true;
+}
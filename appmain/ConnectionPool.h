@@ -0,0 +1,144 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef CONNECTION_POOL_H_
+#define CONNECTION_POOL_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include "Client.h"
+#include "SocketConnectionManager.h"
+
+/**
+ * Socket 连接池
+ *
+ * 预先建立 N 条到 TPM 资源管理器(或软件 TPM 模拟器)的 socket 连接, 每条连接各自绑定一个 Client 对象
+ * (即各自拥有独立的 TCTI 上下文和 System API 上下文), 然后将 Client 对象租借给工作线程使用,
+ * 避免每次请求都重新调用 InitSocketTcti() / Tss2_Sys_Initialize() 建立连接.
+ *
+ * 租出连接之前会按需执行健康检查(发送 TPM2_GetTestResult 命令): 检查失败时自动断开并重新连接.
+ *
+ * ```
+ * // 用法示意:
+ * ConnectionPool pool("127.0.0.1", 2323, 8);
+ * pool.open();
+ * // 在各个工作线程中:
+ * {
+ *     ConnectionPool::Lease lease(pool);
+ *     lease.client().sendCommandAndWaitUntilResponseIsFetched(cmd);
+ * } // Lease 析构时自动归还连接
+ * ```
+ *
+ * @note acquire()/release() 是线程安全的; 租出的 Client 对象在归还之前只能由租借它的线程使用.
+ */
+class ConnectionPool
+{
+public:
+    /** 构造函数 */
+    ConnectionPool(
+            const char *szHostname="127.0.0.1", ///< 主机名或主机IP地址
+            unsigned short nPort=2323, ///< TCP 端口号. 默认连接资源管理器端口 2323
+            size_t nConnections=4 ///< 连接池中的连接个数
+            );
+    /** 析构函数. 自动关闭所有连接 */
+    ~ConnectionPool();
+    /** 建立所有连接 */
+    void open();
+    /**
+     * 关闭所有连接
+     *
+     * @note 调用者必须保证此时没有连接被租出
+     */
+    void close();
+    /**
+     * 租借一个连接
+     *
+     * 连接池中没有空闲连接时阻塞等待, 直到其他线程归还连接或者等待超时.
+     *
+     * @return 已经绑定连接的 Client 对象. 用完之后必须调用 release() 归还
+     *
+     * @throws TSS2_RC 等待超时(TSS2_TCTI_RC_TRY_AGAIN), 或者连接池尚未打开(TSS2_APP_ERROR_LEVEL|TSS2_BASE_RC_BAD_SEQUENCE)
+     * @throws TSS2_RC 健康检查失败并且重新连接后仍然失败(TSS2_TCTI_RC_NO_CONNECTION)
+     */
+    Client& acquire(
+            int timeout=-1 ///< 最长等待时间, 单位毫秒. 负数表示一直等待
+            );
+    /** 归还连接 */
+    void release(
+            Client& client, ///< 之前通过 acquire() 租借的 Client 对象
+            bool broken=false ///< 使用过程中遇到了通信错误时应传入 true, 下次租出该连接之前将重新连接
+            );
+    /**
+     * 设置健康检查间隔
+     *
+     * 连接空闲超过该时间之后, 下次租出之前先执行健康检查. 设为 0 表示每次租出之前都检查
+     */
+    void setHealthCheckInterval(
+            int seconds ///< 单位秒. 默认 30 秒
+            );
+    /** 查询连接个数 */
+    size_t size();
+    /** 查询当前空闲连接个数 */
+    size_t idleCount();
+
+    /// 租借连接的 RAII 助手类, 析构时自动归还连接
+    class Lease
+    {
+    public:
+        /** 构造函数. 从连接池中租借一个连接 */
+        Lease(ConnectionPool& pool, int timeout=-1);
+        /** 析构函数. 归还连接 */
+        ~Lease();
+        /** 取出租借到的 Client 对象 */
+        Client& client();
+        /** 标记连接已损坏, 归还之后将重新连接 */
+        void markBroken();
+
+    private:
+        Lease(const Lease&); // 禁止复制
+        Lease& operator=(const Lease&); // 禁止复制
+        ConnectionPool& m_pool;
+        Client *m_pClient;
+        bool m_broken;
+    };
+
+private:
+    ConnectionPool(const ConnectionPool&); // 禁止复制
+    ConnectionPool& operator=(const ConnectionPool&); // 禁止复制
+
+    /// 连接池中的一个连接
+    struct Slot {
+        SocketConnectionManager *pConnection;
+        Client *pClient;
+        bool leased; ///< 是否已被租出
+        bool broken; ///< 是否需要重新连接
+        time_t lastChecked; ///< 最近一次确认连接可用的时间
+    };
+    /** 健康检查 */
+    static bool isHealthy(Client& client);
+    /** 断开并重新连接 */
+    static void reconnect(Slot& slot);
+
+private:
+    const char *m_szHostname; ///< 主机名或主机IP地址
+    unsigned short m_nPort; ///< TCP 端口号
+    std::vector<Slot> m_slots;
+    bool m_opened;
+    int m_healthCheckInterval; ///< 单位秒
+    std::mutex m_mutex;
+    std::condition_variable m_idle; ///< 有连接被归还时通知等待中的线程
+};
+
+#endif // __cplusplus
+#endif // CONNECTION_POOL_H_
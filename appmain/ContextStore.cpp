@@ -0,0 +1,553 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sapi/tpm20.h>
+#include "BinaryContextFile.h"
+#include "ByteOrder.h"
+#include "ContextStore.h"
+
+static const char MAGIC[4] = {'T', 'C', 'S', 'T'};
+static const uint16_t VERSION = 1;
+static const size_t FILE_HEADER_SIZE = 16;
+static const size_t RECORD_HEADER_SIZE = 8; // 记录体长度(4) + CRC32(4)
+static const size_t RECORD_BODY_MIN_SIZE = 3; // 类型(1) + 索引键长度(2)
+static const size_t RECORD_BODY_MAX_SIZE = RECORD_BODY_MIN_SIZE + 0xFFFF + sizeof(TPMS_CONTEXT) + 8;
+static const size_t COMPACT_BUFFER_SIZE = 64 * 1024;
+
+enum RecordType
+{
+    RECORD_PUT = 1,
+    RECORD_DELETE = 2,
+};
+
+// ============================================================================
+// 文件读写辅助函数
+// ============================================================================
+
+static std::ios::failure IOFailure(const char *what, const std::string& fileName)
+{
+    return std::ios::failure(std::string(what) + " " + fileName + ": " + strerror(errno));
+}
+
+static bool IsAllZero(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// 把 rename() 的结果写入磁盘
+static bool SyncParentDirectory(const std::string& fileName)
+{
+    const std::string::size_type slash = fileName.rfind('/');
+    const std::string dirName = (std::string::npos == slash) ? "." : (0 == slash) ? "/" : fileName.substr(0, slash);
+    int dirFd = ::open(dirName.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0)
+    {
+        return false;
+    }
+    const bool ok = (0 == fsync(dirFd));
+    const int err = errno;
+    ::close(dirFd);
+    errno = err;
+    return ok;
+}
+
+static void MakeFileHeader(uint8_t *header)
+{
+    memset(header, 0x00, FILE_HEADER_SIZE);
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    PutUINT16(header + 4, VERSION);
+    PutUINT16(header + 6, (uint16_t) FILE_HEADER_SIZE);
+}
+
+static bool WriteAll(int fd, const uint8_t *data, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t n = pwrite(fd, data, length, offset);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        length -= (size_t) n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, uint8_t *data, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t n = pread(fd, data, length, offset);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        length -= (size_t) n;
+        offset += n;
+    }
+    return true;
+}
+
+// ============================================================================
+// 打开和关闭
+// ============================================================================
+ContextStore::ContextStore()
+{
+    m_fd = -1;
+    m_fileSize = 0;
+    m_garbageBytes = 0;
+}
+
+ContextStore::~ContextStore()
+{
+    close();
+}
+
+void ContextStore::open(const char *szFileName)
+{
+    if (!szFileName) // 不允许调用者传入NULL指针
+    {
+        throw std::invalid_argument("ContextStore::open(): szFileName is NULL");
+    }
+    close();
+    m_fileName = szFileName;
+    m_fd = ::open(szFileName, O_RDWR | O_CREAT, 0600);
+    if (m_fd < 0)
+    {
+        throw IOFailure("Cannot open", m_fileName);
+    }
+    try
+    {
+        scan();
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+}
+
+void ContextStore::close()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_index.clear();
+    m_fileSize = 0;
+    m_garbageBytes = 0;
+}
+
+/// 顺序扫描全部记录, 只读取记录头和索引键以建立索引
+void ContextStore::scan()
+{
+    struct stat st;
+    if (fstat(m_fd, &st) < 0)
+    {
+        throw IOFailure("Cannot stat", m_fileName);
+    }
+    if (0 == st.st_size) // 新建的空文件
+    {
+        uint8_t header[FILE_HEADER_SIZE];
+        MakeFileHeader(header);
+        if (!WriteAll(m_fd, header, sizeof(header), 0))
+        {
+            throw IOFailure("Cannot write", m_fileName);
+        }
+        m_fileSize = FILE_HEADER_SIZE;
+        return;
+    }
+    if (st.st_size < (off_t) FILE_HEADER_SIZE)
+    {
+        throw std::runtime_error(std::string("Invalid context store: ") + m_fileName);
+    }
+
+    const size_t fileSize = (size_t) st.st_size;
+    void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (MAP_FAILED == mapped)
+    {
+        throw IOFailure("Cannot mmap", m_fileName);
+    }
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+    const uint8_t *p = (const uint8_t *) mapped;
+    const char *error = NULL;
+    const uint16_t headerSize = GetUINT16(p + 6);
+    if (0 != memcmp(p, MAGIC, sizeof(MAGIC)))
+    {
+        error = "bad magic";
+    }
+    else if (GetUINT16(p + 4) != VERSION)
+    {
+        error = "unsupported version";
+    }
+    else if (headerSize < FILE_HEADER_SIZE || headerSize > fileSize)
+    {
+        error = "bad header size";
+    }
+    if (error)
+    {
+        munmap(mapped, fileSize);
+        throw std::runtime_error(std::string("Invalid context store ") + m_fileName + ": " + error);
+    }
+
+    size_t offset = headerSize;
+    bool tornTail = false;
+    while (offset < fileSize)
+    {
+        const uint8_t *record = p + offset;
+        const size_t remaining = fileSize - offset;
+        if (remaining < RECORD_HEADER_SIZE + RECORD_BODY_MIN_SIZE)
+        {
+            tornTail = true; // 记录头没有写完整
+            break;
+        }
+        const uint32_t bodyLength = GetUINT32(record);
+        const uint8_t *body = record + RECORD_HEADER_SIZE;
+        const uint8_t type = body[0];
+        const uint16_t keyLength = GetUINT16(body + 1);
+        const bool sane = (bodyLength >= RECORD_BODY_MIN_SIZE + keyLength && bodyLength <= RECORD_BODY_MAX_SIZE
+                && (RECORD_PUT == type || RECORD_DELETE == type));
+        if (sane && bodyLength > remaining - RECORD_HEADER_SIZE)
+        {
+            tornTail = true; // 记录头完好, 记录体没有写完整
+            break;
+        }
+        const uint32_t recordLength = RECORD_HEADER_SIZE + bodyLength;
+        if (!sane || BinaryContextCRC32(body, bodyLength) != GetUINT32(record + 4))
+        {
+            if ((sane && recordLength == remaining) || IsAllZero(record, remaining))
+            {
+                tornTail = true; // 最后一条记录校验失败, 或文件长度已增加但数据没有落盘
+                break;
+            }
+            // 文件中间的记录损坏: 截断会丢失其后全部有效记录, 拒绝打开
+            munmap(mapped, fileSize);
+            char what[64];
+            snprintf(what, sizeof(what), ": corrupted record at offset %lu", (unsigned long) offset);
+            throw std::runtime_error(std::string("Invalid context store ") + m_fileName + what);
+        }
+        const std::string key((const char *) body + RECORD_BODY_MIN_SIZE, keyLength);
+        std::map<std::string, Entry>::iterator it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            m_garbageBytes += it->second.length;
+        }
+        if (RECORD_PUT == type)
+        {
+            Entry& entry = m_index[key];
+            entry.offset = offset;
+            entry.length = recordLength;
+        }
+        else
+        {
+            if (it != m_index.end())
+            {
+                m_index.erase(it);
+            }
+            m_garbageBytes += recordLength;
+        }
+        offset += recordLength;
+    }
+    munmap(mapped, fileSize);
+
+    if (tornTail) // 丢弃末尾写了一半的记录, 后续写入从此处开始追加
+    {
+        if (ftruncate(m_fd, (off_t) offset) < 0)
+        {
+            throw IOFailure("Cannot truncate", m_fileName);
+        }
+    }
+    m_fileSize = offset;
+}
+
+// ============================================================================
+// 读写
+// ============================================================================
+void ContextStore::appendRecord(uint8_t type, const std::string& key, const TPMS_CONTEXT *context)
+{
+    if (m_fd < 0)
+    {
+        throw std::ios::failure("ContextStore: not opened");
+    }
+    if (key.size() > 0xFFFF)
+    {
+        throw std::invalid_argument("ContextStore: key is too long");
+    }
+    std::vector<uint8_t> record(RECORD_HEADER_SIZE + RECORD_BODY_MIN_SIZE + key.size() + sizeof(TPMS_CONTEXT) + 8);
+    uint8_t *body = &record[RECORD_HEADER_SIZE];
+    body[0] = type;
+    PutUINT16(body + 1, (uint16_t) key.size());
+    memcpy(body + RECORD_BODY_MIN_SIZE, key.data(), key.size());
+    size_t bodyLength = RECORD_BODY_MIN_SIZE + key.size();
+    if (context)
+    {
+        bodyLength += MarshalContext(*context, body + bodyLength, record.size() - RECORD_HEADER_SIZE - bodyLength);
+    }
+    PutUINT32(&record[0], (uint32_t) bodyLength);
+    PutUINT32(&record[4], BinaryContextCRC32(body, bodyLength));
+    const size_t recordLength = RECORD_HEADER_SIZE + bodyLength;
+
+    if (!WriteAll(m_fd, &record[0], recordLength, (off_t) m_fileSize))
+    {
+        const int err = errno;
+        int ignored = ftruncate(m_fd, (off_t) m_fileSize); // 尽量撤销写入了一半的记录
+        (void) ignored;
+        errno = err;
+        throw IOFailure("Cannot write", m_fileName);
+    }
+    m_fileSize += recordLength;
+}
+
+void ContextStore::put(const std::string& key, const TPMS_CONTEXT& context)
+{
+    const uint64_t offset = m_fileSize;
+    appendRecord(RECORD_PUT, key, &context);
+    Entry& entry = m_index[key];
+    if (entry.length > 0) // 覆盖旧记录
+    {
+        m_garbageBytes += entry.length;
+    }
+    entry.offset = offset;
+    entry.length = (uint32_t) (m_fileSize - offset);
+}
+
+void ContextStore::readRecordBody(const Entry& entry, std::vector<uint8_t>& record)
+{
+    record.resize(entry.length);
+    if (!ReadAll(m_fd, &record[0], entry.length, (off_t) entry.offset))
+    {
+        throw IOFailure("Cannot read", m_fileName);
+    }
+    const uint32_t bodyLength = GetUINT32(&record[0]);
+    if (RECORD_HEADER_SIZE + bodyLength != entry.length
+            || BinaryContextCRC32(&record[RECORD_HEADER_SIZE], bodyLength) != GetUINT32(&record[4]))
+    {
+        throw std::runtime_error(std::string("Corrupted record in context store ") + m_fileName);
+    }
+}
+
+bool ContextStore::get(const std::string& key, TPMS_CONTEXT& context)
+{
+    std::map<std::string, Entry>::const_iterator it = m_index.find(key);
+    if (it == m_index.end())
+    {
+        return false;
+    }
+    std::vector<uint8_t> record;
+    readRecordBody(it->second, record);
+    const size_t dataOffset = RECORD_HEADER_SIZE + RECORD_BODY_MIN_SIZE + key.size();
+    if (0 == UnmarshalContext(&record[0] + dataOffset, record.size() - dataOffset, context))
+    {
+        throw std::runtime_error(std::string("Malformed TPMS_CONTEXT in context store ") + m_fileName);
+    }
+    return true;
+}
+
+bool ContextStore::contains(const std::string& key) const
+{
+    return m_index.find(key) != m_index.end();
+}
+
+bool ContextStore::remove(const std::string& key)
+{
+    std::map<std::string, Entry>::iterator it = m_index.find(key);
+    if (it == m_index.end())
+    {
+        return false;
+    }
+    const uint64_t offset = m_fileSize;
+    appendRecord(RECORD_DELETE, key, NULL);
+    m_garbageBytes += it->second.length + (m_fileSize - offset);
+    m_index.erase(it);
+    return true;
+}
+
+std::vector<std::string> ContextStore::keys() const
+{
+    std::vector<std::string> result;
+    result.reserve(m_index.size());
+    for (std::map<std::string, Entry>::const_iterator it = m_index.begin(); it != m_index.end(); ++it)
+    {
+        result.push_back(it->first);
+    }
+    return result;
+}
+
+void ContextStore::sync()
+{
+    if (m_fd >= 0 && fdatasync(m_fd) < 0)
+    {
+        throw IOFailure("Cannot sync", m_fileName);
+    }
+}
+
+// ============================================================================
+// 压缩
+// ============================================================================
+void ContextStore::compact()
+{
+    if (m_fd < 0)
+    {
+        throw std::ios::failure("ContextStore: not opened");
+    }
+    // 按原文件中的偏移顺序复制, 使读取保持顺序访问
+    std::vector<std::pair<uint64_t, std::map<std::string, Entry>::iterator> > order;
+    order.reserve(m_index.size());
+    for (std::map<std::string, Entry>::iterator it = m_index.begin(); it != m_index.end(); ++it)
+    {
+        order.push_back(std::make_pair(it->second.offset, it));
+    }
+    std::sort(order.begin(), order.end(),
+            [](const std::pair<uint64_t, std::map<std::string, Entry>::iterator>& a,
+               const std::pair<uint64_t, std::map<std::string, Entry>::iterator>& b) {
+                return a.first < b.first;
+            });
+
+    const std::string tmpFileName = m_fileName + ".compact";
+    int tmpFd = ::open(tmpFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (tmpFd < 0)
+    {
+        throw IOFailure("Cannot create", tmpFileName);
+    }
+    std::vector<uint64_t> newOffsets(order.size());
+    uint64_t newFileSize = 0;
+    try
+    {
+        std::vector<uint8_t> buffer;
+        buffer.reserve(COMPACT_BUFFER_SIZE * 2);
+        buffer.resize(FILE_HEADER_SIZE);
+        MakeFileHeader(&buffer[0]);
+        std::vector<uint8_t> record;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            readRecordBody(order[i].second->second, record); // 同时校验 CRC32, 不复制已损坏的记录
+            newOffsets[i] = newFileSize + buffer.size();
+            buffer.insert(buffer.end(), record.begin(), record.end());
+            if (buffer.size() >= COMPACT_BUFFER_SIZE)
+            {
+                if (!WriteAll(tmpFd, &buffer[0], buffer.size(), (off_t) newFileSize))
+                {
+                    throw IOFailure("Cannot write", tmpFileName);
+                }
+                newFileSize += buffer.size();
+                buffer.clear();
+            }
+        }
+        if (!buffer.empty() && !WriteAll(tmpFd, &buffer[0], buffer.size(), (off_t) newFileSize))
+        {
+            throw IOFailure("Cannot write", tmpFileName);
+        }
+        newFileSize += buffer.size();
+        if (fsync(tmpFd) < 0)
+        {
+            throw IOFailure("Cannot sync", tmpFileName);
+        }
+    }
+    catch (...)
+    {
+        ::close(tmpFd);
+        unlink(tmpFileName.c_str());
+        throw;
+    }
+    ::close(tmpFd);
+
+    if (0 != rename(tmpFileName.c_str(), m_fileName.c_str()))
+    {
+        const int err = errno;
+        unlink(tmpFileName.c_str());
+        errno = err;
+        throw IOFailure("Cannot replace", m_fileName);
+    }
+    // 原文件已被替换, 此后的错误只能通过重新 open() 恢复
+    ::close(m_fd);
+    m_fd = ::open(m_fileName.c_str(), O_RDWR);
+    if (m_fd < 0)
+    {
+        const int err = errno;
+        m_index.clear();
+        m_fileSize = 0;
+        m_garbageBytes = 0;
+        errno = err;
+        throw IOFailure("Cannot reopen", m_fileName);
+    }
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i].second->second.offset = newOffsets[i];
+    }
+    m_fileSize = newFileSize;
+    m_garbageBytes = 0;
+    if (!SyncParentDirectory(m_fileName))
+    {
+        throw IOFailure("Cannot sync directory of", m_fileName);
+    }
+}
+
+// ============================================================================
+// 统计信息
+// ============================================================================
+size_t ContextStore::size() const
+{
+    return m_index.size();
+}
+
+uint64_t ContextStore::fileSize() const
+{
+    return m_fileSize;
+}
+
+uint64_t ContextStore::garbageBytes() const
+{
+    return m_garbageBytes;
+}
+
+// ============================================================================
+// 索引键
+// ============================================================================
+std::string ContextStore::KeyFromName(const TPM2B_NAME& name)
+{
+    std::string key("N");
+    key.append((const char *) name.t.name, name.t.size);
+    return key;
+}
+
+std::string ContextStore::KeyFromHandle(TPM_HANDLE handle)
+{
+    uint8_t buf[4];
+    PutUINT32(buf, handle);
+    std::string key("H");
+    key.append((const char *) buf, sizeof(buf));
+    return key;
+}
@@ -0,0 +1,112 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef CONTEXT_STORE_H_
+#define CONTEXT_STORE_H_
+#ifdef __cplusplus
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sapi/tpm20.h>
+
+/// 上下文仓库: 将大量 TPMS_CONTEXT 存放在同一个只追加(append-only)文件中
+///
+/// 文件格式(整数均为大端字节序):
+/// - 文件头 16 字节: 魔数 "TCST", 版本号(2), 文件头长度(2), 保留(8)
+/// - 之后为若干条记录, 每条记录: 记录体长度(4), 记录体 CRC32(4), 记录体
+/// - 记录体: 类型(1, 1=写入 2=删除), 索引键长度(2), 索引键, [按 TPM 规范编码的 TPMS_CONTEXT, 仅写入记录有]
+///
+/// 打开文件时顺序扫描并校验全部记录, 在内存中建立 索引键 -> 文件偏移 的索引,
+/// TPMS_CONTEXT 数据本身在 get() 时才按偏移读取(并再次校验 CRC32).
+/// 同一索引键多次写入时以最后一次为准, 旧记录成为垃圾数据, 可通过 compact() 压缩清除.
+///
+/// @note 不支持多线程同时调用, 也不支持多个进程同时写入同一个文件.
+/// @see BinaryContextFileFormatter 单个上下文的二进制文件格式
+class ContextStore
+{
+public:
+    ContextStore();
+    ~ContextStore();
+
+    /// 打开(或创建)仓库文件并建立索引
+    ///
+    /// 只有文件末尾写了一半的最后一条记录(例如写入过程中断电)会被截断丢弃,
+    /// 其他位置的记录损坏时拒绝打开, 以免截断丢失其后的有效记录
+    ///
+    /// @throws std::ios::failure 读写文件失败时抛出
+    /// @throws std::runtime_error 文件头格式错误, 或文件中间的记录损坏时抛出
+    void open(const char *szFileName);
+
+    /// 关闭仓库文件
+    void close();
+
+    /// 写入(或覆盖)一个上下文
+    ///
+    /// @throws std::invalid_argument 索引键超过 65535 字节时抛出
+    /// @throws std::ios::failure 写入失败时抛出
+    void put(const std::string& key, const TPMS_CONTEXT& context);
+
+    /// 读取一个上下文
+    ///
+    /// @return 索引键不存在时返回 false
+    /// @throws std::ios::failure 读取失败时抛出
+    /// @throws std::runtime_error 记录校验和不符时抛出
+    bool get(const std::string& key, TPMS_CONTEXT& context);
+
+    /// 查询索引键是否存在(不读取文件)
+    bool contains(const std::string& key) const;
+
+    /// 删除一个上下文(追加一条删除记录)
+    ///
+    /// @return 索引键不存在时返回 false
+    bool remove(const std::string& key);
+
+    /// 列出全部索引键
+    std::vector<std::string> keys() const;
+
+    /// 将缓存的写入数据刷新到磁盘
+    void sync();
+
+    /// 压缩仓库文件: 只保留每个索引键的最新记录
+    ///
+    /// 先写入临时文件并刷新到磁盘, 然后通过 rename() 原子地替换原文件并刷新所在目录, 中途失败时原文件不受影响
+    void compact();
+
+    /// 统计信息
+    size_t size() const; ///< 有效上下文个数
+    uint64_t fileSize() const; ///< 文件总长度
+    uint64_t garbageBytes() const; ///< 可由 compact() 回收的字节数
+
+    /// 以对象 Name 作为索引键
+    static std::string KeyFromName(const TPM2B_NAME& name);
+
+    /// 以句柄作为索引键
+    static std::string KeyFromHandle(TPM_HANDLE handle);
+
+private:
+    struct Entry {
+        uint64_t offset; ///< 记录在文件中的偏移(指向记录头)
+        uint32_t length; ///< 记录总长度(含记录头)
+    };
+
+    void scan();
+    void appendRecord(uint8_t type, const std::string& key, const TPMS_CONTEXT *context);
+    void readRecordBody(const Entry& entry, std::vector<uint8_t>& body);
+
+    std::string m_fileName;
+    int m_fd;
+    uint64_t m_fileSize;
+    uint64_t m_garbageBytes;
+    std::map<std::string, Entry> m_index;
+
+    // 禁止复制
+    ContextStore(const ContextStore&);
+    ContextStore& operator=(const ContextStore&);
+};
+
+#endif // __cplusplus
+#endif // CONTEXT_STORE_H_
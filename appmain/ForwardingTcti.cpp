@@ -0,0 +1,146 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstring>
+#include <stdexcept>
+#include <sapi/tpm20.h>
+#include "ForwardingTcti.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+static const uint64_t FORWARDING_TCTI_MAGIC = 0x4657445443544931ULL; // "FWDTCTI1"
+
+// 构造函数 ForwardingTcti(inner)
+ForwardingTcti::ForwardingTcti(TSS2_TCTI_CONTEXT *inner)
+{
+    if (!inner) {
+        throw std::invalid_argument("ForwardingTcti: inner TCTI context is NULL");
+    }
+    memset(&m_context.common, 0x00, sizeof(m_context.common));
+    m_context.common.magic = FORWARDING_TCTI_MAGIC;
+    m_context.common.version = 1;
+    m_context.common.transmit = Transmit;
+    m_context.common.receive = Receive;
+    m_context.common.finalize = Finalize;
+    m_context.common.cancel = Cancel;
+    m_context.common.getPollHandles = GetPollHandles;
+    m_context.common.setLocality = SetLocality;
+    m_context.owner = this;
+    m_inner = inner;
+}
+
+// 析构函数
+ForwardingTcti::~ForwardingTcti()
+{
+    m_context.common.magic = 0; // 之后误用已释放的上下文时 FromContext() 返回 NULL 的可能性更大
+}
+
+TSS2_TCTI_CONTEXT *ForwardingTcti::context()
+{
+    return (TSS2_TCTI_CONTEXT *) &m_context;
+}
+
+TSS2_TCTI_CONTEXT *ForwardingTcti::inner() const
+{
+    return m_inner;
+}
+
+ForwardingTcti *ForwardingTcti::FromContext(void *tctiContext)
+{
+    Context *context = (Context *) tctiContext;
+    if (!context || context->common.magic != FORWARDING_TCTI_MAGIC) {
+        return NULL;
+    }
+    return context->owner;
+}
+
+// ============================================================================
+// 默认实现: 原样转发
+// ============================================================================
+TSS2_RC ForwardingTcti::transmit(size_t size, uint8_t *command)
+{
+    return tss2_tcti_transmit(m_inner, size, command);
+}
+
+TSS2_RC ForwardingTcti::receive(size_t *size, uint8_t *response, int32_t timeout)
+{
+    return tss2_tcti_receive(m_inner, size, response, timeout);
+}
+
+void ForwardingTcti::finalize()
+{
+    tss2_tcti_finalize(m_inner);
+}
+
+TSS2_RC ForwardingTcti::cancel()
+{
+    return tss2_tcti_cancel(m_inner);
+}
+
+TSS2_RC ForwardingTcti::getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles)
+{
+    return tss2_tcti_get_poll_handles(m_inner, handles, num_handles);
+}
+
+TSS2_RC ForwardingTcti::setLocality(uint8_t locality)
+{
+    return tss2_tcti_set_locality(m_inner, locality);
+}
+
+// ============================================================================
+// TCTI 回调函数
+// ============================================================================
+TSS2_RC ForwardingTcti::Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return owner->transmit(size, command);
+}
+
+TSS2_RC ForwardingTcti::Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response, int32_t timeout)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return owner->receive(size, response, timeout);
+}
+
+void ForwardingTcti::Finalize(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return;
+    }
+    owner->finalize();
+}
+
+TSS2_RC ForwardingTcti::Cancel(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return owner->cancel();
+}
+
+TSS2_RC ForwardingTcti::GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles,
+        size_t *num_handles)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return owner->getPollHandles(handles, num_handles);
+}
+
+TSS2_RC ForwardingTcti::SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality)
+{
+    ForwardingTcti *owner = FromContext(tctiContext);
+    if (!owner) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return owner->setLocality(locality);
+}
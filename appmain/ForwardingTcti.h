@@ -0,0 +1,66 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef FORWARDING_TCTI_H_
+#define FORWARDING_TCTI_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+/// 转发型 TCTI 上下文
+///
+/// 把 SAPI 对 context() 的全部调用原样转发给被包装的 TCTI 上下文. 派生类重写 transmit()/receive() 等虚函数,
+/// 在转发前后插入自己的处理(例如 WireTracer 记录线路事件, TctiRecorder 录制命令帧和应答帧).
+/// 转发时才读取被包装上下文中的函数指针, 因此可以在被包装的上下文初始化之前创建本对象.
+///
+/// @note 同一个 TCTI 上下文同一时刻只会被一个线程使用, 派生类的单次调用状态不需要加锁
+class ForwardingTcti {
+public:
+    ForwardingTcti(TSS2_TCTI_CONTEXT *inner);
+    virtual ~ForwardingTcti();
+
+    /// 可直接传给 Tss2_Sys_Initialize() 的 TCTI 上下文
+    TSS2_TCTI_CONTEXT *context();
+    /// 被包装的 TCTI 上下文
+    TSS2_TCTI_CONTEXT *inner() const;
+    /// 由 context() 返回的指针找回本对象(例如在 TCTI 日志回调中), 不是转发型上下文时返回 NULL
+    static ForwardingTcti *FromContext(void *tctiContext);
+
+protected:
+    virtual TSS2_RC transmit(size_t size, uint8_t *command);
+    virtual TSS2_RC receive(size_t *size, uint8_t *response, int32_t timeout);
+    virtual void finalize();
+    virtual TSS2_RC cancel();
+    virtual TSS2_RC getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    virtual TSS2_RC setLocality(uint8_t locality);
+
+private:
+    /// 公共部分必须放在首位, SAPI 只访问这一部分
+    struct Context {
+        TSS2_TCTI_CONTEXT_COMMON_V1 common;
+        ForwardingTcti *owner;
+    };
+
+    static TSS2_RC Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command);
+    static TSS2_RC Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response, int32_t timeout);
+    static void Finalize(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC Cancel(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    static TSS2_RC SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality);
+
+    Context m_context;
+    TSS2_TCTI_CONTEXT *m_inner;
+
+    // 禁止复制
+    ForwardingTcti(const ForwardingTcti&);
+    ForwardingTcti& operator=(const ForwardingTcti&);
+};
+
+#endif // __cplusplus
+#endif // FORWARDING_TCTI_H_
@@ -19,6 +19,7 @@ using namespace std;
 #include "CalculatorClient.h"
 #include "ConnectionManager.h"
 #include "SocketConnectionManager.h"
+#include "MockTPMConnectionManager.h"
 
 /* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
 
@@ -30,6 +31,7 @@ static void PrintHelp()
     printf("-rmport 手动指定运行资源管理器的主机端口号 (默认值: %d)\n", DEFAULT_RESMGR_TPM_PORT);
     printf("-localTctiTest\n");
     printf("[注意: 若使用 -localTctiTest 请手动关闭任何占用/dev/tpm0设备的进程, 即: 关闭其他直接访问/dev/tpm0的resourcemgr进程]\n");
+    printf("-mock 使用进程内模拟 TPM (不需要 TPM 设备或 resourcemgr, 可在编译机上运行)\n");
 }
 
 #include <vector>
@@ -43,6 +45,7 @@ using std::runtime_error;
 int main(int argc, char *argv[])
 {
     int count;
+    int usingMock = false;
     int usingDeviceFile = false;
     const char *deviceFile = "/dev/tpm0";
     const char *hostname = "127.0.0.1";
@@ -59,6 +62,14 @@ int main(int argc, char *argv[])
             // 用于直接操作/dev/tpm0设备
             continue;
         }
+        if (0 == strcmp(argv[count], "-mock"))
+        {
+            usingMock = true;
+            count += 1;
+            // 以上代码提供的命令行参数为: -mock
+            // 使用进程内模拟 TPM, 用于在没有 TPM 的编译机上做回归测试
+            continue;
+        }
 
         if (0 == strcmp(argv[count], "-rmhost"))
         {
@@ -92,6 +103,7 @@ int main(int argc, char *argv[])
 
     SocketConnectionManager socketConnectionManager(hostname, port);
     CharacterDeviceConnectionManager deviceConnectionManager(deviceFile);
+    MockTPMConnectionManager mockConnectionManager;
 
     ConnectionManager *connectionManager; ///< 通过指针选择使用哪一个上下文初始化器
 
@@ -100,6 +112,10 @@ int main(int argc, char *argv[])
     {
         connectionManager = &deviceConnectionManager;
     }
+    if (usingMock)
+    {
+        connectionManager = &mockConnectionManager;
+    }
     connectionManager->connect();
 
     /* HMAC 测试 */
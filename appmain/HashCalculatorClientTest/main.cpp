@@ -19,6 +19,7 @@ using namespace std;
 #include "CalculatorClient.h"
 #include "ConnectionManager.h"
 #include "SocketConnectionManager.h"
+#include "MockTPMConnectionManager.h"
 
 /* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
 
@@ -30,6 +31,7 @@ static void PrintHelp()
     printf("-rmport 手动指定运行资源管理器的主机端口号 (默认值: %d)\n", DEFAULT_RESMGR_TPM_PORT);
     printf("-localTctiTest\n");
     printf("[注意: 若使用 -localTctiTest 请手动关闭任何占用/dev/tpm0设备的进程, 即: 关闭其他直接访问/dev/tpm0的resourcemgr进程]\n");
+    printf("-mock 使用进程内模拟 TPM (不需要 TPM 设备或 resourcemgr, 可在编译机上运行)\n");
 }
 
 #include <vector>
@@ -40,9 +42,27 @@ using std::string;
 using std::exception;
 using std::runtime_error;
 
+/// 输出哈希结果并与期望值比较, 不一致时返回 false
+static bool CheckDigest(const std::vector<BYTE>& digest, const BYTE *expected, size_t expectedLength)
+{
+    vector<BYTE>::const_iterator i;
+    for (i=digest.begin(); i!=digest.end(); i++)
+    {
+        printf("%02X:", (BYTE) *i);
+    }
+    printf("\n");
+    if (digest.size() != expectedLength || memcmp(digest.data(), expected, expectedLength) != 0)
+    {
+        printf("哈希摘要与期望值不符!\n");
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     int count;
+    int usingMock = false;
     int usingDeviceFile = false;
     const char *deviceFile = "/dev/tpm0";
     const char *hostname = "127.0.0.1";
@@ -59,6 +79,14 @@ int main(int argc, char *argv[])
             // 用于直接操作/dev/tpm0设备
             continue;
         }
+        if (0 == strcmp(argv[count], "-mock"))
+        {
+            usingMock = true;
+            count += 1;
+            // 以上代码提供的命令行参数为: -mock
+            // 使用进程内模拟 TPM, 用于在没有 TPM 的编译机上做回归测试
+            continue;
+        }
 
         if (0 == strcmp(argv[count], "-rmhost"))
         {
@@ -92,6 +120,7 @@ int main(int argc, char *argv[])
 
     SocketConnectionManager socketConnectionManager(hostname, port);
     CharacterDeviceConnectionManager charDevConnectionManager(deviceFile);
+    MockTPMConnectionManager mockConnectionManager;
 
     ConnectionManager *connectionManager; ///< 通过指针选择使用哪一个上下文初始化器
 
@@ -100,10 +129,15 @@ int main(int argc, char *argv[])
     {
         connectionManager = &charDevConnectionManager;
     }
+    if (usingMock)
+    {
+        connectionManager = &mockConnectionManager;
+    }
     connectionManager->connect();
 
     HashCalculatorClient client;
     client.bind(*connectionManager);
+    int failures = 0; ///< 与期望值不符的测试用例个数
     /* 第一组测试数据 */
     printf("【测试用例-1】\n");
     {
@@ -113,26 +147,33 @@ int main(int argc, char *argv[])
 
         printf("输出SHA1哈希结果如下:\n");
         {
+            const BYTE Expected[] = {
+                0xA9, 0x99, 0x3E, 0x36, 0x47, 0x06, 0x81, 0x6A,
+                0xBA, 0x3E, 0x25, 0x71, 0x78, 0x50, 0xC2, 0x6C,
+                0x9C, 0xD0, 0xD8, 0x9D,
+            };
             const std::vector<BYTE>& digest =
                     client.SHA1(szMsg, nMsgLen);
-            vector<BYTE>::const_iterator i;
-            for (i=digest.begin(); i!=digest.end(); i++)
+            if (!CheckDigest(digest, Expected, sizeof(Expected)))
             {
-                printf("%02X:", (BYTE) *i);
+                failures++;
             }
-            printf("\n");
         }
 
         printf("输出SHA256哈希结果如下:\n");
         {
+            const BYTE Expected[] = {
+                0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA,
+                0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+                0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C,
+                0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD,
+            };
             const std::vector<BYTE>& digest =
                     client.SHA256(szMsg, nMsgLen);
-            vector<BYTE>::const_iterator i;
-            for (i=digest.begin(); i!=digest.end(); i++)
+            if (!CheckDigest(digest, Expected, sizeof(Expected)))
             {
-                printf("%02X:", (BYTE) *i);
+                failures++;
             }
-            printf("\n");
         }
     }
 
@@ -146,26 +187,33 @@ int main(int argc, char *argv[])
 
         printf("输出SHA1哈希结果如下:\n");
         {
+            const BYTE Expected[] = {
+                0x34, 0xAA, 0x97, 0x3C, 0xD4, 0xC4, 0xDA, 0xA4,
+                0xF6, 0x1E, 0xEB, 0x2B, 0xDB, 0xAD, 0x27, 0x31,
+                0x65, 0x34, 0x01, 0x6F,
+            };
             const std::vector<BYTE>& digest =
                     client.SHA1(szMsg, nMsgLen);
-            vector<BYTE>::const_iterator i;
-            for (i=digest.begin(); i!=digest.end(); i++)
+            if (!CheckDigest(digest, Expected, sizeof(Expected)))
             {
-                printf("%02X:", (BYTE) *i);
+                failures++;
             }
-            printf("\n");
         }
 
         printf("输出SHA256哈希结果如下:\n");
         {
+            const BYTE Expected[] = {
+                0xCD, 0xC7, 0x6E, 0x5C, 0x99, 0x14, 0xFB, 0x92,
+                0x81, 0xA1, 0xC7, 0xE2, 0x84, 0xD7, 0x3E, 0x67,
+                0xF1, 0x80, 0x9A, 0x48, 0xA4, 0x97, 0x20, 0x0E,
+                0x04, 0x6D, 0x39, 0xCC, 0xC7, 0x11, 0x2C, 0xD0,
+            };
             const std::vector<BYTE>& digest =
                     client.SHA256(szMsg, nMsgLen);
-            vector<BYTE>::const_iterator i;
-            for (i=digest.begin(); i!=digest.end(); i++)
+            if (!CheckDigest(digest, Expected, sizeof(Expected)))
             {
-                printf("%02X:", (BYTE) *i);
+                failures++;
             }
-            printf("\n");
         }
 
         delete[] szMsg;
@@ -174,5 +222,11 @@ int main(int argc, char *argv[])
     client.unbind();
     connectionManager->disconnect();
 
+    if (failures)
+    {
+        printf("共有%d个哈希结果与期望值不符\n", failures);
+        return (1);
+    }
+    printf("全部哈希结果正确\n");
     return (0);
 }
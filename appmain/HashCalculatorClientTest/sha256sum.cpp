@@ -5,6 +5,10 @@
 #include <errno.h>
 #include <vector>
 using std::vector;
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <stdexcept>
 using std::exception;
 
@@ -32,16 +36,154 @@ static void PrintHelp()
             DEFAULT_HOSTNAME);
     printf("-rmport 手动指定运行资源管理器的主机端口号 (默认值: %d)\n", DEFAULT_RESMGR_TPM_PORT);
     printf("-localTctiTest\n");
+    printf("-hostHash 不需要 TPM 出具校验凭证, 直接在主机端计算哈希摘要(速度快得多)\n");
+    printf("-j 指定并行计算的线程数, 每个线程各自建立一条到资源管理器的连接 (默认值: 1, 仅在指定文件名时有效)\n");
+    printf("[文件名...] 计算指定文件的哈希摘要(通过 mmap 读取文件); 不指定文件名时从标准输入读取数据\n");
     printf("[注意: 若使用 -localTctiTest 请手动关闭任何占用/dev/tpm0设备的进程, 即: 关闭其他直接访问/dev/tpm0的resourcemgr进程]\n");
 }
 
+/// 格式化一个文件的哈希摘要输出行
+static std::string FormatFileDigest(const vector<BYTE>& digest, const char *filename)
+{
+    std::string line;
+    char hex[3];
+    vector<BYTE>::const_iterator i;
+    for (i=digest.begin(); i!=digest.end(); i++)
+    {
+        snprintf(hex, sizeof(hex), "%02x", (BYTE) *i);
+        line += hex;
+    }
+    line += "  ";
+    line += filename;
+    return line;
+}
+
+/// 逐个计算命令行指定文件的哈希摘要, 输出格式与系统自带的 sha256sum 工具相同
+///
+/// @return 打开或计算失败的文件个数
+static size_t PrintFileDigests(ConnectionManager& connectionManager, const vector<const char *>& filenames, bool hashingOnHost)
+{
+    FileHashCalculatorClient calc;
+    calc.bind(connectionManager);
+    calc.configValidationTicketRequired(!hashingOnHost);
+    size_t failures = 0;
+    for (size_t n = 0; n < filenames.size(); n++)
+    {
+        try
+        {
+            const vector<BYTE>& digest = calc.SHA256(filenames[n]);
+            printf("%s\n", FormatFileDigest(digest, filenames[n]).c_str());
+        } catch (std::exception& err)
+        {
+            fprintf(stderr, "%s\n", err.what());
+            failures++;
+        }
+    }
+    calc.unbind();
+    return failures;
+}
+
+/// 单个文件的计算结果
+struct FileDigestResult
+{
+    bool finished; ///< 是否已计算完毕
+    bool failed; ///< 是否计算失败
+    std::string text; ///< 输出行或错误信息
+};
+
+/// 多线程并行计算命令行指定文件的哈希摘要(-j 模式)
+///
+/// 每个工作线程各自建立一条 socket 连接并使用独立的 FileHashCalculatorClient,
+/// 即各自拥有独立的 SAPI 上下文和 TPM 哈希序列, 线程之间只共享待处理文件的序号.
+/// 主线程按输入顺序输出结果: 排在前面的文件计算完毕后立即输出, 不必等待全部文件完成
+///
+/// @return 打开或计算失败的文件个数
+static size_t PrintFileDigestsInParallel(const char *hostname, uint16_t port, const vector<const char *>& filenames, bool hashingOnHost, unsigned int jobs)
+{
+    std::mutex mutex;
+    std::condition_variable resultReady;
+    vector<FileDigestResult> results(filenames.size());
+    size_t nextFile = 0; ///< 下一个待领取的文件序号, 由 mutex 保护
+
+    for (size_t n = 0; n < results.size(); n++)
+    {
+        results[n].finished = false;
+        results[n].failed = false;
+    }
+
+    vector<std::thread> workers;
+    for (unsigned int j = 0; j < jobs; j++)
+    {
+        workers.push_back(std::thread([&]() {
+            SocketConnectionManager connectionManager(hostname, port);
+            connectionManager.connect();
+            FileHashCalculatorClient calc;
+            calc.bind(connectionManager);
+            calc.configValidationTicketRequired(!hashingOnHost);
+            for (;;)
+            {
+                size_t n;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (nextFile >= filenames.size())
+                    {
+                        break;
+                    }
+                    n = nextFile++;
+                }
+                FileDigestResult result;
+                result.finished = true;
+                result.failed = false;
+                try
+                {
+                    result.text = FormatFileDigest(calc.SHA256(filenames[n]), filenames[n]);
+                } catch (std::exception& err)
+                {
+                    result.failed = true;
+                    result.text = err.what();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results[n] = result;
+                }
+                resultReady.notify_all();
+            }
+            calc.unbind();
+            connectionManager.disconnect();
+        }));
+    }
+
+    size_t failures = 0;
+    for (size_t n = 0; n < results.size(); n++)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        resultReady.wait(lock, [&results, n]() { return results[n].finished; });
+        if (results[n].failed)
+        {
+            fprintf(stderr, "%s\n", results[n].text.c_str());
+            failures++;
+        } else
+        {
+            printf("%s\n", results[n].text.c_str());
+        }
+    }
+    for (size_t j = 0; j < workers.size(); j++)
+    {
+        workers[j].join();
+    }
+    return failures;
+}
+
 int main(int argc, char *argv[])
 {
     int count;
     int usingDeviceFile = false;
+    int hashingOnHost = false;
     const char *deviceFile = "/dev/tpm0";
     const char *hostname = "127.0.0.1";
     uint16_t port = DEFAULT_RESMGR_TPM_PORT;
+    vector<const char *> filenames; ///< 命令行指定的输入文件
+    unsigned int jobs = 1; ///< 并行计算的线程数
 
     count = 1;
     while (count < argc)
@@ -55,6 +197,13 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        if (0 == strcmp(argv[count], "-hostHash"))
+        {
+            hashingOnHost = true;
+            count += 1;
+            continue;
+        }
+
         if (0 == strcmp(argv[count], "-rmhost"))
         {
             if (count + 1 >= argc)
@@ -75,6 +224,25 @@ int main(int argc, char *argv[])
             port = strtoul(argv[count + 1], NULL, 10); // 暂时不检查无效的输入参数
             count += 2;
         }
+        else if (0 == strcmp(argv[count], "-j"))
+        {
+            if (count + 1 >= argc)
+            {
+                PrintHelp();
+                return 1;
+            }
+            jobs = strtoul(argv[count + 1], NULL, 10);
+            if (jobs < 1)
+            {
+                jobs = 1;
+            }
+            count += 2;
+        }
+        else if (argv[count][0] != '-')
+        {
+            filenames.push_back(argv[count]);
+            count += 1;
+        }
         else
         {
             PrintHelp();
@@ -85,6 +253,22 @@ int main(int argc, char *argv[])
         // 如果不指定命令行参数, 则会直接连接到本机 IP 地址默认端口上运行的资源管理器
     }
 
+    if (jobs > 1 && usingDeviceFile)
+    {
+        fprintf(stderr, "Warning: /dev/tpm0 只允许一个进程独占访问, 忽略 -j 选项\n");
+        jobs = 1;
+    }
+    if (jobs > filenames.size())
+    {
+        jobs = filenames.size();
+    }
+    if (jobs > 1)
+    {
+        // 各工作线程自行建立连接, 不使用下面的 connectionManager
+        size_t failures = PrintFileDigestsInParallel(hostname, port, filenames, hashingOnHost, jobs);
+        return (failures? 1: 0);
+    }
+
     SocketConnectionManager socketConnectionManager(hostname, port);
     CharacterDeviceConnectionManager charDevConnectionManager(deviceFile);
 
@@ -97,9 +281,18 @@ int main(int argc, char *argv[])
     }
     connectionManager->connect();
 
+    /* 测试 FileHashCalculatorClient: 按文件路径读取 */
+    if (!filenames.empty())
+    {
+        size_t failures = PrintFileDigests(*connectionManager, filenames, hashingOnHost);
+        connectionManager->disconnect();
+        return (failures? 1: 0);
+    }
+
     /* 测试 FileHashCalculatorClient */
     const char *szFilename=NULL;
     FILE *fp;
+    int exitCode = 0;
     if (!szFilename)
     {
         fp = stdin;
@@ -110,6 +303,7 @@ int main(int argc, char *argv[])
     if (!fp)
     {
         fprintf(stderr, "Error: Cannot open file \"%s\"\n", strerror(errno));
+        exitCode = 1;
         goto DISCONNECT;
     }
 
@@ -117,6 +311,7 @@ int main(int argc, char *argv[])
     {
         FileHashCalculatorClient calc;
         calc.bind(*connectionManager);
+        calc.configValidationTicketRequired(!hashingOnHost);
         const vector<BYTE>& digest = calc.SHA256(fp);
         calc.unbind();
         {
@@ -130,11 +325,12 @@ int main(int argc, char *argv[])
     } catch (std::exception err)
     {
         fprintf(stderr, "Error: %s\n", err.what());
+        exitCode = 1;
     }
 
 
 DISCONNECT:
     connectionManager->disconnect();
 
-    return (0);
+    return (exitCode);
 }
@@ -18,6 +18,18 @@ echo
 echo "Run TPM2.0 SHA256 test"
 time { cat $DATA_FILE | ./sha256sum -localTctiTest ; }
 
+echo
+echo "Run host-side SHA256 (no TPM validation ticket)"
+time { cat $DATA_FILE | ./sha256sum -localTctiTest -hostHash ; }
+
 echo
 echo "Run system built-in SHA256 tools:" \``which sha256sum` $DATA_FILE \`
 time { sha256sum $DATA_FILE ; }
+
+echo
+echo "Run host-side SHA256 on a file path (mmap, no stdio pipe)"
+time { ./sha256sum -localTctiTest -hostHash $DATA_FILE ; }
+
+echo
+echo "Run TPM2.0 SHA256 on 4 files in parallel (-j 4, one resourcemgr connection per thread)"
+time { ./sha256sum -j 4 $DATA_FILE $DATA_FILE $DATA_FILE $DATA_FILE ; }
@@ -0,0 +1,359 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <sapi/tpm20.h>
+#include "SHA1.h"
+#include "SHA256.h"
+#include "HostRSAPublicKey.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// 内部函数: 主机端哈希算法
+// ============================================================================
+
+/// 返回主机端能够计算的哈希摘要长度, 主机端不支持的算法返回 0
+static unsigned int HostDigestSize(TPMI_ALG_HASH hashAlg) {
+    switch (hashAlg) {
+    case TPM_ALG_SHA1:
+        return SHA1HashSize;
+    case TPM_ALG_SHA256:
+        return SHA256HashSize;
+    default:
+        return 0;
+    }
+}
+
+/// 在主机端计算 data1||data2 的哈希摘要
+static void HostDigest(TPMI_ALG_HASH hashAlg, const BYTE *data1, size_t length1, const BYTE *data2, size_t length2, BYTE *out) {
+    if (TPM_ALG_SHA1 == hashAlg) {
+        SHA1Context *ctx = SHA1CreateNewContext();
+        SHA1Reset(ctx);
+        SHA1Input(ctx, data1, (unsigned int) length1);
+        SHA1Input(ctx, data2, (unsigned int) length2);
+        SHA1Result(ctx, out);
+        SHA1DeleteContext(ctx);
+    } else {
+        SHA256Context *ctx = SHA256CreateNewContext();
+        SHA256Reset(ctx);
+        SHA256Input(ctx, data1, (unsigned int) length1);
+        SHA256Input(ctx, data2, (unsigned int) length2);
+        SHA256Result(ctx, out);
+        SHA256DeleteContext(ctx);
+    }
+}
+
+/// RSASSA-PKCS#1_v1.5 签名中的 DigestInfo 前缀(DER 编码, 参见 RFC 8017 9.2 节)
+static const BYTE *DigestInfoPrefix(TPMI_ALG_HASH hashAlg, unsigned int *pPrefixSize, unsigned int *pDigestSize) {
+    static const BYTE SHA1_PREFIX[] = {
+        0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2B, 0x0E, 0x03, 0x02, 0x1A, 0x05, 0x00, 0x04, 0x14,
+    };
+    static const BYTE SHA256_PREFIX[] = {
+        0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20,
+    };
+    static const BYTE SHA384_PREFIX[] = {
+        0x30, 0x41, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x02, 0x05, 0x00, 0x04, 0x30,
+    };
+    static const BYTE SHA512_PREFIX[] = {
+        0x30, 0x51, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40,
+    };
+    switch (hashAlg) {
+    case TPM_ALG_SHA1:
+        *pPrefixSize = sizeof(SHA1_PREFIX);
+        *pDigestSize = 20;
+        return SHA1_PREFIX;
+    case TPM_ALG_SHA256:
+        *pPrefixSize = sizeof(SHA256_PREFIX);
+        *pDigestSize = 32;
+        return SHA256_PREFIX;
+    case TPM_ALG_SHA384:
+        *pPrefixSize = sizeof(SHA384_PREFIX);
+        *pDigestSize = 48;
+        return SHA384_PREFIX;
+    case TPM_ALG_SHA512:
+        *pPrefixSize = sizeof(SHA512_PREFIX);
+        *pDigestSize = 64;
+        return SHA512_PREFIX;
+    default:
+        return NULL;
+    }
+}
+
+/// 大端字节串转换为 words 个 32 位小端字, 高位多余的字节被忽略
+static void WordsFromBytes(const BYTE *bytes, size_t size, uint32_t *words, size_t nWords) {
+    memset(words, 0x00, nWords * sizeof(uint32_t));
+    for (size_t i = 0; i < size && i / 4 < nWords; i++) {
+        words[i / 4] |= (uint32_t) bytes[size - 1 - i] << (8 * (i % 4));
+    }
+}
+
+/// a >= b 时返回 true
+static bool GreaterOrEqual(const uint32_t *a, const uint32_t *b, size_t nWords) {
+    for (size_t i = nWords; i > 0; i--) {
+        if (a[i - 1] != b[i - 1]) {
+            return a[i - 1] > b[i - 1];
+        }
+    }
+    return true;
+}
+
+/// a -= b, 返回借位
+static uint32_t Subtract(uint32_t *a, const uint32_t *b, size_t nWords) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < nWords; i++) {
+        uint64_t d = (uint64_t) a[i] - b[i] - borrow;
+        a[i] = (uint32_t) d;
+        borrow = (d >> 32) & 1;
+    }
+    return (uint32_t) borrow;
+}
+
+// ============================================================================
+// 构造函数: 预先计算 Montgomery 参数
+// ============================================================================
+HostRSAPublicKey::HostRSAPublicKey(const TPMT_PUBLIC& publicArea) {
+    if (TPM_ALG_RSA != publicArea.type) {
+        throw std::invalid_argument("HostRSAPublicKey: not an RSA public key");
+    }
+    const TPM2B_PUBLIC_KEY_RSA& n = publicArea.unique.rsa;
+    unsigned int skip = 0;
+    while (skip < n.t.size && 0 == n.t.buffer[skip]) {
+        skip++; // 跳过前导零字节
+    }
+    m_modulusBytes = n.t.size - skip;
+    if (0 == m_modulusBytes || 0 == (n.t.buffer[n.t.size - 1] & 1)) {
+        throw std::invalid_argument("HostRSAPublicKey: invalid RSA modulus");
+    }
+    m_modulusBits = 8 * m_modulusBytes;
+    for (BYTE top = n.t.buffer[skip]; !(top & 0x80); top <<= 1) {
+        m_modulusBits--;
+    }
+    m_exponent = publicArea.parameters.rsaDetail.exponent;
+    if (0 == m_exponent) {
+        m_exponent = 65537; // 取值为 0 表示默认指数 2^16+1
+    }
+
+    const size_t k = (m_modulusBytes + 3) / 4;
+    m_modulus.resize(k);
+    WordsFromBytes(n.t.buffer + skip, m_modulusBytes, &m_modulus[0], k);
+
+    // 牛顿迭代求 n[0] 模 2^32 的逆元
+    uint32_t x = m_modulus[0];
+    for (int i = 0; i < 5; i++) {
+        x *= 2 - m_modulus[0] * x;
+    }
+    m_n0inv = (uint32_t) (0 - x);
+
+    // R^2 mod n = 2^(64k) mod n, 通过反复倍加求得
+    m_rr.assign(k, 0);
+    m_rr[0] = 1;
+    for (size_t i = 0; i < 64 * k; i++) {
+        uint32_t carry = 0;
+        for (size_t j = 0; j < k; j++) {
+            uint32_t w = m_rr[j];
+            m_rr[j] = (w << 1) | carry;
+            carry = w >> 31;
+        }
+        if (carry || GreaterOrEqual(&m_rr[0], &m_modulus[0], k)) {
+            Subtract(&m_rr[0], &m_modulus[0], k);
+        }
+    }
+}
+
+// ============================================================================
+// Montgomery 模乘 out = a * b * R^(-1) mod n (CIOS 算法), t 为 k+2 个字的临时空间
+// ============================================================================
+void HostRSAPublicKey::montgomeryMultiply(const uint32_t *a, const uint32_t *b, uint32_t *out, uint32_t *t) const {
+    const size_t k = m_modulus.size();
+    const uint32_t *n = &m_modulus[0];
+    memset(t, 0x00, (k + 2) * sizeof(uint32_t));
+    for (size_t i = 0; i < k; i++) {
+        uint64_t s;
+        uint64_t c = 0;
+        for (size_t j = 0; j < k; j++) {
+            s = (uint64_t) t[j] + (uint64_t) a[j] * b[i] + c;
+            t[j] = (uint32_t) s;
+            c = s >> 32;
+        }
+        s = (uint64_t) t[k] + c;
+        t[k] = (uint32_t) s;
+        t[k + 1] = (uint32_t) (s >> 32);
+
+        uint32_t m = t[0] * m_n0inv;
+        s = (uint64_t) t[0] + (uint64_t) m * n[0];
+        c = s >> 32;
+        for (size_t j = 1; j < k; j++) {
+            s = (uint64_t) t[j] + (uint64_t) m * n[j] + c;
+            t[j - 1] = (uint32_t) s;
+            c = s >> 32;
+        }
+        s = (uint64_t) t[k] + c;
+        t[k - 1] = (uint32_t) s;
+        t[k] = t[k + 1] + (uint32_t) (s >> 32);
+    }
+    if (t[k] || GreaterOrEqual(t, n, k)) {
+        Subtract(t, n, k);
+    }
+    memcpy(out, t, k * sizeof(uint32_t));
+}
+
+// ============================================================================
+// 公钥运算 em = sig^e mod n
+// ============================================================================
+bool HostRSAPublicKey::publicOperation(const BYTE *sig, UINT16 sigSize, std::vector<BYTE>& em) const {
+    if (sigSize != m_modulusBytes) {
+        return false;
+    }
+    const size_t k = m_modulus.size();
+    std::vector<uint32_t> s(k), base(k), acc(k), t(k + 2);
+    WordsFromBytes(sig, sigSize, &s[0], k);
+    if (GreaterOrEqual(&s[0], &m_modulus[0], k)) {
+        return false; // 签名值必须小于模数
+    }
+
+    montgomeryMultiply(&s[0], &m_rr[0], &base[0], &t[0]); // 转换到 Montgomery 域
+    acc = base;
+    int bit = 31;
+    while (!(m_exponent & (1u << bit))) {
+        bit--;
+    }
+    for (bit--; bit >= 0; bit--) {
+        montgomeryMultiply(&acc[0], &acc[0], &acc[0], &t[0]);
+        if (m_exponent & (1u << bit)) {
+            montgomeryMultiply(&acc[0], &base[0], &acc[0], &t[0]);
+        }
+    }
+    std::vector<uint32_t> one(k, 0);
+    one[0] = 1;
+    montgomeryMultiply(&acc[0], &one[0], &acc[0], &t[0]); // 转换回普通表示
+
+    em.resize(m_modulusBytes);
+    for (size_t i = 0; i < m_modulusBytes; i++) {
+        em[m_modulusBytes - 1 - i] = (BYTE) (acc[i / 4] >> (8 * (i % 4)));
+    }
+    return true;
+}
+
+// ============================================================================
+// RSASSA-PKCS#1_v1.5: EM = 0x00 || 0x01 || PS(0xFF...) || 0x00 || DigestInfo
+// ============================================================================
+bool HostRSAPublicKey::verifyRSASSA(TPMI_ALG_HASH hashAlg, const BYTE *digest, UINT16 digestSize, const BYTE *sig, UINT16 sigSize) const {
+    unsigned int prefixSize = 0;
+    unsigned int hashSize = 0;
+    const BYTE *prefix = DigestInfoPrefix(hashAlg, &prefixSize, &hashSize);
+    if (!prefix || digestSize != hashSize) {
+        return false;
+    }
+    std::vector<BYTE> em;
+    if (!publicOperation(sig, sigSize, em)) {
+        return false;
+    }
+    const size_t tLen = prefixSize + hashSize;
+    if (em.size() < tLen + 11) {
+        return false; // PS 至少 8 个字节
+    }
+    const size_t psEnd = em.size() - tLen - 1;
+    if (0x00 != em[0] || 0x01 != em[1] || 0x00 != em[psEnd]) {
+        return false;
+    }
+    for (size_t i = 2; i < psEnd; i++) {
+        if (0xFF != em[i]) {
+            return false;
+        }
+    }
+    return 0 == memcmp(&em[psEnd + 1], prefix, prefixSize)
+            && 0 == memcmp(&em[psEnd + 1 + prefixSize], digest, hashSize);
+}
+
+// ============================================================================
+// RSA-PSS: 参见 RFC 8017 9.1.2 节 EMSA-PSS-VERIFY
+// ============================================================================
+bool HostRSAPublicKey::verifyRSAPSS(TPMI_ALG_HASH hashAlg, const BYTE *digest, UINT16 digestSize, const BYTE *sig, UINT16 sigSize) const {
+    const unsigned int hLen = HostDigestSize(hashAlg);
+    if (0 == hLen || digestSize != hLen) {
+        return false;
+    }
+    std::vector<BYTE> m;
+    if (!publicOperation(sig, sigSize, m)) {
+        return false;
+    }
+    const unsigned int emBits = m_modulusBits - 1;
+    const size_t emLen = (emBits + 7) / 8;
+    const BYTE *em = &m[m.size() - emLen]; // emBits 为 8 的整数倍时 EM 比模数少一个字节, 高位字节应为零
+    if (m.size() > emLen && 0 != m[0]) {
+        return false;
+    }
+    if (emLen < hLen + 2 || 0xBC != em[emLen - 1]) {
+        return false;
+    }
+    const size_t dbLen = emLen - hLen - 1;
+    const BYTE *h = em + dbLen;
+    const BYTE topMask = (BYTE) (0xFF >> (8 * emLen - emBits));
+    if (em[0] & ~topMask) {
+        return false;
+    }
+
+    // DB = maskedDB xor MGF1(H)
+    std::vector<BYTE> db(em, em + dbLen);
+    BYTE mask[SHA256HashSize];
+    for (uint32_t counter = 0; counter * hLen < dbLen; counter++) {
+        const BYTE c[4] = {
+            (BYTE) (counter >> 24), (BYTE) (counter >> 16), (BYTE) (counter >> 8), (BYTE) counter,
+        };
+        HostDigest(hashAlg, h, hLen, c, sizeof(c), mask);
+        for (size_t i = 0; i < hLen && counter * hLen + i < dbLen; i++) {
+            db[counter * hLen + i] ^= mask[i];
+        }
+    }
+    db[0] &= topMask;
+
+    // DB = PS(0x00...) || 0x01 || salt
+    size_t pos = 0;
+    while (pos < dbLen && 0x00 == db[pos]) {
+        pos++;
+    }
+    if (pos >= dbLen || 0x01 != db[pos]) {
+        return false;
+    }
+    pos++;
+
+    // H' = Hash(0x00 * 8 || mHash || salt)
+    std::vector<BYTE> mPrime(8, 0x00);
+    mPrime.insert(mPrime.end(), digest, digest + digestSize);
+    mPrime.insert(mPrime.end(), db.begin() + pos, db.end());
+    BYTE hPrime[SHA256HashSize];
+    HostDigest(hashAlg, &mPrime[0], mPrime.size(), NULL, 0, hPrime);
+    return 0 == memcmp(h, hPrime, hLen);
+}
+
+// ============================================================================
+// 校验 TPMT_SIGNATURE
+// ============================================================================
+bool HostRSAPublicKey::verify(const TPM2B_DIGEST& digest, const TPMT_SIGNATURE& signature) const {
+    const TPMS_SIGNATURE_RSA& rsa = signature.signature.rsassa; // RSASSA 与 RSAPSS 的签名结构体相同
+    switch (signature.sigAlg) {
+    case TPM_ALG_RSASSA:
+        return verifyRSASSA(rsa.hash, digest.t.buffer, digest.t.size, rsa.sig.t.buffer, rsa.sig.t.size);
+    case TPM_ALG_RSAPSS:
+        return verifyRSAPSS(rsa.hash, digest.t.buffer, digest.t.size, rsa.sig.t.buffer, rsa.sig.t.size);
+    default:
+        return false;
+    }
+}
+
+bool HostRSAPublicKey::supportsScheme(TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg) {
+    unsigned int prefixSize = 0;
+    unsigned int hashSize = 0;
+    switch (sigAlg) {
+    case TPM_ALG_RSASSA:
+        return NULL != DigestInfoPrefix(hashAlg, &prefixSize, &hashSize);
+    case TPM_ALG_RSAPSS:
+        return 0 != HostDigestSize(hashAlg);
+    default:
+        return false;
+    }
+}
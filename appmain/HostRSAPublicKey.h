@@ -0,0 +1,57 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef HOST_RSA_PUBLIC_KEY_H_
+#define HOST_RSA_PUBLIC_KEY_H_
+#ifdef __cplusplus
+
+#include <stdint.h>
+#include <vector>
+#include <sapi/tpm20.h>
+
+/// 主机端 RSA 公钥, 用于在主机端直接校验 TPM 输出的 RSA 数字签名
+///
+/// 公钥运算只涉及公开数据, 无需 TPM 参与. 本类使用 Montgomery 模乘实现模幂运算, 不依赖第三方大数库.
+/// 对象构造完成后只读, 可供多个线程同时调用 verify*() 系列函数.
+class HostRSAPublicKey
+{
+public:
+    /// 由 TPMT_PUBLIC 公钥区构造
+    ///
+    /// @throws std::invalid_argument 不是 RSA 公钥或模数无效(为空或为偶数)时抛出
+    explicit HostRSAPublicKey(const TPMT_PUBLIC& publicArea);
+
+    /// 校验 RSASSA-PKCS#1_v1.5 签名
+    ///
+    /// @return 签名有效时返回 true. 哈希算法不受支持时也返回 false, 调用者应先检查 supportsScheme()
+    bool verifyRSASSA(TPMI_ALG_HASH hashAlg, const BYTE *digest, UINT16 digestSize, const BYTE *sig, UINT16 sigSize) const;
+
+    /// 校验 RSA-PSS 签名, 盐值长度由签名数据自动推算
+    ///
+    /// @return 签名有效时返回 true. 哈希算法不受支持时也返回 false, 调用者应先检查 supportsScheme()
+    bool verifyRSAPSS(TPMI_ALG_HASH hashAlg, const BYTE *digest, UINT16 digestSize, const BYTE *sig, UINT16 sigSize) const;
+
+    /// 校验 TPMT_SIGNATURE 格式的签名
+    bool verify(const TPM2B_DIGEST& digest, const TPMT_SIGNATURE& signature) const;
+
+    /// 查询主机端是否支持校验指定签名方案
+    ///
+    /// RSASSA 支持 SHA1/SHA256/SHA384/SHA512; RSAPSS 的 MGF1 掩码需要主机端哈希算法, 仅支持 SHA1/SHA256
+    static bool supportsScheme(TPMI_ALG_SIG_SCHEME sigAlg, TPMI_ALG_HASH hashAlg);
+
+private:
+    /// 计算 sig^e mod n, 以大端字节序输出到 em (长度等于模数字节数)
+    bool publicOperation(const BYTE *sig, UINT16 sigSize, std::vector<BYTE>& em) const;
+    void montgomeryMultiply(const uint32_t *a, const uint32_t *b, uint32_t *out, uint32_t *t) const;
+
+    std::vector<uint32_t> m_modulus; ///< 模数 n, 32 位小端字数组
+    std::vector<uint32_t> m_rr; ///< R^2 mod n, 用于转换到 Montgomery 域
+    uint32_t m_n0inv; ///< -n^(-1) mod 2^32
+    uint32_t m_exponent;
+    unsigned int m_modulusBytes;
+    unsigned int m_modulusBits;
+};
+
+#endif // __cplusplus
+#endif // HOST_RSA_PUBLIC_KEY_H_
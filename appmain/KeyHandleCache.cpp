@@ -0,0 +1,218 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <cstring>
+#include <string>
+#include <sapi/tpm20.h>
+#include "SHA256.h"
+#include "TPMCommand.h"
+#include "KeyHandleCache.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// 内部函数: 计算密钥身份摘要
+// ============================================================================
+
+/// 身份摘要计算器, 各字段依次以"4字节长度 + 数据"的形式输入 SHA256, 避免字段边界含糊
+class IdentityDigest {
+public:
+    explicit IdentityDigest(const char *tag) {
+        m_ctx = SHA256CreateNewContext();
+        SHA256Reset(m_ctx);
+        input(tag, strlen(tag));
+    }
+    ~IdentityDigest() {
+        SHA256DeleteContext(m_ctx);
+    }
+    void input(const void *data, size_t length) {
+        const uint8_t len[4] = {
+            (uint8_t) (length >> 24), (uint8_t) (length >> 16), (uint8_t) (length >> 8), (uint8_t) length,
+        };
+        SHA256Input(m_ctx, len, sizeof(len));
+        SHA256Input(m_ctx, (const uint8_t *) data, (unsigned int) length);
+    }
+    void inputUINT32(UINT32 value) {
+        const uint8_t bytes[4] = {
+            (uint8_t) (value >> 24), (uint8_t) (value >> 16), (uint8_t) (value >> 8), (uint8_t) value,
+        };
+        SHA256Input(m_ctx, bytes, sizeof(bytes));
+    }
+    std::string result() {
+        uint8_t digest[SHA256HashSize];
+        SHA256Result(m_ctx, digest);
+        return std::string((const char *) digest, sizeof(digest));
+    }
+private:
+    SHA256Context *m_ctx;
+};
+
+static std::string NameKey(const TPM2B_NAME& name) {
+    return std::string((const char *) name.t.name, name.t.size);
+}
+
+// ============================================================================
+// 构造函数/析构函数
+// ============================================================================
+KeyHandleCache::KeyHandleCache(unsigned int maxLoadedKeys)
+        : m_ownedManager(new VirtualHandleManager(maxLoadedKeys, VirtualHandleManager::LEAST_RECENTLY_USED)),
+          m_manager(*m_ownedManager) {
+    m_hitCount = 0;
+    m_missCount = 0;
+    m_restoreCount = 0;
+}
+
+KeyHandleCache::KeyHandleCache(VirtualHandleManager& manager)
+        : m_manager(manager) {
+    m_hitCount = 0;
+    m_missCount = 0;
+    m_restoreCount = 0;
+}
+
+KeyHandleCache::~KeyHandleCache() {
+    // 析构时没有可用的 TPM 连接, 已加载的密钥节点由调用者通过 flushAll() 清除
+}
+
+// ============================================================================
+// 加载密钥(Load)
+// ============================================================================
+TPM_HANDLE KeyHandleCache::load(
+        Client& client,
+        TPMI_DH_OBJECT parentHandle,
+        const TPM2B_PRIVATE& inPrivate,
+        const TPM2B_PUBLIC& inPublic,
+        const void *parentPassword,
+        UINT16 parentPasswordLength
+        ) {
+    // 私钥数据块经父节点加密并带有完整性校验, 同一父节点下可唯一确定一个密钥
+    IdentityDigest identity("Load");
+    identity.inputUINT32(parentHandle);
+    identity.input(inPrivate.t.buffer, inPrivate.t.size);
+    return acquire(client, identity.result(), [&](TPM2B_NAME& name) -> TPM_HANDLE {
+        TPMCommands::Load load;
+        load.configAuthParent(parentHandle);
+        load.configAuthPassword(parentPassword, parentPasswordLength);
+        load.configPrivateData(inPrivate);
+        load.configPublicData(inPublic);
+        client.sendCommandAndWaitUntilResponseIsFetched(load);
+        name = load.outName();
+        return load.outObjectHandle();
+    });
+}
+
+// ============================================================================
+// 加载外部对称密钥(LoadExternal)
+// ============================================================================
+TPM_HANDLE KeyHandleCache::loadExternalKeyedHashKey(
+        Client& client,
+        const void *key,
+        UINT16 keyLength,
+        const void *keyPassword,
+        UINT16 keyPasswordLength,
+        TPMI_RH_HIERARCHY hierarchy
+        ) {
+    IdentityDigest identity("LoadExternal.KeyedHash");
+    identity.inputUINT32(hierarchy);
+    identity.input(key, keyLength);
+    identity.input(keyPassword, keyPasswordLength);
+    return acquire(client, identity.result(), [&](TPM2B_NAME& name) -> TPM_HANDLE {
+        TPMCommands::LoadExternal loadextn;
+        loadextn.configHierarchy(hierarchy);
+        loadextn.configSensitiveDataBits(key, keyLength);
+        loadextn.configKeyTypeKeyedHashKey();
+        loadextn.configKeyAuthValue(keyPassword, keyPasswordLength);
+        try {
+            client.sendCommandAndWaitUntilResponseIsFetched(loadextn);
+        } catch (...) {
+            loadextn.eraseCachedKeyAuthValue();
+            throw;
+        }
+        // 手动覆盖清除命令对象中缓存的对称密钥值副本
+        char buf[keyLength];
+        memset(buf, 0xFF, keyLength);
+        loadextn.configSensitiveDataBits(buf, keyLength);
+        loadextn.eraseCachedKeyAuthValue();
+        name = loadextn.outName();
+        return loadextn.outObjectHandle();
+    });
+}
+
+// ============================================================================
+// 按 Name 查找
+// ============================================================================
+bool KeyHandleCache::lookupByName(Client& client, const TPM2B_NAME& name, TPM_HANDLE *pHandle) {
+    std::map<std::string, TPM_HANDLE>::iterator found = m_byName.find(NameKey(name));
+    if (found == m_byName.end()) {
+        return false;
+    }
+    *pHandle = resolve(client, found->second);
+    return true;
+}
+
+// ============================================================================
+// 查找缓存, 未命中时调用 loader 加载密钥
+// ============================================================================
+TPM_HANDLE KeyHandleCache::acquire(Client& client, const std::string& identity, const KeyLoader& loader) {
+    std::map<std::string, TPM_HANDLE>::iterator found = m_byIdentity.find(identity);
+    if (found != m_byIdentity.end()) {
+        return resolve(client, found->second);
+    }
+
+    m_missCount++;
+    TPM2B_NAME name;
+    name.t.size = 0;
+    const TPM_HANDLE virtualHandle = m_manager.loadObject(client, [&]() -> TPM_HANDLE {
+        return loader(name);
+    });
+    m_byIdentity[identity] = virtualHandle;
+    if (name.t.size > 0) {
+        m_byName[NameKey(name)] = virtualHandle;
+    }
+    return m_manager.resolve(client, virtualHandle); // 刚加载的对象一定命中, 不计入统计
+}
+
+// ============================================================================
+// 虚拟句柄 -> 临时句柄, 已被淘汰的密钥由管理器通过 ContextLoad 恢复
+// ============================================================================
+TPM_HANDLE KeyHandleCache::resolve(Client& client, TPM_HANDLE virtualHandle) {
+    const unsigned long swapIns = m_manager.statistics().swapIns;
+    const TPM_HANDLE handle = m_manager.resolve(client, virtualHandle);
+    if (m_manager.statistics().swapIns == swapIns) {
+        m_hitCount++;
+    } else {
+        m_restoreCount++;
+    }
+    return handle;
+}
+
+// ============================================================================
+// 清除本缓存加载的全部密钥节点
+// ============================================================================
+void KeyHandleCache::flushAll(Client& client) {
+    for (std::map<std::string, TPM_HANDLE>::iterator it = m_byIdentity.begin(); it != m_byIdentity.end(); ++it) {
+        try {
+            m_manager.release(client, it->second);
+        } catch (TSS2_RC rc) {
+            // 忽略错误, 继续清除其他节点
+        }
+    }
+    m_byIdentity.clear();
+    m_byName.clear();
+}
+
+unsigned long KeyHandleCache::hitCount() const {
+    return m_hitCount;
+}
+
+unsigned long KeyHandleCache::missCount() const {
+    return m_missCount;
+}
+
+unsigned long KeyHandleCache::evictionCount() const {
+    return m_manager.statistics().swapOuts;
+}
+
+unsigned long KeyHandleCache::restoreCount() const {
+    return m_restoreCount;
+}
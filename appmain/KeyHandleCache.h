@@ -0,0 +1,108 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef KEY_HANDLE_CACHE_H_
+#define KEY_HANDLE_CACHE_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "Client.h"
+#include "VirtualHandleManager.h"
+
+#ifdef __cplusplus
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+/// 已加载密钥句柄缓存
+///
+/// 反复加载同一个密钥时直接返回之前加载得到的临时句柄, 省去 Load/LoadExternal 命令.
+/// 密钥按身份摘要索引: Load 密钥取父节点句柄和私钥数据块, LoadExternal 密钥取对称密钥值和授权值,
+/// 经主机端 SHA256 计算摘要后作为索引, 缓存中不保存敏感数据明文. 加载成功后同时按密钥 Name 建立索引.
+///
+/// 对象槽位由 VirtualHandleManager 管理: 每个已加载的密钥登记为一个虚拟句柄, 槽位不足或 TPM 返回
+/// TPM_RC_OBJECT_MEMORY 时由管理器按最近最少使用(LRU)原则换出(ContextSave + FlushLoadedKeyNode),
+/// 之后再次用到该密钥时由管理器执行 ContextLoad 恢复. 程序中同时使用 VirtualHandleManager 时,
+/// 应将同一个管理器传给本类的构造函数, 使全部对象按同一个顺序换出, 不会各自记账争抢槽位.
+///
+/// @note 同一个缓存对象必须始终配合同一个 TPM 连接使用(临时句柄只在一个连接内有效).
+/// @note 返回的句柄在下一次调用本类(或共用的管理器)的加载函数之前保证有效, 之后可能被淘汰.
+class KeyHandleCache
+{
+public:
+    /// 构造函数
+    ///
+    /// @param maxLoadedKeys 同时保持加载状态的密钥个数上限, 默认为 3 (TPM 规范要求的最少临时对象槽位数)
+    explicit KeyHandleCache(unsigned int maxLoadedKeys=3);
+    /// 构造函数: 与其他代码共用对象槽位管理器
+    ///
+    /// @param manager 虚拟句柄管理器, 必须比本对象存在更久
+    explicit KeyHandleCache(VirtualHandleManager& manager);
+    ~KeyHandleCache();
+
+    /// 通过 TPMCommands::Load 加载密钥, 已缓存时直接返回句柄
+    ///
+    /// @throws TSS2_RC 加载失败时抛出 TPM 错误码
+    TPM_HANDLE load(
+            Client& client, ///< 用于发送命令的 TPM 客户端
+            TPMI_DH_OBJECT parentHandle, ///< 父节点句柄
+            const TPM2B_PRIVATE& inPrivate, ///< 私钥数据块
+            const TPM2B_PUBLIC& inPublic, ///< 公开数据
+            const void *parentPassword="", ///< 父节点授权密码
+            UINT16 parentPasswordLength=0 ///< 父节点授权密码长度
+            );
+
+    /// 通过 TPMCommands::LoadExternal 加载 keyed-hash 对称密钥(例如 HMAC 密钥), 已缓存时直接返回句柄
+    ///
+    /// @throws TSS2_RC 加载失败时抛出 TPM 错误码
+    TPM_HANDLE loadExternalKeyedHashKey(
+            Client& client, ///< 用于发送命令的 TPM 客户端
+            const void *key, ///< 对称密钥值
+            UINT16 keyLength, ///< 对称密钥长度
+            const void *keyPassword="", ///< 新节点的授权密码
+            UINT16 keyPasswordLength=0, ///< 授权密码长度
+            TPMI_RH_HIERARCHY hierarchy=TPM_RH_NULL ///< 密钥所属层级
+            );
+
+    /// 按密钥 Name 查找之前加载过的密钥, 已被淘汰的密钥会自动恢复
+    ///
+    /// @return 找到时返回 true 并通过 pHandle 输出句柄
+    bool lookupByName(Client& client, const TPM2B_NAME& name, TPM_HANDLE *pHandle);
+
+    /// 清除本缓存加载的全部密钥节点并清空缓存. 解除 TPM 连接之前应调用此函数
+    void flushAll(Client& client);
+
+    /// 统计信息
+    unsigned long hitCount() const; ///< 命中次数(无需任何 TPM 命令)
+    unsigned long missCount() const; ///< 未命中次数(执行了 Load/LoadExternal)
+    unsigned long evictionCount() const; ///< 淘汰次数(执行了 ContextSave + FlushLoadedKeyNode), 共用管理器时为管理器的总换出次数
+    unsigned long restoreCount() const; ///< 恢复次数(执行了 ContextLoad)
+
+private:
+    typedef std::function<TPM_HANDLE (TPM2B_NAME& name)> KeyLoader;
+
+    TPM_HANDLE acquire(Client& client, const std::string& identity, const KeyLoader& loader);
+    TPM_HANDLE resolve(Client& client, TPM_HANDLE virtualHandle);
+
+    std::unique_ptr<VirtualHandleManager> m_ownedManager; ///< 未指定管理器时自行创建
+    VirtualHandleManager& m_manager;
+    std::map<std::string, TPM_HANDLE> m_byIdentity; ///< 身份摘要 -> 虚拟句柄
+    std::map<std::string, TPM_HANDLE> m_byName; ///< 密钥 Name -> 虚拟句柄
+    unsigned long m_hitCount;
+    unsigned long m_missCount;
+    unsigned long m_restoreCount;
+
+    // 禁止复制
+    KeyHandleCache(const KeyHandleCache&);
+    KeyHandleCache& operator=(const KeyHandleCache&);
+};
+
+#endif // __cplusplus
+#endif // KEY_HANDLE_CACHE_H_
@@ -0,0 +1,103 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <stdexcept>
+#include <string>
+#include <sapi/tpm20.h>
+#include "BinaryContextFile.h"
+#include "ContextFileParser.h"
+#include "LazyContextRestorer.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+LazyContextRestorer::LazyContextRestorer(VirtualHandleManager& manager)
+        : m_manager(manager) {
+}
+
+LazyContextRestorer::~LazyContextRestorer() {
+}
+
+// ============================================================================
+// 登记
+// ============================================================================
+TPM_HANDLE LazyContextRestorer::registerKey(const std::string& key, const VirtualHandleManager::ContextProvider& provider) {
+    std::map<std::string, TPM_HANDLE>::iterator it = m_handles.find(key);
+    if (it != m_handles.end()) {
+        // 不能悄悄忽略新的 provider, 否则调用者会以为换入的是新登记的上下文
+        throw std::invalid_argument("LazyContextRestorer: key is already registered");
+    }
+    TPM_HANDLE virtualHandle = m_manager.registerLazyContext(provider);
+    m_handles[key] = virtualHandle;
+    return virtualHandle;
+}
+
+size_t LazyContextRestorer::registerStore(ContextStore& store) {
+    const std::vector<std::string> keys = store.keys();
+    for (size_t i = 0; i < keys.size(); i++) {
+        registerStoreEntry(store, keys[i]);
+    }
+    return keys.size();
+}
+
+TPM_HANDLE LazyContextRestorer::registerStoreEntry(ContextStore& store, const std::string& key) {
+    if (!store.contains(key)) {
+        throw std::invalid_argument("LazyContextRestorer::registerStoreEntry(): key not found in context store");
+    }
+    ContextStore *pStore = &store;
+    return registerKey(key, [pStore, key](TPMS_CONTEXT& context) {
+        if (!pStore->get(key, context)) {
+            throw std::runtime_error("LazyContextRestorer: context was removed from store");
+        }
+    });
+}
+
+TPM_HANDLE LazyContextRestorer::registerContextFile(const std::string& key, const char *szFileName) {
+    if (!szFileName) { // 不允许调用者传入NULL指针
+        throw std::invalid_argument("LazyContextRestorer::registerContextFile(): szFileName is NULL");
+    }
+    const std::string fileName(szFileName);
+    const bool isText = fileName.size() >= 4 && 0 == fileName.compare(fileName.size() - 4, 4, ".csv");
+    return registerKey(key, [fileName, isText](TPMS_CONTEXT& context) {
+        if (isText) {
+            ContextFileParser parser(fileName.c_str());
+            parser.fetch(context);
+        } else {
+            BinaryContextFileParser parser(fileName.c_str());
+            parser.fetch(context);
+        }
+    });
+}
+
+// ============================================================================
+// 查询
+// ============================================================================
+TPM_HANDLE LazyContextRestorer::handleOf(const std::string& key) const {
+    std::map<std::string, TPM_HANDLE>::const_iterator it = m_handles.find(key);
+    if (it == m_handles.end()) {
+        throw std::invalid_argument("LazyContextRestorer::handleOf(): key is not registered");
+    }
+    return it->second;
+}
+
+bool LazyContextRestorer::contains(const std::string& key) const {
+    return m_handles.find(key) != m_handles.end();
+}
+
+// ============================================================================
+// 预取
+// ============================================================================
+void LazyContextRestorer::addPrefetchHint(const std::string& key) {
+    m_prefetchHints.push_back(key);
+}
+
+void LazyContextRestorer::prefetch(Client& client) {
+    std::vector<TPM_HANDLE> virtualHandles;
+    for (size_t i = 0; i < m_prefetchHints.size(); i++) {
+        std::map<std::string, TPM_HANDLE>::const_iterator it = m_handles.find(m_prefetchHints[i]);
+        if (it != m_handles.end()) {
+            virtualHandles.push_back(it->second);
+        }
+    }
+    m_manager.prefetch(client, virtualHandles);
+}
@@ -0,0 +1,93 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef LAZY_CONTEXT_RESTORER_H_
+#define LAZY_CONTEXT_RESTORER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "Client.h"
+#include "ContextStore.h"
+#include "VirtualHandleManager.h"
+
+#ifdef __cplusplus
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// 服务启动时的延迟恢复(lazy restore)
+///
+/// 传统做法是启动时逐个解析上下文文件并立即执行 ContextLoad(参见 ObjectContextSavingAndLoadingTest).
+/// 本类只登记已保存的上下文, 为每个对象分配虚拟句柄, 首次 resolve() 时才读取上下文并执行 ContextLoad.
+/// 已知的常用对象可以通过 addPrefetchHint() 标记, 然后由 prefetch() 提前换入.
+///
+/// 用法示意(伪代码):
+/// ```
+/// VirtualHandleManager vhm;
+/// LazyContextRestorer restorer(vhm);
+/// restorer.registerStore(store); // 只读取索引, 不读取上下文
+/// restorer.addPrefetchHint(ContextStore::KeyFromName(hotKeyName));
+/// restorer.prefetch(client); // 可选
+/// ...
+/// TPM_HANDLE realHandle = vhm.resolve(client, restorer.handleOf(key)); // 首次使用时才 ContextLoad
+/// ```
+///
+/// @note 上下文由 ContextStore 提供时, store 对象必须在 VirtualHandleManager 取回全部上下文之前保持打开.
+class LazyContextRestorer
+{
+public:
+    explicit LazyContextRestorer(VirtualHandleManager& manager);
+    ~LazyContextRestorer();
+
+    /// 登记 ContextStore 中的全部上下文, 返回登记的个数
+    ///
+    /// @throws std::invalid_argument 某个索引键已经登记过时抛出
+    size_t registerStore(ContextStore& store);
+
+    /// 登记 ContextStore 中的单个上下文
+    ///
+    /// @throws std::invalid_argument store 中不存在该索引键, 或索引键已经登记过时抛出
+    TPM_HANDLE registerStoreEntry(ContextStore& store, const std::string& key);
+
+    /// 登记单个上下文文件, 扩展名为 ".csv" 时按 ContextFileParser 的文本格式解析, 否则按 BinaryContextFileParser 的二进制格式解析
+    ///
+    /// @throws std::invalid_argument 索引键已经登记过时抛出
+    TPM_HANDLE registerContextFile(const std::string& key, const char *szFileName);
+
+    /// 查询索引键对应的虚拟句柄
+    ///
+    /// @throws std::invalid_argument 索引键未登记时抛出
+    TPM_HANDLE handleOf(const std::string& key) const;
+
+    /// 查询索引键是否已登记
+    bool contains(const std::string& key) const;
+
+    /// 标记常用对象. 多次调用时按标记顺序预取
+    void addPrefetchHint(const std::string& key);
+
+    /**
+     * 按预取标记提前换入对象(参见 VirtualHandleManager::prefetch()), 未登记的标记被忽略
+     *
+     * @throws TSS2_RC ContextLoad 失败(TPM_RC_OBJECT_MEMORY 除外)时抛出 TPM 错误码
+     */
+    void prefetch(Client& client);
+
+private:
+    TPM_HANDLE registerKey(const std::string& key, const VirtualHandleManager::ContextProvider& provider);
+
+    VirtualHandleManager& m_manager;
+    std::map<std::string, TPM_HANDLE> m_handles;
+    std::vector<std::string> m_prefetchHints;
+
+    // 禁止复制
+    LazyContextRestorer(const LazyContextRestorer&);
+    LazyContextRestorer& operator=(const LazyContextRestorer&);
+};
+
+#endif // __cplusplus
+#endif // LAZY_CONTEXT_RESTORER_H_
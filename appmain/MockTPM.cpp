@@ -0,0 +1,1552 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <sapi/tpm20.h>
+#include "SHA1.h"
+#include "SHA256.h"
+#include "MockTPM.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// 错误码
+// ============================================================================
+// 注: TPM_RC_XXX 宏的类型是 int, 抛出前必须转换为 TPM_RC, 否则 execute() 无法捕获
+static TPM_RC RC(TPM_RC rc) {
+    return rc;
+}
+
+/// 带句柄序号(从 1 开始)的错误码
+static TPM_RC RC_H(TPM_RC rc, unsigned int n) {
+    return rc + TPM_RC_H + TPM_RC_1 * n;
+}
+
+/// 带参数序号(从 1 开始)的错误码
+static TPM_RC RC_P(TPM_RC rc, unsigned int n) {
+    return rc + TPM_RC_P + TPM_RC_1 * n;
+}
+
+/// 带会话序号(从 1 开始)的错误码
+static TPM_RC RC_S(TPM_RC rc, unsigned int n) {
+    return rc + TPM_RC_S + TPM_RC_1 * n;
+}
+
+// ============================================================================
+// 大端字节序读写
+// ============================================================================
+typedef std::vector<uint8_t> Bytes;
+
+class Reader {
+public:
+    Reader() : m_data(NULL), m_size(0), m_pos(0), m_error(0) {
+    }
+
+    /// @param error 数据不足时抛出的错误码
+    Reader(const uint8_t *data, size_t size, TPM_RC error)
+            : m_data(data), m_size(size), m_pos(0), m_error(error) {
+    }
+
+    uint8_t u8() {
+        need(1);
+        return m_data[m_pos++];
+    }
+
+    uint16_t u16() {
+        need(2);
+        uint16_t value = (uint16_t) ((m_data[m_pos] << 8) | m_data[m_pos + 1]);
+        m_pos += 2;
+        return value;
+    }
+
+    uint32_t u32() {
+        uint32_t high = u16();
+        return (high << 16) | u16();
+    }
+
+    uint64_t u64() {
+        uint64_t high = u32();
+        return (high << 32) | u32();
+    }
+
+    void bytes(Bytes& out, size_t length) {
+        need(length);
+        out.assign(m_data + m_pos, m_data + m_pos + length);
+        m_pos += length;
+    }
+
+    /// 读取 TPM2B 结构体(2 字节长度 + 数据)
+    ///
+    /// @param maxSize 长度上限, 超出时抛出 TPM_RC_SIZE
+    void tpm2b(Bytes& out, size_t maxSize=0xFFFF) {
+        size_t length = u16();
+        if (length > maxSize) {
+            throw RC((m_error & ~0x3F) + (TPM_RC_SIZE & 0x3F)); // 保留参数序号, 替换错误类型
+        }
+        bytes(out, length);
+    }
+
+    Bytes tpm2b() {
+        Bytes out;
+        tpm2b(out);
+        return out;
+    }
+
+    /// 取出下一段 TPM2B 的数据区作为子读取器(用于 TPM2B_PUBLIC 等嵌套结构)
+    Reader sub() {
+        size_t length = u16();
+        need(length);
+        Reader reader(m_data + m_pos, length, m_error);
+        m_pos += length;
+        return reader;
+    }
+
+    size_t position() const {
+        return m_pos;
+    }
+
+    size_t remaining() const {
+        return m_size - m_pos;
+    }
+
+    const uint8_t *current() const {
+        return m_data + m_pos;
+    }
+
+    void skip(size_t length) {
+        need(length);
+        m_pos += length;
+    }
+
+private:
+    void need(size_t length) const {
+        if (length > m_size - m_pos) {
+            throw RC(m_error);
+        }
+    }
+
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_pos;
+    TPM_RC m_error;
+};
+
+class Writer {
+public:
+    void u8(uint8_t value) {
+        m_data.push_back(value);
+    }
+
+    void u16(uint16_t value) {
+        m_data.push_back((uint8_t) (value >> 8));
+        m_data.push_back((uint8_t) value);
+    }
+
+    void u32(uint32_t value) {
+        u16((uint16_t) (value >> 16));
+        u16((uint16_t) value);
+    }
+
+    void u64(uint64_t value) {
+        u32((uint32_t) (value >> 32));
+        u32((uint32_t) value);
+    }
+
+    void bytes(const Bytes& data) {
+        m_data.insert(m_data.end(), data.begin(), data.end());
+    }
+
+    void bytes(const void *data, size_t length) {
+        const uint8_t *p = (const uint8_t *) data;
+        m_data.insert(m_data.end(), p, p + length);
+    }
+
+    void tpm2b(const Bytes& data) {
+        u16((uint16_t) data.size());
+        bytes(data);
+    }
+
+    Bytes& data() {
+        return m_data;
+    }
+
+private:
+    Bytes m_data;
+};
+
+static Bytes Concat(const Bytes& a, const Bytes& b) {
+    Bytes out(a);
+    out.insert(out.end(), b.begin(), b.end());
+    return out;
+}
+
+static Bytes BE16(uint16_t value) {
+    Bytes out(2);
+    out[0] = (uint8_t) (value >> 8);
+    out[1] = (uint8_t) value;
+    return out;
+}
+
+static Bytes BE32(uint32_t value) {
+    return Concat(BE16((uint16_t) (value >> 16)), BE16((uint16_t) value));
+}
+
+static Bytes Label(const char *label) {
+    return Bytes(label, label + strlen(label));
+}
+
+// ============================================================================
+// 请求与应答
+// ============================================================================
+class MockTPM::Request {
+public:
+    struct Auth {
+        TPM_HANDLE sessionHandle;
+        Bytes nonce;
+        uint8_t attributes;
+        Bytes hmac;
+    };
+
+    TPM_ST tag;
+    TPM_CC commandCode;
+    std::vector<TPM_HANDLE> handles;
+    std::vector<Auth> auths;
+    Reader params;
+};
+
+class MockTPM::Response {
+public:
+    std::vector<TPM_HANDLE> handles;
+    Writer params;
+};
+
+// ============================================================================
+// 哈希算法
+// ============================================================================
+class MockTPM::HashState {
+public:
+    explicit HashState(TPM_ALG_ID alg) : m_alg(alg), m_sha1(NULL), m_sha256(NULL) {
+        if (TPM_ALG_SHA1 == alg) {
+            m_sha1 = SHA1CreateNewContext();
+            SHA1Reset(m_sha1);
+        } else if (TPM_ALG_SHA256 == alg) {
+            m_sha256 = SHA256CreateNewContext();
+            SHA256Reset(m_sha256);
+        } else {
+            throw RC(TPM_RC_HASH);
+        }
+    }
+
+    ~HashState() {
+        if (m_sha1) {
+            SHA1DeleteContext(m_sha1);
+        }
+        if (m_sha256) {
+            SHA256DeleteContext(m_sha256);
+        }
+    }
+
+    void update(const Bytes& data) {
+        if (data.empty()) {
+            return;
+        }
+        if (m_sha1) {
+            SHA1Input(m_sha1, data.data(), (unsigned int) data.size());
+        } else {
+            SHA256Input(m_sha256, data.data(), (unsigned int) data.size());
+        }
+    }
+
+    Bytes finish() {
+        Bytes digest(DigestSize(m_alg));
+        if (m_sha1) {
+            SHA1Result(m_sha1, digest.data());
+        } else {
+            SHA256Result(m_sha256, digest.data());
+        }
+        return digest;
+    }
+
+    /// 摘要长度, 未知算法返回 0
+    static size_t DigestSize(TPM_ALG_ID alg) {
+        switch (alg) {
+        case TPM_ALG_SHA1:
+            return SHA1HashSize;
+        case TPM_ALG_SHA256:
+        case TPM_ALG_SM3_256:
+            return SHA256HashSize;
+        case TPM_ALG_SHA384:
+            return 48;
+        case TPM_ALG_SHA512:
+            return 64;
+        default:
+            return 0;
+        }
+    }
+
+    /// 模拟器能够实际计算的算法
+    static bool IsSupported(TPM_ALG_ID alg) {
+        return TPM_ALG_SHA1 == alg || TPM_ALG_SHA256 == alg;
+    }
+
+    static Bytes Digest(TPM_ALG_ID alg, const Bytes& data) {
+        HashState state(alg);
+        state.update(data);
+        return state.finish();
+    }
+
+    /// HMAC 密钥预处理: 超过分组长度时先取哈希, 然后补零到分组长度
+    static Bytes PadKey(TPM_ALG_ID alg, const Bytes& key) {
+        Bytes padded = (key.size() > BLOCK_SIZE) ? Digest(alg, key) : key;
+        padded.resize(BLOCK_SIZE, 0);
+        return padded;
+    }
+
+    static Bytes XorPad(const Bytes& paddedKey, uint8_t pad) {
+        Bytes out(paddedKey);
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] ^= pad;
+        }
+        return out;
+    }
+
+    static Bytes HMAC(TPM_ALG_ID alg, const Bytes& key, const Bytes& data) {
+        const Bytes paddedKey = PadKey(alg, key);
+        HashState inner(alg);
+        inner.update(XorPad(paddedKey, 0x36));
+        inner.update(data);
+        HashState outer(alg);
+        outer.update(XorPad(paddedKey, 0x5C));
+        outer.update(inner.finish());
+        return outer.finish();
+    }
+
+    /// 计数器模式的掩码生成函数(基于 SHA256), 用于派生模拟密钥数据
+    static Bytes MGF(const Bytes& seed, size_t length) {
+        Bytes out;
+        for (uint32_t counter = 0; out.size() < length; counter++) {
+            HashState state(TPM_ALG_SHA256);
+            state.update(seed);
+            state.update(BE32(counter));
+            const Bytes block = state.finish();
+            out.insert(out.end(), block.begin(), block.end());
+        }
+        out.resize(length);
+        return out;
+    }
+
+    static const size_t BLOCK_SIZE = 64; ///< SHA1/SHA256 分组长度
+
+private:
+    TPM_ALG_ID m_alg;
+    SHA1Context *m_sha1;
+    SHA256Context *m_sha256;
+
+    // 禁止复制
+    HashState(const HashState&);
+    HashState& operator=(const HashState&);
+};
+
+typedef MockTPM::HashState HashState;
+
+// ============================================================================
+// 密钥模板解析
+// ============================================================================
+static const TPM_HANDLE FIRST_TRANSIENT_HANDLE = 0x80000000;
+static const TPM_HANDLE FIRST_HMAC_SESSION = 0x02000000;
+static const TPM_HANDLE FIRST_POLICY_SESSION = 0x03000000;
+static const size_t SESSION_COUNT_LIMIT = 64;
+static const size_t NV_INDEX_COUNT_LIMIT = 64;
+static const size_t NV_INDEX_SIZE_LIMIT = 2048;
+static const UINT32 OBJECT_ATTRIBUTE_SIGN = 1u << 18;
+static const UINT32 NV_ATTRIBUTE_WRITTEN = 1u << 29;
+static const uint8_t SESSION_ATTRIBUTE_CONTINUE = 0x01;
+
+static bool IsTransient(TPM_HANDLE handle) {
+    return (handle >> 24) == (FIRST_TRANSIENT_HANDLE >> 24);
+}
+
+static bool IsSession(TPM_HANDLE handle) {
+    return (handle >> 24) == (FIRST_HMAC_SESSION >> 24) || (handle >> 24) == (FIRST_POLICY_SESSION >> 24);
+}
+
+static bool IsNVIndex(TPM_HANDLE handle) {
+    return (handle >> 24) == 0x01;
+}
+
+static bool IsHierarchy(TPM_HANDLE handle) {
+    return TPM_RH_OWNER == handle || TPM_RH_ENDORSEMENT == handle || TPM_RH_PLATFORM == handle || TPM_RH_NULL == handle;
+}
+
+static UINT16 CurveBytes(TPM_ECC_CURVE curve) {
+    switch (curve) {
+    case TPM_ECC_NIST_P192:
+        return 24;
+    case TPM_ECC_NIST_P224:
+        return 28;
+    case TPM_ECC_NIST_P256:
+    case TPM_ECC_BN_P256:
+    case TPM_ECC_SM2_P256:
+        return 32;
+    case TPM_ECC_NIST_P384:
+        return 48;
+    case TPM_ECC_NIST_P521:
+        return 66;
+    case TPM_ECC_BN_P638:
+        return 80;
+    default:
+        return 0;
+    }
+}
+
+/// 读取 TPMT_SYM_DEF_OBJECT, 返回密钥长度(比特)
+static UINT16 ReadSymDef(Reader& r) {
+    TPM_ALG_ID alg = r.u16();
+    if (TPM_ALG_XOR == alg) {
+        r.u16(); // hashAlg
+        return 0;
+    }
+    if (TPM_ALG_NULL == alg) {
+        return 0;
+    }
+    UINT16 keyBits = r.u16();
+    r.u16(); // mode
+    return keyBits;
+}
+
+static bool IsECCSignScheme(TPM_ALG_ID scheme) {
+    return TPM_ALG_ECDSA == scheme || TPM_ALG_ECDAA == scheme || TPM_ALG_SM2 == scheme || TPM_ALG_ECSCHNORR == scheme;
+}
+
+static bool IsRSASignScheme(TPM_ALG_ID scheme) {
+    return TPM_ALG_RSASSA == scheme || TPM_ALG_RSAPSS == scheme;
+}
+
+/// 解析 TPMT_PUBLIC 并计算对象 Name, 返回 unique 字段在 publicArea 中的偏移
+///
+/// @param paramNo publicArea 所在的参数序号, 用于生成错误码
+static size_t ParsePublicArea(const Bytes& area, TPM_ALG_ID& type, TPM_ALG_ID& nameAlg, UINT32& attributes,
+        TPM_ALG_ID& schemeAlg, TPM_ALG_ID& schemeHash, UINT16& keyBytes, Bytes& unique, Bytes& name,
+        unsigned int paramNo) {
+    Reader r(area.data(), area.size(), RC_P(TPM_RC_INSUFFICIENT, paramNo));
+    Bytes authPolicy;
+    type = r.u16();
+    nameAlg = r.u16();
+    attributes = r.u32();
+    r.tpm2b(authPolicy);
+    schemeAlg = TPM_ALG_NULL;
+    schemeHash = TPM_ALG_NULL;
+    keyBytes = 0;
+    switch (type) {
+    case TPM_ALG_KEYEDHASH:
+        schemeAlg = r.u16();
+        if (TPM_ALG_HMAC == schemeAlg) {
+            schemeHash = r.u16();
+        } else if (TPM_ALG_XOR == schemeAlg) {
+            schemeHash = r.u16();
+            r.u16(); // kdf
+        } else if (TPM_ALG_NULL != schemeAlg) {
+            throw RC_P(TPM_RC_SCHEME, paramNo);
+        }
+        break;
+    case TPM_ALG_SYMCIPHER:
+        keyBytes = ReadSymDef(r) / 8;
+        break;
+    case TPM_ALG_RSA: {
+        ReadSymDef(r);
+        schemeAlg = r.u16();
+        if (TPM_ALG_NULL != schemeAlg && TPM_ALG_RSAES != schemeAlg) {
+            schemeHash = r.u16();
+        }
+        UINT16 keyBits = r.u16();
+        r.u32(); // exponent
+        if (keyBits < 512 || keyBits > 4096 || keyBits % 8 != 0) {
+            throw RC_P(TPM_RC_KEY_SIZE, paramNo);
+        }
+        keyBytes = keyBits / 8;
+        break;
+    }
+    case TPM_ALG_ECC:
+        ReadSymDef(r);
+        schemeAlg = r.u16();
+        if (TPM_ALG_NULL != schemeAlg) {
+            schemeHash = r.u16();
+            if (TPM_ALG_ECDAA == schemeAlg) {
+                r.u16(); // count
+            }
+        }
+        keyBytes = CurveBytes(r.u16());
+        if (0 == keyBytes) {
+            throw RC_P(TPM_RC_CURVE, paramNo);
+        }
+        if (TPM_ALG_NULL != r.u16()) { // kdf
+            r.u16();
+        }
+        break;
+    default:
+        throw RC_P(TPM_RC_TYPE, paramNo);
+    }
+    const size_t uniqueOffset = r.position();
+    Bytes ignored;
+    r.tpm2b(ignored);
+    if (TPM_ALG_ECC == type) {
+        r.tpm2b(ignored);
+    }
+    if (r.remaining() != 0) {
+        throw RC_P(TPM_RC_SIZE, paramNo);
+    }
+    if (!HashState::IsSupported(nameAlg)) {
+        throw RC_P(TPM_RC_HASH, paramNo);
+    }
+    unique.assign(area.begin() + uniqueOffset, area.end());
+    name = Concat(BE16(nameAlg), HashState::Digest(nameAlg, area));
+    return uniqueOffset;
+}
+
+static void ParsePublicArea(const Bytes& area, MockTPM::Object& object, unsigned int paramNo) {
+    ParsePublicArea(area, object.type, object.nameAlg, object.attributes, object.schemeAlg, object.schemeHash,
+            object.keyBytes, object.unique, object.name, paramNo);
+    object.publicArea = area;
+}
+
+/// 限定名 QN = nameAlg || H(parentQN || name)
+static Bytes QualifiedName(TPM_ALG_ID nameAlg, const Bytes& parentQualifiedName, const Bytes& name) {
+    return Concat(BE16(nameAlg), HashState::Digest(nameAlg, Concat(parentQualifiedName, name)));
+}
+
+/// 模拟的非对称运算结果: 由公钥数据和输入数据派生出的确定性字节串
+static Bytes MockAsymmetric(const MockTPM::Object& key, const Bytes& input, const char *label, size_t length) {
+    Bytes seed = Concat(key.unique, input);
+    seed = Concat(seed, Label(label));
+    return HashState::MGF(seed, length);
+}
+
+// ============================================================================
+// 构造与配置
+// ============================================================================
+MockTPM::Object::Object()
+        : hierarchy(TPM_RH_NULL), type(TPM_ALG_NULL), nameAlg(TPM_ALG_NULL), attributes(0),
+          schemeAlg(TPM_ALG_NULL), schemeHash(TPM_ALG_NULL), keyBytes(0), isSequence(false),
+          sequenceHashAlg(TPM_ALG_NULL) {
+}
+
+MockTPM::MockTPM(unsigned int maxLoadedObjects, uint64_t seed)
+        : m_maxLoadedObjects(maxLoadedObjects), m_contextSequence(1) {
+    configRandomSeed(seed);
+}
+
+MockTPM::~MockTPM() {
+}
+
+void MockTPM::configMaxLoadedObjects(unsigned int maxLoadedObjects) {
+    m_maxLoadedObjects = maxLoadedObjects;
+}
+
+void MockTPM::configRandomSeed(uint64_t seed) {
+    m_rng.seed(seed);
+    m_primarySeed = randomBytes(32);
+}
+
+void MockTPM::reset() {
+    m_objects.clear();
+    m_sessions.clear();
+}
+
+unsigned int MockTPM::loadedObjectCount() const {
+    return (unsigned int) m_objects.size();
+}
+
+unsigned int MockTPM::sessionCount() const {
+    return (unsigned int) m_sessions.size();
+}
+
+TPM_CC MockTPM::CommandCodeOf(const uint8_t *command, size_t commandSize) {
+    if (!command || commandSize < 10) {
+        return 0;
+    }
+    return ((TPM_CC) command[6] << 24) | ((TPM_CC) command[7] << 16) | ((TPM_CC) command[8] << 8) | command[9];
+}
+
+std::vector<uint8_t> MockTPM::randomBytes(size_t length) {
+    Bytes out(length);
+    for (size_t i = 0; i < length; i += 8) {
+        uint64_t value = m_rng();
+        for (size_t j = 0; j < 8 && i + j < length; j++) {
+            out[i + j] = (uint8_t) (value >> (8 * j));
+        }
+    }
+    return out;
+}
+
+// ============================================================================
+// 命令分派
+// ============================================================================
+const MockTPM::CommandInfo *MockTPM::FindCommand(TPM_CC commandCode) {
+    static const CommandInfo table[] = {
+        {TPM_CC_Startup, 0, 0, &MockTPM::startup},
+        {TPM_CC_Shutdown, 0, 0, &MockTPM::shutdown},
+        {TPM_CC_GetTestResult, 0, 0, &MockTPM::getTestResult},
+        {TPM_CC_Hash, 0, 0, &MockTPM::hash},
+        {TPM_CC_HMAC, 1, 1, &MockTPM::hmac},
+        {TPM_CC_HMAC_Start, 1, 1, &MockTPM::hmacStart},
+        {TPM_CC_HashSequenceStart, 0, 0, &MockTPM::hashSequenceStart},
+        {TPM_CC_SequenceUpdate, 1, 1, &MockTPM::sequenceUpdate},
+        {TPM_CC_SequenceComplete, 1, 1, &MockTPM::sequenceComplete},
+        {TPM_CC_StartAuthSession, 2, 0, &MockTPM::startAuthSession},
+        {TPM_CC_FlushContext, 0, 0, &MockTPM::flushContext},
+        {TPM_CC_ContextSave, 1, 0, &MockTPM::contextSave},
+        {TPM_CC_ContextLoad, 0, 0, &MockTPM::contextLoad},
+        {TPM_CC_CreatePrimary, 1, 1, &MockTPM::createPrimary},
+        {TPM_CC_Create, 1, 1, &MockTPM::create},
+        {TPM_CC_Load, 1, 1, &MockTPM::load},
+        {TPM_CC_LoadExternal, 0, 0, &MockTPM::loadExternal},
+        {TPM_CC_ReadPublic, 1, 0, &MockTPM::readPublic},
+        {TPM_CC_RSA_Encrypt, 1, 0, &MockTPM::rsaEncrypt},
+        {TPM_CC_RSA_Decrypt, 1, 1, &MockTPM::rsaDecrypt},
+        {TPM_CC_Sign, 1, 1, &MockTPM::sign},
+        {TPM_CC_VerifySignature, 1, 0, &MockTPM::verifySignature},
+        {TPM_CC_NV_DefineSpace, 1, 1, &MockTPM::nvDefineSpace},
+        {TPM_CC_NV_UndefineSpace, 2, 1, &MockTPM::nvUndefineSpace},
+        {TPM_CC_NV_ReadPublic, 1, 0, &MockTPM::nvReadPublic},
+        {TPM_CC_NV_Write, 2, 1, &MockTPM::nvWrite},
+        {TPM_CC_NV_Read, 2, 1, &MockTPM::nvRead},
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (table[i].commandCode == commandCode) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+size_t MockTPM::execute(const uint8_t *command, size_t commandSize, uint8_t *response, size_t capacity) {
+    Request request;
+    Response rsp;
+    TPM_RC rc = TPM_RC_SUCCESS;
+    try {
+        Reader header(command, command ? commandSize : 0, RC(TPM_RC_COMMAND_SIZE));
+        request.tag = header.u16();
+        const uint32_t size = header.u32();
+        request.commandCode = header.u32();
+        if (TPM_ST_SESSIONS != request.tag && TPM_ST_NO_SESSIONS != request.tag) {
+            throw RC(TPM_RC_BAD_TAG);
+        }
+        if (size != commandSize) {
+            throw RC(TPM_RC_COMMAND_SIZE);
+        }
+        const CommandInfo *info = FindCommand(request.commandCode);
+        if (!info) {
+            throw RC(TPM_RC_COMMAND_CODE);
+        }
+        for (unsigned int i = 0; i < info->handleCount; i++) {
+            request.handles.push_back(header.u32());
+        }
+        if (TPM_ST_SESSIONS == request.tag) {
+            const uint32_t authSize = header.u32();
+            if (authSize > header.remaining()) {
+                throw RC(TPM_RC_AUTHSIZE);
+            }
+            Reader auths(header.current(), authSize, RC(TPM_RC_AUTHSIZE));
+            while (auths.remaining() > 0) {
+                Request::Auth auth;
+                auth.sessionHandle = auths.u32();
+                auths.tpm2b(auth.nonce);
+                auth.attributes = auths.u8();
+                auths.tpm2b(auth.hmac);
+                request.auths.push_back(auth);
+            }
+            if (request.auths.empty() || request.auths.size() > 3) {
+                throw RC(TPM_RC_AUTHSIZE);
+            }
+            header.skip(authSize);
+        }
+        if (request.auths.size() < info->authHandleCount) {
+            throw RC(TPM_RC_AUTH_MISSING);
+        }
+        request.params = Reader(header.current(), header.remaining(), RC_P(TPM_RC_INSUFFICIENT, 1));
+        checkAuthorizations(request);
+        (this->*info->handler)(request, rsp);
+    } catch (TPM_RC e) {
+        rc = e;
+    } catch (...) {
+        rc = TPM_RC_FAILURE;
+    }
+
+    Writer out;
+    if (TPM_RC_SUCCESS != rc) {
+        out.u16(TPM_ST_NO_SESSIONS);
+        out.u32(10);
+        out.u32(rc);
+    } else {
+        out.u16(request.tag);
+        out.u32(0); // 稍后回填
+        out.u32(TPM_RC_SUCCESS);
+        for (size_t i = 0; i < rsp.handles.size(); i++) {
+            out.u32(rsp.handles[i]);
+        }
+        const Bytes& params = rsp.params.data();
+        if (TPM_ST_SESSIONS == request.tag) {
+            out.u32((uint32_t) params.size());
+        }
+        out.bytes(params);
+        for (size_t i = 0; i < request.auths.size(); i++) {
+            const Request::Auth& auth = request.auths[i];
+            const bool continueSession = (auth.attributes & SESSION_ATTRIBUTE_CONTINUE) != 0;
+            std::map<TPM_HANDLE, Session>::iterator it = m_sessions.find(auth.sessionHandle);
+            if (it == m_sessions.end()) { // 口令会话(或本条命令刚刚清除的会话)
+                out.tpm2b(Bytes());
+            } else {
+                out.tpm2b(randomBytes(HashState::DigestSize(it->second.authHash)));
+                if (!continueSession) {
+                    m_sessions.erase(it);
+                }
+            }
+            out.u8(auth.attributes & SESSION_ATTRIBUTE_CONTINUE);
+            out.tpm2b(Bytes());
+        }
+    }
+    Bytes& frame = out.data();
+    if (frame.size() > capacity) { // 缓冲区不足时只能返回错误码
+        Writer error;
+        error.u16(TPM_ST_NO_SESSIONS);
+        error.u32(10);
+        error.u32(TPM_RC_FAILURE);
+        frame = error.data();
+        if (frame.size() > capacity) {
+            return 0;
+        }
+    }
+    const uint32_t frameSize = (uint32_t) frame.size();
+    frame[2] = (uint8_t) (frameSize >> 24);
+    frame[3] = (uint8_t) (frameSize >> 16);
+    frame[4] = (uint8_t) (frameSize >> 8);
+    frame[5] = (uint8_t) frameSize;
+    memcpy(response, frame.data(), frame.size());
+    return frame.size();
+}
+
+// ============================================================================
+// 授权与对象管理
+// ============================================================================
+/// 比较口令时忽略末尾的 0 (TPM 规范规定 authValue 末尾的 0 不参与比较)
+static bool SameAuthValue(Bytes a, Bytes b) {
+    while (!a.empty() && 0 == a.back()) {
+        a.pop_back();
+    }
+    while (!b.empty() && 0 == b.back()) {
+        b.pop_back();
+    }
+    return a == b;
+}
+
+void MockTPM::checkAuthorizations(Request& request) {
+    for (size_t i = 0; i < request.auths.size(); i++) {
+        const Request::Auth& auth = request.auths[i];
+        const unsigned int sessionNo = (unsigned int) i + 1;
+        if (TPM_RS_PW == auth.sessionHandle) {
+            if (i >= request.handles.size() || i >= FindCommand(request.commandCode)->authHandleCount) {
+                throw RC_S(TPM_RC_VALUE, sessionNo); // 口令会话只能用于授权句柄
+            }
+            if (!SameAuthValue(auth.hmac, authValueOf(request.handles[i]))) {
+                throw RC_S(TPM_RC_AUTH_FAIL, sessionNo);
+            }
+        } else if (m_sessions.find(auth.sessionHandle) == m_sessions.end()) {
+            throw RC_S(TPM_RC_HANDLE, sessionNo);
+        }
+    }
+}
+
+const std::vector<uint8_t>& MockTPM::authValueOf(TPM_HANDLE handle) {
+    static const Bytes empty;
+    if (IsTransient(handle)) {
+        std::map<TPM_HANDLE, Object>::const_iterator it = m_objects.find(handle);
+        if (it == m_objects.end()) {
+            throw RC_H(TPM_RC_HANDLE, 1);
+        }
+        return it->second.authValue;
+    }
+    if (IsNVIndex(handle)) {
+        std::map<TPM_HANDLE, NVIndex>::const_iterator it = m_nvIndexes.find(handle);
+        if (it == m_nvIndexes.end()) {
+            throw RC_H(TPM_RC_HANDLE, 1);
+        }
+        return it->second.authValue;
+    }
+    return empty; // 层级句柄的授权值总是为空
+}
+
+MockTPM::Object& MockTPM::findObject(TPM_HANDLE handle, TPM_RC errorLocation) {
+    std::map<TPM_HANDLE, Object>::iterator it = m_objects.find(handle);
+    if (it == m_objects.end()) {
+        throw RC(TPM_RC_HANDLE + errorLocation);
+    }
+    return it->second;
+}
+
+TPM_HANDLE MockTPM::addObject(const Object& object) {
+    if (m_objects.size() >= m_maxLoadedObjects) {
+        throw RC(TPM_RC_OBJECT_MEMORY);
+    }
+    TPM_HANDLE handle = FIRST_TRANSIENT_HANDLE;
+    while (m_objects.find(handle) != m_objects.end()) {
+        handle++;
+    }
+    m_objects[handle] = object;
+    return handle;
+}
+
+void MockTPM::buildObject(Object& object, const std::vector<uint8_t>& inPublic,
+        const std::vector<uint8_t>& sensitiveData, const std::vector<uint8_t>& seed, bool generateSecret) {
+    const size_t uniqueOffset = ParsePublicArea(inPublic, object.type, object.nameAlg, object.attributes,
+            object.schemeAlg, object.schemeHash, object.keyBytes, object.unique, object.name, 2);
+    if (generateSecret) {
+        size_t length;
+        switch (object.type) {
+        case TPM_ALG_KEYEDHASH:
+            length = HashState::DigestSize(TPM_ALG_NULL != object.schemeHash ? object.schemeHash : object.nameAlg);
+            break;
+        case TPM_ALG_SYMCIPHER:
+            length = object.keyBytes;
+            break;
+        default:
+            length = 32;
+            break;
+        }
+        if (TPM_ALG_KEYEDHASH == object.type && !sensitiveData.empty()) {
+            object.secret = sensitiveData; // 用户提供的 HMAC 密钥或封装数据
+        } else if (!seed.empty()) {
+            object.secret = HashState::MGF(Concat(seed, Label("secret")), length);
+        } else {
+            object.secret = randomBytes(length);
+        }
+    }
+
+    Writer unique;
+    if (TPM_ALG_RSA == object.type) {
+        Bytes modulus = HashState::MGF(Concat(object.secret, Label("rsa")), object.keyBytes);
+        modulus[0] |= 0x80;
+        unique.tpm2b(modulus);
+    } else if (TPM_ALG_ECC == object.type) {
+        unique.tpm2b(HashState::MGF(Concat(object.secret, Label("x")), object.keyBytes));
+        unique.tpm2b(HashState::MGF(Concat(object.secret, Label("y")), object.keyBytes));
+    } else {
+        unique.tpm2b(HashState::Digest(object.nameAlg, object.secret));
+    }
+    Bytes publicArea(inPublic.begin(), inPublic.begin() + uniqueOffset);
+    publicArea = Concat(publicArea, unique.data());
+    ParsePublicArea(publicArea, object, 2);
+}
+
+void MockTPM::marshalCreationData(Response& response, const Object& object, const std::vector<uint8_t>& parentName,
+        const std::vector<uint8_t>& outsideInfo, TPMI_RH_HIERARCHY hierarchy) {
+    Writer creationData;
+    creationData.u32(0); // pcrSelect.count
+    creationData.tpm2b(Bytes()); // pcrDigest
+    creationData.u8(1); // locality
+    const bool isPrimary = parentName.size() == sizeof(TPM_HANDLE);
+    creationData.u16(isPrimary ? TPM_ALG_NULL : (TPM_ALG_ID) ((parentName[0] << 8) | parentName[1]));
+    creationData.tpm2b(parentName);
+    creationData.tpm2b(parentName); // parentQualifiedName, 模拟器不区分
+    creationData.tpm2b(outsideInfo);
+    const Bytes creationHash = HashState::Digest(object.nameAlg, creationData.data());
+
+    response.params.tpm2b(creationData.data());
+    response.params.tpm2b(creationHash);
+    response.params.u16(TPM_ST_CREATION);
+    response.params.u32(hierarchy);
+    if (TPM_RH_NULL == hierarchy) {
+        response.params.tpm2b(Bytes());
+    } else {
+        response.params.tpm2b(HashState::HMAC(TPM_ALG_SHA256, m_primarySeed, Concat(creationHash, object.name)));
+    }
+}
+
+// ============================================================================
+// 启动与自检
+// ============================================================================
+void MockTPM::startup(Request& request, Response& response) {
+    request.params.u16(); // startupType
+}
+
+void MockTPM::shutdown(Request& request, Response& response) {
+    request.params.u16(); // shutdownType
+}
+
+void MockTPM::getTestResult(Request& request, Response& response) {
+    response.params.tpm2b(Bytes()); // outData
+    response.params.u32(TPM_RC_SUCCESS); // testResult
+}
+
+// ============================================================================
+// 哈希与 HMAC
+// ============================================================================
+/// 生成 TPMT_TK_HASHCHECK 票据
+static void MarshalHashCheck(Writer& out, TPMI_RH_HIERARCHY hierarchy, const Bytes& digest, const Bytes& proof) {
+    out.u16(TPM_ST_HASHCHECK);
+    out.u32(hierarchy);
+    if (TPM_RH_NULL == hierarchy) {
+        out.tpm2b(Bytes());
+    } else {
+        out.tpm2b(HashState::HMAC(TPM_ALG_SHA256, proof, digest));
+    }
+}
+
+void MockTPM::hash(Request& request, Response& response) {
+    Bytes data;
+    request.params.tpm2b(data, MAX_DIGEST_BUFFER);
+    const TPM_ALG_ID hashAlg = request.params.u16();
+    const TPMI_RH_HIERARCHY hierarchy = request.params.u32();
+    if (!HashState::IsSupported(hashAlg)) {
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    if (!IsHierarchy(hierarchy)) {
+        throw RC_P(TPM_RC_VALUE, 3);
+    }
+    const Bytes digest = HashState::Digest(hashAlg, data);
+    response.params.tpm2b(digest);
+    MarshalHashCheck(response.params, hierarchy, digest, m_primarySeed);
+}
+
+void MockTPM::hmac(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (key.isSequence || TPM_ALG_KEYEDHASH != key.type) {
+        throw RC_H(TPM_RC_TYPE, 1);
+    }
+    Bytes buffer;
+    request.params.tpm2b(buffer, MAX_DIGEST_BUFFER);
+    TPM_ALG_ID hashAlg = request.params.u16();
+    if (TPM_ALG_NULL == hashAlg) {
+        hashAlg = key.schemeHash;
+    }
+    if (!HashState::IsSupported(hashAlg)) {
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    response.params.tpm2b(HashState::HMAC(hashAlg, key.secret, buffer));
+}
+
+void MockTPM::hmacStart(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (key.isSequence || TPM_ALG_KEYEDHASH != key.type) {
+        throw RC_H(TPM_RC_TYPE, 1);
+    }
+    Object sequence;
+    request.params.tpm2b(sequence.authValue, sizeof(TPMU_HA));
+    TPM_ALG_ID hashAlg = request.params.u16();
+    if (TPM_ALG_NULL == hashAlg) {
+        hashAlg = key.schemeHash;
+    }
+    if (!HashState::IsSupported(hashAlg)) {
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    sequence.isSequence = true;
+    sequence.sequenceHashAlg = hashAlg;
+    sequence.hmacKey = HashState::PadKey(hashAlg, key.secret);
+    sequence.sequenceHash.reset(new HashState(hashAlg));
+    sequence.sequenceHash->update(HashState::XorPad(sequence.hmacKey, 0x36));
+    response.handles.push_back(addObject(sequence));
+}
+
+void MockTPM::hashSequenceStart(Request& request, Response& response) {
+    Object sequence;
+    request.params.tpm2b(sequence.authValue, sizeof(TPMU_HA));
+    const TPM_ALG_ID hashAlg = request.params.u16();
+    if (!HashState::IsSupported(hashAlg)) { // 包括 TPM_ALG_NULL 表示的事件序列, 模拟器不支持
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    sequence.isSequence = true;
+    sequence.sequenceHashAlg = hashAlg;
+    sequence.sequenceHash.reset(new HashState(hashAlg));
+    response.handles.push_back(addObject(sequence));
+}
+
+void MockTPM::sequenceUpdate(Request& request, Response& response) {
+    Object& sequence = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (!sequence.isSequence) {
+        throw RC_H(TPM_RC_MODE, 1);
+    }
+    Bytes buffer;
+    request.params.tpm2b(buffer, MAX_DIGEST_BUFFER);
+    sequence.sequenceHash->update(buffer);
+}
+
+void MockTPM::sequenceComplete(Request& request, Response& response) {
+    Object& sequence = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (!sequence.isSequence) {
+        throw RC_H(TPM_RC_MODE, 1);
+    }
+    Bytes buffer;
+    request.params.tpm2b(buffer, MAX_DIGEST_BUFFER);
+    TPMI_RH_HIERARCHY hierarchy = request.params.u32();
+    if (!IsHierarchy(hierarchy)) {
+        throw RC_P(TPM_RC_VALUE, 2);
+    }
+    sequence.sequenceHash->update(buffer);
+    Bytes result = sequence.sequenceHash->finish();
+    if (!sequence.hmacKey.empty()) {
+        HashState outer(sequence.sequenceHashAlg);
+        outer.update(HashState::XorPad(sequence.hmacKey, 0x5C));
+        outer.update(result);
+        result = outer.finish();
+        hierarchy = TPM_RH_NULL; // HMAC 序列不生成票据
+    }
+    m_objects.erase(request.handles[0]);
+    response.params.tpm2b(result);
+    MarshalHashCheck(response.params, hierarchy, result, m_primarySeed);
+}
+
+// ============================================================================
+// 会话与上下文
+// ============================================================================
+void MockTPM::startAuthSession(Request& request, Response& response) {
+    Reader& r = request.params;
+    Bytes nonceCaller;
+    Bytes encryptedSalt;
+    r.tpm2b(nonceCaller, sizeof(TPMU_HA));
+    r.tpm2b(encryptedSalt);
+    Session session;
+    session.sessionType = r.u8();
+    ReadSymDef(r);
+    session.authHash = r.u16();
+    if (TPM_SE_HMAC != session.sessionType && TPM_SE_POLICY != session.sessionType
+            && TPM_SE_TRIAL != session.sessionType) {
+        throw RC_P(TPM_RC_VALUE, 3);
+    }
+    if (0 == HashState::DigestSize(session.authHash)) {
+        throw RC_P(TPM_RC_HASH, 5);
+    }
+    if (m_sessions.size() >= SESSION_COUNT_LIMIT) {
+        throw RC(TPM_RC_SESSION_MEMORY);
+    }
+    TPM_HANDLE handle = (TPM_SE_HMAC == session.sessionType) ? FIRST_HMAC_SESSION : FIRST_POLICY_SESSION;
+    while (m_sessions.find(handle) != m_sessions.end()) {
+        handle++;
+    }
+    m_sessions[handle] = session;
+    response.handles.push_back(handle);
+    response.params.tpm2b(randomBytes(HashState::DigestSize(session.authHash))); // nonceTPM
+}
+
+void MockTPM::flushContext(Request& request, Response& response) {
+    const TPM_HANDLE handle = request.params.u32();
+    if (IsTransient(handle) && m_objects.erase(handle)) {
+        return;
+    }
+    if (IsSession(handle) && m_sessions.erase(handle)) {
+        return;
+    }
+    throw RC_P(TPM_RC_HANDLE, 1);
+}
+
+static const char CONTEXT_MAGIC[] = "MCTX";
+static const uint8_t CONTEXT_KIND_OBJECT = 1;
+static const uint8_t CONTEXT_KIND_SESSION = 2;
+static const size_t INTEGRITY_SIZE = 8;
+
+/// 在数据末尾附加完整性校验值
+static Bytes Seal(const Bytes& proof, const Bytes& data, const Bytes& boundTo) {
+    Bytes mac = HashState::HMAC(TPM_ALG_SHA256, proof, Concat(boundTo, data));
+    mac.resize(INTEGRITY_SIZE);
+    return Concat(data, mac);
+}
+
+/// 校验并去除数据末尾的完整性校验值
+static bool Unseal(const Bytes& proof, const Bytes& sealed, const Bytes& boundTo, Bytes& data) {
+    if (sealed.size() < INTEGRITY_SIZE) {
+        return false;
+    }
+    data.assign(sealed.begin(), sealed.end() - INTEGRITY_SIZE);
+    return Seal(proof, data, boundTo) == sealed;
+}
+
+void MockTPM::contextSave(Request& request, Response& response) {
+    const TPM_HANDLE handle = request.handles[0];
+    Writer blob;
+    blob.bytes(CONTEXT_MAGIC, 4);
+    TPM_HANDLE savedHandle;
+    TPMI_RH_HIERARCHY hierarchy;
+    if (IsTransient(handle)) {
+        const Object& object = findObject(handle, TPM_RC_H + TPM_RC_1);
+        if (object.isSequence) {
+            throw RC_H(TPM_RC_TYPE, 1); // 模拟器无法保存哈希中间状态
+        }
+        blob.u8(CONTEXT_KIND_OBJECT);
+        blob.u32(object.hierarchy);
+        blob.tpm2b(object.publicArea);
+        blob.tpm2b(object.secret);
+        blob.tpm2b(object.authValue);
+        blob.tpm2b(object.qualifiedName);
+        savedHandle = FIRST_TRANSIENT_HANDLE;
+        hierarchy = object.hierarchy;
+    } else if (IsSession(handle) && m_sessions.find(handle) != m_sessions.end()) {
+        const Session& session = m_sessions[handle];
+        blob.u8(CONTEXT_KIND_SESSION);
+        blob.u32(handle);
+        blob.u8(session.sessionType);
+        blob.u16(session.authHash);
+        m_sessions.erase(handle); // 会话上下文只能加载一次, 简化为保存时移出
+        savedHandle = handle;
+        hierarchy = TPM_RH_NULL;
+    } else {
+        throw RC_H(TPM_RC_HANDLE, 1);
+    }
+    response.params.u64(m_contextSequence++);
+    response.params.u32(savedHandle);
+    response.params.u32(hierarchy);
+    response.params.tpm2b(Seal(m_primarySeed, blob.data(), Bytes()));
+}
+
+void MockTPM::contextLoad(Request& request, Response& response) {
+    Reader& r = request.params;
+    r.u64(); // sequence
+    r.u32(); // savedHandle
+    r.u32(); // hierarchy
+    Bytes sealed;
+    r.tpm2b(sealed, MAX_CONTEXT_SIZE);
+    Bytes blob;
+    if (!Unseal(m_primarySeed, sealed, Bytes(), blob) || blob.size() < 5 || memcmp(blob.data(), CONTEXT_MAGIC, 4)) {
+        throw RC_P(TPM_RC_INTEGRITY, 1);
+    }
+    Reader b(blob.data() + 5, blob.size() - 5, RC_P(TPM_RC_INTEGRITY, 1));
+    if (CONTEXT_KIND_OBJECT == blob[4]) {
+        Object object;
+        object.hierarchy = b.u32();
+        Bytes publicArea;
+        b.tpm2b(publicArea);
+        b.tpm2b(object.secret);
+        b.tpm2b(object.authValue);
+        b.tpm2b(object.qualifiedName);
+        ParsePublicArea(publicArea, object, 1);
+        response.handles.push_back(addObject(object));
+    } else if (CONTEXT_KIND_SESSION == blob[4]) {
+        const TPM_HANDLE handle = b.u32();
+        Session session;
+        session.sessionType = b.u8();
+        session.authHash = b.u16();
+        if (m_sessions.find(handle) != m_sessions.end()) {
+            throw RC_P(TPM_RC_HANDLE, 1);
+        }
+        if (m_sessions.size() >= SESSION_COUNT_LIMIT) {
+            throw RC(TPM_RC_SESSION_MEMORY);
+        }
+        m_sessions[handle] = session;
+        response.handles.push_back(handle);
+    } else {
+        throw RC_P(TPM_RC_INTEGRITY, 1);
+    }
+}
+
+// ============================================================================
+// 对象创建与加载
+// ============================================================================
+/// 读取 TPM2B_SENSITIVE_CREATE, TPM2B_PUBLIC, TPM2B_DATA outsideInfo, TPML_PCR_SELECTION creationPCR
+static void ReadCreateParams(Reader& r, Bytes& userAuth, Bytes& data, Bytes& inPublic, Bytes& outsideInfo) {
+    Reader sensitive = r.sub();
+    sensitive.tpm2b(userAuth, sizeof(TPMU_HA));
+    sensitive.tpm2b(data, MAX_SYM_DATA);
+    r.tpm2b(inPublic);
+    if (inPublic.empty()) {
+        throw RC_P(TPM_RC_SIZE, 2);
+    }
+    r.tpm2b(outsideInfo);
+    const uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; i++) {
+        r.u16(); // hash
+        Bytes select;
+        r.bytes(select, r.u8());
+    }
+}
+
+void MockTPM::createPrimary(Request& request, Response& response) {
+    const TPMI_RH_HIERARCHY hierarchy = request.handles[0];
+    if (!IsHierarchy(hierarchy)) {
+        throw RC_H(TPM_RC_VALUE, 1);
+    }
+    Bytes userAuth, data, inPublic, outsideInfo;
+    ReadCreateParams(request.params, userAuth, data, inPublic, outsideInfo);
+
+    // 主密钥由层级种子和模板确定性地派生
+    Bytes seedInput = Concat(BE32(hierarchy), inPublic);
+    seedInput = Concat(seedInput, data);
+    const Bytes seed = HashState::HMAC(TPM_ALG_SHA256, m_primarySeed, seedInput);
+
+    Object object;
+    object.hierarchy = hierarchy;
+    object.authValue = userAuth;
+    buildObject(object, inPublic, data, seed, true);
+    const Bytes parentName = BE32(hierarchy);
+    object.qualifiedName = QualifiedName(object.nameAlg, parentName, object.name);
+    const TPM_HANDLE handle = addObject(object);
+
+    response.handles.push_back(handle);
+    response.params.tpm2b(object.publicArea);
+    marshalCreationData(response, object, parentName, outsideInfo, hierarchy);
+    response.params.tpm2b(object.name);
+}
+
+static const char PRIVATE_MAGIC[] = "MPRV";
+
+void MockTPM::create(Request& request, Response& response) {
+    const Object& parent = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (parent.isSequence) {
+        throw RC_H(TPM_RC_TYPE, 1);
+    }
+    Bytes userAuth, data, inPublic, outsideInfo;
+    ReadCreateParams(request.params, userAuth, data, inPublic, outsideInfo);
+
+    Object object;
+    object.hierarchy = parent.hierarchy;
+    object.authValue = userAuth;
+    buildObject(object, inPublic, data, Bytes(), true);
+
+    Writer sensitive;
+    sensitive.bytes(PRIVATE_MAGIC, 4);
+    sensitive.tpm2b(object.secret);
+    sensitive.tpm2b(object.authValue);
+    const Bytes outPrivate = Seal(m_primarySeed, sensitive.data(), Concat(parent.name, object.publicArea));
+
+    response.params.tpm2b(outPrivate);
+    response.params.tpm2b(object.publicArea);
+    marshalCreationData(response, object, parent.name, outsideInfo, parent.hierarchy);
+}
+
+void MockTPM::load(Request& request, Response& response) {
+    const Object& parent = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (parent.isSequence) {
+        throw RC_H(TPM_RC_TYPE, 1);
+    }
+    Bytes inPrivate, inPublic;
+    request.params.tpm2b(inPrivate);
+    request.params.tpm2b(inPublic);
+
+    Object object;
+    ParsePublicArea(inPublic, object, 2);
+    Bytes sensitive;
+    if (!Unseal(m_primarySeed, inPrivate, Concat(parent.name, inPublic), sensitive)
+            || sensitive.size() < 4 || memcmp(sensitive.data(), PRIVATE_MAGIC, 4)) {
+        throw RC_P(TPM_RC_INTEGRITY, 1);
+    }
+    Reader s(sensitive.data() + 4, sensitive.size() - 4, RC_P(TPM_RC_INTEGRITY, 1));
+    s.tpm2b(object.secret);
+    s.tpm2b(object.authValue);
+    object.hierarchy = parent.hierarchy;
+    object.qualifiedName = QualifiedName(object.nameAlg, parent.qualifiedName, object.name);
+
+    response.handles.push_back(addObject(object));
+    response.params.tpm2b(object.name);
+}
+
+void MockTPM::loadExternal(Request& request, Response& response) {
+    Reader& r = request.params;
+    Object object;
+    Reader sensitive = r.sub();
+    if (sensitive.remaining() > 0) { // 长度为 0 表示只加载公钥
+        Bytes seedValue;
+        sensitive.u16(); // sensitiveType
+        sensitive.tpm2b(object.authValue, sizeof(TPMU_HA));
+        sensitive.tpm2b(seedValue);
+        sensitive.tpm2b(object.secret);
+    }
+    Bytes inPublic;
+    r.tpm2b(inPublic);
+    object.hierarchy = r.u32();
+    if (!IsHierarchy(object.hierarchy)) {
+        throw RC_P(TPM_RC_VALUE, 3);
+    }
+    ParsePublicArea(inPublic, object, 2);
+    object.qualifiedName = QualifiedName(object.nameAlg, BE32(object.hierarchy), object.name);
+
+    response.handles.push_back(addObject(object));
+    response.params.tpm2b(object.name);
+}
+
+void MockTPM::readPublic(Request& request, Response& response) {
+    const Object& object = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (object.isSequence) {
+        throw RC(TPM_RC_SEQUENCE);
+    }
+    response.params.tpm2b(object.publicArea);
+    response.params.tpm2b(object.name);
+    response.params.tpm2b(object.qualifiedName);
+}
+
+// ============================================================================
+// RSA 加解密
+// ============================================================================
+/// 读取 TPMT_RSA_DECRYPT 加密方案
+static TPM_ALG_ID ReadRSADecryptScheme(Reader& r) {
+    TPM_ALG_ID scheme = r.u16();
+    if (TPM_ALG_NULL != scheme && TPM_ALG_RSAES != scheme) {
+        r.u16(); // hashAlg
+    }
+    return scheme;
+}
+
+/// 加解密共用的掩码, 加密与解密互为逆运算
+static Bytes RSAMask(const MockTPM::Object& key, const Bytes& label) {
+    return MockAsymmetric(key, label, "enc", key.keyBytes);
+}
+
+void MockTPM::rsaEncrypt(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (TPM_ALG_RSA != key.type) {
+        throw RC_H(TPM_RC_KEY, 1);
+    }
+    Bytes message, label;
+    request.params.tpm2b(message);
+    ReadRSADecryptScheme(request.params);
+    request.params.tpm2b(label);
+    if (message.size() + 2 > key.keyBytes) {
+        throw RC_P(TPM_RC_VALUE, 1);
+    }
+    Bytes block = Concat(BE16((uint16_t) message.size()), message);
+    block.resize(key.keyBytes, 0);
+    const Bytes mask = RSAMask(key, label);
+    for (size_t i = 0; i < block.size(); i++) {
+        block[i] ^= mask[i];
+    }
+    response.params.tpm2b(block);
+}
+
+void MockTPM::rsaDecrypt(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (TPM_ALG_RSA != key.type) {
+        throw RC_H(TPM_RC_KEY, 1);
+    }
+    Bytes block, label;
+    request.params.tpm2b(block);
+    ReadRSADecryptScheme(request.params);
+    request.params.tpm2b(label);
+    if (block.size() != key.keyBytes) {
+        throw RC_P(TPM_RC_SIZE, 1);
+    }
+    const Bytes mask = RSAMask(key, label);
+    for (size_t i = 0; i < block.size(); i++) {
+        block[i] ^= mask[i];
+    }
+    const size_t length = (block[0] << 8) | block[1];
+    if (length + 2 > block.size()) {
+        throw RC_P(TPM_RC_VALUE, 1);
+    }
+    response.params.tpm2b(Bytes(block.begin() + 2, block.begin() + 2 + length));
+}
+
+// ============================================================================
+// 签名与验签
+// ============================================================================
+/// 按签名方案生成 TPMT_SIGNATURE
+static void MarshalSignature(Writer& out, const MockTPM::Object& key, TPM_ALG_ID scheme, TPM_ALG_ID hashAlg,
+        const Bytes& digest) {
+    Bytes input = Concat(BE16(scheme), BE16(hashAlg));
+    input = Concat(input, digest);
+    out.u16(scheme);
+    out.u16(hashAlg);
+    if (TPM_ALG_HMAC == scheme) {
+        out.bytes(HashState::HMAC(hashAlg, key.secret, digest)); // TPMT_HA, 没有长度前缀
+    } else if (IsRSASignScheme(scheme)) {
+        out.tpm2b(MockAsymmetric(key, input, "sig", key.keyBytes));
+    } else {
+        out.tpm2b(MockAsymmetric(key, input, "r", key.keyBytes));
+        out.tpm2b(MockAsymmetric(key, input, "s", key.keyBytes));
+    }
+}
+
+/// 检查签名方案与密钥类型是否匹配
+static bool SchemeMatchesKey(const MockTPM::Object& key, TPM_ALG_ID scheme) {
+    switch (key.type) {
+    case TPM_ALG_KEYEDHASH:
+        return TPM_ALG_HMAC == scheme;
+    case TPM_ALG_RSA:
+        return IsRSASignScheme(scheme);
+    case TPM_ALG_ECC:
+        return IsECCSignScheme(scheme);
+    default:
+        return false;
+    }
+}
+
+void MockTPM::sign(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (key.isSequence || !(key.attributes & OBJECT_ATTRIBUTE_SIGN)) {
+        throw RC_H(TPM_RC_KEY, 1);
+    }
+    Reader& r = request.params;
+    Bytes digest;
+    r.tpm2b(digest, sizeof(TPMU_HA));
+    TPM_ALG_ID scheme = r.u16();
+    TPM_ALG_ID hashAlg = TPM_ALG_NULL;
+    if (TPM_ALG_NULL != scheme) {
+        hashAlg = r.u16();
+        if (TPM_ALG_ECDAA == scheme) {
+            r.u16(); // count
+        }
+    }
+    r.u16(); // validation.tag
+    r.u32(); // validation.hierarchy
+    Bytes ticket;
+    r.tpm2b(ticket);
+
+    if (TPM_ALG_NULL == scheme) {
+        scheme = key.schemeAlg;
+        hashAlg = key.schemeHash;
+    } else if (TPM_ALG_NULL != key.schemeAlg && (scheme != key.schemeAlg || hashAlg != key.schemeHash)) {
+        throw RC_P(TPM_RC_SCHEME, 2);
+    }
+    if (!SchemeMatchesKey(key, scheme)) {
+        throw RC_P(TPM_RC_SCHEME, 2);
+    }
+    if (TPM_ALG_HMAC == scheme && !HashState::IsSupported(hashAlg)) {
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    if (TPM_ALG_HMAC != scheme && digest.size() != HashState::DigestSize(hashAlg)) {
+        throw RC_P(TPM_RC_SIZE, 1);
+    }
+    MarshalSignature(response.params, key, scheme, hashAlg, digest);
+}
+
+void MockTPM::verifySignature(Request& request, Response& response) {
+    const Object& key = findObject(request.handles[0], TPM_RC_H + TPM_RC_1);
+    if (key.isSequence) {
+        throw RC_H(TPM_RC_TYPE, 1);
+    }
+    Reader& r = request.params;
+    Bytes digest;
+    r.tpm2b(digest, sizeof(TPMU_HA));
+    const size_t signatureOffset = r.position();
+    const TPM_ALG_ID scheme = r.u16();
+    if (!SchemeMatchesKey(key, scheme)) {
+        throw RC_P(TPM_RC_SCHEME, 2);
+    }
+    const TPM_ALG_ID hashAlg = r.u16();
+    Bytes part;
+    if (TPM_ALG_HMAC == scheme) {
+        if (!HashState::IsSupported(hashAlg)) {
+            throw RC_P(TPM_RC_HASH, 2);
+        }
+        r.bytes(part, HashState::DigestSize(hashAlg));
+    } else {
+        r.tpm2b(part);
+        if (!IsRSASignScheme(scheme)) {
+            r.tpm2b(part);
+        }
+    }
+    const Bytes signature(r.current() - (r.position() - signatureOffset), r.current());
+
+    Writer expected;
+    MarshalSignature(expected, key, scheme, hashAlg, digest);
+    if (expected.data() != signature) {
+        throw RC_P(TPM_RC_SIGNATURE, 2);
+    }
+    response.params.u16(TPM_ST_VERIFIED);
+    response.params.u32(key.hierarchy);
+    if (TPM_RH_NULL == key.hierarchy) {
+        response.params.tpm2b(Bytes());
+    } else {
+        response.params.tpm2b(HashState::HMAC(TPM_ALG_SHA256, m_primarySeed, Concat(digest, key.name)));
+    }
+}
+
+// ============================================================================
+// NV 存储
+// ============================================================================
+/// 按 TPMS_NV_PUBLIC 编码 NV 索引的公开信息
+static Bytes MarshalNVPublic(TPM_HANDLE nvIndex, const MockTPM::NVIndex& index) {
+    Writer out;
+    out.u32(nvIndex);
+    out.u16(index.nameAlg);
+    out.u32(index.attributes | (index.written ? NV_ATTRIBUTE_WRITTEN : 0));
+    out.tpm2b(index.authPolicy);
+    out.u16((uint16_t) index.data.size());
+    return out.data();
+}
+
+void MockTPM::nvDefineSpace(Request& request, Response& response) {
+    const TPM_HANDLE authHandle = request.handles[0];
+    if (TPM_RH_OWNER != authHandle && TPM_RH_PLATFORM != authHandle) {
+        throw RC_H(TPM_RC_HIERARCHY, 1);
+    }
+    Reader& r = request.params;
+    NVIndex index;
+    r.tpm2b(index.authValue, sizeof(TPMU_HA));
+    Reader nvPublic = r.sub();
+    const TPM_HANDLE nvIndex = nvPublic.u32();
+    index.nameAlg = nvPublic.u16();
+    index.attributes = nvPublic.u32() & ~NV_ATTRIBUTE_WRITTEN;
+    nvPublic.tpm2b(index.authPolicy, sizeof(TPMU_HA));
+    const size_t dataSize = nvPublic.u16();
+    index.written = false;
+    if (!IsNVIndex(nvIndex)) {
+        throw RC_P(TPM_RC_VALUE, 2);
+    }
+    if (!HashState::IsSupported(index.nameAlg)) {
+        throw RC_P(TPM_RC_HASH, 2);
+    }
+    if (m_nvIndexes.find(nvIndex) != m_nvIndexes.end()) {
+        throw RC(TPM_RC_NV_DEFINED);
+    }
+    if (dataSize > NV_INDEX_SIZE_LIMIT) {
+        throw RC(TPM_RC_NV_SIZE);
+    }
+    if (m_nvIndexes.size() >= NV_INDEX_COUNT_LIMIT) {
+        throw RC(TPM_RC_NV_SPACE);
+    }
+    index.data.assign(dataSize, 0xFF);
+    m_nvIndexes[nvIndex] = index;
+}
+
+void MockTPM::nvUndefineSpace(Request& request, Response& response) {
+    const TPM_HANDLE authHandle = request.handles[0];
+    if (TPM_RH_OWNER != authHandle && TPM_RH_PLATFORM != authHandle) {
+        throw RC_H(TPM_RC_HIERARCHY, 1);
+    }
+    if (!m_nvIndexes.erase(request.handles[1])) {
+        throw RC_H(TPM_RC_HANDLE, 2);
+    }
+}
+
+void MockTPM::nvReadPublic(Request& request, Response& response) {
+    std::map<TPM_HANDLE, NVIndex>::const_iterator it = m_nvIndexes.find(request.handles[0]);
+    if (it == m_nvIndexes.end()) {
+        throw RC_H(TPM_RC_HANDLE, 1);
+    }
+    const Bytes nvPublic = MarshalNVPublic(it->first, it->second);
+    response.params.tpm2b(nvPublic);
+    response.params.tpm2b(Concat(BE16(it->second.nameAlg), HashState::Digest(it->second.nameAlg, nvPublic)));
+}
+
+void MockTPM::nvWrite(Request& request, Response& response) {
+    std::map<TPM_HANDLE, NVIndex>::iterator it = m_nvIndexes.find(request.handles[1]);
+    if (it == m_nvIndexes.end()) {
+        throw RC_H(TPM_RC_HANDLE, 2);
+    }
+    Bytes data;
+    request.params.tpm2b(data, MAX_NV_BUFFER_SIZE);
+    const size_t offset = request.params.u16();
+    NVIndex& index = it->second;
+    if (offset + data.size() > index.data.size()) {
+        throw RC(TPM_RC_NV_RANGE);
+    }
+    std::copy(data.begin(), data.end(), index.data.begin() + offset);
+    index.written = true;
+}
+
+void MockTPM::nvRead(Request& request, Response& response) {
+    std::map<TPM_HANDLE, NVIndex>::const_iterator it = m_nvIndexes.find(request.handles[1]);
+    if (it == m_nvIndexes.end()) {
+        throw RC_H(TPM_RC_HANDLE, 2);
+    }
+    const size_t size = request.params.u16();
+    const size_t offset = request.params.u16();
+    const NVIndex& index = it->second;
+    if (size > MAX_NV_BUFFER_SIZE) {
+        throw RC_P(TPM_RC_VALUE, 1);
+    }
+    if (!index.written) {
+        throw RC(TPM_RC_NV_UNINITIALIZED);
+    }
+    if (offset + size > index.data.size()) {
+        throw RC(TPM_RC_NV_RANGE);
+    }
+    response.params.tpm2b(Bytes(index.data.begin() + offset, index.data.begin() + offset + size));
+}
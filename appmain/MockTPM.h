@@ -0,0 +1,185 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef MOCK_TPM_H_
+#define MOCK_TPM_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+#include <stdint.h>
+
+/// 进程内模拟 TPM(仅用于测试和性能评估)
+///
+/// 直接解析 TPM 2.0 命令帧并生成应答帧, 支持 libplugin 及 SequenceScheduler 用到的全部命令:
+/// Startup, Shutdown, GetTestResult, Hash, HMAC, HMAC_Start, HashSequenceStart, SequenceUpdate, SequenceComplete,
+/// StartAuthSession, FlushContext, ContextSave, ContextLoad, CreatePrimary, Create, Load, LoadExternal, ReadPublic,
+/// RSA_Encrypt, RSA_Decrypt, Sign, VerifySignature, NV_DefineSpace, NV_UndefineSpace, NV_ReadPublic, NV_Write, NV_Read.
+///
+/// 与真实 TPM 的差别:
+/// - 哈希和 HMAC 使用主机端 SHA1/SHA256 真实计算, 结果可与主机端算法对比; 其他哈希算法返回 TPM_RC_HASH
+/// - RSA/ECC 签名和 RSA 加解密不是真实的公钥运算, 而是由公钥数据和输入数据派生出的确定性字节串,
+///   长度与真实结果一致, 并且 Sign 与 VerifySignature, RSA_Encrypt 与 RSA_Decrypt 可以互相验证
+/// - 口令会话(TPM_RS_PW)检查口令, HMAC 会话和策略会话不作校验
+/// - 临时对象槽位个数有限(默认 3 个), 超出时返回 TPM_RC_OBJECT_MEMORY, 与真实 TPM 一致
+/// - 随机数由可设定种子的伪随机数发生器产生, 相同种子下的运行结果完全可重复
+///
+/// @note 本类不是线程安全的, 由 MockTPMConnectionManager 负责加锁
+class MockTPM
+{
+public:
+    /// 构造函数
+    ///
+    /// @param maxLoadedObjects 临时对象(包括哈希序列对象)槽位个数
+    /// @param seed 伪随机数种子
+    explicit MockTPM(unsigned int maxLoadedObjects=3, uint64_t seed=0);
+    ~MockTPM();
+
+    /// 执行一条命令
+    ///
+    /// @param command 命令帧
+    /// @param commandSize 命令帧长度
+    /// @param response 输出参数. 应答帧缓冲区
+    /// @param capacity 应答帧缓冲区容量
+    /// @return 应答帧长度. 任何错误均以 TPM 错误码应答帧的形式返回
+    size_t execute(const uint8_t *command, size_t commandSize, uint8_t *response, size_t capacity);
+
+    /// 设定临时对象槽位个数
+    void configMaxLoadedObjects(unsigned int maxLoadedObjects);
+
+    /// 重新设定伪随机数种子. 主密钥由种子派生, 因此不同种子下 CreatePrimary 生成的密钥不同
+    void configRandomSeed(uint64_t seed);
+
+    /// 模拟 TPM 重启: 清除全部临时对象和会话, NV 数据保留
+    void reset();
+
+    /// 当前已加载的临时对象个数
+    unsigned int loadedObjectCount() const;
+
+    /// 当前会话个数
+    unsigned int sessionCount() const;
+
+    /// 从命令帧中取出命令码, 命令帧不完整时返回 0
+    static TPM_CC CommandCodeOf(const uint8_t *command, size_t commandSize);
+
+public:
+    // 以下为内部数据结构, 仅在 MockTPM.cpp 中使用
+    class Request;
+    class Response;
+    class HashState;
+
+    /// 临时对象(密钥或哈希序列)
+    struct Object {
+        std::vector<uint8_t> publicArea; ///< 按 TPM 规范编码的 TPMT_PUBLIC
+        std::vector<uint8_t> name;
+        std::vector<uint8_t> qualifiedName;
+        std::vector<uint8_t> secret; ///< 对称密钥/HMAC 密钥, 或非对称密钥的私钥种子
+        std::vector<uint8_t> authValue;
+        TPMI_RH_HIERARCHY hierarchy;
+        // 以下字段由 publicArea 解析得到
+        TPM_ALG_ID type;
+        TPM_ALG_ID nameAlg;
+        UINT32 attributes;
+        TPM_ALG_ID schemeAlg;
+        TPM_ALG_ID schemeHash;
+        UINT16 keyBytes; ///< RSA 模数长度, ECC 坐标长度, 或对称密钥长度
+        std::vector<uint8_t> unique; ///< publicArea 中 unique 字段的编码
+        // 以下字段仅用于哈希序列对象
+        bool isSequence;
+        TPM_ALG_ID sequenceHashAlg;
+        std::shared_ptr<HashState> sequenceHash;
+        std::vector<uint8_t> hmacKey; ///< HMAC 序列的密钥(已按分组长度补齐), 哈希序列为空
+
+        Object();
+    };
+
+    /// 授权会话
+    struct Session {
+        uint8_t sessionType;
+        TPM_ALG_ID authHash;
+    };
+
+    /// NV 索引
+    struct NVIndex {
+        TPM_ALG_ID nameAlg;
+        UINT32 attributes;
+        std::vector<uint8_t> authPolicy;
+        std::vector<uint8_t> authValue;
+        std::vector<uint8_t> data;
+        bool written;
+    };
+
+private:
+    typedef void (MockTPM::*CommandHandler)(Request& request, Response& response);
+    struct CommandInfo {
+        TPM_CC commandCode;
+        unsigned int handleCount; ///< 命令帧中的句柄个数
+        unsigned int authHandleCount; ///< 其中需要授权的句柄个数(总是排在前面)
+        CommandHandler handler;
+    };
+    static const CommandInfo *FindCommand(TPM_CC commandCode);
+
+    void checkAuthorizations(Request& request);
+    const std::vector<uint8_t>& authValueOf(TPM_HANDLE handle);
+    Object& findObject(TPM_HANDLE handle, TPM_RC errorLocation);
+    TPM_HANDLE addObject(const Object& object);
+    std::vector<uint8_t> randomBytes(size_t length);
+    void buildObject(Object& object, const std::vector<uint8_t>& inPublic, const std::vector<uint8_t>& sensitiveData,
+            const std::vector<uint8_t>& seed, bool generateSecret);
+    void marshalCreationData(Response& response, const Object& object, const std::vector<uint8_t>& parentName,
+            const std::vector<uint8_t>& outsideInfo, TPMI_RH_HIERARCHY hierarchy);
+
+    // 命令处理函数
+    void startup(Request& request, Response& response);
+    void shutdown(Request& request, Response& response);
+    void getTestResult(Request& request, Response& response);
+    void hash(Request& request, Response& response);
+    void hmac(Request& request, Response& response);
+    void hmacStart(Request& request, Response& response);
+    void hashSequenceStart(Request& request, Response& response);
+    void sequenceUpdate(Request& request, Response& response);
+    void sequenceComplete(Request& request, Response& response);
+    void startAuthSession(Request& request, Response& response);
+    void flushContext(Request& request, Response& response);
+    void contextSave(Request& request, Response& response);
+    void contextLoad(Request& request, Response& response);
+    void createPrimary(Request& request, Response& response);
+    void create(Request& request, Response& response);
+    void load(Request& request, Response& response);
+    void loadExternal(Request& request, Response& response);
+    void readPublic(Request& request, Response& response);
+    void rsaEncrypt(Request& request, Response& response);
+    void rsaDecrypt(Request& request, Response& response);
+    void sign(Request& request, Response& response);
+    void verifySignature(Request& request, Response& response);
+    void nvDefineSpace(Request& request, Response& response);
+    void nvUndefineSpace(Request& request, Response& response);
+    void nvReadPublic(Request& request, Response& response);
+    void nvWrite(Request& request, Response& response);
+    void nvRead(Request& request, Response& response);
+
+    unsigned int m_maxLoadedObjects;
+    std::mt19937_64 m_rng;
+    std::vector<uint8_t> m_primarySeed; ///< 主密钥种子, 相同模板的 CreatePrimary 总是生成相同的密钥
+    uint64_t m_contextSequence;
+    std::map<TPM_HANDLE, Object> m_objects;
+    std::map<TPM_HANDLE, Session> m_sessions;
+    std::map<TPM_HANDLE, NVIndex> m_nvIndexes;
+
+    // 禁止复制
+    MockTPM(const MockTPM&);
+    MockTPM& operator=(const MockTPM&);
+};
+
+#endif // __cplusplus
+#endif // MOCK_TPM_H_
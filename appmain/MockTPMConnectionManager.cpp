@@ -0,0 +1,424 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <sapi/tpm20.h>
+#include "ConnectionManager.h"
+#include "MockTPMConnectionManager.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+// ============================================================================
+// 延迟分布
+// ============================================================================
+MockLatencyDistribution::MockLatencyDistribution()
+        : m_kind(KIND_ZERO), m_a(0), m_b(0)
+{
+}
+
+MockLatencyDistribution::MockLatencyDistribution(Kind kind, double a, double b)
+        : m_kind(kind), m_a(a), m_b(b)
+{
+}
+
+MockLatencyDistribution MockLatencyDistribution::Zero()
+{
+    return MockLatencyDistribution();
+}
+
+MockLatencyDistribution MockLatencyDistribution::Constant(double microseconds)
+{
+    if (microseconds < 0) {
+        throw std::invalid_argument("MockLatencyDistribution::Constant(): negative latency");
+    }
+    return MockLatencyDistribution(KIND_CONSTANT, microseconds, 0);
+}
+
+MockLatencyDistribution MockLatencyDistribution::Uniform(double min, double max)
+{
+    if (min < 0 || max < min) {
+        throw std::invalid_argument("MockLatencyDistribution::Uniform(): requires 0 <= min <= max");
+    }
+    return MockLatencyDistribution(KIND_UNIFORM, min, max);
+}
+
+MockLatencyDistribution MockLatencyDistribution::Normal(double mean, double stddev)
+{
+    if (stddev < 0) {
+        throw std::invalid_argument("MockLatencyDistribution::Normal(): negative stddev");
+    }
+    return MockLatencyDistribution(KIND_NORMAL, mean, stddev);
+}
+
+MockLatencyDistribution MockLatencyDistribution::LogNormal(double median, double sigma)
+{
+    if (median <= 0 || sigma < 0) {
+        throw std::invalid_argument("MockLatencyDistribution::LogNormal(): requires median > 0 and sigma >= 0");
+    }
+    return MockLatencyDistribution(KIND_LOGNORMAL, std::log(median), sigma);
+}
+
+MockLatencyDistribution MockLatencyDistribution::Exponential(double mean)
+{
+    if (mean <= 0) {
+        throw std::invalid_argument("MockLatencyDistribution::Exponential(): requires mean > 0");
+    }
+    return MockLatencyDistribution(KIND_EXPONENTIAL, mean, 0);
+}
+
+double MockLatencyDistribution::sample(std::mt19937_64& rng) const
+{
+    double value = 0;
+    switch (m_kind) {
+    case KIND_CONSTANT:
+        value = m_a;
+        break;
+    case KIND_UNIFORM:
+        value = std::uniform_real_distribution<double>(m_a, m_b)(rng);
+        break;
+    case KIND_NORMAL:
+        value = (m_b > 0) ? std::normal_distribution<double>(m_a, m_b)(rng) : m_a;
+        break;
+    case KIND_LOGNORMAL:
+        value = (m_b > 0) ? std::lognormal_distribution<double>(m_a, m_b)(rng) : std::exp(m_a);
+        break;
+    case KIND_EXPONENTIAL:
+        value = std::exponential_distribution<double>(1.0 / m_a)(rng);
+        break;
+    case KIND_ZERO:
+    default:
+        break;
+    }
+    return (value > 0) ? value : 0;
+}
+
+// ============================================================================
+// 模拟 TCTI 上下文
+// ============================================================================
+/// 模拟 TCTI 上下文, 公共部分必须放在首位, SAPI 只访问这一部分
+struct MockTPMConnectionManager::MockTctiContext {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    MockTPMConnectionManager *owner;
+};
+
+static const uint64_t MOCK_TCTI_MAGIC = 0x4D4F434B54504D31ULL; // "MOCKTPM1"
+
+MockTPMConnectionManager *MockTPMConnectionManager::OwnerOf(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    MockTctiContext *ctx = (MockTctiContext *) tctiContext;
+    if (!ctx || ctx->common.magic != MOCK_TCTI_MAGIC) {
+        return NULL;
+    }
+    return ctx->owner;
+}
+
+// 构造函数 MockTPMConnectionManager(maxLoadedObjects)
+MockTPMConnectionManager::MockTPMConnectionManager(unsigned int maxLoadedObjects)
+        : m_tpm(maxLoadedObjects), m_timerFd(-1), m_virtualClock(false), m_responsePending(false),
+          m_commandCount(0), m_busyMicroseconds(0)
+{
+    m_tctiContext = new MockTctiContext;
+    memset(&m_tctiContext->common, 0x00, sizeof(m_tctiContext->common));
+    m_tctiContext->owner = this;
+}
+
+// 析构函数
+MockTPMConnectionManager::~MockTPMConnectionManager()
+{
+    disconnect();
+    delete m_tctiContext;
+}
+
+// 接口函数 connect()
+void MockTPMConnectionManager::connect()
+{
+    TSS2_TCTI_CONTEXT_COMMON_V1& common = m_tctiContext->common;
+    common.magic = MOCK_TCTI_MAGIC;
+    common.version = 1;
+    common.transmit = Transmit;
+    common.receive = Receive;
+    common.finalize = Finalize;
+    common.cancel = Cancel;
+    common.getPollHandles = GetPollHandles;
+    common.setLocality = SetLocality;
+
+    if (m_timerFd < 0) {
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timerFd < 0) {
+            fprintf(stderr, "Warning: timerfd_create() failed, poll handles will not be available\n");
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_responsePending = false;
+    m_response.clear();
+}
+
+// 接口函数 disconnect()
+void MockTPMConnectionManager::disconnect()
+{
+    memset(&m_tctiContext->common, 0x00, sizeof(m_tctiContext->common));
+    if (m_timerFd >= 0) {
+        close(m_timerFd);
+        m_timerFd = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_responsePending = false;
+    m_response.clear();
+}
+
+/// 取出指向TCTI上下文区域的指针
+void MockTPMConnectionManager::initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize)
+{
+    TSS2_ABI_VERSION abiVersion;
+    abiVersion.tssCreator = TSSWG_INTEROP;
+    abiVersion.tssFamily = TSS_SAPI_FIRST_FAMILY;
+    abiVersion.tssLevel = TSS_SAPI_FIRST_LEVEL;
+    abiVersion.tssVersion = TSS_SAPI_FIRST_VERSION;
+
+    TSS2_RC err = 0;
+    err = Tss2_Sys_Initialize(
+            sysContext,
+            contextSize,
+            (TSS2_TCTI_CONTEXT *) m_tctiContext,
+            &abiVersion);
+    if (err) {
+        fprintf(stderr, "Error: Tss2_Sys_Initialize() returns 0x%X\n", (int) err);
+        throw err;
+    }
+}
+
+// ============================================================================
+// 配置与统计
+// ============================================================================
+void MockTPMConnectionManager::configLatency(const MockLatencyDistribution& latency)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_defaultLatency = latency;
+}
+
+void MockTPMConnectionManager::configLatency(TPM_CC commandCode, const MockLatencyDistribution& latency)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latencies[commandCode] = latency;
+}
+
+void MockTPMConnectionManager::configRandomSeed(uint64_t seed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tpm.configRandomSeed(seed);
+    m_latencyRng.seed(seed);
+}
+
+void MockTPMConnectionManager::configVirtualClock(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_virtualClock = enabled;
+}
+
+uint64_t MockTPMConnectionManager::commandCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_commandCount;
+}
+
+double MockTPMConnectionManager::simulatedBusyMicroseconds() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_busyMicroseconds;
+}
+
+MockTPM& MockTPMConnectionManager::tpm()
+{
+    return m_tpm;
+}
+
+// ============================================================================
+// TCTI 回调函数
+// ============================================================================
+TSS2_RC MockTPMConnectionManager::Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command)
+{
+    MockTPMConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->transmit(size, command) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC MockTPMConnectionManager::Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response,
+        int32_t timeout)
+{
+    MockTPMConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->receive(size, response, timeout) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+void MockTPMConnectionManager::Finalize(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    // 资源由 disconnect() 和析构函数释放
+}
+
+TSS2_RC MockTPMConnectionManager::Cancel(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    MockTPMConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->cancel() : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC MockTPMConnectionManager::GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles,
+        size_t *num_handles)
+{
+    MockTPMConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->getPollHandles(handles, num_handles) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC MockTPMConnectionManager::SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality)
+{
+    MockTPMConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->setLocality(locality) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC MockTPMConnectionManager::transmit(size_t size, const uint8_t *command)
+{
+    if (!command) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE; // 上一条命令的应答尚未取走
+    }
+    m_response.resize(MAX_RESPONSE_SIZE);
+    m_response.resize(m_tpm.execute(command, size, m_response.data(), m_response.size()));
+
+    const TPM_CC commandCode = MockTPM::CommandCodeOf(command, size);
+    std::map<TPM_CC, MockLatencyDistribution>::const_iterator it = m_latencies.find(commandCode);
+    const MockLatencyDistribution& latency = (it != m_latencies.end()) ? it->second : m_defaultLatency;
+    const double microseconds = latency.sample(m_latencyRng);
+    m_busyMicroseconds += microseconds;
+    m_commandCount++;
+
+    Clock::duration delay = Clock::duration::zero();
+    if (!m_virtualClock) {
+        delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(microseconds));
+    }
+    m_readyTime = Clock::now() + delay;
+    m_responsePending = true;
+    armTimer(delay);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC MockTPMConnectionManager::receive(size_t *size, uint8_t *response, int32_t timeout)
+{
+    if (!size) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    const Clock::time_point readyTime = m_readyTime;
+    const Clock::time_point now = Clock::now();
+    if (now < readyTime) {
+        if (TSS2_TCTI_TIMEOUT_NONE == timeout) {
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        // 等待期间释放锁, 以便其他线程查询统计信息
+        lock.unlock();
+        if (timeout > 0 && now + std::chrono::milliseconds(timeout) < readyTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        std::this_thread::sleep_until(readyTime);
+        lock.lock();
+        if (!m_responsePending) { // 等待期间命令被取消
+            return TSS2_TCTI_RC_BAD_SEQUENCE;
+        }
+    }
+    if (!response) { // 只查询应答帧长度
+        *size = m_response.size();
+        return TSS2_RC_SUCCESS;
+    }
+    if (*size < m_response.size()) {
+        *size = m_response.size();
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy(response, m_response.data(), m_response.size());
+    *size = m_response.size();
+    m_responsePending = false;
+    disarmTimer();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC MockTPMConnectionManager::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    m_responsePending = false; // 命令已在 transmit() 中执行, 只能丢弃应答
+    disarmTimer();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC MockTPMConnectionManager::getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles)
+{
+    if (!num_handles) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (m_timerFd < 0) {
+        return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+    }
+    if (!handles) {
+        *num_handles = 1;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*num_handles < 1) {
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    handles[0].fd = m_timerFd;
+    handles[0].events = POLLIN;
+    handles[0].revents = 0;
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC MockTPMConnectionManager::setLocality(uint8_t locality)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    return TSS2_RC_SUCCESS; // 模拟 TPM 不区分 locality
+}
+
+// ============================================================================
+// 轮询句柄
+// ============================================================================
+void MockTPMConnectionManager::armTimer(Clock::duration delay)
+{
+    if (m_timerFd < 0) {
+        return;
+    }
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+    struct itimerspec spec;
+    memset(&spec, 0x00, sizeof(spec));
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if (0 == spec.it_value.tv_sec && 0 == spec.it_value.tv_nsec) {
+        spec.it_value.tv_nsec = 1; // 全 0 表示停止计时器, 用 1 纳秒代替
+    }
+    timerfd_settime(m_timerFd, 0, &spec, NULL);
+}
+
+void MockTPMConnectionManager::disarmTimer()
+{
+    if (m_timerFd < 0) {
+        return;
+    }
+    struct itimerspec spec;
+    memset(&spec, 0x00, sizeof(spec));
+    timerfd_settime(m_timerFd, 0, &spec, NULL);
+    uint64_t expirations;
+    ssize_t ignored = read(m_timerFd, &expirations, sizeof(expirations)); // 清除可读状态(TFD_NONBLOCK)
+    (void) ignored;
+}
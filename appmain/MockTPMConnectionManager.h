@@ -0,0 +1,156 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef MOCK_TPM_CONNECTION_MANAGER_H_
+#define MOCK_TPM_CONNECTION_MANAGER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <stdint.h>
+#include "ConnectionManager.h"
+#include "MockTPM.h"
+
+/// 模拟命令执行延迟的概率分布(单位: 微秒)
+class MockLatencyDistribution {
+public:
+    /// 无延迟(默认)
+    static MockLatencyDistribution Zero();
+    /// 固定延迟
+    static MockLatencyDistribution Constant(double microseconds);
+    /// 均匀分布 [min, max]
+    static MockLatencyDistribution Uniform(double min, double max);
+    /// 正态分布, 负值按 0 处理
+    static MockLatencyDistribution Normal(double mean, double stddev);
+    /// 对数正态分布, 适合模拟带长尾的 TPM 命令延迟
+    ///
+    /// @param median 中位数
+    /// @param sigma 对数标准差, 越大尾部越长
+    static MockLatencyDistribution LogNormal(double median, double sigma);
+    /// 指数分布
+    static MockLatencyDistribution Exponential(double mean);
+
+    /// 抽取一个样本(微秒), 总是 >= 0
+    double sample(std::mt19937_64& rng) const;
+
+    MockLatencyDistribution();
+
+private:
+    enum Kind {
+        KIND_ZERO,
+        KIND_CONSTANT,
+        KIND_UNIFORM,
+        KIND_NORMAL,
+        KIND_LOGNORMAL,
+        KIND_EXPONENTIAL,
+    };
+    MockLatencyDistribution(Kind kind, double a, double b);
+
+    Kind m_kind;
+    double m_a; ///< 第一个参数(含义随分布类型而定)
+    double m_b; ///< 第二个参数(含义随分布类型而定)
+};
+
+/// 进程内模拟 TPM 连接管理器
+///
+/// 不需要 /dev/tpm0 或 2321 端口上的软件模拟器, 命令由 MockTPM 在进程内执行,
+/// 可以在编译机上确定性地测试 Client, HashSequenceScheduler 等组件的功能和吞吐量.
+/// 各测试程序的 -mock 选项使用本类, make check 以此运行回归测试.
+///
+/// 每条命令的应答延迟按命令码从配置的概率分布中抽样:
+/// - transmit() 立即执行命令, 应答在抽样得到的延迟之后才能被 receive() 取走
+/// - 非阻塞 receive() 在应答就绪前返回 TSS2_TCTI_RC_TRY_AGAIN, 与真实 TCTI 的异步行为一致
+/// - getPollHandles() 返回一个在应答就绪时变为可读的 timerfd, 可以交给 ClientEventLoop 等待
+///
+/// 打开虚拟时钟(configVirtualClock(true))后应答立即就绪, 延迟只累计到 simulatedBusyMicroseconds() 中,
+/// 用于快速估算调度策略在给定延迟模型下的 TPM 忙碌时间.
+///
+/// 伪随机数种子相同时, 命令结果和延迟序列完全可重复.
+///
+/// @see MockTPM 支持的命令以及与真实 TPM 的差别
+class MockTPMConnectionManager: public ConnectionManager {
+public:
+    /// 构造函数
+    MockTPMConnectionManager(unsigned int maxLoadedObjects=3 ///< 临时对象槽位个数
+            );
+    /// 析构函数
+    ~MockTPMConnectionManager();
+    /// 初始化模拟 TCTI
+    void connect();
+    /// 主动断开连接
+    void disconnect();
+    /// 用模拟 TCTI 初始化 System API 上下文
+    ///
+    /// @throws TSS2_RC Tss2_Sys_Initialize() 失败时抛出错误码
+    void initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize);
+
+    /// 设定全部命令的默认延迟分布
+    void configLatency(const MockLatencyDistribution& latency);
+    /// 设定单个命令的延迟分布, 优先于默认延迟分布
+    void configLatency(TPM_CC commandCode, const MockLatencyDistribution& latency);
+    /// 设定伪随机数种子(同时作用于 MockTPM 和延迟抽样)
+    void configRandomSeed(uint64_t seed);
+    /// 打开或关闭虚拟时钟
+    void configVirtualClock(bool enabled);
+
+    /// 已执行的命令条数
+    uint64_t commandCount() const;
+    /// 累计的模拟执行时间(微秒)
+    double simulatedBusyMicroseconds() const;
+    /// 访问模拟 TPM 本身(例如调整槽位个数或模拟重启), 调用者不得在命令执行期间访问
+    MockTPM& tpm();
+
+private:
+    struct MockTctiContext;
+    typedef std::chrono::steady_clock Clock;
+
+    static MockTPMConnectionManager *OwnerOf(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command);
+    static TSS2_RC Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response, int32_t timeout);
+    static void Finalize(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC Cancel(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    static TSS2_RC SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality);
+
+    TSS2_RC transmit(size_t size, const uint8_t *command);
+    TSS2_RC receive(size_t *size, uint8_t *response, int32_t timeout);
+    TSS2_RC cancel();
+    TSS2_RC getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    TSS2_RC setLocality(uint8_t locality);
+    void armTimer(Clock::duration delay);
+    void disarmTimer();
+
+    MockTPM m_tpm;
+    MockTctiContext *m_tctiContext;
+    int m_timerFd; ///< 轮询句柄, 应答就绪时可读
+
+    mutable std::mutex m_mutex;
+    std::mt19937_64 m_latencyRng;
+    MockLatencyDistribution m_defaultLatency;
+    std::map<TPM_CC, MockLatencyDistribution> m_latencies;
+    bool m_virtualClock;
+
+    std::vector<uint8_t> m_response;
+    bool m_responsePending;
+    Clock::time_point m_readyTime;
+    uint64_t m_commandCount;
+    double m_busyMicroseconds;
+
+    // 禁止复制
+    MockTPMConnectionManager(const MockTPMConnectionManager&);
+    MockTPMConnectionManager& operator=(const MockTPMConnectionManager&);
+};
+
+#endif // __cplusplus
+#endif // MOCK_TPM_CONNECTION_MANAGER_H_
@@ -18,12 +18,14 @@ using namespace std;
 #include "TPMCommand.h"
 #include "ConnectionManager.h"
 #include "SocketConnectionManager.h"
+#include "MockTPMConnectionManager.h"
 #include "Base64Converter.h"
 
 // 内部函数原型声明
 static void TestRSAStorageKeyBuilderClient(ConnectionManager& connectionManager);
 static void TestTPMNodeRestoringClient(ConnectionManager& connectionManager);
-static void TestNameAfterNodeIsRestored(ConnectionManager& connectionManager);
+static bool TestNameAfterNodeIsRestored(ConnectionManager& connectionManager);
+static void TestLazyNodeRestoring(ConnectionManager& connectionManager);
 
 /* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
 
@@ -35,11 +37,13 @@ static void PrintHelp()
     printf("-rmport 手动指定运行资源管理器的主机端口号 (默认值: %d)\n", DEFAULT_RESMGR_TPM_PORT);
     printf("-localTctiTest\n");
     printf("[注意: 若使用 -localTctiTest 请手动关闭任何占用/dev/tpm0设备的进程, 即: 关闭其他直接访问/dev/tpm0的resourcemgr进程]\n");
+    printf("-mock 使用进程内模拟 TPM (不需要 TPM 设备或 resourcemgr, 可在编译机上运行)\n");
 }
 
 int main(int argc, char *argv[])
 {
     int count;
+    int usingMock = false;
     int usingDeviceFile = false;
     const char *deviceFile = "/dev/tpm0";
     const char *hostname = "127.0.0.1";
@@ -56,6 +60,14 @@ int main(int argc, char *argv[])
             // 用于直接操作/dev/tpm0设备
             continue;
         }
+        if (0 == strcmp(argv[count], "-mock"))
+        {
+            usingMock = true;
+            count += 1;
+            // 以上代码提供的命令行参数为: -mock
+            // 使用进程内模拟 TPM, 用于在没有 TPM 的编译机上做回归测试
+            continue;
+        }
 
         if (0 == strcmp(argv[count], "-rmhost"))
         {
@@ -89,6 +101,7 @@ int main(int argc, char *argv[])
 
     SocketConnectionManager socketConnectionManager(hostname, port);
     CharacterDeviceConnectionManager deviceConnectionManager(deviceFile);
+    MockTPMConnectionManager mockConnectionManager;
 
     ConnectionManager *connectionManager; ///< 通过指针选择使用哪一个上下文初始化器
     connectionManager = &socketConnectionManager; // 默认优先使用socket连接(2323端口上的resourcemgr或2321端口上的Simulator)
@@ -96,12 +109,17 @@ int main(int argc, char *argv[])
     {
         connectionManager = &deviceConnectionManager;
     }
+    if (usingMock)
+    {
+        connectionManager = &mockConnectionManager;
+    }
     connectionManager->connect();
     TestRSAStorageKeyBuilderClient(*connectionManager);
-    TestNameAfterNodeIsRestored(*connectionManager);
+    const bool consistent = TestNameAfterNodeIsRestored(*connectionManager);
+    TestLazyNodeRestoring(*connectionManager);
     connectionManager->disconnect();
 
-    return (0);
+    return (consistent? 0: 1);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -110,6 +128,7 @@ int main(int argc, char *argv[])
 using std::exception;
 #include "Client.h"
 #include "ContextFileFormatter.h"
+#include "BinaryContextFile.h"
 
 static void TestRSAStorageKeyBuilderClient(ConnectionManager& connectionManager)
 {
@@ -288,6 +307,15 @@ static void TestRSAStorageKeyBuilderClient(ConnectionManager& connectionManager)
         } catch (...)
         {
         }
+        BinaryContextFileFormatter binaryFormatter;
+        try
+        {
+            binaryFormatter.setFileName("PrimaryNodeContext.ctx");
+            binaryFormatter.output(client.getNodeContext());
+        } catch (std::exception& e)
+        {
+            fprintf(stderr, "BinaryContextFileFormatter: %s\n", e.what());
+        }
     } catch (...)
     {
     }
@@ -411,8 +439,10 @@ static void HexTextFromBinaryData(std::string& text, const void *dataIn, unsigne
 using std::exception;
 #include "Client.h"
 #include "ContextFileParser.h"
+#include "BinaryContextFile.h"
 
-static void TestNameAfterNodeIsRestored(ConnectionManager& connectionManager)
+/// @return 二进制上下文文件与文本上下文文件内容一致时返回 true, 不一致或无法读取二进制文件时返回 false
+static bool TestNameAfterNodeIsRestored(ConnectionManager& connectionManager)
 {
     class NodeNameDisplayerClient: public Client
     {
@@ -472,6 +502,24 @@ static void TestNameAfterNodeIsRestored(ConnectionManager& connectionManager)
     parser.setFileName("PrimaryNodeContext.csv");
     parser.fetch(nodeContext);
 
+    bool same = false;
+    try
+    {
+        // 二进制格式与文本格式应还原出完全相同的上下文
+        TPMS_CONTEXT binaryContext;
+        BinaryContextFileParser binaryParser("PrimaryNodeContext.ctx");
+        binaryParser.fetch(binaryContext);
+        same = binaryContext.sequence == nodeContext.sequence
+                && binaryContext.savedHandle == nodeContext.savedHandle
+                && binaryContext.hierarchy == nodeContext.hierarchy
+                && binaryContext.contextBlob.t.size == nodeContext.contextBlob.t.size
+                && 0 == memcmp(binaryContext.contextBlob.t.buffer, nodeContext.contextBlob.t.buffer, nodeContext.contextBlob.t.size);
+        printf("二进制上下文文件与文本上下文文件内容%s\n", same ? "一致" : "不一致");
+    } catch (std::exception& e)
+    {
+        fprintf(stderr, "BinaryContextFileParser: %s\n", e.what());
+    }
+
     {
         NodeNameDisplayerClient client;
         client.bind(connectionManager);
@@ -482,4 +530,43 @@ static void TestNameAfterNodeIsRestored(ConnectionManager& connectionManager)
         printf("节点名: %s\n", client.sName.c_str());
         printf("QualifiedName: %s\n", client.sQualifiedName.c_str());
     }
+    return same;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VirtualHandleManager.h"
+#include "LazyContextRestorer.h"
+
+static void TestLazyNodeRestoring(ConnectionManager& connectionManager)
+{
+    VirtualHandleManager manager;
+    LazyContextRestorer restorer(manager);
+    Client client;
+    client.bind(connectionManager);
+    try
+    {
+        // 登记时不读取文件, 也不执行 ContextLoad
+        restorer.registerContextFile("primary", "PrimaryNodeContext.ctx");
+        restorer.registerContextFile("primary-csv", "PrimaryNodeContext.csv");
+        restorer.addPrefetchHint("primary");
+        restorer.prefetch(client);
+        printf("预取之后: ContextLoad %lu 次, 读取上下文文件 %lu 次\n",
+                manager.statistics().prefetches, manager.statistics().lazyFetches);
+
+        TPM_HANDLE handle = manager.resolve(client, restorer.handleOf("primary"));
+        printf("延迟恢复的节点句柄为 0x%08X\n", (int)handle);
+        handle = manager.resolve(client, restorer.handleOf("primary-csv"));
+        printf("首次使用时才恢复的节点句柄为 0x%08X\n", (int)handle);
+        printf("共 ContextLoad %lu 次(含预取), 读取上下文文件 %lu 次\n",
+                manager.statistics().swapIns + manager.statistics().prefetches, manager.statistics().lazyFetches);
+    } catch (std::exception& e)
+    {
+        fprintf(stderr, "TestLazyNodeRestoring: %s\n", e.what());
+    } catch (TSS2_RC rc)
+    {
+        fprintf(stderr, "TestLazyNodeRestoring: TPM error 0x%08X\n", rc);
+    }
+    manager.releaseAll(client);
+    client.unbind();
 }
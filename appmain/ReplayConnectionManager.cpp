@@ -0,0 +1,406 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <sapi/tpm20.h>
+#include "ConnectionManager.h"
+#include "ReplayConnectionManager.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+/// 重放 TCTI 上下文, 公共部分必须放在首位, SAPI 只访问这一部分
+struct ReplayConnectionManager::ReplayTctiContext {
+    TSS2_TCTI_CONTEXT_COMMON_V1 common;
+    ReplayConnectionManager *owner;
+};
+
+static const uint64_t REPLAY_TCTI_MAGIC = 0x5245504C41593031ULL; // "REPLAY01"
+
+/// 命令帧/应答帧头部第 6~9 字节: 命令码或应答码, 帧不完整时返回 0
+static uint32_t CodeOfFrame(const uint8_t *frame, size_t size)
+{
+    if (!frame || size < 10) {
+        return 0;
+    }
+    return ((uint32_t) frame[6] << 24) | ((uint32_t) frame[7] << 16) | ((uint32_t) frame[8] << 8) | frame[9];
+}
+
+ReplayConnectionManager *ReplayConnectionManager::OwnerOf(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    ReplayTctiContext *ctx = (ReplayTctiContext *) tctiContext;
+    if (!ctx || ctx->common.magic != REPLAY_TCTI_MAGIC) {
+        return NULL;
+    }
+    return ctx->owner;
+}
+
+// 构造函数 ReplayConnectionManager(fileName)
+ReplayConnectionManager::ReplayConnectionManager(const char *fileName)
+        : m_timerFd(-1), m_cursor(0), m_timeScale(1.0), m_channel(-1), m_loop(false), m_responseRc(0),
+          m_responsePending(false), m_commandCount(0), m_skippedCount(0), m_unmatchedCount(0)
+{
+    if (!fileName) {
+        throw std::invalid_argument("ReplayConnectionManager: fileName is NULL");
+    }
+    TctiRecorder::Load(fileName, m_allRecords);
+    selectRecords();
+    m_tctiContext = new ReplayTctiContext;
+    memset(&m_tctiContext->common, 0x00, sizeof(m_tctiContext->common));
+    m_tctiContext->owner = this;
+}
+
+// 析构函数
+ReplayConnectionManager::~ReplayConnectionManager()
+{
+    disconnect();
+    delete m_tctiContext;
+}
+
+// 接口函数 connect()
+void ReplayConnectionManager::connect()
+{
+    TSS2_TCTI_CONTEXT_COMMON_V1& common = m_tctiContext->common;
+    common.magic = REPLAY_TCTI_MAGIC;
+    common.version = 1;
+    common.transmit = Transmit;
+    common.receive = Receive;
+    common.finalize = Finalize;
+    common.cancel = Cancel;
+    common.getPollHandles = GetPollHandles;
+    common.setLocality = SetLocality;
+
+    if (m_timerFd < 0) {
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timerFd < 0) {
+            fprintf(stderr, "Warning: timerfd_create() failed, poll handles will not be available\n");
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cursor = 0;
+    m_responsePending = false;
+    m_response.clear();
+}
+
+// 接口函数 disconnect()
+void ReplayConnectionManager::disconnect()
+{
+    memset(&m_tctiContext->common, 0x00, sizeof(m_tctiContext->common));
+    if (m_timerFd >= 0) {
+        close(m_timerFd);
+        m_timerFd = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_responsePending = false;
+    m_response.clear();
+}
+
+/// 取出指向TCTI上下文区域的指针
+void ReplayConnectionManager::initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize)
+{
+    TSS2_ABI_VERSION abiVersion;
+    abiVersion.tssCreator = TSSWG_INTEROP;
+    abiVersion.tssFamily = TSS_SAPI_FIRST_FAMILY;
+    abiVersion.tssLevel = TSS_SAPI_FIRST_LEVEL;
+    abiVersion.tssVersion = TSS_SAPI_FIRST_VERSION;
+
+    TSS2_RC err = 0;
+    err = Tss2_Sys_Initialize(
+            sysContext,
+            contextSize,
+            (TSS2_TCTI_CONTEXT *) m_tctiContext,
+            &abiVersion);
+    if (err) {
+        fprintf(stderr, "Error: Tss2_Sys_Initialize() returns 0x%X\n", (int) err);
+        // TODO: throw/raise an expection to the up level
+    }
+}
+
+// ============================================================================
+// 配置与统计
+// ============================================================================
+void ReplayConnectionManager::configTimeScale(double scale)
+{
+    if (scale < 0) {
+        throw std::invalid_argument("ReplayConnectionManager::configTimeScale(): negative scale");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_timeScale = scale;
+}
+
+void ReplayConnectionManager::configChannel(int channel)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_channel = channel;
+    selectRecords();
+}
+
+void ReplayConnectionManager::configLoop(bool loop)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loop = loop;
+}
+
+void ReplayConnectionManager::selectRecords()
+{
+    m_records.clear();
+    for (size_t i = 0; i < m_allRecords.size(); i++) {
+        if (m_channel < 0 || m_allRecords[i].channel == (uint32_t) m_channel) {
+            m_records.push_back(&m_allRecords[i]);
+        }
+    }
+    m_cursor = 0;
+}
+
+size_t ReplayConnectionManager::recordCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records.size();
+}
+
+uint64_t ReplayConnectionManager::commandCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_commandCount;
+}
+
+uint64_t ReplayConnectionManager::skippedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_skippedCount;
+}
+
+uint64_t ReplayConnectionManager::unmatchedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_unmatchedCount;
+}
+
+// ============================================================================
+// TCTI 回调函数
+// ============================================================================
+TSS2_RC ReplayConnectionManager::Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command)
+{
+    ReplayConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->transmit(size, command) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC ReplayConnectionManager::Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response,
+        int32_t timeout)
+{
+    ReplayConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->receive(size, response, timeout) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+void ReplayConnectionManager::Finalize(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    // 资源由 disconnect() 和析构函数释放
+}
+
+TSS2_RC ReplayConnectionManager::Cancel(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    ReplayConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->cancel() : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC ReplayConnectionManager::GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles,
+        size_t *num_handles)
+{
+    ReplayConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? owner->getPollHandles(handles, num_handles) : TSS2_TCTI_RC_BAD_CONTEXT;
+}
+
+TSS2_RC ReplayConnectionManager::SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality)
+{
+    ReplayConnectionManager *owner = OwnerOf(tctiContext);
+    return owner ? TSS2_RC_SUCCESS : TSS2_TCTI_RC_BAD_CONTEXT; // 录制文件不区分 locality
+}
+
+const TctiRecord *ReplayConnectionManager::match(const uint8_t *command, size_t size)
+{
+    const size_t n = m_records.size();
+    if (0 == n) {
+        return NULL;
+    }
+    const size_t remaining = m_loop ? n : n - m_cursor;
+    size_t found = remaining;
+
+    const size_t lookahead = (LOOKAHEAD < remaining) ? LOOKAHEAD : remaining;
+    for (size_t k = 0; k < lookahead; k++) {
+        const TctiRecord *record = m_records[(m_cursor + k) % n];
+        if (record->command.size() == size && 0 == memcmp(record->command.data(), command, size)) {
+            found = k;
+            break;
+        }
+    }
+    if (found == remaining) {
+        const uint32_t commandCode = CodeOfFrame(command, size);
+        // 同样只在窗口内查找: 客户端多发出一条命令时不能跳过整个录制文件
+        for (size_t k = 0; k < lookahead; k++) {
+            const TctiRecord *record = m_records[(m_cursor + k) % n];
+            if (CodeOfFrame(record->command.data(), record->command.size()) == commandCode) {
+                found = k;
+                break;
+            }
+        }
+    }
+    if (found == remaining) {
+        return NULL; // 匹配位置保持不变
+    }
+
+    const size_t index = (m_cursor + found) % n;
+    m_skippedCount += found;
+    m_cursor = index + 1;
+    if (m_loop && m_cursor >= n) {
+        m_cursor = 0;
+    }
+    return m_records[index];
+}
+
+TSS2_RC ReplayConnectionManager::transmit(size_t size, const uint8_t *command)
+{
+    if (!command) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE; // 上一条命令的应答尚未取走
+    }
+
+    Clock::duration delay = Clock::duration::zero();
+    const TctiRecord *record = match(command, size);
+    if (record) {
+        m_response = record->response;
+        m_responseRc = record->rc;
+        delay = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::nano>(record->latencyNs * m_timeScale));
+    } else {
+        // 找不到匹配的记录: 返回 TPM_RC_FAILURE
+        static const uint8_t failure[] = {
+            0x80, 0x01, // TPM_ST_NO_SESSIONS
+            0x00, 0x00, 0x00, 0x0A, // responseSize
+            0x00, 0x00, 0x01, 0x01, // TPM_RC_FAILURE
+        };
+        m_response.assign(failure, failure + sizeof(failure));
+        m_responseRc = TSS2_RC_SUCCESS;
+        m_unmatchedCount++;
+    }
+    m_commandCount++;
+    m_readyTime = Clock::now() + delay;
+    m_responsePending = true;
+    armTimer(delay);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC ReplayConnectionManager::receive(size_t *size, uint8_t *response, int32_t timeout)
+{
+    if (!size) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    const Clock::time_point readyTime = m_readyTime;
+    const Clock::time_point now = Clock::now();
+    if (now < readyTime) {
+        if (TSS2_TCTI_TIMEOUT_NONE == timeout) {
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        // 等待期间释放锁, 以便其他线程查询统计信息
+        lock.unlock();
+        if (timeout > 0 && now + std::chrono::milliseconds(timeout) < readyTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        }
+        std::this_thread::sleep_until(readyTime);
+        lock.lock();
+        if (!m_responsePending) { // 等待期间命令被取消
+            return TSS2_TCTI_RC_BAD_SEQUENCE;
+        }
+    }
+    if (m_responseRc) { // 录制时 receive() 本身就失败了, 原样重现
+        m_responsePending = false;
+        disarmTimer();
+        return m_responseRc;
+    }
+    if (!response) { // 只查询应答帧长度
+        *size = m_response.size();
+        return TSS2_RC_SUCCESS;
+    }
+    if (*size < m_response.size()) {
+        *size = m_response.size();
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy(response, m_response.data(), m_response.size());
+    *size = m_response.size();
+    m_responsePending = false;
+    disarmTimer();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC ReplayConnectionManager::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_responsePending) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    m_responsePending = false;
+    disarmTimer();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC ReplayConnectionManager::getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles)
+{
+    if (!num_handles) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (m_timerFd < 0) {
+        return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+    }
+    if (!handles) {
+        *num_handles = 1;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*num_handles < 1) {
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    handles[0].fd = m_timerFd;
+    handles[0].events = POLLIN;
+    handles[0].revents = 0;
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+// ============================================================================
+// 轮询句柄
+// ============================================================================
+void ReplayConnectionManager::armTimer(Clock::duration delay)
+{
+    if (m_timerFd < 0) {
+        return;
+    }
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+    struct itimerspec spec;
+    memset(&spec, 0x00, sizeof(spec));
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if (0 == spec.it_value.tv_sec && 0 == spec.it_value.tv_nsec) {
+        spec.it_value.tv_nsec = 1; // 全 0 表示停止计时器, 用 1 纳秒代替
+    }
+    timerfd_settime(m_timerFd, 0, &spec, NULL);
+}
+
+void ReplayConnectionManager::disarmTimer()
+{
+    if (m_timerFd < 0) {
+        return;
+    }
+    struct itimerspec spec;
+    memset(&spec, 0x00, sizeof(spec));
+    timerfd_settime(m_timerFd, 0, &spec, NULL);
+}
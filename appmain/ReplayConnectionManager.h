@@ -0,0 +1,122 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef REPLAY_CONNECTION_MANAGER_H_
+#define REPLAY_CONNECTION_MANAGER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include "ConnectionManager.h"
+#include "TctiRecorder.h"
+
+/// 重放连接管理器
+///
+/// 读取 TctiRecorder 录制的文件, 不连接任何 TPM, 对客户端发出的每个命令帧返回录制时对应的应答帧,
+/// 应答在录制时的延迟乘以 configTimeScale() 设定的系数之后才能被取走. 用于在没有 TPM 的机器上
+/// 以真实负载对比新旧版本客户端代码的吞吐量.
+///
+/// 命令帧的匹配规则: 从上一次匹配位置之后开始,
+/// - 优先在随后 LOOKAHEAD 条记录中查找字节完全相同的命令帧
+/// - 否则在同样的 LOOKAHEAD 条记录中取第一条命令码相同的记录(会话随机数等字段每次运行都不同, 因此命令帧通常不会完全相同)
+/// - 仍找不到时返回应答码为 TPM_RC_FAILURE 的应答帧, 计入 unmatchedCount(), 匹配位置保持不变
+///
+/// 客户端以与录制时相同的顺序发出命令时(例如重复运行同一个程序), 每条命令都能匹配到原来的应答,
+/// 录制时 TPM 返回的句柄也会原样返回给客户端, 因此后续引用这些句柄的命令同样能够匹配.
+///
+/// 与 MockTPMConnectionManager 相同, 非阻塞 receive() 在应答就绪前返回 TSS2_TCTI_RC_TRY_AGAIN,
+/// getPollHandles() 返回在应答就绪时变为可读的 timerfd.
+class ReplayConnectionManager: public ConnectionManager {
+public:
+    /// 在随后多少条记录中查找匹配的命令帧
+    static const size_t LOOKAHEAD = 64;
+
+    /**
+     * 构造函数: 读取录制文件
+     *
+     * @throws std::ios::failure 文件无法打开时抛出
+     * @throws std::runtime_error 文件格式错误时抛出
+     */
+    ReplayConnectionManager(const char *fileName);
+    /// 析构函数
+    ~ReplayConnectionManager();
+    /// 初始化重放 TCTI, 从第一条记录开始重放
+    void connect();
+    /// 主动断开连接
+    void disconnect();
+    ///
+    void initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize);
+
+    /// 设定延迟缩放系数: 1.0 为原始延迟(默认), 0 为立即应答, 0.5 模拟快一倍的 TPM
+    void configTimeScale(double scale);
+    /// 只重放指定通道的记录(录制文件中混有多个连接时使用). 默认 -1 表示按文件顺序重放全部记录
+    void configChannel(int channel);
+    /// 记录用完之后是否从头开始重放(默认 false)
+    void configLoop(bool loop);
+
+    /// 参与重放的记录条数
+    size_t recordCount() const;
+    /// 已应答的命令条数
+    uint64_t commandCount() const;
+    /// 匹配时被跳过的记录条数(客户端没有发出的命令)
+    uint64_t skippedCount() const;
+    /// 找不到匹配记录的命令条数
+    uint64_t unmatchedCount() const;
+
+private:
+    struct ReplayTctiContext;
+    typedef std::chrono::steady_clock Clock;
+
+    static ReplayConnectionManager *OwnerOf(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC Transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size, uint8_t *command);
+    static TSS2_RC Receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response, int32_t timeout);
+    static void Finalize(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC Cancel(TSS2_TCTI_CONTEXT *tctiContext);
+    static TSS2_RC GetPollHandles(TSS2_TCTI_CONTEXT *tctiContext, TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    static TSS2_RC SetLocality(TSS2_TCTI_CONTEXT *tctiContext, uint8_t locality);
+
+    TSS2_RC transmit(size_t size, const uint8_t *command);
+    TSS2_RC receive(size_t *size, uint8_t *response, int32_t timeout);
+    TSS2_RC cancel();
+    TSS2_RC getPollHandles(TSS2_TCTI_POLL_HANDLE *handles, size_t *num_handles);
+    const TctiRecord *match(const uint8_t *command, size_t size);
+    void selectRecords();
+    void armTimer(Clock::duration delay);
+    void disarmTimer();
+
+    std::vector<TctiRecord> m_allRecords; ///< 录制文件中的全部记录
+    ReplayTctiContext *m_tctiContext;
+    int m_timerFd; ///< 轮询句柄, 应答就绪时可读
+
+    mutable std::mutex m_mutex;
+    std::vector<const TctiRecord *> m_records; ///< 参与重放的记录, 按录制顺序排列
+    size_t m_cursor; ///< 下一次匹配的起始位置
+    double m_timeScale;
+    int m_channel;
+    bool m_loop;
+
+    std::vector<uint8_t> m_response;
+    TSS2_RC m_responseRc;
+    bool m_responsePending;
+    Clock::time_point m_readyTime;
+    uint64_t m_commandCount;
+    uint64_t m_skippedCount;
+    uint64_t m_unmatchedCount;
+
+    // 禁止复制
+    ReplayConnectionManager(const ReplayConnectionManager&);
+    ReplayConnectionManager& operator=(const ReplayConnectionManager&);
+};
+
+#endif // __cplusplus
+#endif // REPLAY_CONNECTION_MANAGER_H_
@@ -3,6 +3,7 @@
 // All rights reserved.
 
 #include <sstream>
+#include <chrono>
 using std::ostringstream;
 #include <stdexcept>
 using std::runtime_error;
@@ -33,8 +34,83 @@ inline static int NoPrintf()
 #define fprintf(fp, ...) NoPrintf()
 #endif
 
+// ============================================================================
+// 序列句柄授权区
+// ============================================================================
+SequenceAuthorization::SequenceAuthorization() {
+    m_cmdAuth.sessionHandle = TPM_RS_PW;
+    m_cmdAuth.nonce.t.size = 0;
+    m_cmdAuth.sessionAttributes.val = 0x0;
+    m_cmdAuth.hmac.t.size = 0;
+    m_cmdAuthPointers[0] = &m_cmdAuth;
+    m_cmdAuthPointers[1] = m_cmdAuthPointers[2] = NULL;
+    m_cmdAuthsArray.cmdAuths = m_cmdAuthPointers;
+    m_cmdAuthsArray.cmdAuthsCount = 1;
+
+    memset(&m_rspAuth, 0x00, sizeof(m_rspAuth));
+    m_rspAuthPointers[0] = &m_rspAuth;
+    m_rspAuthPointers[1] = m_rspAuthPointers[2] = NULL;
+    m_rspAuthsArray.rspAuths = m_rspAuthPointers;
+    m_rspAuthsArray.rspAuthsCount = 1;
+}
+
+SequenceAuthorization::~SequenceAuthorization() {
+    erase();
+}
+
+void SequenceAuthorization::configPassword(const TPM2B_AUTH& password) {
+    m_cmdAuth.sessionHandle = TPM_RS_PW;
+    m_cmdAuth.nonce.t.size = 0;
+    m_cmdAuth.sessionAttributes.val = 0x0;
+    m_cmdAuth.hmac = password; // 密码
+}
+
+void SequenceAuthorization::erase() {
+    memset(m_cmdAuth.hmac.t.buffer, 0xFF, sizeof(m_cmdAuth.hmac.t.buffer));
+    m_cmdAuth.hmac.t.size = 0;
+}
+
+const TSS2_SYS_CMD_AUTHS *SequenceAuthorization::cmdAuths() const {
+    return &m_cmdAuthsArray;
+}
+
+TSS2_SYS_RSP_AUTHS *SequenceAuthorization::rspAuths() {
+    m_rspAuthsArray.rspAuthsCount = m_cmdAuthsArray.cmdAuthsCount;
+    return &m_rspAuthsArray;
+}
+
+/// 发送一条 TPM2_SequenceUpdate 命令(Hash 序列和 HMAC 序列共用)
+///
+/// 与 Tss2_Sys_SequenceUpdate() 不同, 数据直接从调用者的缓冲区编组到 System API 命令帧中,
+/// 不必先复制到 TPM2B_MAX_BUFFER 结构体中转
+///
+/// @param data 数据包, 长度不超过 MAX_DIGEST_BUFFER=1024 字节
+/// @param size 数据包长度
+/// @return TPM 返回码, 0 表示成功
+static TPM_RC SequenceUpdateFromBuffer(TSS2_SYS_CONTEXT *sysContext, TPMI_DH_OBJECT sequenceHandle, const TSS2_SYS_CMD_AUTHS *cmdAuthsArray, const BYTE *data, UINT16 size, TSS2_SYS_RSP_AUTHS *rspAuthsArray) {
+    TPM_RC err;
+    err = Tss2_Sys_SequenceUpdate_Prepare(sysContext, sequenceHandle, (TPM2B_MAX_BUFFER *) NULL); // 数据参数先留空
+    if (err) {
+        return err;
+    }
+    err = Tss2_Sys_SetDecryptParam(sysContext, size, data); // 将数据直接填入命令帧中的第一个参数
+    if (err) {
+        return err;
+    }
+    err = Tss2_Sys_SetCmdAuths(sysContext, cmdAuthsArray);
+    if (err) {
+        return err;
+    }
+    err = Tss2_Sys_Execute(sysContext);
+    if (err) {
+        return err;
+    }
+    return Tss2_Sys_GetRspAuths(sysContext, rspAuthsArray);
+}
+
 // (函数描述参见头文件中的定义)
 HMACSequenceScheduler::HMACSequenceScheduler() {
+    m_pKeyHandleCache = NULL;
     m_savedSequenceHandle = 0x0;
     m_cachedData.t.size = 0;
     m_hmacDigest.t.size = 0;
@@ -53,66 +129,46 @@ void HMACSequenceScheduler::inputData(const void *data_, unsigned int length) {
         throw runtime_error("HMACSequenceScheduler::inputData(): 函数调用次序错误, 请先调用start()");
     }
 
-    TPMS_AUTH_COMMAND *cmdAuths[3];
-    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
-    TPMS_AUTH_COMMAND cmdAuthBlob;
-    cmdAuthBlob.sessionHandle = TPM_RS_PW;
-    cmdAuthBlob.nonce.t.size = 0;
-    cmdAuthBlob.sessionAttributes.val = 0x0;
-    cmdAuthBlob.hmac = m_savedAuthValueForSequenceHandle; // 密码
-    cmdAuths[0] = &cmdAuthBlob;
-    cmdAuths[1] = cmdAuths[2] = NULL;
-    cmdAuthsArray.cmdAuths = cmdAuths;
-    cmdAuthsArray.cmdAuthsCount = 1;
-
-
-    TPMS_AUTH_RESPONSE *rspAuths[3];
-    TSS2_SYS_RSP_AUTHS rspAuthsArray;
-    TPMS_AUTH_RESPONSE rspAuthBlob;
-    memset(&rspAuthBlob, 0x00, sizeof(rspAuthBlob));
-    rspAuths[0] = &rspAuthBlob;
-    rspAuths[1] = rspAuths[2] = NULL;
-    rspAuthsArray.rspAuths = rspAuths;
-    rspAuthsArray.rspAuthsCount = cmdAuthsArray.cmdAuthsCount;
-
     const BYTE *data = (const BYTE *) data_;
-
     const size_t MaxBufferSize = sizeof(m_cachedData.t.buffer);
-    const size_t leftBufferSize = MaxBufferSize - m_cachedData.t.size;
+    TPM_RC err = 0;
 
-    size_t n;
-    n = length;
-    if (length > leftBufferSize) {
-        n = leftBufferSize;
-    }
-    memcpy(m_cachedData.t.buffer+m_cachedData.t.size, data, n);
-    m_cachedData.t.size += n;
-    data += n;
-    length -= n;
-    if (m_cachedData.t.size < MaxBufferSize) {
-        // 发现尚未凑满一个1024字节数据包, 所以此时不必发送任何数据
-        return;
+    if (m_cachedData.t.size > 0) { // 先用新数据补齐上次余留的不完整数据包
+        const size_t leftBufferSize = MaxBufferSize - m_cachedData.t.size;
+        size_t n = length;
+        if (length > leftBufferSize) {
+            n = leftBufferSize;
+        }
+        memcpy(m_cachedData.t.buffer + m_cachedData.t.size, data, n);
+        m_cachedData.t.size += n;
+        data += n;
+        length -= n;
+        if (m_cachedData.t.size < MaxBufferSize) {
+            // 发现尚未凑满一个1024字节数据包, 所以此时不必发送任何数据
+            return;
+        }
+        const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
+        err = SequenceUpdateFromBuffer(m_sysContext, m_savedSequenceHandle, m_authorization.cmdAuths(), m_cachedData.t.buffer, m_cachedData.t.size, m_authorization.rspAuths());
+        recordStatistics(TPM_CC_SequenceUpdate, transmitTime, err);
+        if (err) {
+            std::ostringstream msg;
+            msg << "HMACSequenceScheduler::inputData(): TPM Command Tss2_Sys_SequenceUpdate() has returned an error code 0x" << std::hex << err;
+            throw runtime_error(msg.str());
+        }
+        m_cachedData.t.size = 0;
     }
 
-    length = length + m_cachedData.t.size;
-    while (length >= MaxBufferSize) { // 每轮发送1024字节
-        TPM_RC err = 0;
-        err = Tss2_Sys_SequenceUpdate(m_sysContext,
-                m_savedSequenceHandle, // OUT
-                &cmdAuthsArray, // IN
-                &m_cachedData, // IN
-                &rspAuthsArray /* OUT */);
+    while (length >= MaxBufferSize) { // 完整的1024字节数据包直接从调用者的缓冲区发送, 不再复制到 m_cachedData
+        const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
+        err = SequenceUpdateFromBuffer(m_sysContext, m_savedSequenceHandle, m_authorization.cmdAuths(), data, (UINT16) MaxBufferSize, m_authorization.rspAuths());
+        recordStatistics(TPM_CC_SequenceUpdate, transmitTime, err);
         if (err) {
             std::ostringstream msg;
             msg << "HMACSequenceScheduler::inputData(): TPM Command Tss2_Sys_SequenceUpdate() has returned an error code 0x" << std::hex << err;
             throw runtime_error(msg.str());
         }
+        data += MaxBufferSize;
         length -= MaxBufferSize;
-        if (length >= MaxBufferSize) {
-            memcpy(m_cachedData.t.buffer, data, MaxBufferSize);
-            m_cachedData.t.size = MaxBufferSize;
-            data += MaxBufferSize;
-        }
     }
     if (length > 0) { // 缓存最后余留的数据(不足1024字节), 留待下轮凑满1024字节后再发送
         memcpy(m_cachedData.t.buffer, data, length);
@@ -136,41 +192,22 @@ void HMACSequenceScheduler::complete() {
         throw runtime_error("HMACSequenceScheduler::complete(): 函数调用次序错误, 请先调用start()");
     }
 
-    TPMS_AUTH_COMMAND *cmdAuths[3];
-    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
-    TPMS_AUTH_COMMAND cmdAuthBlob;
-    cmdAuthBlob.sessionHandle = TPM_RS_PW;
-    cmdAuthBlob.nonce.t.size = 0;
-    cmdAuthBlob.sessionAttributes.val = 0x0;
-    cmdAuthBlob.hmac = m_savedAuthValueForSequenceHandle; // 密码
-    cmdAuths[0] = &cmdAuthBlob;
-    cmdAuths[1] = cmdAuths[2] = NULL;
-    cmdAuthsArray.cmdAuths = cmdAuths;
-    cmdAuthsArray.cmdAuthsCount = 1;
-
-    TPMS_AUTH_RESPONSE *rspAuths[3];
-    TSS2_SYS_RSP_AUTHS rspAuthsArray;
-    TPMS_AUTH_RESPONSE rspAuthBlob;
-    memset(&rspAuthBlob, 0x00, sizeof(rspAuthBlob));
-    rspAuths[0] = &rspAuthBlob;
-    rspAuths[1] = rspAuths[2] = NULL;
-    rspAuthsArray.rspAuths = rspAuths;
-    rspAuthsArray.rspAuthsCount = cmdAuthsArray.cmdAuthsCount;
-
     TPMI_RH_HIERARCHY hierarchy;
     hierarchy = TPM_RH_NULL; // TODO: 应该允许用户自定义修改validationTicket的hierarchy
 
     m_hmacDigest.t.size = sizeof(m_hmacDigest.t.buffer);
 
     TPM_RC err = 0;
+    const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
     err = Tss2_Sys_SequenceComplete(m_sysContext,
             m_savedSequenceHandle, // IN
-            &cmdAuthsArray, // IN
+            m_authorization.cmdAuths(), // IN
             &m_cachedData, // IN
             hierarchy, // IN
             &m_hmacDigest, // OUT
             &m_validationTicket, // OUT
-            &rspAuthsArray); //
+            m_authorization.rspAuths()); //
+    recordStatistics(TPM_CC_SequenceComplete, transmitTime, err);
     if (err) {
         std::ostringstream msg;
         msg << "HMACSequenceScheduler::complete(): TPM Command Tss2_Sys_SequenceComplete() has returned an error code 0x" << std::hex << err;
@@ -178,33 +215,48 @@ void HMACSequenceScheduler::complete() {
     }
 }
 
+// HMAC序列调度器 -- 指定密钥句柄缓存. (功能描述参见头文件中的定义)
+void HMACSequenceScheduler::configKeyHandleCache(KeyHandleCache *pCache) {
+    m_pKeyHandleCache = pCache;
+}
+
 // HMAC序列调度器 -- 子函数 start(). (功能描述参见头文件中的定义)
 void HMACSequenceScheduler::start(TPMI_ALG_HASH hashAlgorithm, const void *key, unsigned int keyLen, const void *keyPassword, unsigned int keyPasswordLen) {
     TPMI_RH_HIERARCHY hierarchy = TPM_RH_NULL; // 在 TPM_RH_NULL 区域创建的节点是临时密钥节点
     TPM_HANDLE keyHandle = 0xFC000000;
-    TPMCommands::LoadExternal loadextn;
-    try {
-        printf("设置 LoadExternal 命令帧参数\n");
-        loadextn.configHierarchy(hierarchy);
-        loadextn.configSensitiveDataBits(key, keyLen);
-        loadextn.configKeyTypeKeyedHashKey();
-        loadextn.configKeyAuthValue(keyPassword, keyPasswordLen);
-        printf("发送 LoadExternal 命令桢创建临时节点(用于存储用户输入的自定义对称密钥)\n");
-        sendCommand(loadextn);
-        fetchResponse();
-        printf("临时节点创建成功, 密钥句柄=0x%08X\n", (int)loadextn.outObjectHandle());
-        keyHandle = loadextn.outObjectHandle();
-    } catch (TSS2_RC rc) {
-        std::ostringstream msg;
-        msg << "加载外部密钥失败: TPM Command LoadExternal() has returned an error code 0x" << std::hex << rc;
-        throw std::runtime_error(msg.str());
-    } catch (...) {
-        throw std::runtime_error("加载外部密钥失败: Unknown error happened in TPM command LoadExternal()\n");
-    }
+    if (m_pKeyHandleCache) {
+        try {
+            keyHandle = m_pKeyHandleCache->loadExternalKeyedHashKey(*this, key, keyLen, keyPassword, keyPasswordLen, hierarchy);
+        } catch (TSS2_RC rc) {
+            std::ostringstream msg;
+            msg << "加载外部密钥失败: KeyHandleCache::loadExternalKeyedHashKey() has returned an error code 0x" << std::hex << rc;
+            throw std::runtime_error(msg.str());
+        }
+    } else {
+        TPMCommands::LoadExternal loadextn;
+        try {
+            printf("设置 LoadExternal 命令帧参数\n");
+            loadextn.configHierarchy(hierarchy);
+            loadextn.configSensitiveDataBits(key, keyLen);
+            loadextn.configKeyTypeKeyedHashKey();
+            loadextn.configKeyAuthValue(keyPassword, keyPasswordLen);
+            printf("发送 LoadExternal 命令桢创建临时节点(用于存储用户输入的自定义对称密钥)\n");
+            sendCommand(loadextn);
+            fetchResponse();
+            printf("临时节点创建成功, 密钥句柄=0x%08X\n", (int)loadextn.outObjectHandle());
+            keyHandle = loadextn.outObjectHandle();
+        } catch (TSS2_RC rc) {
+            std::ostringstream msg;
+            msg << "加载外部密钥失败: TPM Command LoadExternal() has returned an error code 0x" << std::hex << rc;
+            throw std::runtime_error(msg.str());
+        } catch (...) {
+            throw std::runtime_error("加载外部密钥失败: Unknown error happened in TPM command LoadExternal()\n");
+        }
 
-    char buf[keyLen];
-    memset(buf, 0xFF, keyLen);
-    loadextn.configSensitiveDataBits(buf, keyLen); // 手动覆盖清除之前缓存的对称密钥值副本(清除敏感数据)
+        char buf[keyLen];
+        memset(buf, 0xFF, keyLen);
+        loadextn.configSensitiveDataBits(buf, keyLen); // 手动覆盖清除之前缓存的对称密钥值副本(清除敏感数据)
+    }
 
     TPMS_AUTH_COMMAND *cmdAuths[3];
     TSS2_SYS_CMD_AUTHS cmdAuthsArray;
@@ -243,6 +295,7 @@ void HMACSequenceScheduler::start(TPMI_ALG_HASH hashAlgorithm, const void *key,
     }
 
     m_savedSequenceHandle = 0x0; // 方便调试
+    const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
     TPM_RC rc = Tss2_Sys_HMAC_Start(m_sysContext,
             keyHandle, // IN
             &cmdAuthsArray, // IN
@@ -250,6 +303,7 @@ void HMACSequenceScheduler::start(TPMI_ALG_HASH hashAlgorithm, const void *key,
             hashAlgorithm, // IN
             &sequenceHandle, // OUT
             &rspAuthsArray /* OUT */);
+    recordStatistics(TPM_CC_HMAC_Start, transmitTime, rc);
     memset(&cmdAuthBlob, 0xFF, sizeof(cmdAuthBlob)); // 立即清除局部变量中缓存的密码
     if (rc) {
         std::ostringstream msg;
@@ -257,6 +311,7 @@ void HMACSequenceScheduler::start(TPMI_ALG_HASH hashAlgorithm, const void *key,
         throw std::runtime_error(msg.str());
     }
     m_savedSequenceHandle = sequenceHandle;
+    m_authorization.configPassword(m_savedAuthValueForSequenceHandle); // 构建一次授权区, 此后每个数据包直接复用
     m_cachedData.t.size = 0;
 }
 
@@ -287,18 +342,21 @@ void HashSequenceScheduler::start(TPMI_ALG_HASH hashAlgorithm) {
 
     sequenceHandle = 0x0; // 方便调试
     m_savedAuthValueForSequenceHandle.t.size = 0; // TODO: 允许自定义HashSequence密码
+    const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
     TPM_RC rc = Tss2_Sys_HashSequenceStart(m_sysContext,
             (TSS2_SYS_CMD_AUTHS const *) NULL, // IN
             &m_savedAuthValueForSequenceHandle, // IN
             hashAlgorithm, // IN
             &sequenceHandle, // OUT
             (TSS2_SYS_RSP_AUTHS *) NULL /* OUT */);
+    recordStatistics(TPM_CC_HashSequenceStart, transmitTime, rc);
     if (rc) {
         std::ostringstream msg;
         msg << "HashSequenceScheduler::start(): TPM Command Tss2_Sys_HashSequenceStart() has returned an error code 0x" << std::hex << rc;
         throw std::runtime_error(msg.str());
     }
     m_savedSequenceHandle = sequenceHandle;
+    m_authorization.configPassword(m_savedAuthValueForSequenceHandle); // 构建一次授权区, 此后每个数据包直接复用
     m_cachedData.t.size = 0;
 }
 
@@ -308,68 +366,47 @@ void HashSequenceScheduler::inputData(const void *data_, unsigned int length) {
         throw std::runtime_error("HashSequenceScheduler::inputData(): 函数调用次序错误, 请先调用start()");
     }
 
-    TPMS_AUTH_COMMAND *cmdAuths[3];
-    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
-    TPMS_AUTH_COMMAND cmdAuthBlob;
-    cmdAuthBlob.sessionHandle = TPM_RS_PW;
-    cmdAuthBlob.nonce.t.size = 0;
-    cmdAuthBlob.sessionAttributes.val = 0x0;
-    cmdAuthBlob.hmac = m_savedAuthValueForSequenceHandle; // 密码
-    cmdAuths[0] = &cmdAuthBlob;
-    cmdAuths[1] = cmdAuths[2] = NULL;
-    cmdAuthsArray.cmdAuths = cmdAuths;
-    cmdAuthsArray.cmdAuthsCount = 1;
-
-    TPMS_AUTH_RESPONSE *rspAuths[3];
-    TSS2_SYS_RSP_AUTHS rspAuthsArray;
-    TPMS_AUTH_RESPONSE rspAuthBlob;
-    memset(&rspAuthBlob, 0x00, sizeof(rspAuthBlob));
-    rspAuths[0] = &rspAuthBlob;
-    rspAuths[1] = rspAuths[2] = NULL;
-    rspAuthsArray.rspAuths = rspAuths;
-    rspAuthsArray.rspAuthsCount = cmdAuthsArray.cmdAuthsCount;
-
     const BYTE *data = (const BYTE *) data_;
-
     const size_t MaxBufferSize = sizeof(m_cachedData.t.buffer);
-    const size_t leftBufferSize = MaxBufferSize - m_cachedData.t.size;
+    TPM_RC err = 0;
 
-    size_t n;
-    n = length;
-    if (length > leftBufferSize) {
-        n = leftBufferSize;
-    }
-    memcpy(m_cachedData.t.buffer+m_cachedData.t.size, data, n);
-    m_cachedData.t.size += n;
-    data += n;
-    length -= n;
-    if (m_cachedData.t.size < MaxBufferSize) {
-        // 发现尚未凑满一个1024字节数据包, 所以此时不必发送任何数据
-        return;
+    if (m_cachedData.t.size > 0) { // 先用新数据补齐上次余留的不完整数据包
+        const size_t leftBufferSize = MaxBufferSize - m_cachedData.t.size;
+        size_t n = length;
+        if (length > leftBufferSize) {
+            n = leftBufferSize;
+        }
+        memcpy(m_cachedData.t.buffer + m_cachedData.t.size, data, n);
+        m_cachedData.t.size += n;
+        data += n;
+        length -= n;
+        if (m_cachedData.t.size < MaxBufferSize) {
+            // 发现尚未凑满一个1024字节数据包, 所以此时不必发送任何数据
+            return;
+        }
+        const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
+        err = SequenceUpdateFromBuffer(m_sysContext, m_savedSequenceHandle, m_authorization.cmdAuths(), m_cachedData.t.buffer, m_cachedData.t.size, m_authorization.rspAuths());
+        recordStatistics(TPM_CC_SequenceUpdate, transmitTime, err);
+        if (err) {
+            std::ostringstream msg;
+            msg << "HashSequenceScheduler::inputData(): TPM Command Tss2_Sys_SequenceUpdate() has returned an error code 0x" << std::hex << err;
+            throw std::runtime_error(msg.str());
+        }
+        m_cachedData.t.size = 0;
     }
 
-    length = length + m_cachedData.t.size;
-    while (length >= MaxBufferSize) { // 每轮发送1024字节
+    while (length >= MaxBufferSize) { // 完整的1024字节数据包直接从调用者的缓冲区发送, 不再复制到 m_cachedData
         printf("调试信息: length=%d\n", length);
-        printf("调试信息: m_cachedData.t.size=%d\n", m_cachedData.t.size);
-        TPM_RC err = 0;
-        err = Tss2_Sys_SequenceUpdate(m_sysContext,
-                m_savedSequenceHandle, // OUT
-                &cmdAuthsArray, // IN
-                &m_cachedData, // IN
-                &rspAuthsArray /* OUT */);
+        const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
+        err = SequenceUpdateFromBuffer(m_sysContext, m_savedSequenceHandle, m_authorization.cmdAuths(), data, (UINT16) MaxBufferSize, m_authorization.rspAuths());
+        recordStatistics(TPM_CC_SequenceUpdate, transmitTime, err);
         if (err) {
             std::ostringstream msg;
             msg << "HashSequenceScheduler::inputData(): TPM Command Tss2_Sys_SequenceUpdate() has returned an error code 0x" << std::hex << err;
             throw std::runtime_error(msg.str());
         }
+        data += MaxBufferSize;
         length -= MaxBufferSize;
-        if (length >= MaxBufferSize)
-        {
-            memcpy(m_cachedData.t.buffer, data, MaxBufferSize);
-            m_cachedData.t.size = MaxBufferSize;
-            data += MaxBufferSize;
-        }
     }
     if (length > 0) { // 缓存最后余留的数据(不足1024字节), 留待下轮凑满1024字节后再发送
         memcpy(m_cachedData.t.buffer, data, length);
@@ -394,27 +431,6 @@ void HashSequenceScheduler::complete() {
         throw std::runtime_error("HashSequenceScheduler::complete(): 函数调用次序错误, 请先调用start()");
     }
 
-    TPMS_AUTH_COMMAND *cmdAuths[3];
-    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
-    TPMS_AUTH_COMMAND cmdAuthBlob;
-    cmdAuthBlob.sessionHandle = TPM_RS_PW;
-    cmdAuthBlob.nonce.t.size = 0;
-    cmdAuthBlob.sessionAttributes.val = 0x0;
-    cmdAuthBlob.hmac = m_savedAuthValueForSequenceHandle; // 密码
-    cmdAuths[0] = &cmdAuthBlob;
-    cmdAuths[1] = cmdAuths[2] = NULL;
-    cmdAuthsArray.cmdAuths = cmdAuths;
-    cmdAuthsArray.cmdAuthsCount = 1;
-
-    TPMS_AUTH_RESPONSE *rspAuths[3];
-    TSS2_SYS_RSP_AUTHS rspAuthsArray;
-    TPMS_AUTH_RESPONSE rspAuthBlob;
-    memset(&rspAuthBlob, 0x00, sizeof(rspAuthBlob));
-    rspAuths[0] = &rspAuthBlob;
-    rspAuths[1] = rspAuths[2] = NULL;
-    rspAuthsArray.rspAuths = rspAuths;
-    rspAuthsArray.rspAuthsCount = cmdAuthsArray.cmdAuthsCount;
-
     TPMI_RH_HIERARCHY hierarchy;
     hierarchy = TPM_RH_NULL; // TODO: 应该允许用户自定义修改validationTicket的hierarchy
 
@@ -422,14 +438,16 @@ void HashSequenceScheduler::complete() {
 
     printf("调试信息: m_cachedData.t.size=%d\n", m_cachedData.t.size);
     TPM_RC err = 0;
+    const std::chrono::steady_clock::time_point transmitTime = std::chrono::steady_clock::now();
     err = Tss2_Sys_SequenceComplete(m_sysContext,
             m_savedSequenceHandle, // IN
-            &cmdAuthsArray, // IN
+            m_authorization.cmdAuths(), // IN
             &m_cachedData, // IN
             hierarchy, // IN
             &m_hashDigest, // OUT
             &m_validationTicket, // OUT
-            &rspAuthsArray); //
+            m_authorization.rspAuths()); //
+    recordStatistics(TPM_CC_SequenceComplete, transmitTime, err);
     if (err) {
         std::ostringstream msg;
         msg << "HashSequenceScheduler::complete(): TPM Command Tss2_Sys_SequenceComplete() has returned an error code 0x" << std::hex << err;
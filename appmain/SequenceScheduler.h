@@ -11,9 +11,45 @@
 
 #include <sapi/tpm20.h>
 #include "Client.h"
+#include "KeyHandleCache.h"
 
 #ifdef __cplusplus
 
+/// 序列句柄的授权区(Hash 序列和 HMAC 序列共用)
+///
+/// 在 start() 中构建一次, 此后每次 SequenceUpdate/SequenceComplete 直接复用,
+/// 不必为每个1024字节数据包重新填写授权数组和复制密码
+class SequenceAuthorization
+{
+public:
+    SequenceAuthorization();
+    ~SequenceAuthorization();
+
+    /// 指定序列句柄的访问密码(明文密码会话 TPM_RS_PW)
+    void configPassword(const TPM2B_AUTH& password);
+
+    /// 擦除缓存的密码
+    void erase();
+
+    /// 命令帧授权数组, 可直接传给 Tss2_Sys_SetCmdAuths() 等函数
+    const TSS2_SYS_CMD_AUTHS *cmdAuths() const;
+
+    /// 应答帧授权数组, 可直接传给 Tss2_Sys_GetRspAuths() 等函数
+    TSS2_SYS_RSP_AUTHS *rspAuths();
+
+private:
+    SequenceAuthorization(const SequenceAuthorization&); ///< 禁止复制: 内部指针数组指向对象自身的成员
+    SequenceAuthorization& operator=(const SequenceAuthorization&);
+
+private:
+    TPMS_AUTH_COMMAND m_cmdAuth;
+    TPMS_AUTH_COMMAND *m_cmdAuthPointers[3];
+    TSS2_SYS_CMD_AUTHS m_cmdAuthsArray;
+    TPMS_AUTH_RESPONSE m_rspAuth;
+    TPMS_AUTH_RESPONSE *m_rspAuthPointers[3];
+    TSS2_SYS_RSP_AUTHS m_rspAuthsArray;
+};
+
 /// Hash sequence 调度器
 class HashSequenceScheduler: public Client
 {
@@ -54,11 +90,13 @@ private:
 private:
     TPMT_TK_HASHCHECK m_validationTicket;///< 存储本次计算是由TPM完成的校验凭证
 private:
-    TPM2B_MAX_BUFFER m_cachedData;///< 预留缓存区, 提高IO效率
+    TPM2B_MAX_BUFFER m_cachedData;///< 预留缓存区, 仅缓存不足一个数据包(1024字节)的余留数据, 完整数据包直接从调用者的缓冲区发送
 private:
     TPMI_DH_OBJECT m_savedSequenceHandle;
 private:
     TPM2B_AUTH m_savedAuthValueForSequenceHandle;
+private:
+    SequenceAuthorization m_authorization; ///< 访问序列句柄时使用的授权区, 由 start() 构建
 };
 
 /// HMAC sequence 调度器
@@ -78,6 +116,12 @@ public:
     /// @throws std::exception 通过 std::exception::what() 描述错误原因
     void start(TPMI_ALG_HASH hashAlgorithm, const void *key, unsigned int keyLength, const void *keyPassword="", unsigned int keyPasswordLength=0);
 
+    /// 指定密钥句柄缓存
+    ///
+    /// 指定之后 start() 通过缓存加载 HMAC 密钥, 反复使用同一个密钥时不再重复执行 LoadExternal 命令
+    /// @param pCache 密钥句柄缓存, 必须始终配合本对象绑定的同一个 TPM 连接使用. 取值 NULL 表示不使用缓存(默认值)
+    void configKeyHandleCache(KeyHandleCache *pCache);
+
     /// HMAC序列输入下一个数据包
     ///
     /// @param data
@@ -105,11 +149,15 @@ private:
 private:
     TPMT_TK_HASHCHECK m_validationTicket;///< 存储本次计算是由TPM完成的校验凭证
 private:
-    TPM2B_MAX_BUFFER m_cachedData;///< 预留缓存区, 提高IO效率
+    TPM2B_MAX_BUFFER m_cachedData;///< 预留缓存区, 仅缓存不足一个数据包(1024字节)的余留数据, 完整数据包直接从调用者的缓冲区发送
 private:
     TPMI_DH_OBJECT m_savedSequenceHandle;
 private:
     TPM2B_AUTH m_savedAuthValueForSequenceHandle;
+private:
+    SequenceAuthorization m_authorization; ///< 访问序列句柄时使用的授权区, 由 start() 构建
+private:
+    KeyHandleCache *m_pKeyHandleCache; ///< 密钥句柄缓存, 为 NULL 时每次 start() 都执行 LoadExternal
 };
 
 #endif // __cplusplus
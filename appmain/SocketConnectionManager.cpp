@@ -10,6 +10,8 @@ using std::exception;
 #include <tcti/tcti_socket.h>
 #include "ConnectionManager.h"
 #include "SocketConnectionManager.h"
+#include "WireTracer.h"
+#include "TctiRecorder.h"
 
 /* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
 
@@ -46,6 +48,10 @@ SocketConnectionManager::SocketConnectionManager(const char *szHostname, uint16_
     }
     m_szHostname = szHostname;
     m_nPort = nPort;
+    m_pTracer = NULL;
+    m_tracedContext = NULL;
+    m_pRecorder = NULL;
+    m_recordedContext = NULL;
 }
 
 // 析构函数
@@ -59,12 +65,27 @@ SocketConnectionManager::~SocketConnectionManager()
 // 接口函数 connect()
 void SocketConnectionManager::connect()
 {
+    if (m_pTracer && !m_tracedContext) {
+        char name[300];
+        snprintf(name, sizeof(name), "socket %s:%u", m_szHostname, (unsigned int) m_nPort);
+        m_tracedContext = m_pTracer->attach(m_tctiContext, name);
+    }
+    if (m_pRecorder && !m_recordedContext) {
+        m_recordedContext = m_pRecorder->attach(m_tracedContext ? m_tracedContext : m_tctiContext);
+    }
+
     TCTI_SOCKET_CONF conf;
     conf.hostname = (const char *) m_szHostname;
     conf.port = m_nPort;
-    conf.logCallback = NULL;
-    conf.logBufferCallback = NULL;
-    conf.logData = NULL;
+    if (m_tracedContext) {
+        conf.logCallback = WireTracer::LogCallback;
+        conf.logBufferCallback = WireTracer::LogBufferCallback;
+        conf.logData = m_tracedContext;
+    } else {
+        conf.logCallback = NULL;
+        conf.logBufferCallback = NULL;
+        conf.logData = NULL;
+    }
 
     TSS2_RC tctiError;
     tctiError = InitSocketTcti(m_tctiContext, &m_tctiContextSize, &conf, 0);
@@ -103,10 +124,25 @@ void SocketConnectionManager::initializeSysContext(TSS2_SYS_CONTEXT *sysContext,
     err = Tss2_Sys_Initialize(
             sysContext,
             contextSize,
-            m_tctiContext,
+            m_recordedContext ? m_recordedContext : m_tracedContext ? m_tracedContext : m_tctiContext,
             &abiVersion);
     if (err) {
         fprintf(stderr, "Error: Tss2_Sys_Initialize() returns 0x%X\n", (int) err);
         // TODO: throw/raise an expection to the up level
     }
 }
+
+// 接口函数 configTracer()
+void SocketConnectionManager::configTracer(WireTracer *tracer)
+{
+    m_pTracer = tracer;
+    m_tracedContext = NULL; // 下次 connect() 时向新的跟踪器注册
+    m_recordedContext = NULL; // 录制器包装的是跟踪器的转发上下文, 需要重新包装
+}
+
+// 接口函数 configRecorder()
+void SocketConnectionManager::configRecorder(TctiRecorder *recorder)
+{
+    m_pRecorder = recorder;
+    m_recordedContext = NULL; // 下次 connect() 时向新的录制器注册
+}
@@ -14,6 +14,8 @@
 #ifdef __cplusplus
 
 #include "ConnectionManager.h"
+#include "WireTracer.h"
+#include "TctiRecorder.h"
 
 /// Socket 连接管理器
 class SocketConnectionManager: public ConnectionManager {
@@ -28,12 +30,22 @@ public:
     void disconnect();
     ///
     void initializeSysContext(TSS2_SYS_CONTEXT *sysContext, size_t contextSize);
+    /// 设定线路跟踪器, 必须在 connect() 之前调用. NULL 表示不跟踪(默认)
+    ///
+    /// 跟踪器的日志回调会填入 TCTI_SOCKET_CONF, 命令帧/应答帧由 WireTracer::attach() 返回的转发上下文记录
+    void configTracer(WireTracer *tracer);
+    /// 设定 TCTI 录制器, 必须在 connect() 之前调用. NULL 表示不录制(默认)
+    void configRecorder(TctiRecorder *recorder);
 
 private:
     const char *m_szHostname; ///< 主机名或主机IP地址
     unsigned short m_nPort; ///< TCP 端口号
     TSS2_TCTI_CONTEXT *m_tctiContext;
     size_t m_tctiContextSize;
+    WireTracer *m_pTracer;
+    TSS2_TCTI_CONTEXT *m_tracedContext; ///< 由 m_pTracer 持有的转发上下文, 未跟踪时为 NULL
+    TctiRecorder *m_pRecorder;
+    TSS2_TCTI_CONTEXT *m_recordedContext; ///< 由 m_pRecorder 持有的转发上下文, 未录制时为 NULL
 };
 
 #endif // __cplusplus
@@ -21,6 +21,13 @@ public:
     int m_rspAuthsCount; ///< 记录应答帧携带的 AuthValue 个数, 初始值应为 0, 执行完 unpackRspPacket() 之后会更新
     TPMS_AUTH_COMMAND m_sendAuthValues[3];
     TPMS_AUTH_RESPONSE m_fetchAuthResponse[3];
+protected:
+    /// 授权区指针数组, 构造时一次性指向 m_sendAuthValues[] / m_fetchAuthResponse[],
+    /// buildCmdPacket()/unpackRspPacket() 每次只需更新授权个数, 不再重新构建
+    TPMS_AUTH_COMMAND *m_cmdAuthPointers[3];
+    TSS2_SYS_CMD_AUTHS m_cmdAuthsArray;
+    TPMS_AUTH_RESPONSE *m_rspAuthPointers[3];
+    TSS2_SYS_RSP_AUTHS m_rspAuthsArray;
 public:
     TPMCommand();
     virtual void buildCmdPacket(TSS2_SYS_CONTEXT *ctx);
@@ -37,6 +44,10 @@ public:
             );
     /** 擦除临时缓存的密码 */
     virtual void eraseCachedAuthPassword();
+private:
+    /// 禁止复制: 授权区指针数组指向对象自身的成员
+    TPMCommand(const TPMCommand&);
+    TPMCommand& operator=(const TPMCommand&);
 };
 
 /// @namespace DigitalSignatureSchemes
@@ -133,6 +144,26 @@ public:
     virtual ~Shutdown();
 };
 
+/// 查询 TPM 自检结果
+class GetTestResult: public TPMCommand
+/// @details
+/// 不需要授权, 执行开销很小, 可用于检查 TPM 连接是否仍然可用(健康检查)
+{
+public:
+    GetTestResult();
+    virtual void buildCmdPacket(TSS2_SYS_CONTEXT *ctx);
+    virtual void unpackRspPacket(TSS2_SYS_CONTEXT *ctx);
+    virtual ~GetTestResult();
+    /**
+     * 输出自检结果
+     *
+     * @return TPM_RC_SUCCESS 表示自检全部通过, TPM_RC_TESTING 表示仍在自检中, TPM_RC_FAILURE 表示 TPM 已进入故障模式
+     */
+    TPM_RC outTestResult();
+    /** 输出厂商自定义的自检详细信息 */
+    const TPM2B_MAX_BUFFER& outData();
+};
+
 /// 哈希计算命令
 class Hash: public TPMCommand
 /// @details
@@ -0,0 +1,255 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <ios>
+#include <stdexcept>
+#include <sapi/tpm20.h>
+#include "ByteOrder.h"
+#include "ForwardingTcti.h"
+#include "TctiRecorder.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+static const char MAGIC[4] = {'T', 'R', 'E', 'C'};
+static const uint16_t TCTI_RECORD_FILE_VERSION = 1;
+static const size_t TCTI_RECORD_FILE_HEADER_SIZE = 16;
+static const size_t TCTI_RECORD_HEADER_SIZE = 32;
+
+// ============================================================================
+// 录制器
+// ============================================================================
+
+TctiRecord::TctiRecord()
+        : channel(0), startNs(0), latencyNs(0), rc(0)
+{
+}
+
+/// 录制用的转发型 TCTI 上下文
+///
+/// 同一个 TCTI 上下文同一时刻只会被一个线程使用, 因此 pending/command/startNs 不需要加锁
+struct TctiRecorder::RecordingTcti: public ForwardingTcti {
+    TctiRecorder *recorder;
+    uint32_t channel;
+    bool pending; ///< 已发出命令帧, 尚未取回应答帧
+    uint64_t startNs;
+    std::vector<uint8_t> command;
+
+    RecordingTcti(TSS2_TCTI_CONTEXT *inner, TctiRecorder *recorder, uint32_t channel);
+    TSS2_RC transmit(size_t size, uint8_t *command);
+    TSS2_RC receive(size_t *size, uint8_t *response, int32_t timeout);
+    void finalize();
+    TSS2_RC cancel();
+};
+
+// 构造函数 TctiRecorder(fileName)
+TctiRecorder::TctiRecorder(const char *fileName)
+        : m_epoch(Clock::now()), m_writeError(false), m_recordCount(0)
+{
+    if (!fileName) {
+        throw std::invalid_argument("TctiRecorder: fileName is NULL");
+    }
+    m_fileName = fileName;
+    m_fp = fopen(fileName, "wb");
+    if (!m_fp) {
+        throw std::ios::failure(std::string("Cannot create ") + fileName + ": " + strerror(errno));
+    }
+    uint8_t header[TCTI_RECORD_FILE_HEADER_SIZE];
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    PutUINT16(header + 4, TCTI_RECORD_FILE_VERSION);
+    PutUINT16(header + 6, (uint16_t) TCTI_RECORD_FILE_HEADER_SIZE);
+    PutUINT64(header + 8, (uint64_t) time(NULL));
+    if (fwrite(header, 1, sizeof(header), m_fp) != sizeof(header)) {
+        m_writeError = true;
+    }
+}
+
+// 析构函数
+TctiRecorder::~TctiRecorder()
+{
+    if (m_fp) {
+        fclose(m_fp);
+    }
+    for (size_t i = 0; i < m_recordingTctis.size(); i++) {
+        delete m_recordingTctis[i];
+    }
+}
+
+TSS2_TCTI_CONTEXT *TctiRecorder::attach(TSS2_TCTI_CONTEXT *tctiContext)
+{
+    if (!tctiContext) {
+        throw std::invalid_argument("TctiRecorder::attach(): tctiContext is NULL");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RecordingTcti *recording = new RecordingTcti(tctiContext, this, (uint32_t) m_recordingTctis.size());
+    m_recordingTctis.push_back(recording);
+    return recording->context();
+}
+
+uint64_t TctiRecorder::now() const
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_epoch).count();
+}
+
+void TctiRecorder::write(const RecordingTcti& recording, uint64_t endNs, TSS2_RC rc,
+        const uint8_t *response, size_t size)
+{
+    uint8_t header[TCTI_RECORD_HEADER_SIZE];
+    PutUINT32(header, recording.channel);
+    PutUINT64(header + 4, recording.startNs);
+    PutUINT64(header + 12, (endNs > recording.startNs) ? endNs - recording.startNs : 0);
+    PutUINT32(header + 20, rc);
+    PutUINT32(header + 24, (uint32_t) recording.command.size());
+    PutUINT32(header + 28, (uint32_t) size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_fp) {
+        return; // 已关闭
+    }
+    bool ok = (fwrite(header, 1, sizeof(header), m_fp) == sizeof(header));
+    ok = ok && (fwrite(recording.command.data(), 1, recording.command.size(), m_fp) == recording.command.size());
+    if (size > 0) {
+        ok = ok && (fwrite(response, 1, size, m_fp) == size);
+    }
+    if (!ok) {
+        m_writeError = true; // 不在 TCTI 调用路径上抛出异常, 由 flush()/close() 报告
+        return;
+    }
+    m_recordCount++;
+}
+
+uint64_t TctiRecorder::recordCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_recordCount;
+}
+
+void TctiRecorder::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fp && 0 != fflush(m_fp)) {
+        m_writeError = true;
+    }
+    if (m_writeError) {
+        throw std::ios::failure(std::string("Cannot write ") + m_fileName);
+    }
+}
+
+void TctiRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fp) {
+        if (0 != fclose(m_fp)) {
+            m_writeError = true;
+        }
+        m_fp = NULL;
+    }
+    if (m_writeError) {
+        throw std::ios::failure(std::string("Cannot write ") + m_fileName);
+    }
+}
+
+// ============================================================================
+// 录制用的转发型 TCTI 上下文
+// ============================================================================
+TctiRecorder::RecordingTcti::RecordingTcti(TSS2_TCTI_CONTEXT *inner, TctiRecorder *recorder, uint32_t channel)
+        : ForwardingTcti(inner), recorder(recorder), channel(channel), pending(false), startNs(0)
+{
+}
+
+TSS2_RC TctiRecorder::RecordingTcti::transmit(size_t size, uint8_t *command)
+{
+    const uint64_t startNs = recorder->now();
+    TSS2_RC rc = ForwardingTcti::transmit(size, command);
+    if (TSS2_RC_SUCCESS == rc && command) {
+        this->pending = true;
+        this->startNs = startNs;
+        this->command.assign(command, command + size);
+    }
+    return rc;
+}
+
+TSS2_RC TctiRecorder::RecordingTcti::receive(size_t *size, uint8_t *response, int32_t timeout)
+{
+    TSS2_RC rc = ForwardingTcti::receive(size, response, timeout);
+    if (TSS2_TCTI_RC_TRY_AGAIN == rc || TSS2_TCTI_RC_INSUFFICIENT_BUFFER == rc || !response || !pending) {
+        return rc; // 应答尚未取走, 或没有与之对应的命令帧
+    }
+    const uint64_t endNs = recorder->now();
+    const size_t length = (TSS2_RC_SUCCESS == rc && size) ? *size : 0;
+    recorder->write(*this, endNs, rc, response, length);
+    pending = false;
+    return rc;
+}
+
+void TctiRecorder::RecordingTcti::finalize()
+{
+    pending = false;
+    ForwardingTcti::finalize();
+}
+
+TSS2_RC TctiRecorder::RecordingTcti::cancel()
+{
+    TSS2_RC rc = ForwardingTcti::cancel();
+    if (TSS2_RC_SUCCESS == rc) {
+        pending = false; // 被取消的命令没有应答, 不录制
+    }
+    return rc;
+}
+
+// ============================================================================
+// 读取录制文件
+// ============================================================================
+void TctiRecorder::Load(const char *fileName, std::vector<TctiRecord>& records)
+{
+    FILE *fp = fopen(fileName, "rb");
+    if (!fp) {
+        throw std::ios::failure(std::string("Cannot open ") + fileName + ": " + strerror(errno));
+    }
+    const std::string what = std::string("TctiRecorder: ") + fileName + ": ";
+    uint8_t header[TCTI_RECORD_FILE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) || 0 != memcmp(header, MAGIC, sizeof(MAGIC))) {
+        fclose(fp);
+        throw std::runtime_error(what + "not a TCTI recording");
+    }
+    if (GetUINT16(header + 4) != TCTI_RECORD_FILE_VERSION) {
+        fclose(fp);
+        throw std::runtime_error(what + "unsupported version");
+    }
+    const size_t headerSize = GetUINT16(header + 6);
+    if (headerSize < TCTI_RECORD_FILE_HEADER_SIZE || 0 != fseek(fp, (long) headerSize, SEEK_SET)) {
+        fclose(fp);
+        throw std::runtime_error(what + "bad header size");
+    }
+
+    records.clear();
+    uint8_t recordHeader[TCTI_RECORD_HEADER_SIZE];
+    while (fread(recordHeader, 1, sizeof(recordHeader), fp) == sizeof(recordHeader)) {
+        TctiRecord record;
+        record.channel = GetUINT32(recordHeader);
+        record.startNs = GetUINT64(recordHeader + 4);
+        record.latencyNs = GetUINT64(recordHeader + 12);
+        record.rc = GetUINT32(recordHeader + 20);
+        const size_t commandSize = GetUINT32(recordHeader + 24);
+        const size_t responseSize = GetUINT32(recordHeader + 28);
+        if (commandSize > MAX_COMMAND_SIZE || responseSize > MAX_RESPONSE_SIZE) {
+            fclose(fp);
+            throw std::runtime_error(what + "frame too large");
+        }
+        record.command.resize(commandSize);
+        record.response.resize(responseSize);
+        if (fread(record.command.data(), 1, commandSize, fp) != commandSize
+                || fread(record.response.data(), 1, responseSize, fp) != responseSize) {
+            break; // 末尾不完整的记录
+        }
+        records.push_back(record);
+    }
+    const bool failed = ferror(fp);
+    fclose(fp);
+    if (failed) {
+        throw std::ios::failure(std::string("Cannot read ") + fileName);
+    }
+}
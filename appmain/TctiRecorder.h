@@ -0,0 +1,135 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef TCTI_RECORDER_H_
+#define TCTI_RECORDER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+
+#ifdef __cplusplus
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/// 录制文件中的一对命令帧/应答帧
+struct TctiRecord {
+    uint32_t channel; ///< 通道号, 每个被录制的 TCTI 连接一个通道
+    uint64_t startNs; ///< 发出命令帧的时刻, 相对于录制开始时刻, 单位纳秒
+    uint64_t latencyNs; ///< 从发出命令帧到取回应答帧的时间, 单位纳秒
+    TSS2_RC rc; ///< receive() 的返回值, 非 0 时 response 为空
+    std::vector<uint8_t> command;
+    std::vector<uint8_t> response;
+
+    TctiRecord();
+};
+
+/// TCTI 录制器
+///
+/// 用一个转发型 TCTI 上下文包装真正的 TCTI 上下文, 把经过的每一对命令帧/应答帧及其时间追加写入录制文件,
+/// 配套的 ReplayConnectionManager 读取录制文件, 在没有 TPM 的机器上按原始(或缩放后的)延迟重放应答,
+/// 用于以真实负载(例如一整天的 Sign/Hash 请求)对比新旧版本客户端代码的吞吐量.
+///
+/// 与 WireTracer 不同, 录制器不丢弃任何数据: 每取回一个应答帧就通过 stdio 缓冲写入文件, 适合长时间录制.
+///
+/// ```
+/// // 用法示意:
+/// TctiRecorder recorder("sign.tctirec");
+/// SocketConnectionManager manager("127.0.0.1", 2321);
+/// manager.configRecorder(&recorder); // 必须在 connect() 之前调用
+/// manager.connect();
+/// // ... 正常使用 Client ...
+/// manager.disconnect();
+/// recorder.close();
+/// ```
+///
+/// 录制文件格式(版本 1), 所有整数均为大端字节序:
+///
+/// | 偏移 | 长度 | 字段                                           |
+/// |------|------|------------------------------------------------|
+/// | 0    | 4    | 魔数 "TREC"                                    |
+/// | 4    | 2    | 格式版本号, 当前为 1                           |
+/// | 6    | 2    | 文件头长度, 当前为 16                          |
+/// | 8    | 8    | 录制开始时刻(UNIX 时间, 单位秒)                |
+/// | 16   | -    | 记录, 一直到文件末尾                           |
+///
+/// 每条记录为: 通道号(4), startNs(8), latencyNs(8), rc(4), 命令帧长度(4), 应答帧长度(4), 命令帧, 应答帧.
+///
+/// @note 所有成员函数都是线程安全的, 多个连接可以录制到同一个文件中
+class TctiRecorder {
+public:
+    /**
+     * 构造函数: 创建录制文件
+     *
+     * @throws std::ios::failure 文件无法创建时抛出
+     */
+    TctiRecorder(const char *fileName);
+    /// 析构函数: 关闭录制文件
+    ~TctiRecorder();
+
+    /**
+     * 包装一个 TCTI 上下文
+     *
+     * 返回的上下文把全部调用转发给 tctiContext, 可直接传给 Tss2_Sys_Initialize().
+     * 转发时才读取 tctiContext 中的函数指针, 因此可以在 tctiContext 初始化之前调用本函数.
+     *
+     * @return 由 TctiRecorder 持有的转发上下文, 在 TctiRecorder 析构时释放
+     */
+    TSS2_TCTI_CONTEXT *attach(TSS2_TCTI_CONTEXT *tctiContext);
+
+    /// 已写入的记录条数
+    uint64_t recordCount() const;
+    /**
+     * 把缓冲的记录写入文件
+     *
+     * @throws std::ios::failure 之前的写入或本次写入失败时抛出
+     */
+    void flush();
+    /**
+     * 关闭录制文件. 之后经过转发上下文的命令不再被录制
+     *
+     * @throws std::ios::failure 之前的写入或关闭文件失败时抛出
+     */
+    void close();
+
+    /**
+     * 读取录制文件
+     *
+     * 末尾不完整的记录(例如录制进程被强行终止)被忽略.
+     *
+     * @throws std::ios::failure 文件无法打开时抛出
+     * @throws std::runtime_error 文件格式错误时抛出
+     */
+    static void Load(const char *fileName, std::vector<TctiRecord>& records);
+
+private:
+    struct RecordingTcti;
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t now() const;
+    void write(const RecordingTcti& recording, uint64_t endNs, TSS2_RC rc, const uint8_t *response, size_t size);
+
+    const Clock::time_point m_epoch;
+    std::string m_fileName;
+
+    mutable std::mutex m_mutex;
+    FILE *m_fp;
+    bool m_writeError;
+    uint64_t m_recordCount;
+    std::vector<RecordingTcti *> m_recordingTctis;
+
+    // 禁止复制
+    TctiRecorder(const TctiRecorder&);
+    TctiRecorder& operator=(const TctiRecorder&);
+};
+
+#endif // __cplusplus
+#endif // TCTI_RECORDER_H_
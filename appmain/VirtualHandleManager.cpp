@@ -0,0 +1,321 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "VirtualHandleManager.h"
+
+/* 排版格式: 以下函数均使用4个空格缩进，不使用Tab缩进 */
+
+const TPM_HANDLE VirtualHandleManager::VIRTUAL_HANDLE_BASE;
+
+VirtualHandleManager::VirtualHandleManager(unsigned int maxLoadedObjects, EvictionPolicy policy) {
+    m_maxLoadedObjects = (maxLoadedObjects < 1) ? 1 : maxLoadedObjects;
+    m_policy = policy;
+    m_loadedObjects = 0;
+    m_nextVirtualHandle = VIRTUAL_HANDLE_BASE;
+    m_clock = 0;
+    memset(&m_statistics, 0x00, sizeof(m_statistics));
+}
+
+VirtualHandleManager::~VirtualHandleManager() {
+    // 析构时没有可用的 TPM 连接, 仍在 TPM 中的对象由调用者通过 releaseAll() 清除
+}
+
+// ============================================================================
+// 登记对象
+// ============================================================================
+TPM_HANDLE VirtualHandleManager::registerObject(Client& client, TPM_HANDLE realHandle) {
+    Entry entry;
+    entry.realHandle = realHandle;
+    entry.loaded = true;
+    entry.pinCount = 1; // 登记期间暂时锁定, 以免 makeRoom() 换出自己
+    entry.lastUse = ++m_clock;
+    entry.useCount = 0;
+    memset(&entry.context, 0x00, sizeof(entry.context));
+    entry.contextReady = false; // 对象已在 TPM 中, 换出时才会生成上下文
+    TPM_HANDLE virtualHandle = m_nextVirtualHandle++;
+    Entry& e = m_entries[virtualHandle] = entry;
+    m_loadedObjects++;
+    try {
+        while (m_loadedObjects > m_maxLoadedObjects && evictOne(client)) {
+        }
+    } catch (...) {
+        e.pinCount--;
+        throw;
+    }
+    e.pinCount--;
+    return virtualHandle;
+}
+
+TPM_HANDLE VirtualHandleManager::loadObject(Client& client, const std::function<TPM_HANDLE ()>& loader) {
+    makeRoom(client);
+    TPM_HANDLE realHandle = retryOnObjectMemory(client, loader);
+    return registerObject(client, realHandle);
+}
+
+TPM_HANDLE VirtualHandleManager::registerContext(const TPMS_CONTEXT& context) {
+    Entry entry;
+    entry.realHandle = 0;
+    entry.loaded = false;
+    entry.pinCount = 0;
+    entry.lastUse = ++m_clock;
+    entry.useCount = 0;
+    entry.context = context;
+    entry.contextReady = true;
+    TPM_HANDLE virtualHandle = m_nextVirtualHandle++;
+    m_entries[virtualHandle] = entry;
+    return virtualHandle;
+}
+
+TPM_HANDLE VirtualHandleManager::registerLazyContext(const ContextProvider& provider) {
+    if (!provider) {
+        throw std::invalid_argument("VirtualHandleManager::registerLazyContext(): provider is empty");
+    }
+    TPM_HANDLE virtualHandle = m_nextVirtualHandle++;
+    Entry& entry = m_entries[virtualHandle];
+    entry.realHandle = 0;
+    entry.loaded = false;
+    entry.pinCount = 0;
+    entry.lastUse = 0; // 尚未使用过
+    entry.useCount = 0;
+    entry.contextReady = false;
+    entry.provider = provider;
+    return virtualHandle;
+}
+
+// ============================================================================
+// 释放对象
+// ============================================================================
+void VirtualHandleManager::release(Client& client, TPM_HANDLE virtualHandle) {
+    EntryIterator it = find(virtualHandle);
+    if (it->second.loaded) {
+        TPMCommands::FlushLoadedKeyNode flush;
+        flush.configKeyNodeToFlushAway(it->second.realHandle);
+        client.sendCommandAndWaitUntilResponseIsFetched(flush); // 失败时保留登记信息, 对象仍占用槽位
+        m_loadedObjects--;
+    }
+    m_entries.erase(it);
+}
+
+void VirtualHandleManager::releaseAll(Client& client) {
+    for (EntryIterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (!it->second.loaded) {
+            continue;
+        }
+        try {
+            TPMCommands::FlushLoadedKeyNode flush;
+            flush.configKeyNodeToFlushAway(it->second.realHandle);
+            client.sendCommandAndWaitUntilResponseIsFetched(flush);
+        } catch (TSS2_RC rc) {
+            // 忽略错误, 继续清除其他对象
+        }
+    }
+    m_entries.clear();
+    m_loadedObjects = 0;
+}
+
+// ============================================================================
+// 虚拟句柄 -> 真实句柄
+// ============================================================================
+TPM_HANDLE VirtualHandleManager::resolve(Client& client, TPM_HANDLE virtualHandle) {
+    Entry& entry = find(virtualHandle)->second;
+    m_statistics.resolves++;
+    entry.lastUse = ++m_clock;
+    entry.useCount++;
+    if (entry.loaded) {
+        m_statistics.hits++;
+        return entry.realHandle;
+    }
+    entry.pinCount++; // 换入期间锁定自己
+    try {
+        swapIn(client, entry);
+    } catch (...) {
+        entry.pinCount--;
+        throw;
+    }
+    entry.pinCount--;
+    return entry.realHandle;
+}
+
+void VirtualHandleManager::pin(TPM_HANDLE virtualHandle) {
+    find(virtualHandle)->second.pinCount++;
+}
+
+void VirtualHandleManager::unpin(TPM_HANDLE virtualHandle) {
+    Entry& entry = find(virtualHandle)->second;
+    if (entry.pinCount > 0) {
+        entry.pinCount--;
+    }
+}
+
+void VirtualHandleManager::execute(
+        Client& client,
+        const std::vector<TPM_HANDLE>& virtualHandles,
+        const std::function<void (const std::vector<TPM_HANDLE>& realHandles)>& operation
+        ) {
+    if (virtualHandles.size() > m_maxLoadedObjects) {
+        throw std::invalid_argument("VirtualHandleManager::execute(): too many objects for available TPM slots");
+    }
+    std::vector<TPM_HANDLE> realHandles;
+    size_t pinned = 0;
+    try {
+        for (; pinned < virtualHandles.size(); pinned++) {
+            realHandles.push_back(resolve(client, virtualHandles[pinned]));
+            pin(virtualHandles[pinned]);
+        }
+        operation(realHandles);
+    } catch (...) {
+        for (size_t i = 0; i < pinned; i++) {
+            unpin(virtualHandles[i]);
+        }
+        throw;
+    }
+    for (size_t i = 0; i < pinned; i++) {
+        unpin(virtualHandles[i]);
+    }
+}
+
+void VirtualHandleManager::prefetch(Client& client, const std::vector<TPM_HANDLE>& virtualHandles) {
+    bool slotsExhausted = false;
+    for (size_t i = 0; i < virtualHandles.size(); i++) {
+        Entry& entry = find(virtualHandles[i])->second;
+        if (entry.loaded) {
+            continue;
+        }
+        fetchContext(entry);
+        if (slotsExhausted || m_loadedObjects >= m_maxLoadedObjects) {
+            continue; // 槽位已满, 只预取主机端的上下文
+        }
+        TPMCommands::ContextLoad contextLoad;
+        contextLoad.configContext(entry.context);
+        try {
+            client.sendCommandAndWaitUntilResponseIsFetched(contextLoad);
+        } catch (TSS2_RC rc) {
+            if (TPM_RC_OBJECT_MEMORY == rc) {
+                slotsExhausted = true; // 槽位被本管理器之外的对象占用, 预取只是提示, 不为此换出其他对象
+                continue;
+            }
+            throw;
+        }
+        entry.realHandle = contextLoad.outHandle();
+        entry.loaded = true;
+        entry.lastUse = ++m_clock; // 否则 lastUse 仍为 0, 预取的对象会最先被换出
+        m_loadedObjects++;
+        m_statistics.prefetches++;
+    }
+}
+
+const VirtualHandleManager::Statistics& VirtualHandleManager::statistics() const {
+    return m_statistics;
+}
+
+unsigned int VirtualHandleManager::loadedObjectCount() const {
+    return m_loadedObjects;
+}
+
+// ============================================================================
+// 内部函数
+// ============================================================================
+VirtualHandleManager::EntryIterator VirtualHandleManager::find(TPM_HANDLE virtualHandle) {
+    EntryIterator it = m_entries.find(virtualHandle);
+    if (it == m_entries.end()) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Invalid virtual handle 0x%X", virtualHandle);
+        throw std::invalid_argument(msg);
+    }
+    return it;
+}
+
+/// 延迟登记的对象首次使用时取回上下文
+void VirtualHandleManager::fetchContext(Entry& entry) {
+    if (entry.contextReady) {
+        return;
+    }
+    entry.provider(entry.context);
+    entry.contextReady = true;
+    entry.provider = nullptr; // 释放 provider 捕获的资源
+    m_statistics.lazyFetches++;
+}
+
+/// 换入: ContextLoad, 对象槽位不足时先换出其他对象
+void VirtualHandleManager::swapIn(Client& client, Entry& entry) {
+    fetchContext(entry);
+    makeRoom(client);
+    const TPMS_CONTEXT& context = entry.context;
+    entry.realHandle = retryOnObjectMemory(client, [&]() -> TPM_HANDLE {
+        TPMCommands::ContextLoad contextLoad;
+        contextLoad.configContext(context);
+        client.sendCommandAndWaitUntilResponseIsFetched(contextLoad);
+        return contextLoad.outHandle();
+    });
+    entry.loaded = true;
+    m_loadedObjects++;
+    m_statistics.swapIns++;
+}
+
+/// 换出: ContextSave + FlushLoadedKeyNode
+void VirtualHandleManager::swapOut(Client& client, Entry& entry) {
+    TPMCommands::ContextSave contextSave;
+    contextSave.configHandle(entry.realHandle);
+    client.sendCommandAndWaitUntilResponseIsFetched(contextSave);
+    entry.context = contextSave.outContext();
+    entry.contextReady = true;
+
+    TPMCommands::FlushLoadedKeyNode flush;
+    flush.configKeyNodeToFlushAway(entry.realHandle);
+    client.sendCommandAndWaitUntilResponseIsFetched(flush);
+    entry.loaded = false;
+    entry.realHandle = 0;
+    m_loadedObjects--;
+    m_statistics.swapOuts++;
+}
+
+/// 按换出策略选出一个未锁定的对象换出, 没有可换出的对象时返回 false
+bool VirtualHandleManager::evictOne(Client& client) {
+    Entry *victim = NULL;
+    for (EntryIterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        Entry& e = it->second;
+        if (!e.loaded || e.pinCount > 0) {
+            continue;
+        }
+        if (!victim) {
+            victim = &e;
+        } else if (LEAST_FREQUENTLY_USED == m_policy && e.useCount != victim->useCount) {
+            if (e.useCount < victim->useCount) {
+                victim = &e;
+            }
+        } else if (e.lastUse < victim->lastUse) {
+            victim = &e;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    swapOut(client, *victim);
+    return true;
+}
+
+void VirtualHandleManager::makeRoom(Client& client) {
+    while (m_loadedObjects >= m_maxLoadedObjects && evictOne(client)) {
+    }
+}
+
+/// TPM 对象槽位不足时(可能被本管理器之外的对象占用)换出一个对象后重试
+TPM_HANDLE VirtualHandleManager::retryOnObjectMemory(Client& client, const std::function<TPM_HANDLE ()>& operation) {
+    while (true) {
+        try {
+            return operation();
+        } catch (TSS2_RC rc) {
+            if (TPM_RC_OBJECT_MEMORY == rc && evictOne(client)) {
+                m_statistics.objectMemoryRetries++;
+                continue;
+            }
+            throw;
+        }
+    }
+}
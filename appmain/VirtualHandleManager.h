@@ -0,0 +1,187 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef VIRTUAL_HANDLE_MANAGER_H_
+#define VIRTUAL_HANDLE_MANAGER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+#include "Client.h"
+
+#ifdef __cplusplus
+
+#include <functional>
+#include <map>
+#include <vector>
+
+/// 进程内虚拟对象句柄管理器
+///
+/// TPM 的临时对象槽位很少(通常只有 3 个), 同时使用的密钥较多时会返回 TPM_RC_OBJECT_MEMORY.
+/// 本类为每个对象分配一个稳定不变的虚拟句柄, 真实对象则按需换入换出:
+/// 换出时依次执行 ContextSave 和 FlushLoadedKeyNode, 换入时执行 ContextLoad.
+/// 使用对象之前调用 resolve() 或 execute() 将虚拟句柄翻译成当前有效的真实句柄.
+/// KeyHandleCache 也通过本类管理对象槽位, 二者可以共用同一个管理器, 统一换出顺序.
+///
+/// 用法示意(伪代码):
+/// ```
+/// VirtualHandleManager vhm;
+/// TPM_HANDLE vKey = vhm.registerObject(client, load.outObjectHandle()); // 接管已加载的对象
+/// ...
+/// vhm.execute(client, {vKey}, [&](const std::vector<TPM_HANDLE>& handles) {
+///     sign.configSigningKey(handles[0]);
+///     client.sendCommandAndWaitUntilResponseIsFetched(sign);
+/// });
+/// ```
+///
+/// @note 同一个管理器必须始终配合同一个 TPM 连接使用, 并且不支持多线程同时调用.
+class VirtualHandleManager
+{
+public:
+    /// 换出策略
+    enum EvictionPolicy {
+        LEAST_RECENTLY_USED, ///< 换出最久未使用的对象(默认值)
+        LEAST_FREQUENTLY_USED, ///< 换出使用次数最少的对象, 次数相同时换出最久未使用的对象
+    };
+
+    /// 统计信息
+    struct Statistics {
+        unsigned long resolves; ///< resolve() 调用次数
+        unsigned long hits; ///< 对象已在 TPM 中, 无需换入的次数
+        unsigned long swapIns; ///< ContextLoad 次数
+        unsigned long swapOuts; ///< ContextSave + FlushLoadedKeyNode 次数
+        unsigned long objectMemoryRetries; ///< TPM 返回 TPM_RC_OBJECT_MEMORY 后换出对象重试的次数
+        unsigned long lazyFetches; ///< 首次使用时才调用 ContextProvider 取回上下文的次数
+        unsigned long prefetches; ///< prefetch() 预先执行 ContextLoad 的次数
+    };
+
+    /// 上下文提供者: 首次换入对象时才被调用, 用于从文件等位置取回之前保存的上下文
+    ///
+    /// 可以抛出任意异常, 异常将从 resolve() 原样传递给调用者
+    typedef std::function<void (TPMS_CONTEXT& context)> ContextProvider;
+
+    /// 虚拟句柄的取值范围从 VIRTUAL_HANDLE_BASE 开始. 0x8F 不是 TPM 定义的句柄类型, 因此不会与真实句柄混淆
+    static const TPM_HANDLE VIRTUAL_HANDLE_BASE = 0x8F000000;
+
+    /// 构造函数
+    ///
+    /// @param maxLoadedObjects 同时保持在 TPM 中的对象个数上限, 默认为 3
+    /// @param policy 换出策略
+    explicit VirtualHandleManager(unsigned int maxLoadedObjects=3, EvictionPolicy policy=LEAST_RECENTLY_USED);
+    ~VirtualHandleManager();
+
+    /// 接管一个已加载的对象, 返回其虚拟句柄
+    TPM_HANDLE registerObject(Client& client, TPM_HANDLE realHandle);
+
+    /**
+     * 加载一个新对象并接管, 返回其虚拟句柄
+     *
+     * 先按换出策略腾出槽位, 再调用 loader 执行 Load/LoadExternal 等命令并返回真实句柄;
+     * loader 抛出 TPM_RC_OBJECT_MEMORY 时(槽位可能被本管理器之外的对象占用)再换出一个对象后重试
+     *
+     * @throws TSS2_RC 换出失败或 loader 失败时抛出 TPM 错误码; loader 抛出的其他异常原样传递
+     */
+    TPM_HANDLE loadObject(Client& client, const std::function<TPM_HANDLE ()>& loader);
+
+    /// 登记一个之前保存的对象上下文(此时不执行 ContextLoad), 返回其虚拟句柄
+    TPM_HANDLE registerContext(const TPMS_CONTEXT& context);
+
+    /// 登记一个延迟取回的对象上下文, 返回其虚拟句柄
+    ///
+    /// 登记时不读取上下文, 也不执行 ContextLoad; 首次 resolve() 时才调用 provider 取回上下文并换入.
+    /// 适用于服务启动时登记大量已保存的对象, 而只有少数对象会被实际使用的场合
+    TPM_HANDLE registerLazyContext(const ContextProvider& provider);
+
+    /**
+     * 预取: 按给定顺序将一组对象提前换入 TPM
+     *
+     * 只使用空闲的对象槽位, 不会为此换出其他对象; 槽位用完(或 TPM 返回 TPM_RC_OBJECT_MEMORY)后,
+     * 其余对象只在主机内存中取回上下文. 预取的对象按列表顺序计为最近使用过.
+     * 用于服务启动时预先加载已知的常用对象
+     *
+     * @throws std::invalid_argument 虚拟句柄无效时抛出
+     * @throws TSS2_RC ContextLoad 失败(TPM_RC_OBJECT_MEMORY 除外)时抛出 TPM 错误码
+     */
+    void prefetch(Client& client, const std::vector<TPM_HANDLE>& virtualHandles);
+
+    /// 释放虚拟句柄, 对象仍在 TPM 中时执行 FlushLoadedKeyNode
+    ///
+    /// @throws TSS2_RC FlushLoadedKeyNode 失败时抛出 TPM 错误码, 此时虚拟句柄仍然有效
+    void release(Client& client, TPM_HANDLE virtualHandle);
+
+    /// 释放全部虚拟句柄. 解除 TPM 连接之前应调用此函数
+    void releaseAll(Client& client);
+
+    /**
+     * 将虚拟句柄翻译成真实句柄, 对象已被换出时自动换入
+     *
+     * 返回的真实句柄在下一次调用 resolve() 之前有效; 需要同时使用多个对象时请使用 pin() 或 execute()
+     *
+     * @throws std::invalid_argument 虚拟句柄无效时抛出
+     * @throws TSS2_RC 换入换出失败时抛出 TPM 错误码
+     */
+    TPM_HANDLE resolve(Client& client, TPM_HANDLE virtualHandle);
+
+    /// 锁定对象, 被锁定的对象不会被换出(可嵌套调用)
+    void pin(TPM_HANDLE virtualHandle);
+
+    /// 解除锁定
+    void unpin(TPM_HANDLE virtualHandle);
+
+    /**
+     * 换入并锁定一组对象, 然后以真实句柄调用 operation, 返回后解除锁定
+     *
+     * @throws std::invalid_argument / TSS2_RC 同 resolve(); operation 抛出的异常原样传递
+     */
+    void execute(
+            Client& client,
+            const std::vector<TPM_HANDLE>& virtualHandles,
+            const std::function<void (const std::vector<TPM_HANDLE>& realHandles)>& operation
+            );
+
+    /// 查询统计信息
+    const Statistics& statistics() const;
+
+    /// 当前处于换入状态的对象个数
+    unsigned int loadedObjectCount() const;
+
+private:
+    struct Entry {
+        TPM_HANDLE realHandle; ///< 换入时的真实句柄
+        bool loaded;
+        unsigned int pinCount;
+        unsigned long lastUse; ///< 最近一次使用的逻辑时钟
+        unsigned long useCount;
+        TPMS_CONTEXT context; ///< 换出时保存的上下文
+        bool contextReady; ///< context 是否有效, 为 false 时换入前须先调用 provider
+        ContextProvider provider;
+    };
+    typedef std::map<TPM_HANDLE, Entry>::iterator EntryIterator;
+
+    EntryIterator find(TPM_HANDLE virtualHandle);
+    void fetchContext(Entry& entry);
+    void swapIn(Client& client, Entry& entry);
+    void swapOut(Client& client, Entry& entry);
+    bool evictOne(Client& client);
+    void makeRoom(Client& client);
+    TPM_HANDLE retryOnObjectMemory(Client& client, const std::function<TPM_HANDLE ()>& operation);
+
+    unsigned int m_maxLoadedObjects;
+    EvictionPolicy m_policy;
+    unsigned int m_loadedObjects;
+    TPM_HANDLE m_nextVirtualHandle;
+    unsigned long m_clock;
+    std::map<TPM_HANDLE, Entry> m_entries;
+    Statistics m_statistics;
+
+    // 禁止复制
+    VirtualHandleManager(const VirtualHandleManager&);
+    VirtualHandleManager& operator=(const VirtualHandleManager&);
+};
+
+#endif // __cplusplus
+#endif // VIRTUAL_HANDLE_MANAGER_H_
@@ -0,0 +1,560 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include <map>
+#include <stdexcept>
+#include <sapi/tpm20.h>
+#include "ByteOrder.h"
+#include "CommandStatistics.h"
+#include "ForwardingTcti.h"
+#include "WireTracer.h"
+
+/* 排版格式: 以下代码均使用4个空格缩进，不使用Tab缩进 */
+
+static const char MAGIC[4] = {'T', 'W', 'T', 'R'};
+static const uint16_t WIRE_TRACE_FILE_VERSION = 1;
+static const size_t WIRE_TRACE_FILE_HEADER_SIZE = 24;
+static const size_t WIRE_TRACE_EVENT_HEADER_SIZE = 32;
+
+// ============================================================================
+// 环形缓冲区
+// ============================================================================
+
+WireTraceEvent::WireTraceEvent()
+        : timestampNs(0), channel(0), kind(0), rc(0), length(0)
+{
+}
+
+/// 环形缓冲区槽位
+///
+/// sequence 为 0 表示从未写入; 序号为 n 的事件写入期间为 2n+1, 写入完成后为 2n+2.
+/// 读取方在复制前后各读一次 sequence, 两次都等于 2n+2 才说明复制到的是完整的第 n 个事件.
+struct WireTracer::Slot {
+    std::atomic<uint64_t> sequence;
+    uint64_t timestampNs;
+    uint32_t channel;
+    uint16_t kind;
+    TSS2_RC rc;
+    uint32_t length;
+    uint32_t capturedLength;
+};
+
+/// 跟踪用的转发型 TCTI 上下文
+struct WireTracer::TracedTcti: public ForwardingTcti {
+    WireTracer *tracer;
+    uint32_t channel;
+
+    TracedTcti(TSS2_TCTI_CONTEXT *inner, WireTracer *tracer, uint32_t channel);
+    static TracedTcti *FromLogData(void *data);
+    TSS2_RC transmit(size_t size, uint8_t *command);
+    TSS2_RC receive(size_t *size, uint8_t *response, int32_t timeout);
+    TSS2_RC cancel();
+};
+
+static size_t RoundUpToPowerOfTwo(size_t n)
+{
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// 构造函数 WireTracer(capacity, maxCapturedBytes)
+WireTracer::WireTracer(size_t capacity, size_t maxCapturedBytes)
+        : m_epoch(Clock::now()), m_head(0)
+{
+    if (capacity < 1) {
+        throw std::invalid_argument("WireTracer: capacity must be positive");
+    }
+    m_capacity = RoundUpToPowerOfTwo(capacity);
+    m_maxCapturedBytes = maxCapturedBytes;
+    m_slots = new Slot[m_capacity];
+    for (size_t i = 0; i < m_capacity; i++) {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    m_pool = new uint8_t[m_capacity * m_maxCapturedBytes + 1];
+}
+
+// 析构函数
+WireTracer::~WireTracer()
+{
+    for (size_t i = 0; i < m_tracedTctis.size(); i++) {
+        delete m_tracedTctis[i];
+    }
+    delete[] m_pool;
+    delete[] m_slots;
+}
+
+uint64_t WireTracer::now() const
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_epoch).count();
+}
+
+void WireTracer::record(uint32_t channel, EventKind kind, TSS2_RC rc, const uint8_t *data, size_t length)
+{
+    record(now(), channel, kind, rc, data, length);
+}
+
+void WireTracer::record(uint64_t timestampNs, uint32_t channel, EventKind kind, TSS2_RC rc,
+        const uint8_t *data, size_t length)
+{
+    const uint64_t ticket = m_head.fetch_add(1, std::memory_order_relaxed);
+    const size_t index = (size_t) (ticket & (m_capacity - 1));
+    Slot& slot = m_slots[index];
+
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t captured = (length < m_maxCapturedBytes) ? length : m_maxCapturedBytes;
+    if (!data) {
+        captured = 0;
+    }
+    slot.timestampNs = timestampNs;
+    slot.channel = channel;
+    slot.kind = (uint16_t) kind;
+    slot.rc = rc;
+    slot.length = (uint32_t) length;
+    slot.capturedLength = (uint32_t) captured;
+    if (captured > 0) {
+        memcpy(m_pool + index * m_maxCapturedBytes, data, captured);
+    }
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<WireTraceEvent> WireTracer::snapshot(uint64_t *droppedCount) const
+{
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const uint64_t first = (head > m_capacity) ? head - m_capacity : 0;
+    if (droppedCount) {
+        *droppedCount = first;
+    }
+    std::vector<WireTraceEvent> events;
+    events.reserve((size_t) (head - first));
+    for (uint64_t ticket = first; ticket < head; ticket++) {
+        const size_t index = (size_t) (ticket & (m_capacity - 1));
+        const Slot& slot = m_slots[index];
+        const uint64_t expected = 2 * ticket + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            continue; // 尚未写完, 或已被更新的事件覆盖
+        }
+        WireTraceEvent event;
+        event.timestampNs = slot.timestampNs;
+        event.channel = slot.channel;
+        event.kind = slot.kind;
+        event.rc = slot.rc;
+        event.length = slot.length;
+        size_t captured = slot.capturedLength;
+        if (captured > m_maxCapturedBytes) {
+            captured = m_maxCapturedBytes;
+        }
+        const uint8_t *data = m_pool + index * m_maxCapturedBytes;
+        event.data.assign(data, data + captured);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+            continue; // 复制期间被改写
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+std::vector<std::string> WireTracer::channelNames() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_channelNames;
+}
+
+uint64_t WireTracer::recordedCount() const
+{
+    return m_head.load(std::memory_order_relaxed);
+}
+
+uint64_t WireTracer::droppedCount() const
+{
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    return (head > m_capacity) ? head - m_capacity : 0;
+}
+
+// ============================================================================
+// 转发型 TCTI 上下文
+// ============================================================================
+TSS2_TCTI_CONTEXT *WireTracer::attach(TSS2_TCTI_CONTEXT *tctiContext, const char *name)
+{
+    if (!tctiContext) {
+        throw std::invalid_argument("WireTracer::attach(): tctiContext is NULL");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TracedTcti *traced = new TracedTcti(tctiContext, this, (uint32_t) m_channelNames.size());
+    m_channelNames.push_back(name ? name : "");
+    m_tracedTctis.push_back(traced);
+    return traced->context();
+}
+
+WireTracer::TracedTcti::TracedTcti(TSS2_TCTI_CONTEXT *inner, WireTracer *tracer, uint32_t channel)
+        : ForwardingTcti(inner), tracer(tracer), channel(channel)
+{
+}
+
+WireTracer::TracedTcti *WireTracer::TracedTcti::FromLogData(void *data)
+{
+    return dynamic_cast<TracedTcti *>(ForwardingTcti::FromContext(data));
+}
+
+TSS2_RC WireTracer::TracedTcti::transmit(size_t size, uint8_t *command)
+{
+    const uint64_t timestampNs = tracer->now();
+    TSS2_RC rc = ForwardingTcti::transmit(size, command);
+    tracer->record(timestampNs, channel, EVENT_COMMAND, rc, command, size);
+    return rc;
+}
+
+TSS2_RC WireTracer::TracedTcti::receive(size_t *size, uint8_t *response, int32_t timeout)
+{
+    TSS2_RC rc = ForwardingTcti::receive(size, response, timeout);
+    if (TSS2_TCTI_RC_TRY_AGAIN == rc || !response) {
+        return rc; // 应答尚未就绪, 或只是查询应答长度, 线路上没有数据
+    }
+    const size_t length = (TSS2_RC_SUCCESS == rc && size) ? *size : 0;
+    tracer->record(channel, EVENT_RESPONSE, rc, response, length);
+    return rc;
+}
+
+TSS2_RC WireTracer::TracedTcti::cancel()
+{
+    TSS2_RC rc = ForwardingTcti::cancel();
+    tracer->record(channel, EVENT_CANCEL, rc, NULL, 0);
+    return rc;
+}
+
+// ============================================================================
+// TCTI 日志回调
+// ============================================================================
+int WireTracer::LogCallback(void *data, printf_type type, const char *format, ...)
+{
+    TracedTcti *traced = TracedTcti::FromLogData(data);
+    if (!traced || !format) {
+        return 0;
+    }
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (n < 0) {
+        return n;
+    }
+    const size_t length = ((size_t) n < sizeof(text)) ? (size_t) n : sizeof(text) - 1;
+    traced->tracer->record(traced->channel, EVENT_LOG_TEXT, 0, (const uint8_t *) text, length);
+    return n;
+}
+
+int WireTracer::LogBufferCallback(void *userData, printf_type type, UINT8 *buffer, UINT32 length)
+{
+    TracedTcti *traced = TracedTcti::FromLogData(userData);
+    if (!traced) {
+        return 0;
+    }
+    traced->tracer->record(traced->channel, EVENT_LOG_BUFFER, 0, buffer, length);
+    return 0;
+}
+
+// ============================================================================
+// 二进制跟踪文件
+// ============================================================================
+void WireTracer::dumpBinary(const char *fileName) const
+{
+    const std::vector<std::string> names = channelNames();
+    uint64_t dropped = 0;
+    const std::vector<WireTraceEvent> events = snapshot(&dropped);
+
+    std::vector<uint8_t> buffer(WIRE_TRACE_FILE_HEADER_SIZE);
+    memcpy(buffer.data(), MAGIC, sizeof(MAGIC));
+    PutUINT16(buffer.data() + 4, WIRE_TRACE_FILE_VERSION);
+    PutUINT16(buffer.data() + 6, (uint16_t) WIRE_TRACE_FILE_HEADER_SIZE);
+    PutUINT32(buffer.data() + 8, (uint32_t) names.size());
+    PutUINT32(buffer.data() + 12, (uint32_t) events.size());
+    PutUINT64(buffer.data() + 16, dropped);
+
+    for (size_t i = 0; i < names.size(); i++) {
+        const size_t nameLength = (names[i].size() < 0xFFFF) ? names[i].size() : 0xFFFF;
+        uint8_t header[6];
+        PutUINT32(header, (uint32_t) i);
+        PutUINT16(header + 4, (uint16_t) nameLength);
+        buffer.insert(buffer.end(), header, header + sizeof(header));
+        buffer.insert(buffer.end(), names[i].begin(), names[i].begin() + nameLength);
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        const WireTraceEvent& e = events[i];
+        uint8_t header[WIRE_TRACE_EVENT_HEADER_SIZE];
+        PutUINT64(header, e.timestampNs);
+        PutUINT32(header + 8, e.channel);
+        PutUINT16(header + 12, e.kind);
+        PutUINT16(header + 14, 0);
+        PutUINT32(header + 16, e.rc);
+        PutUINT32(header + 20, e.length);
+        PutUINT32(header + 24, (uint32_t) e.data.size());
+        PutUINT32(header + 28, 0);
+        buffer.insert(buffer.end(), header, header + sizeof(header));
+        buffer.insert(buffer.end(), e.data.begin(), e.data.end());
+    }
+
+    FILE *fp = fopen(fileName, "wb");
+    if (!fp) {
+        throw std::ios::failure(std::string("Cannot create ") + fileName + ": " + strerror(errno));
+    }
+    const bool ok = (fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size()) && (0 == fflush(fp));
+    const int err = errno;
+    fclose(fp);
+    if (!ok) {
+        throw std::ios::failure(std::string("Cannot write ") + fileName + ": " + strerror(err));
+    }
+}
+
+void WireTracer::LoadBinary(const char *fileName, std::vector<std::string>& channelNames,
+        std::vector<WireTraceEvent>& events, uint64_t *droppedCount)
+{
+    FILE *fp = fopen(fileName, "rb");
+    if (!fp) {
+        throw std::ios::failure(std::string("Cannot open ") + fileName + ": " + strerror(errno));
+    }
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    }
+    const bool failed = ferror(fp);
+    fclose(fp);
+    if (failed) {
+        throw std::ios::failure(std::string("Cannot read ") + fileName);
+    }
+
+    const std::string what = std::string("WireTracer: ") + fileName + ": ";
+    if (buffer.size() < WIRE_TRACE_FILE_HEADER_SIZE || 0 != memcmp(buffer.data(), MAGIC, sizeof(MAGIC))) {
+        throw std::runtime_error(what + "not a wire trace file");
+    }
+    if (GetUINT16(buffer.data() + 4) != WIRE_TRACE_FILE_VERSION) {
+        throw std::runtime_error(what + "unsupported version");
+    }
+    size_t offset = GetUINT16(buffer.data() + 6);
+    const uint32_t channelCount = GetUINT32(buffer.data() + 8);
+    const uint32_t eventCount = GetUINT32(buffer.data() + 12);
+    if (droppedCount) {
+        *droppedCount = GetUINT64(buffer.data() + 16);
+    }
+
+    // 每个通道至少占 6 字节, 据此限制通道个数, 避免按损坏的通道号分配巨大的名称表
+    if (offset > buffer.size() || channelCount > (buffer.size() - offset) / 6) {
+        throw std::runtime_error(what + "truncated channel table");
+    }
+    channelNames.clear();
+    for (uint32_t i = 0; i < channelCount; i++) {
+        if (offset + 6 > buffer.size()) {
+            throw std::runtime_error(what + "truncated channel table");
+        }
+        const uint32_t channel = GetUINT32(buffer.data() + offset);
+        const size_t nameLength = GetUINT16(buffer.data() + offset + 4);
+        offset += 6;
+        if (offset + nameLength > buffer.size()) {
+            throw std::runtime_error(what + "truncated channel table");
+        }
+        if (channel >= channelCount) {
+            throw std::runtime_error(what + "invalid channel number");
+        }
+        if (channel >= channelNames.size()) {
+            channelNames.resize(channel + 1);
+        }
+        channelNames[channel].assign((const char *) buffer.data() + offset, nameLength);
+        offset += nameLength;
+    }
+
+    events.clear();
+    events.reserve(eventCount);
+    for (uint32_t i = 0; i < eventCount; i++) {
+        if (offset + WIRE_TRACE_EVENT_HEADER_SIZE > buffer.size()) {
+            throw std::runtime_error(what + "truncated event");
+        }
+        const uint8_t *p = buffer.data() + offset;
+        WireTraceEvent event;
+        event.timestampNs = GetUINT64(p);
+        event.channel = GetUINT32(p + 8);
+        event.kind = GetUINT16(p + 12);
+        event.rc = GetUINT32(p + 16);
+        event.length = GetUINT32(p + 20);
+        const size_t captured = GetUINT32(p + 24);
+        offset += WIRE_TRACE_EVENT_HEADER_SIZE;
+        if (offset + captured > buffer.size()) {
+            throw std::runtime_error(what + "truncated event");
+        }
+        event.data.assign(buffer.begin() + offset, buffer.begin() + offset + captured);
+        offset += captured;
+        events.push_back(event);
+    }
+}
+
+// ============================================================================
+// Chrome trace JSON
+// ============================================================================
+
+/// 以 JSON 字符串格式输出(含两侧的引号)
+static void WriteJSONString(FILE *fp, const char *s, size_t length)
+{
+    fputc('"', fp);
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = (unsigned char) s[i];
+        if ('"' == c || '\\' == c) {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if ('\n' == c) {
+            fputs("\\n", fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/// 命令帧/应答帧头部第 6~9 字节: 命令码或应答码, 帧不完整时返回 0
+static uint32_t CodeOfFrame(const WireTraceEvent& frame)
+{
+    if (frame.data.size() < 10) {
+        return 0;
+    }
+    return GetUINT32(frame.data.data() + 6);
+}
+
+static std::string CommandNameOf(const WireTraceEvent& command)
+{
+    const TPM_CC commandCode = CodeOfFrame(command);
+    const char *name = CommandStatistics::CommandName(commandCode);
+    if (name) {
+        return name;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "0x%08X", commandCode);
+    return buf;
+}
+
+void WireTracer::WriteChromeTrace(FILE *fp, const std::vector<std::string>& channelNames,
+        const std::vector<WireTraceEvent>& events, uint64_t droppedCount)
+{
+    const char *separator = "\n";
+    fprintf(fp, "{\"traceEvents\":[");
+    for (size_t i = 0; i < channelNames.size(); i++) {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                separator, (unsigned int) i);
+        WriteJSONString(fp, channelNames[i].data(), channelNames[i].size());
+        fprintf(fp, "}}");
+        separator = ",\n";
+    }
+
+    std::map<uint32_t, const WireTraceEvent *> pendingCommands; // 各通道尚未收到应答的命令帧
+    for (size_t i = 0; i < events.size(); i++) {
+        const WireTraceEvent& e = events[i];
+        const double ts = e.timestampNs / 1000.0;
+        switch (e.kind) {
+        case EVENT_COMMAND: {
+            if (e.rc) {
+                fprintf(fp, "%s{\"name\":\"%s (transmit failed)\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"args\":{\"tcti_rc\":\"0x%08X\"}}",
+                        separator, CommandNameOf(e).c_str(), e.channel, ts, e.rc);
+                break;
+            }
+            const WireTraceEvent *previous = pendingCommands[e.channel];
+            if (previous) {
+                fprintf(fp, "%s{\"name\":\"%s (no response)\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"args\":{\"command_bytes\":%u}}",
+                        separator, CommandNameOf(*previous).c_str(), previous->channel,
+                        previous->timestampNs / 1000.0, previous->length);
+            }
+            pendingCommands[e.channel] = &e;
+            break;
+        }
+        case EVENT_RESPONSE: {
+            const WireTraceEvent *command = pendingCommands[e.channel];
+            pendingCommands[e.channel] = NULL;
+            if (!command) {
+                fprintf(fp, "%s{\"name\":\"response\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"args\":{\"response_bytes\":%u,\"tcti_rc\":\"0x%08X\"}}",
+                        separator, e.channel, ts, e.length, e.rc);
+                break;
+            }
+            const double start = command->timestampNs / 1000.0;
+            const TSS2_RC responseCode = e.rc ? e.rc : CodeOfFrame(e);
+            fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"tpm\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"command_code\":\"0x%08X\",\"command_bytes\":%u,"
+                    "\"response_bytes\":%u,\"response_code\":\"0x%08X\"}}",
+                    separator, CommandNameOf(*command).c_str(), e.channel, start, ts - start,
+                    CodeOfFrame(*command), command->length, e.length, responseCode);
+            break;
+        }
+        case EVENT_CANCEL:
+            fprintf(fp, "%s{\"name\":\"cancel\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"tcti_rc\":\"0x%08X\"}}",
+                    separator, e.channel, ts, e.rc);
+            break;
+        case EVENT_LOG_TEXT:
+            fprintf(fp, "%s{\"name\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"text\":",
+                    separator, e.channel, ts);
+            WriteJSONString(fp, (const char *) e.data.data(), e.data.size());
+            fprintf(fp, "}}");
+            break;
+        case EVENT_LOG_BUFFER:
+            fprintf(fp, "%s{\"name\":\"log buffer\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"bytes\":%u}}",
+                    separator, e.channel, ts, e.length);
+            break;
+        default:
+            continue;
+        }
+        separator = ",\n";
+    }
+    for (std::map<uint32_t, const WireTraceEvent *>::const_iterator it = pendingCommands.begin();
+            it != pendingCommands.end(); ++it) {
+        const WireTraceEvent *command = it->second;
+        if (command) {
+            fprintf(fp, "%s{\"name\":\"%s (no response)\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"command_bytes\":%u}}",
+                    separator, CommandNameOf(*command).c_str(), command->channel,
+                    command->timestampNs / 1000.0, command->length);
+            separator = ",\n";
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu}}\n",
+            (unsigned long long) droppedCount);
+}
+
+void WireTracer::writeChromeTrace(FILE *fp) const
+{
+    uint64_t dropped = 0;
+    const std::vector<WireTraceEvent> events = snapshot(&dropped);
+    WriteChromeTrace(fp, channelNames(), events, dropped);
+}
+
+void WireTracer::ConvertToChromeTrace(const char *binaryFileName, const char *jsonFileName)
+{
+    std::vector<std::string> names;
+    std::vector<WireTraceEvent> events;
+    uint64_t dropped = 0;
+    LoadBinary(binaryFileName, names, events, &dropped);
+
+    FILE *fp = fopen(jsonFileName, "w");
+    if (!fp) {
+        throw std::ios::failure(std::string("Cannot create ") + jsonFileName + ": " + strerror(errno));
+    }
+    WriteChromeTrace(fp, names, events, dropped);
+    const bool ok = !ferror(fp) && (0 == fflush(fp));
+    const int err = errno;
+    fclose(fp);
+    if (!ok) {
+        throw std::ios::failure(std::string("Cannot write ") + jsonFileName + ": " + strerror(err));
+    }
+}
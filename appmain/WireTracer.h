@@ -0,0 +1,189 @@
+/* encoding: utf-8 */
+// Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+// All rights reserved.
+
+#ifndef WIRE_TRACER_H_
+#define WIRE_TRACER_H_
+
+#ifndef __cplusplus
+#warning // Only C++ is supported. Please DON'T include this file from *.c!
+#endif
+
+#include <sapi/tpm20.h>
+#include <tcti/common.h>
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/// 一条线路跟踪事件
+struct WireTraceEvent {
+    uint64_t timestampNs; ///< 相对于 WireTracer 创建时刻的单调时钟时间, 单位纳秒
+    uint32_t channel; ///< 通道号, 每个被跟踪的 TCTI 连接一个通道
+    uint16_t kind; ///< 事件类型, 取值见 WireTracer::EventKind
+    TSS2_RC rc; ///< TCTI 函数的返回值
+    uint32_t length; ///< 原始字节流的长度
+    std::vector<uint8_t> data; ///< 截获的字节流, 超过 maxCapturedBytes 的部分被截断
+
+    WireTraceEvent();
+};
+
+/// TCTI 线路跟踪器
+///
+/// 记录经过 TCTI 的每一帧命令/应答字节流及其时间戳, 用于分析尾延迟尖峰出现时线路上究竟发生了什么.
+///
+/// 事件保存在固定容量的环形缓冲区中, 写满后覆盖最旧的事件(飞行记录仪模式).
+/// 写入方只做一次原子 fetch_add 领取槽位, 再以槽位序号(seqlock)发布数据, 不加锁也不分配内存,
+/// 多个连接/线程可以同时写入; snapshot() 跳过正在被改写的槽位, 随时可以调用.
+///
+/// 接入方式有两种, 均由连接管理器在 connect() 时完成:
+/// - attach(): 用一个转发型 TCTI 上下文包装真正的 TCTI 上下文, 在 transmit()/receive() 前后记录命令帧和应答帧.
+///   libtcti-device 不提供字节流日志回调, 字符设备连接依靠这种方式跟踪; socket 连接同样使用它获取精确时间戳
+/// - LogCallback()/LogBufferCallback(): 填入 TCTI_SOCKET_CONF / TCTI_DEVICE_CONF 的日志回调,
+///   logData 为 attach() 返回的上下文. TCTI 库(仅调试版本)输出的日志文本和字节流作为附加事件记录
+///
+/// 跟踪结果可以用 dumpBinary() 保存为二进制文件, 再用 ConvertToChromeTrace() 转换为
+/// Chrome trace JSON(在 chrome://tracing 或 Perfetto 中打开), 每条命令显示为一个从发出命令帧到收到应答帧的时间段.
+///
+/// ```
+/// // 用法示意:
+/// WireTracer tracer;
+/// SocketConnectionManager manager("127.0.0.1", 2321);
+/// manager.configTracer(&tracer); // 必须在 connect() 之前调用
+/// manager.connect();
+/// // ... 正常使用 Client ...
+/// tracer.dumpBinary("wire.trace");
+/// WireTracer::ConvertToChromeTrace("wire.trace", "wire.json");
+/// ```
+///
+/// 二进制跟踪文件格式(版本 1), 所有整数均为大端字节序:
+///
+/// | 偏移 | 长度 | 字段                                           |
+/// |------|------|------------------------------------------------|
+/// | 0    | 4    | 魔数 "TWTR"                                    |
+/// | 4    | 2    | 格式版本号, 当前为 1                           |
+/// | 6    | 2    | 文件头长度, 当前为 24                          |
+/// | 8    | 4    | 通道个数                                       |
+/// | 12   | 4    | 事件个数                                       |
+/// | 16   | 8    | 因缓冲区写满而被覆盖的事件个数                 |
+/// | 24   | -    | 通道表, 然后是事件表                           |
+///
+/// 通道表每项为: 通道号(4), 名称长度(2), 名称(UTF-8, 不含结尾的 0).
+/// 事件表每项为: 时间戳纳秒(8), 通道号(4), 事件类型(2), 保留(2), rc(4), 原始长度(4), 截获长度(4), 截获的字节流.
+///
+/// @note 被包装的 TCTI 上下文以及 attach() 返回的上下文必须在 WireTracer 析构之前停止使用
+class WireTracer {
+public:
+    /// 事件类型
+    enum EventKind {
+        EVENT_COMMAND = 1, ///< transmit() 发出的命令帧, 时间戳为调用 transmit() 的时刻
+        EVENT_RESPONSE = 2, ///< receive() 取回的应答帧(或 receive() 的错误), 时间戳为 receive() 返回的时刻
+        EVENT_CANCEL = 3, ///< cancel()
+        EVENT_LOG_TEXT = 4, ///< TCTI 库通过 logCallback 输出的日志文本
+        EVENT_LOG_BUFFER = 5, ///< TCTI 库通过 logBufferCallback 输出的字节流
+    };
+
+    /// 构造函数
+    WireTracer(size_t capacity=4096, ///< 环形缓冲区的事件个数, 向上取整为 2 的幂
+            size_t maxCapturedBytes=MAX_COMMAND_SIZE ///< 每个事件最多保存的字节数
+            );
+    /// 析构函数
+    ~WireTracer();
+
+    /**
+     * 包装一个 TCTI 上下文
+     *
+     * 返回的上下文把全部调用转发给 tctiContext, 同时记录命令帧/应答帧,
+     * 可直接传给 Tss2_Sys_Initialize(); 它也是 LogCallback()/LogBufferCallback() 所需的 logData.
+     * 转发时才读取 tctiContext 中的函数指针, 因此可以在 tctiContext 初始化之前调用本函数.
+     *
+     * @return 由 WireTracer 持有的转发上下文, 在 WireTracer 析构时释放
+     */
+    TSS2_TCTI_CONTEXT *attach(TSS2_TCTI_CONTEXT *tctiContext, ///< 被跟踪的 TCTI 上下文
+            const char *name ///< 通道名称, 显示在 Chrome trace 的线程名中
+            );
+
+    /// TCTI_LOG_CALLBACK 回调函数, data 必须是 attach() 返回的上下文
+    static int LogCallback(void *data, printf_type type, const char *format, ...);
+    /// TCTI_LOG_BUFFER_CALLBACK 回调函数, userData 必须是 attach() 返回的上下文
+    static int LogBufferCallback(void *userData, printf_type type, UINT8 *buffer, UINT32 length);
+
+    /// 记录一个事件, 时间戳取当前时刻
+    void record(uint32_t channel, EventKind kind, TSS2_RC rc, const uint8_t *data, size_t length);
+
+    /// 取出环形缓冲区中现存全部事件的副本, 按记录顺序排列
+    std::vector<WireTraceEvent> snapshot(
+            uint64_t *droppedCount=NULL ///< 输出(可选): 截至本次快照被覆盖的事件个数, 与返回的事件取自同一时刻
+            ) const;
+    /// 全部通道的名称, 下标即通道号
+    std::vector<std::string> channelNames() const;
+    /// 累计记录的事件个数(包括已被覆盖的事件)
+    uint64_t recordedCount() const;
+    /// 因缓冲区写满而被覆盖的事件个数
+    uint64_t droppedCount() const;
+
+    /**
+     * 保存为二进制跟踪文件
+     *
+     * @throws std::ios::failure 文件无法写入时抛出
+     */
+    void dumpBinary(const char *fileName) const;
+    /// 以 Chrome trace JSON 格式输出
+    void writeChromeTrace(FILE *fp) const;
+
+    /**
+     * 读取二进制跟踪文件
+     *
+     * @throws std::ios::failure 文件无法打开时抛出
+     * @throws std::runtime_error 文件格式错误时抛出
+     */
+    static void LoadBinary(const char *fileName,
+            std::vector<std::string>& channelNames, ///< 输出: 通道名称
+            std::vector<WireTraceEvent>& events, ///< 输出: 事件
+            uint64_t *droppedCount=NULL ///< 输出(可选): 被覆盖的事件个数
+            );
+    /// 以 Chrome trace JSON 格式输出给定的事件
+    static void WriteChromeTrace(FILE *fp,
+            const std::vector<std::string>& channelNames,
+            const std::vector<WireTraceEvent>& events,
+            uint64_t droppedCount=0);
+    /**
+     * 把二进制跟踪文件转换为 Chrome trace JSON 文件
+     *
+     * @throws std::ios::failure 文件无法读写时抛出
+     * @throws std::runtime_error 二进制文件格式错误时抛出
+     */
+    static void ConvertToChromeTrace(const char *binaryFileName, const char *jsonFileName);
+
+private:
+    struct Slot;
+    struct TracedTcti;
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t now() const;
+    void record(uint64_t timestampNs, uint32_t channel, EventKind kind, TSS2_RC rc, const uint8_t *data, size_t length);
+
+    const Clock::time_point m_epoch;
+    size_t m_capacity; ///< 2 的幂
+    size_t m_maxCapturedBytes;
+    Slot *m_slots;
+    uint8_t *m_pool; ///< 各槽位的字节流存储区, 每个槽位 m_maxCapturedBytes 字节
+    std::atomic<uint64_t> m_head; ///< 下一个待领取的序号
+
+    mutable std::mutex m_mutex; ///< 只保护通道表, 不在记录事件的路径上使用
+    std::vector<std::string> m_channelNames;
+    std::vector<TracedTcti *> m_tracedTctis;
+
+    // 禁止复制
+    WireTracer(const WireTracer&);
+    WireTracer& operator=(const WireTracer&);
+};
+
+#endif // __cplusplus
+#endif // WIRE_TRACER_H_
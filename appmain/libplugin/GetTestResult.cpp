@@ -0,0 +1,72 @@
+/* encoding: utf-8 */
+/// @copyright Copyright (c) 2017, 青岛中怡智能安全研究院有限公司
+/// All rights reserved.
+
+#include <sapi/tpm20.h>
+#include "TPMCommand.h"
+using namespace TPMCommands;
+
+// ============================================================================
+// 自定义输入输出参数格式
+// ============================================================================
+
+/// 私有结构体 GetTestResult_Out
+typedef struct Out {
+    TPM2B_MAX_BUFFER outData;
+    TPM_RC testResult;
+} GetTestResult_Out;
+
+// ============================================================================
+// 构造函数
+// ============================================================================
+GetTestResult::GetTestResult() {
+    m_in = NULL; // 该命令没有输入参数
+    m_out = new GetTestResult_Out;
+    memset(m_out, 0x00, sizeof(*m_out));
+    m_out->testResult = TPM_RC_FAILURE;
+
+    m_cmdAuthsCount = 0; // 查询自检结果时不需要授权
+}
+
+// ============================================================================
+// 析构函数
+// ============================================================================
+GetTestResult::~GetTestResult() {
+    delete m_out;
+}
+
+// ============================================================================
+// 组建命令帧报文
+// ============================================================================
+void GetTestResult::buildCmdPacket(TSS2_SYS_CONTEXT *ctx) {
+    Tss2_Sys_GetTestResult_Prepare(ctx); // NOTE: 此处应检查函数返回值
+    this->TPMCommand::buildCmdPacket(ctx);
+}
+
+// ============================================================================
+// 解码应答桢报文
+// ============================================================================
+void GetTestResult::unpackRspPacket(TSS2_SYS_CONTEXT *ctx) {
+    this->TPMCommand::unpackRspPacket(ctx);
+    m_out->outData.t.size = sizeof(m_out->outData.t.buffer);
+    m_out->testResult = TPM_RC_FAILURE;
+    Tss2_Sys_GetTestResult_Complete(// NOTE: 此处应检查函数返回值
+            ctx,
+            &(m_out->outData),
+            &(m_out->testResult)
+            );
+}
+
+// ============================================================================
+// 输出自检结果
+// ============================================================================
+TPM_RC GetTestResult::outTestResult() {
+    return m_out->testResult;
+}
+
+// ============================================================================
+// 输出厂商自定义的自检详细信息
+// ============================================================================
+const TPM2B_MAX_BUFFER& GetTestResult::outData() {
+    return m_out->outData;
+}
@@ -18,21 +18,22 @@ TPMCommand::TPMCommand() {
     cmdAuth.sessionAttributes.val = 0; // 默认清除所有标记位
     cmdAuth.nonce.t.size = 0;
     cmdAuth.hmac.t.size = 0;
+
+    // 授权区指针数组只需构建一次
+    for (int i = 0; i < 3; i++) {
+        m_cmdAuthPointers[i] = &(m_sendAuthValues[i]);
+        m_rspAuthPointers[i] = &(m_fetchAuthResponse[i]);
+    }
+    m_cmdAuthsArray.cmdAuths = m_cmdAuthPointers;
+    m_cmdAuthsArray.cmdAuthsCount = 0;
+    m_rspAuthsArray.rspAuths = m_rspAuthPointers;
+    m_rspAuthsArray.rspAuthsCount = 0;
 }
 
 void TPMCommand::buildCmdPacket(TSS2_SYS_CONTEXT *ctx) {
-    TPMS_AUTH_COMMAND *cmdAuths[3];
-    TSS2_SYS_CMD_AUTHS cmdAuthsArray;
-
     if (m_cmdAuthsCount >= 1) {
-        cmdAuthsArray.cmdAuths = cmdAuths;
-        cmdAuths[0] = cmdAuths[1] = cmdAuths[2] = NULL;
-        cmdAuthsArray.cmdAuthsCount = 0;
-        for (int i = 0; i < 3 && i < m_cmdAuthsCount; i++) {
-            cmdAuthsArray.cmdAuthsCount++;
-            cmdAuthsArray.cmdAuths[i] = &(m_sendAuthValues[i]);
-        }
-        TSS2_RC err = Tss2_Sys_SetCmdAuths(ctx, &cmdAuthsArray);
+        m_cmdAuthsArray.cmdAuthsCount = (m_cmdAuthsCount < 3) ? m_cmdAuthsCount : 3;
+        TSS2_RC err = Tss2_Sys_SetCmdAuths(ctx, &m_cmdAuthsArray);
         if (err) {
             // TODO: 此处应抛出异常
             if (TSS2_SYS_RC_BAD_SEQUENCE == err) {
@@ -45,20 +46,10 @@ void TPMCommand::buildCmdPacket(TSS2_SYS_CONTEXT *ctx) {
 }
 
 void TPMCommand::unpackRspPacket(TSS2_SYS_CONTEXT *ctx) {
-    TPMS_AUTH_RESPONSE *rspAuths[3];
-    TSS2_SYS_RSP_AUTHS rspAuthsArray;
-
-    rspAuthsArray.rspAuthsCount = 0;
     if (m_cmdAuthsCount >= 1) {
-        rspAuthsArray.rspAuths = rspAuths;
-        rspAuths[0] = rspAuths[1] = rspAuths[2] = NULL;
-        rspAuthsArray.rspAuthsCount = 0;
-        for (int i = 0; i < 3 && i < m_cmdAuthsCount; i++) {
-            rspAuthsArray.rspAuthsCount++;
-            rspAuthsArray.rspAuths[i] = &(m_fetchAuthResponse[i]);
-        }
-        Tss2_Sys_GetRspAuths(ctx, &rspAuthsArray);
-        m_rspAuthsCount = rspAuthsArray.rspAuthsCount;
+        m_rspAuthsArray.rspAuthsCount = (m_cmdAuthsCount < 3) ? m_cmdAuthsCount : 3;
+        Tss2_Sys_GetRspAuths(ctx, &m_rspAuthsArray);
+        m_rspAuthsCount = m_rspAuthsArray.rspAuthsCount;
     }
 }
 